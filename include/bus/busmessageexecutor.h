@@ -0,0 +1,87 @@
+/*
+* Copyright 2025 Ingemar Hedvall
+* SPDX-License-Identifier: MIT
+*/
+
+/** \file busmessageexecutor.h
+ * \brief Worker pool that runs subscription callbacks.
+ */
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace bus {
+
+/** \class BusMessageExecutor busmessageexecutor.h "bus/busmessageexecutor.h"
+ * \brief Runs tasks on a pool of worker threads.
+ *
+ * The executor is used by the IBusMessageBroker::Subscribe() function to
+ * move the callbacks away from the transport threads.
+ * The task queue is bounded. If the queue is full, the Post() function
+ * blocks until a worker have taken a task. This is the back-pressure
+ * mechanism, a slow callback slows down the transport instead of growing
+ * an unlimited queue.
+ *
+ * Note that tasks are run in parallel if the executor has more than one
+ * worker, so the message order is only kept with a single worker.
+ */
+class BusMessageExecutor {
+ public:
+  using Task = std::function<void()>; ///< Task (callback) type.
+
+  /** \brief Creates and starts the worker threads.
+   *
+   * @param nof_workers Number of worker threads (at least one).
+   * @param max_tasks Max number of queued tasks (at least one).
+   */
+  explicit BusMessageExecutor(size_t nof_workers = 1,
+                              size_t max_tasks = 10'000);
+  virtual ~BusMessageExecutor(); ///< Stops the worker threads.
+
+  BusMessageExecutor(const BusMessageExecutor&) = delete;
+  BusMessageExecutor& operator=(const BusMessageExecutor&) = delete;
+
+  /** \brief Queues a task.
+   *
+   * Blocks while the task queue is full.
+   * @param task Task to run.
+   * @return False if the executor is stopped.
+   */
+  bool Post(Task task);
+
+  /** \brief Returns number of queued tasks. */
+  [[nodiscard]] size_t Size() const;
+
+  /** \brief Returns max number of queued tasks. */
+  [[nodiscard]] size_t MaxTasks() const { return max_tasks_; }
+
+  /** \brief Returns number of worker threads. */
+  [[nodiscard]] size_t NofWorkers() const { return workers_.size(); }
+
+  /** \brief Stops the workers.
+   *
+   * Queued tasks are run before the workers stop. Any following Post()
+   * call is rejected.
+   */
+  void Stop();
+
+ private:
+  size_t max_tasks_;
+  std::deque<Task> tasks_;
+  mutable std::mutex task_mutex_;
+  std::condition_variable task_not_empty_;
+  std::condition_variable task_not_full_;
+  std::atomic<bool> stop_workers_ = false;
+  std::vector<std::thread> workers_;
+
+  void WorkerThread();
+};
+
+}  // namespace bus
@@ -0,0 +1,100 @@
+/*
+* Copyright 2025 Ingemar Hedvall
+* SPDX-License-Identifier: MIT
+*/
+
+/** \file busmessagefilter.h
+ * \brief Subscription filter on bus channel, message type and CAN ID.
+ */
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "bus/busmessageview.h"
+#include "bus/canidfilter.h"
+#include "bus/ibusmessage.h"
+
+namespace bus {
+
+/** \class BusMessageFilter busmessagefilter.h "bus/busmessagefilter.h"
+ * \brief Selects which messages a subscriber receives.
+ *
+ * The filter have 3 independent criteria. A message passes the filter if
+ * it passes all of them. An empty criteria passes all messages, so a
+ * default constructed filter passes everything.
+ *
+ * The CAN ID criteria only applies to CAN data frames. Other message types
+ * are not tested against the CAN IDs.
+ */
+class BusMessageFilter {
+ public:
+  /** \brief Adds a bus channel to the filter. */
+  void AddBusChannel(uint16_t channel);
+
+  /** \brief Returns the bus channel list. Empty list means all channels. */
+  [[nodiscard]] const std::vector<uint16_t>& BusChannels() const {
+    return channels_;
+  }
+
+  /** \brief Adds a message type to the filter. */
+  void AddType(BusMessageType type);
+
+  /** \brief Returns the message type list. Empty list means all types. */
+  [[nodiscard]] const std::vector<BusMessageType>& Types() const {
+    return types_;
+  }
+
+  /** \brief Returns the CAN ID filter. Empty filter means all IDs. */
+  [[nodiscard]] CanIdFilter& CanIds() { return can_ids_; }
+
+  /** \brief Returns the CAN ID filter. Empty filter means all IDs. */
+  [[nodiscard]] const CanIdFilter& CanIds() const { return can_ids_; }
+
+  /** \brief Removes all criteria. */
+  void Clear();
+
+  /** \brief Returns true if the filter passes all messages. */
+  [[nodiscard]] bool Empty() const;
+
+  /** \brief Serializes the filter.
+   *
+   * The filter is serialized when a TCP/IP client sends its subscription
+   * filter to the server.
+   * @param dest Destination byte array. The size is set by the function.
+   */
+  void ToRaw(std::vector<uint8_t>& dest) const;
+
+  /** \brief Deserializes a filter that was serialized by ToRaw().
+   *
+   * @param source Source byte array.
+   * @return False if the byte array isn't a valid filter.
+   */
+  [[nodiscard]] bool FromRaw(std::span<const uint8_t> source);
+
+  /** \brief Returns true if the message passes the filter.
+   *
+   * @param message Message object.
+   * @return True if the message passes the filter.
+   */
+  [[nodiscard]] bool Match(const IBusMessage& message) const;
+
+  /** \brief Returns true if the serialized message passes the filter.
+   *
+   * The test is done without creating any message object.
+   * Invalid messages never pass the filter.
+   * @param message View of a serialized message.
+   * @return True if the message passes the filter.
+   */
+  [[nodiscard]] bool Match(const BusMessageView& message) const;
+
+ private:
+  std::vector<uint16_t> channels_;
+  std::vector<BusMessageType> types_;
+  CanIdFilter can_ids_;
+
+  [[nodiscard]] bool MatchHeader(BusMessageType type, uint16_t channel) const;
+};
+
+}  // namespace bus
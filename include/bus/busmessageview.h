@@ -0,0 +1,109 @@
+/*
+* Copyright 2025 Ingemar Hedvall
+* SPDX-License-Identifier: MIT
+*/
+
+/** \file busmessageview.h
+ * \brief Read-only view of a serialized bus message header.
+ *
+ * The view reads the message header fields directly from a byte array
+ * without creating any message object.
+ */
+#pragma once
+
+#include <cstdint>
+#include <span>
+
+#include "bus/ibusmessage.h"
+#include "bus/littlebuffer.h"
+
+namespace bus {
+
+/** \class BusMessageView busmessageview.h "bus/busmessageview.h"
+ * \brief Non-owning view of a serialized bus message.
+ *
+ * The view is a lightweight alternative to IBusMessage for read-only
+ * consumers as filters, routers and statistics.
+ * The fields are read on demand at the fixed offsets defined in the
+ * IBusMessage header layout.
+ * The view doesn't own the bytes, so the byte array must outlive the view.
+ *
+ * Check the Valid() function before using any of the other functions.
+ */
+class BusMessageView {
+ public:
+  BusMessageView() = default; ///< Creates an empty (invalid) view.
+
+  /** \brief Creates a view over a serialized message.
+   *
+   * @param source Serialized message bytes.
+   */
+  explicit BusMessageView(std::span<const uint8_t> source) noexcept
+      : source_(source) {}
+
+  /** \brief Returns true if the buffer holds a complete message header.
+   *
+   * The header length must be within the buffer size.
+   * @return True if the header fields can be read.
+   */
+  [[nodiscard]] bool Valid() const noexcept {
+    return source_.size() >= kHeaderSize && Size() >= kHeaderSize &&
+           Size() <= source_.size();
+  }
+
+  /** \brief Returns type of message. */
+  [[nodiscard]] BusMessageType Type() const noexcept {
+    return static_cast<BusMessageType>(Read<uint16_t>(0));
+  }
+
+  /** \brief Returns the version number of the message. */
+  [[nodiscard]] uint16_t Version() const noexcept {
+    return Read<uint16_t>(2);
+  }
+
+  /** \brief Returns the total size of the message. */
+  [[nodiscard]] uint32_t Size() const noexcept {
+    return Read<uint32_t>(4);
+  }
+
+  /** \brief Returns the timestamp, nanoseconds since 1970 (UTC). */
+  [[nodiscard]] uint64_t Timestamp() const noexcept {
+    return Read<uint64_t>(8);
+  }
+
+  /** \brief Returns the bus channel number. */
+  [[nodiscard]] uint16_t BusChannel() const noexcept {
+    return Read<uint16_t>(16);
+  }
+
+  /** \brief Returns the serialized message bytes.
+   *
+   * Returns an empty span if the view isn't valid.
+   * @return The message bytes.
+   */
+  [[nodiscard]] std::span<const uint8_t> Raw() const noexcept {
+    return Valid() ? source_.first(Size()) : std::span<const uint8_t>();
+  }
+
+ protected:
+  static constexpr size_t kHeaderSize = 18; ///< Size of the message header.
+
+  /** \brief Reads a little endian value at a byte offset.
+   *
+   * Returns 0 if the value is outside the buffer.
+   * @tparam T Type of value.
+   * @param offset Byte offset in the message.
+   * @return The value.
+   */
+  template <typename T>
+  [[nodiscard]] T Read(size_t offset) const noexcept {
+    if (offset + sizeof(T) > source_.size()) {
+      return T{};
+    }
+    return LittleBuffer<T>(source_.data(), offset).value();
+  }
+
+  std::span<const uint8_t> source_; ///< Serialized message.
+};
+
+}  // namespace bus
@@ -0,0 +1,39 @@
+/*
+* Copyright 2025 Ingemar Hedvall
+* SPDX-License-Identifier: MIT
+*/
+
+/** \file cancompactlayout.h
+ * \brief Bit values of the compact CAN data frame layout (version 1).
+ *
+ * The constants are shared by the CanDataFrame serialization and the
+ * CanFrameView parser, so both read the same layout.
+ */
+#pragma once
+
+#include <cstdint>
+
+namespace bus {
+
+/** \brief Smallest compact frame, header + flags byte + 1-byte ID. */
+constexpr uint32_t kCompactMinSize = 20;
+
+// Flags byte (byte 18) of the compact layout.
+constexpr uint8_t kCompactDlcMask = 0x0F; ///< Data length code.
+constexpr uint8_t kCompactDir = 0x10; ///< Transmitted frame.
+constexpr uint8_t kCompactEdl = 0x20; ///< CAN FD frame.
+constexpr uint8_t kCompactBrs = 0x40; ///< Bit rate switch.
+constexpr uint8_t kCompactOptions = 0x80; ///< An options varint follows.
+
+// Options varint of the compact layout.
+constexpr uint32_t kOptionCrc = 0x001; ///< A CRC varint follows.
+constexpr uint32_t kOptionDuration = 0x002; ///< A duration varint follows.
+constexpr uint32_t kOptionSrr = 0x004; ///< SRR bit.
+constexpr uint32_t kOptionEsi = 0x008; ///< Error state indicator.
+constexpr uint32_t kOptionRtr = 0x010; ///< Remote frame.
+constexpr uint32_t kOptionR0 = 0x020; ///< R0 bit.
+constexpr uint32_t kOptionR1 = 0x040; ///< R1 bit.
+constexpr uint32_t kOptionWakeUp = 0x080; ///< Wake up.
+constexpr uint32_t kOptionSingleWire = 0x100; ///< Single wire.
+
+}  // namespace bus
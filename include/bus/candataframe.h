@@ -57,9 +57,35 @@ enum class CanErrorType : uint8_t {
  * <tr><td>30</td><td>Frame Duration (ns)/td><td>uint32_t</td></tr>
  * <tr><td>34</td><td>Data Bytes</td><td>Data Length bytes</td></tr>
  * </table>
+ *
+ * Version 1 (kCompactVersion) is a compact variable-length layout that
+ * roughly halves the size of a classic CAN frame. The message header is
+ * unchanged, so the BusMessageView and filters works on both layouts.
+ * The options and the CRC/duration values are only stored if any of
+ * them is non-zero. The data length is the remaining bytes of the message.
+ * <table>
+ * <caption id="CanCompactLayout">CAN Data Frame Compact Layout</caption>
+ * <tr><th>Byte (Bits) Offset</th><th>Description</th><th>Size</th></tr>
+ * <tr><td>0-17</td><td>Message Header</td><td>18 bytes</td></tr>
+ * <tr><td>18:0-3</td><td>DLC</td><td>4-bit</td></tr>
+ * <tr><td>18:4</td><td>Direction (Rx=0, Tx=1)</td><td>1-bit</td></tr>
+ * <tr><td>18:5</td><td>EDL</td><td>1-bit</td></tr>
+ * <tr><td>18:6</td><td>BRS</td><td>1-bit</td></tr>
+ * <tr><td>18:7</td><td>Options follows</td><td>1-bit</td></tr>
+ * <tr><td>19</td><td>CAN ID << 1 | IDE</td><td>varint</td></tr>
+ * <tr><td>-</td><td>Options (bit 0: CRC follows, 1: Duration follows,
+ * 2: SRR, 3: ESI, 4: RTR, 5: R0, 6: R1, 7: Wake Up, 8: Single Wire)</td>
+ * <td>varint</td></tr>
+ * <tr><td>-</td><td>CRC (optional)</td><td>varint</td></tr>
+ * <tr><td>-</td><td>Frame Duration (ns) (optional)</td><td>varint</td></tr>
+ * <tr><td>-</td><td>Data Bytes</td><td>Remaining bytes</td></tr>
+ * </table>
  */
 class CanDataFrame : public IBusMessage  {
  public:
+    /** \brief Version number of the compact layout. */
+    static constexpr uint16_t kCompactVersion = 1;
+
     CanDataFrame(); ///< Deafult constructor.
     explicit CanDataFrame(CanErrorType type) = delete;
 
@@ -200,16 +226,20 @@ class CanDataFrame : public IBusMessage  {
    *
    * Serialize the message to a destination byte array.
    * The destination array size is set by the function.
+   * The compact layout is used if the version is set to kCompactVersion.
    * @param dest Destination buffer.
    */
   void ToRaw(std::vector<uint8_t>& dest) const override;
 
-  /** \brief Deserialize the message.
+  /** \brief Deserialize the message without exceptions.
    *
    * Reads in the byte array and desrialize the message.
+   * All lengths are validated before the buffer is read.
    * @param source Source buffer.
+   * @return Decode status. BusDecodeStatus::Ok if the message was decoded.
    */
-  void FromRaw(const std::vector<uint8_t>& source) override;
+  [[nodiscard]] BusDecodeStatus Decode(
+      std::span<const uint8_t> source) noexcept override;
   std::string ToString(uint64_t loglevel) const override;
  private:
   uint32_t message_id_ = 0; ///< Message ID with bit 31 set if extended ID.
@@ -220,6 +250,12 @@ class CanDataFrame : public IBusMessage  {
   CanErrorType error_type_ = CanErrorType::UNKNOWN_ERROR; ///< Error type.
   uint32_t frame_duration_ = 0;
   uint32_t crc_ = 0;
+
+  [[nodiscard]] uint32_t RawSize() const; ///< Serialized size.
+  [[nodiscard]] uint32_t CompactOptions() const;
+  void CompactToRaw(std::vector<uint8_t>& dest) const;
+  [[nodiscard]] BusDecodeStatus DecodeCompact(
+      std::span<const uint8_t> source) noexcept;
 };
 
 }  // namespace mdf
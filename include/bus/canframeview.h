@@ -0,0 +1,191 @@
+/*
+* Copyright 2025 Ingemar Hedvall
+* SPDX-License-Identifier: MIT
+*/
+
+/** \file canframeview.h
+ * \brief Read-only view of a serialized CAN data frame.
+ *
+ * The view reads the CAN fields directly from a byte array without
+ * creating a CanDataFrame object.
+ */
+#pragma once
+
+#include <cstdint>
+#include <span>
+
+#include "bus/busmessageview.h"
+#include "bus/cancompactlayout.h"
+#include "bus/varint.h"
+
+namespace bus {
+
+/** \class CanFrameView canframeview.h "bus/canframeview.h"
+ * \brief Non-owning view of a serialized CAN data frame.
+ *
+ * The view follows the CanDataFrame byte layout. Both the fixed layout
+ * (version 0) and the compact layout (version 1) are supported. The CAN
+ * fields are parsed once when the view is created.
+ * No payload is copied and no bit set is created, which suits read-only
+ * consumers as gateways, filters and bus-load statistics.
+ *
+ * Check the Valid() function before using any of the other functions.
+ */
+class CanFrameView : public BusMessageView {
+ public:
+  CanFrameView() = default; ///< Creates an empty (invalid) view.
+
+  /** \brief Creates a view over a serialized CAN data frame.
+   *
+   * @param source Serialized message bytes.
+   */
+  explicit CanFrameView(std::span<const uint8_t> source) noexcept
+      : BusMessageView(source) {
+    if (BusMessageView::Valid()) {
+      valid_ = Version() == kCompactVersion ? ParseCompact() : Parse();
+    }
+  }
+
+  /** \brief Returns true if the buffer holds a complete CAN frame.
+   *
+   * The fixed part of the frame and the data bytes must be within the
+   * message size.
+   * @return True if all fields can be read.
+   */
+  [[nodiscard]] bool Valid() const noexcept { return valid_; }
+
+  /** \brief DBC message ID. Note that bit 31 indicate extended ID. */
+  [[nodiscard]] uint32_t MessageId() const noexcept { return message_id_; }
+
+  /** \brief 29/11 bit CAN message ID. Note that bit 31 is not used. */
+  [[nodiscard]] uint32_t CanId() const noexcept {
+    return MessageId() & ~kExtendedBit;
+  }
+
+  /** \brief Returns true if the CAN ID uses 29-bit addressing. */
+  [[nodiscard]] bool ExtendedId() const noexcept {
+    return (MessageId() & kExtendedBit) != 0;
+  }
+
+  /** \brief Returns the data length code (DLC). */
+  [[nodiscard]] uint8_t Dlc() const noexcept { return dlc_; }
+
+  /** \brief Returns number of data bytes. */
+  [[nodiscard]] uint8_t DataLength() const noexcept { return data_length_; }
+
+  /** \brief Returns the CRC code. */
+  [[nodiscard]] uint32_t Crc() const noexcept { return crc_; }
+
+  /** \brief Returns true if the message was transmitted. */
+  [[nodiscard]] bool Dir() const noexcept { return Flag(kFlagDir); }
+  [[nodiscard]] bool Srr() const noexcept { return Flag(kFlagSrr); } ///< SRR bit.
+  [[nodiscard]] bool Edl() const noexcept { return Flag(kFlagEdl); } ///< CAN FD.
+  [[nodiscard]] bool Brs() const noexcept { return Flag(kFlagBrs); } ///< Bit rate switch.
+  [[nodiscard]] bool Esi() const noexcept { return Flag(kFlagEsi); } ///< Error state.
+  [[nodiscard]] bool Rtr() const noexcept { return Flag(kFlagRtr); } ///< Remote frame.
+  [[nodiscard]] bool R0() const noexcept { return Flag(kFlagR0); } ///< R0 flag.
+  [[nodiscard]] bool R1() const noexcept { return Flag(kFlagR1); } ///< R1 flag.
+  [[nodiscard]] bool WakeUp() const noexcept { return Flag(kFlagWakeUp); } ///< Wake up.
+  [[nodiscard]] bool SingleWire() const noexcept { return Flag(kFlagSingleWire); } ///< Single wire.
+
+  /** \brief Frame duration in nano-seconds. */
+  [[nodiscard]] uint32_t FrameDuration() const noexcept {
+    return frame_duration_;
+  }
+
+  /** \brief Returns the payload data bytes.
+   *
+   * The span points into the source buffer. An empty span is returned if
+   * the view isn't valid.
+   * @return Payload data bytes.
+   */
+  [[nodiscard]] std::span<const uint8_t> DataBytes() const noexcept {
+    return Valid() ? source_.subspan(data_offset_, DataLength())
+                   : std::span<const uint8_t>();
+  }
+
+ private:
+  static constexpr size_t kFrameSize = 34; ///< Fixed part of the frame.
+  static constexpr uint16_t kCompactVersion = 1; ///< Compact layout.
+  static constexpr uint32_t kExtendedBit = 0x80000000;
+  static constexpr size_t kMaxDataLength = 64; ///< CAN FD max length.
+
+  // Flags as bytes 28-29 in the fixed layout.
+  static constexpr uint16_t kFlagDir = 0x0001;
+  static constexpr uint16_t kFlagSrr = 0x0002;
+  static constexpr uint16_t kFlagEdl = 0x0004;
+  static constexpr uint16_t kFlagBrs = 0x0008;
+  static constexpr uint16_t kFlagEsi = 0x0010;
+  static constexpr uint16_t kFlagRtr = 0x0020;
+  static constexpr uint16_t kFlagR0 = 0x0040;
+  static constexpr uint16_t kFlagR1 = 0x0080;
+  static constexpr uint16_t kFlagWakeUp = 0x0100;
+  static constexpr uint16_t kFlagSingleWire = 0x0200;
+
+  bool valid_ = false;
+  uint32_t message_id_ = 0;
+  uint8_t dlc_ = 0;
+  uint8_t data_length_ = 0;
+  uint16_t flags_ = 0; ///< Flags as bytes 28-29 in the fixed layout.
+  uint32_t crc_ = 0;
+  uint32_t frame_duration_ = 0;
+  size_t data_offset_ = kFrameSize;
+
+  [[nodiscard]] bool Flag(uint16_t mask) const noexcept {
+    return (flags_ & mask) != 0;
+  }
+
+  [[nodiscard]] bool Parse() noexcept {
+    if (Size() < kFrameSize) {
+      return false;
+    }
+    message_id_ = Read<uint32_t>(18);
+    dlc_ = Read<uint8_t>(22);
+    data_length_ = Read<uint8_t>(23);
+    crc_ = Read<uint32_t>(24);
+    flags_ = Read<uint16_t>(28);
+    frame_duration_ = Read<uint32_t>(30);
+    return kFrameSize + data_length_ <= Size();
+  }
+
+  [[nodiscard]] bool ParseCompact() noexcept {
+    const auto message = source_.first(Size());
+    if (message.size() <= kHeaderSize) {
+      return false;
+    }
+    const uint8_t first = message[kHeaderSize];
+    uint32_t id = 0;
+    uint32_t options = 0;
+    size_t offset = ReadVarint(message, kHeaderSize + 1, id);
+    if (offset > 0 && (first & kCompactOptions) != 0) {
+      offset = ReadVarint(message, offset, options);
+    }
+    if (offset > 0 && (options & kOptionCrc) != 0) {
+      offset = ReadVarint(message, offset, crc_);
+    }
+    if (offset > 0 && (options & kOptionDuration) != 0) {
+      offset = ReadVarint(message, offset, frame_duration_);
+    }
+    if (offset == 0 || message.size() - offset > kMaxDataLength) {
+      return false;
+    }
+    message_id_ = (id >> 1) | ((id & 0x01) != 0 ? kExtendedBit : 0);
+    dlc_ = first & kCompactDlcMask;
+    data_length_ = static_cast<uint8_t>(message.size() - offset);
+    data_offset_ = offset;
+    // Map the compact flags and options onto the fixed layout flags.
+    flags_ = (first & kCompactDir) != 0 ? kFlagDir : 0;
+    flags_ |= (first & kCompactEdl) != 0 ? kFlagEdl : 0;
+    flags_ |= (first & kCompactBrs) != 0 ? kFlagBrs : 0;
+    flags_ |= (options & kOptionSrr) != 0 ? kFlagSrr : 0;
+    flags_ |= (options & kOptionEsi) != 0 ? kFlagEsi : 0;
+    flags_ |= (options & kOptionRtr) != 0 ? kFlagRtr : 0;
+    flags_ |= (options & kOptionR0) != 0 ? kFlagR0 : 0;
+    flags_ |= (options & kOptionR1) != 0 ? kFlagR1 : 0;
+    flags_ |= (options & kOptionWakeUp) != 0 ? kFlagWakeUp : 0;
+    flags_ |= (options & kOptionSingleWire) != 0 ? kFlagSingleWire : 0;
+    return true;
+  }
+};
+
+}  // namespace bus
@@ -0,0 +1,120 @@
+/*
+* Copyright 2025 Ingemar Hedvall
+* SPDX-License-Identifier: MIT
+*/
+
+/** \file canidfilter.h
+ * \brief Bulk CAN message ID filter over serialized message batches.
+ *
+ * The filter scans a contiguous run of serialized messages and returns
+ * the messages that match an ID bitmap or an ID range list.
+ */
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace bus {
+
+/** \class CanIdFilter canidfilter.h "bus/canidfilter.h"
+ * \brief Filters CAN data frames on their message ID.
+ *
+ * The filter holds a bitmap for the 11-bit standard IDs and a list of ID
+ * ranges for the extended IDs.
+ * Note that the filter uses the message ID, i.e. the CAN ID with bit 31
+ * set for extended IDs. An extended ID will never match a standard ID.
+ *
+ * The Scan() function is the inner loop of an ID based router.
+ * It scans a batch of length prefixed messages, the same format as used in
+ * the shared memory and on the TCP/IP links, without creating any message
+ * objects.
+ * The ID test is vectorized with AVX2 or SSE2 if the compiler targets
+ * these instruction sets, otherwise a scalar loop is used.
+ */
+class CanIdFilter {
+ public:
+  /** \brief Adds a message ID to the filter.
+   *
+   * Standard (11-bit) IDs are stored in a bitmap while extended IDs are
+   * added as a single value range.
+   * @param message_id Message ID. Bit 31 set if extended ID.
+   */
+  void AddId(uint32_t message_id);
+
+  /** \brief Adds a range of message IDs to the filter.
+   *
+   * @param first First message ID in the range.
+   * @param last Last message ID in the range (inclusive).
+   */
+  void AddRange(uint32_t first, uint32_t last);
+
+  /** \brief Removes all IDs from the filter. */
+  void Clear();
+
+  /** \brief Returns true if the filter doesn't include any ID. */
+  [[nodiscard]] bool Empty() const;
+
+  /** \brief Appends the filter to a byte array.
+   *
+   * The standard IDs are stored as a bitmap and the extended IDs as a
+   * list of ranges.
+   * @param dest Destination byte array.
+   */
+  void ToRaw(std::vector<uint8_t>& dest) const;
+
+  /** \brief Reads a filter that was stored by ToRaw().
+   *
+   * @param source Source byte array.
+   * @param offset Offset of the filter. Returns the offset after it.
+   * @return False if the filter is truncated.
+   */
+  [[nodiscard]] bool FromRaw(std::span<const uint8_t> source, size_t& offset);
+
+  /** \brief Returns true if the message ID passes the filter.
+   *
+   * @param message_id Message ID. Bit 31 set if extended ID.
+   * @return True if the ID matches.
+   */
+  [[nodiscard]] bool Match(uint32_t message_id) const noexcept;
+
+  /** \brief Tests a list of message IDs.
+   *
+   * The function tests up to 64 IDs and returns a bit mask where bit N
+   * is set if ID N matches.
+   * @param message_ids List of up to 64 message IDs.
+   * @return Bit mask of matching IDs.
+   */
+  [[nodiscard]] uint64_t MatchMask(
+      std::span<const uint32_t> message_ids) const noexcept;
+
+  /** \brief Scans a batch of serialized messages.
+   *
+   * The batch is a contiguous run of messages where each message is
+   * prefixed with its length (uint32_t).
+   * Only CAN data frames are tested, other messages are skipped.
+   * Frames in the compact layout are parsed by a CanFrameView.
+   * The scan stops at the first truncated message.
+   *
+   * The offsets of the matching messages are returned. The offset points
+   * to the first message byte after the length prefix, so a CanFrameView
+   * can be created directly on the batch.
+   * @param batch Length prefixed serialized messages.
+   * @param matches Offsets of the matching messages.
+   * @return Number of matching messages.
+   */
+  size_t Scan(std::span<const uint8_t> batch,
+              std::vector<size_t>& matches) const;
+
+ private:
+  static constexpr uint32_t kNofStandardIds = 2048;
+
+  /** \brief One bit for each standard (11-bit) ID. */
+  std::array<uint32_t, kNofStandardIds / 32> standard_ids_ = {};
+  bool has_standard_ids_ = false;
+  std::vector<uint32_t> first_ids_; ///< First ID of each range.
+  std::vector<uint32_t> last_ids_;  ///< Last ID of each range.
+};
+
+}  // namespace bus
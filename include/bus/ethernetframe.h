@@ -0,0 +1,110 @@
+/*
+* Copyright 2025 Ingemar Hedvall
+* SPDX-License-Identifier: MIT
+*/
+
+/** \file ethernetframe.h
+ * \brief Simple wrapper around an Ethernet frame.
+ *
+ * The class is a simple wrapper around an Ethernet frame. It is used when
+ * serializing Ethernet frames in a general way.
+ */
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "bus/ibusmessage.h"
+
+namespace bus {
+
+/** \class EthernetFrame ethernetframe.h "bus/ethernetframe.h"
+ * \brief Implements an interface against an Ethernet frame.
+ *
+ * The data bytes are the frame from the destination MAC address up to,
+ * but not including, the frame check sequence (FCS).
+ * Standard frames (including a VLAN tag) are stored inside the object,
+ * so they doesn't need any extra allocation. Jumbo frames up to 9216 bytes
+ * are stored in a heap buffer that is kept when the object is reused,
+ * e.g. when decoding a stream of frames into the same object.
+ *
+ * The serialization is according to table below and uses little endian
+ * byte order.
+ * <table>
+ * <caption id="EthernetFrameLayout">Ethernet Frame Message Layout</caption>
+ * <tr><th>Byte (Bits) Offset</th><th>Description</th><th>Size</th></tr>
+ * <tr><td>0-17</td><td>Message Header</td><td>18 bytes</td></tr>
+ * <tr><td>18:0</td><td>Direction (Rx=0, Tx=1)</td><td>1-bit</td></tr>
+ * <tr><td>18:1</td><td>FCS Valid</td><td>1-bit</td></tr>
+ * <tr><td>19</td><td>Reserved</td><td>uint8_t</td></tr>
+ * <tr><td>20</td><td>Data Length</td><td>uint16_t</td></tr>
+ * <tr><td>22</td><td>Frame Check Sequence (CRC)</td><td>uint32_t</td></tr>
+ * <tr><td>26</td><td>Frame Duration (ns)</td><td>uint32_t</td></tr>
+ * <tr><td>30</td><td>Data Bytes</td><td>Data Length bytes</td></tr>
+ * </table>
+ */
+class EthernetFrame : public IBusMessage {
+ public:
+  static constexpr size_t kInlineLength = 1'518; ///< Inline data bytes.
+  static constexpr size_t kMaxDataLength = 9'216; ///< Max (jumbo) length.
+
+  EthernetFrame(); ///< Default constructor.
+
+  /** \brief Returns the destination MAC address (48-bit). */
+  [[nodiscard]] uint64_t Destination() const;
+
+  /** \brief Returns the source MAC address (48-bit). */
+  [[nodiscard]] uint64_t Source() const;
+
+  /** \brief Returns the EtherType. A VLAN tag is skipped. */
+  [[nodiscard]] uint16_t EtherType() const;
+
+  /** \brief If set true, the message was transmitted. */
+  void Dir(bool transmit) { dir_ = transmit; }
+  /** \brief Returns true if the message was transmitted. */
+  [[nodiscard]] bool Dir() const { return dir_; }
+
+  /** \brief Sets the frame check sequence. */
+  void Crc(uint32_t crc) { crc_ = crc; crc_valid_ = true; }
+  /** \brief Returns the frame check sequence. */
+  [[nodiscard]] uint32_t Crc() const { return crc_; }
+  /** \brief Returns true if the frame check sequence is set. */
+  [[nodiscard]] bool CrcValid() const { return crc_valid_; }
+
+  void FrameDuration(uint32_t duration); ///< Frame duration in nano-seconds.
+  [[nodiscard]] uint32_t FrameDuration() const; ///< Frame duration in ns.
+
+  /** \brief Sets the frame bytes.
+   *
+   * Bytes above kMaxDataLength are ignored.
+   * @param data Frame bytes without the FCS.
+   */
+  void DataBytes(std::span<const uint8_t> data);
+
+  /** \brief Returns the frame bytes. */
+  [[nodiscard]] std::span<const uint8_t> DataBytes() const;
+
+  /** \brief Returns number of frame bytes. */
+  [[nodiscard]] uint16_t DataLength() const { return data_length_; }
+
+  void ToRaw(std::vector<uint8_t>& dest) const override;
+  [[nodiscard]] BusDecodeStatus Decode(
+      std::span<const uint8_t> source) noexcept override;
+  std::string ToString(uint64_t loglevel) const override;
+
+ private:
+  bool dir_ = false;
+  bool crc_valid_ = false;
+  uint16_t data_length_ = 0;
+  uint32_t crc_ = 0;
+  uint32_t frame_duration_ = 0;
+  std::array<uint8_t, kInlineLength> inline_bytes_ = {}; ///< Standard frames.
+  std::vector<uint8_t> jumbo_bytes_; ///< Jumbo frames.
+
+  [[nodiscard]] uint8_t* Data(size_t length);
+  [[nodiscard]] uint64_t MacAt(size_t offset) const;
+};
+
+}  // namespace bus
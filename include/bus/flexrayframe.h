@@ -0,0 +1,141 @@
+/*
+* Copyright 2025 Ingemar Hedvall
+* SPDX-License-Identifier: MIT
+*/
+
+/** \file flexrayframe.h
+ * \brief Simple wrapper around a FlexRay frame.
+ *
+ * The class is a simple wrapper around a FlexRay frame. It is used when
+ * serializing FlexRay frames in a general way.
+ */
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <span>
+
+#include "bus/ibusmessage.h"
+
+namespace bus {
+
+/** \brief FlexRay channel A and/or B. */
+enum class FlexRayChannel : uint8_t {
+  None = 0, ///< No channel.
+  A = 1,  ///< Channel A.
+  B = 2, ///< Channel B.
+  AB = 3 ///< Both channels.
+};
+
+/** \class FlexRayFrame flexrayframe.h "bus/flexrayframe.h"
+ * \brief Implements an interface against a FlexRay frame.
+ *
+ * A FlexRay frame is identified by its slot (frame ID) and cycle counter.
+ * The payload is 0-254 bytes.
+ * The serialization is according to table below and uses little endian
+ * byte order.
+ * <table>
+ * <caption id="FlexRayFrameLayout">FlexRay Frame Message Layout</caption>
+ * <tr><th>Byte (Bits) Offset</th><th>Description</th><th>Size</th></tr>
+ * <tr><td>0-17</td><td>Message Header</td><td>18 bytes</td></tr>
+ * <tr><td>18</td><td>Frame ID (slot)</td><td>uint16_t</td></tr>
+ * <tr><td>20</td><td>Cycle Counter</td><td>uint8_t</td></tr>
+ * <tr><td>21</td><td>Channel (A=1, B=2)</td><td>uint8_t</td></tr>
+ * <tr><td>22:0</td><td>Direction (Rx=0, Tx=1)</td><td>1-bit</td></tr>
+ * <tr><td>22:1</td><td>Startup Frame</td><td>1-bit</td></tr>
+ * <tr><td>22:2</td><td>Sync Frame</td><td>1-bit</td></tr>
+ * <tr><td>22:3</td><td>Null Frame</td><td>1-bit</td></tr>
+ * <tr><td>22:4</td><td>Payload Preamble</td><td>1-bit</td></tr>
+ * <tr><td>23</td><td>Data Length</td><td>uint8_t</td></tr>
+ * <tr><td>24</td><td>Header CRC</td><td>uint16_t</td></tr>
+ * <tr><td>26</td><td>Frame CRC</td><td>uint32_t</td></tr>
+ * <tr><td>30</td><td>Frame Duration (ns)</td><td>uint32_t</td></tr>
+ * <tr><td>34</td><td>Data Bytes</td><td>Data Length bytes</td></tr>
+ * </table>
+ */
+class FlexRayFrame : public IBusMessage {
+ public:
+  static constexpr size_t kMaxDataLength = 254; ///< Max number of data bytes.
+
+  FlexRayFrame(); ///< Default constructor.
+
+  void FrameId(uint16_t frame_id) { frame_id_ = frame_id; } ///< Slot ID.
+  [[nodiscard]] uint16_t FrameId() const { return frame_id_; } ///< Slot ID.
+
+  void Cycle(uint8_t cycle) { cycle_ = cycle; } ///< Cycle counter (0-63).
+  [[nodiscard]] uint8_t Cycle() const { return cycle_; } ///< Cycle counter.
+
+  void Channel(FlexRayChannel channel) { channel_ = channel; } ///< Channel.
+  [[nodiscard]] FlexRayChannel Channel() const { return channel_; } ///< Channel.
+
+  /** \brief If set true, the message was transmitted. */
+  void Dir(bool transmit) { SetFlag(kDirFlag, transmit); }
+  /** \brief Returns true if the message was transmitted. */
+  [[nodiscard]] bool Dir() const { return (flags_ & kDirFlag) != 0; }
+
+  void Startup(bool startup) { SetFlag(kStartupFlag, startup); } ///< Startup.
+  [[nodiscard]] bool Startup() const { return (flags_ & kStartupFlag) != 0; }
+
+  void Sync(bool sync) { SetFlag(kSyncFlag, sync); } ///< Sync frame.
+  [[nodiscard]] bool Sync() const { return (flags_ & kSyncFlag) != 0; }
+
+  void NullFrame(bool null) { SetFlag(kNullFlag, null); } ///< Null frame.
+  [[nodiscard]] bool NullFrame() const { return (flags_ & kNullFlag) != 0; }
+
+  /** \brief Payload preamble indicator. */
+  void PayloadPreamble(bool preamble) { SetFlag(kPreambleFlag, preamble); }
+  /** \brief Payload preamble indicator. */
+  [[nodiscard]] bool PayloadPreamble() const {
+    return (flags_ & kPreambleFlag) != 0;
+  }
+
+  void HeaderCrc(uint16_t crc) { header_crc_ = crc; } ///< Header CRC.
+  [[nodiscard]] uint16_t HeaderCrc() const { return header_crc_; }
+
+  void Crc(uint32_t crc) { crc_ = crc; } ///< Frame CRC.
+  [[nodiscard]] uint32_t Crc() const { return crc_; } ///< Frame CRC.
+
+  void FrameDuration(uint32_t duration); ///< Frame duration in nano-seconds.
+  [[nodiscard]] uint32_t FrameDuration() const; ///< Frame duration in ns.
+
+  /** \brief Sets the payload data bytes (max 254 bytes).
+   *
+   * Bytes above 254 are ignored.
+   * @param data Payload data.
+   */
+  void DataBytes(std::span<const uint8_t> data);
+
+  /** \brief Returns the payload data bytes. */
+  [[nodiscard]] std::span<const uint8_t> DataBytes() const;
+
+  /** \brief Returns number of data bytes. */
+  [[nodiscard]] uint8_t DataLength() const { return data_length_; }
+
+  void ToRaw(std::vector<uint8_t>& dest) const override;
+  [[nodiscard]] BusDecodeStatus Decode(
+      std::span<const uint8_t> source) noexcept override;
+  std::string ToString(uint64_t loglevel) const override;
+
+ private:
+  static constexpr uint8_t kDirFlag = 0x01;
+  static constexpr uint8_t kStartupFlag = 0x02;
+  static constexpr uint8_t kSyncFlag = 0x04;
+  static constexpr uint8_t kNullFlag = 0x08;
+  static constexpr uint8_t kPreambleFlag = 0x10;
+
+  uint16_t frame_id_ = 0;
+  uint8_t cycle_ = 0;
+  FlexRayChannel channel_ = FlexRayChannel::A;
+  uint8_t flags_ = 0;
+  uint8_t data_length_ = 0;
+  uint16_t header_crc_ = 0;
+  uint32_t crc_ = 0;
+  uint32_t frame_duration_ = 0;
+  std::array<uint8_t, kMaxDataLength> data_bytes_ = {};
+
+  void SetFlag(uint8_t flag, bool set) {
+    flags_ = set ? (flags_ | flag) : (flags_ & ~flag);
+  }
+};
+
+}  // namespace bus
@@ -14,13 +14,18 @@
 #include <cstdint>
 #include <memory>
 #include <vector>
+#include <span>
 
 #include <string>
 
 
 namespace bus {
 
-/** \brief Defines all message types. */
+/** \brief Defines all message types.
+ *
+ * Each bus has its own range of types. CAN uses 10-19, LIN 20-29,
+ * FlexRay 30-39, MOST 40-49 and Ethernet 50-59.
+ */
 enum class BusMessageType : uint16_t {
   Unknown = 0,
   Ctrl_BusChannel = 1,
@@ -28,7 +33,30 @@ enum class BusMessageType : uint16_t {
   CAN_RemoteFrame = 11,
   CAN_ErrorFrame = 12,
   CAN_OverloadFrame = 13,
+  LIN_Frame = 20, ///< LinFrame
+  FlexRay_Frame = 30, ///< FlexRayFrame
+  MOST_Message = 40, ///< MostMessage
+  ETH_Frame = 50, ///< EthernetFrame
+};
 
+/** \brief Upper limit of a serialized message.
+ *
+ * The transports reject larger messages, so a corrupt length field
+ * cannot allocate an unlimited amount of memory.
+ */
+constexpr uint32_t kMaxMessageSize = 0x100000;
+
+/** \brief Result of a message decode (deserialization).
+ *
+ * The decode functions never throw or allocate on the error path.
+ * Instead they return one of these status codes.
+ */
+enum class BusDecodeStatus : uint8_t {
+  Ok = 0,            ///< The message was decoded.
+  TooSmall = 1,      ///< The buffer is smaller than the fixed message layout.
+  LengthMismatch = 2,///< The header length doesn't match the buffer size.
+  InvalidData = 3,   ///< A length field points outside the message.
+  AllocationError = 4 ///< Failed to allocate the payload data.
 };
 
 /**
@@ -70,16 +98,33 @@ public:
 
   virtual ~IBusMessage() = default;
 
+  /** \brief Function that creates an empty message of a type. */
+  using MessageFactory = std::shared_ptr<IBusMessage> (*)();
+
   /** \brief Creates a message by its type.
    *
    * Creates a message by its type.
    * This fucntion is used by subscriber when deserialize a message.
+   * The type is looked up in a table of factories, so the cost is the
+   * same for all message types. Unregistered types creates an
+   * IBusMessage object that only decodes the header.
    *
    * @param type Type of message.
    * @return Smart pointer to IBussMessage object.
    */
   static std::shared_ptr<IBusMessage> Create(BusMessageType type);
 
+  /** \brief Registers a factory for a message type.
+   *
+   * The library's message types are registered by default. The function
+   * is used for application specific message types and replaces any
+   * previous factory. Only types below 256 can be registered.
+   * @param type Type of message.
+   * @param factory Factory function. Nullptr removes the type.
+   * @return False if the type cannot be registered.
+   */
+  static bool Register(BusMessageType type, MessageFactory factory);
+
   /** \brief Serialize the message.
    *
    * The function serialize a message to a byte array.
@@ -93,10 +138,25 @@ public:
   /** \brief Deserialize the message.
    *
    * This function desrialize a message from an byte array.
+   * The function calls the Decode() function and logs an error if the
+   * decode fails.
    * @param source Source buffer.
    */
   virtual void FromRaw(const std::vector<uint8_t>& source);
 
+  /** \brief Deserialize the message without exceptions or logging.
+   *
+   * The function validates all lengths before reading the buffer and
+   * returns a status code instead of throwing an exception. Nothing is
+   * allocated on the error path, so a malformed buffer costs about the
+   * same as a branch. The Valid() flag is updated as well.
+   * Derived classes override this function instead of FromRaw().
+   * @param source Source buffer.
+   * @return Decode status. BusDecodeStatus::Ok if the message was decoded.
+   */
+  [[nodiscard]] virtual BusDecodeStatus Decode(
+      std::span<const uint8_t> source) noexcept;
+
 
   virtual std::string ToString(uint64_t loglevel)  const;
 
@@ -17,9 +17,13 @@
 #include <vector>
 #include <atomic>
 #include <thread>
+#include <algorithm>
 #include <string>
 #include <mutex>
+#include <span>
 
+#include "bus/busmessageexecutor.h"
+#include "bus/busmessagefilter.h"
 #include "ibusmessagequeue.h"
 
 namespace bus {
@@ -32,6 +36,116 @@ struct Channel {
   uint32_t queue_index = 0; ///< Queue index of the connection.
 };
 
+/**
+ * @brief Defines how a shared memory buffer handles slow subscribers.
+ */
+enum class OverrunPolicy : uint8_t {
+  /** \brief The publishers overwrite the oldest messages.
+   *
+   * Publishers and fast subscribers never wait on a slow subscriber.
+   * A subscriber that falls more than one buffer behind looses messages
+   * and reports an overrun.
+   */
+  Overwrite = 0,
+  /** \brief The publishers wait for the slowest subscriber.
+   *
+   * No message is lost unless a subscriber blocks the publishers for
+   * more than 10 seconds. That subscriber is then overrun.
+   * Note that only attached subscribers block the publishers. Without
+   * subscribers, the oldest messages are overwritten. A subscriber
+   * attaches when it is started, or when the shared memory is created
+   * later, and starts reading at the oldest message in the buffer.
+   */
+  Block = 1
+};
+
+/**
+ * @brief Defines how a shared memory broker partitions the messages.
+ *
+ * Each partition is an independent ring buffer. The partition of a message
+ * is the key modulo the number of partitions.
+ */
+enum class PartitionKey : uint8_t {
+  BusChannel = 0, ///< Partitions on IBusMessage::BusChannel().
+  MessageType = 1 ///< Partitions on IBusMessage::Type().
+};
+
+/**
+ * @brief Defines the compression of a TCP/IP connection.
+ *
+ * Compression is used on a connection if both the client and the server
+ * enables it. Batches of messages are then sent as compressed blocks.
+ */
+enum class BusCompression : uint8_t {
+  None = 0, ///< Messages are sent as is.
+  Lz4 = 1 ///< Batches of messages are LZ4 block compressed.
+};
+
+/**
+ * @brief Defines how a TCP/IP server handles a slow client.
+ *
+ * Each client connection has a bounded send queue, see SendQueueSize().
+ * The policy defines what happens when the queue is full.
+ */
+enum class SlowClientPolicy : uint8_t {
+  DropOldest = 0, ///< The oldest queued messages are dropped.
+  /** \brief The connection is closed if the client is too slow.
+   *
+   * The oldest messages are dropped while the queue is full. If the
+   * queue still is full after the slow client timeout, the connection is
+   * closed. The client then reconnects and gets the newest messages.
+   */
+  Disconnect = 1,
+  /** \brief Only the latest message of each frame ID is kept.
+   *
+   * Suits clients that only show the latest signal values.
+   */
+  LatestPerId = 2
+};
+
+/**
+ * @brief Statistics of a TCP/IP client connection or a multicast sender.
+ *
+ * A TCP/IP server reports its client connections. The lag is the time the
+ * connection have been behind, i.e. the time since its send queue was
+ * empty.
+ * A UDP multicast broker reports the senders that it receives from. The
+ * lost datagrams are detected by gaps in the sequence numbers.
+ */
+struct ConnectionStatistics {
+  std::string remote; ///< Client or sender address and port.
+  size_t queue_size = 0; ///< Messages waiting to be sent.
+  uint64_t lost_messages = 0; ///< Messages dropped by the send queue.
+  uint64_t sent_messages = 0; ///< Number of sent messages.
+  uint64_t sent_bytes = 0; ///< Number of sent bytes (after compression).
+  uint64_t lag = 0; ///< Current lag (ms).
+  uint64_t max_lag = 0; ///< Max lag since the connection was made (ms).
+  uint64_t received_messages = 0; ///< Number of received messages.
+  uint64_t lost_datagrams = 0; ///< Missing datagrams (UDP).
+};
+
+/**
+ * @brief Memory options for a shared memory segment.
+ *
+ * The options are used when a shared memory broker or server creates its
+ * segment, and when its publishers and subscribers map the segment.
+ * Options that the platform doesn't support are ignored with a warning.
+ */
+struct SharedMemoryOptions {
+  /** \brief Backs the segment with huge pages.
+   *
+   * The segment size is rounded up to 2 MB and advised to use
+   * (transparent) huge pages. This reduces the TLB misses for large
+   * buffers. On Linux, this requires that
+   * /sys/kernel/mm/transparent_hugepage/shmem_enabled is set to advise or
+   * always. Otherwise, a warning is logged and normal pages are used.
+   */
+  bool huge_pages = false;
+  bool prefault = false; ///< Fault in all pages when mapping the segment.
+  bool lock = false; ///< Lock the pages in RAM (mlock).
+  int numa_node = -1; ///< Binds the pages to a NUMA node. -1 = no binding.
+};
+
 /**
  * @brief Defines an interface to a broker, server or client.
  *
@@ -61,7 +175,11 @@ public:
   /**
    * @brief Sets the internal memory size.
    *
-   * This function is deprecated as the shared memory is fixed to 16kB.
+   * For shared memory brokers and servers, this is the capacity of each
+   * ring buffer (partition). The minimum size is 16 kB, which holds at
+   * least one jumbo Ethernet frame. Ethernet captures typical needs a
+   * couple of MB, so the publishers don't block on slow subscribers.
+   * The default size is 64 kB.
    * @param size Size of internal memory.
    */
   void MemorySize(uint32_t size) {memory_size_ = size; }
@@ -72,6 +190,93 @@ public:
    */
   [[nodiscard]] uint32_t MemorySize() const { return memory_size_; }
 
+  /**
+   * @brief Sets max number of subscribers for a shared memory broker.
+   *
+   * Each subscriber uses a channel (slot) in the shared memory. The
+   * number of slots is fixed when the broker is started.
+   * @param max_subscribers Max number of subscribers.
+   */
+  void MaxSubscribers(uint32_t max_subscribers) {
+    max_subscribers_ = max_subscribers;
+  }
+
+  /**
+   * @brief Returns max number of subscribers.
+   * @return Max number of subscribers.
+   */
+  [[nodiscard]] uint32_t MaxSubscribers() const { return max_subscribers_; }
+
+  /**
+   * @brief Sets how a shared memory broker handles slow subscribers.
+   *
+   * The default policy is Block, i.e. no messages are lost for the
+   * attached subscribers. Messages published before a subscriber is
+   * attached are only kept while they fit in the buffer, see
+   * OverrunPolicy::Block.
+   * @param policy Overrun policy.
+   */
+  void Overrun(OverrunPolicy policy) { overrun_ = policy; }
+
+  /**
+   * @brief Returns the overrun policy.
+   * @return Overrun policy.
+   */
+  [[nodiscard]] OverrunPolicy Overrun() const { return overrun_; }
+
+  /**
+   * @brief Sets the number of shared memory partitions.
+   *
+   * A shared memory broker splits the traffic into independent ring
+   * buffers, so a busy bus channel cannot fill the buffer for the other
+   * channels. Each partition has the MemorySize() capacity. Note that the
+   * message order is only kept within a partition.
+   * The default is one partition. The number is fixed when the broker is
+   * started.
+   * @param partitions Number of partitions (1..64).
+   */
+  void Partitions(uint32_t partitions) {
+    partitions_ = std::clamp(partitions, 1U, 64U);
+  }
+
+  /**
+   * @brief Returns the number of shared memory partitions.
+   * @return Number of partitions.
+   */
+  [[nodiscard]] uint32_t Partitions() const { return partitions_; }
+
+  /**
+   * @brief Sets the key that selects the partition of a message.
+   *
+   * The default key is the bus channel.
+   * @param key Partition key.
+   */
+  void PartitionBy(PartitionKey key) { partition_key_ = key; }
+
+  /**
+   * @brief Returns the partition key.
+   * @return Partition key.
+   */
+  [[nodiscard]] PartitionKey PartitionBy() const { return partition_key_; }
+
+  /**
+   * @brief Sets the shared memory options.
+   *
+   * The options shall be set before the Start() call.
+   * @param options Shared memory options.
+   */
+  void MemoryOptions(const SharedMemoryOptions& options) {
+    memory_options_ = options;
+  }
+
+  /**
+   * @brief Returns the shared memory options.
+   * @return Shared memory options.
+   */
+  [[nodiscard]] const SharedMemoryOptions& MemoryOptions() const {
+    return memory_options_;
+  }
+
   /**
    * @brief Sets the TCP/IP host address.
    *
@@ -108,6 +313,176 @@ public:
    */
   [[nodiscard]] uint16_t Port() const { return port_; }
 
+  /**
+   * @brief Sets the compression of TCP/IP connections.
+   *
+   * The client and the server exchange their supported encodings when the
+   * client connects. The connection is compressed if both the client and
+   * the server have compression enabled.
+   * Compression suits slow links as VPN connections. On a local network,
+   * the CPU cost is normally higher than the bandwidth gain.
+   * @param compression Type of compression.
+   */
+  void Compression(BusCompression compression) { compression_ = compression; }
+
+  /**
+   * @brief Returns the compression of TCP/IP connections.
+   * @return Type of compression.
+   */
+  [[nodiscard]] BusCompression Compression() const { return compression_; }
+
+  /**
+   * @brief Sends CAN data frames in the compact layout.
+   *
+   * The compact layout (CanDataFrame::kCompactVersion) is used on TCP/IP
+   * connections if both the client and the server enables it.
+   * @param compact True if the compact layout shall be used.
+   */
+  void CompactEncoding(bool compact) { compact_encoding_ = compact; }
+
+  /**
+   * @brief Returns true if the compact CAN layout is enabled.
+   * @return True if compact CAN frames are used.
+   */
+  [[nodiscard]] bool CompactEncoding() const { return compact_encoding_; }
+
+  /**
+   * @brief Sets the minimum time between two TCP/IP sends.
+   *
+   * The messages are collected during the interval and sent as one batch.
+   * Larger batches compresses better but adds latency.
+   * The default 0 ms, sends the messages as soon as possible.
+   * @param interval Flush interval in milliseconds.
+   */
+  void FlushInterval(uint32_t interval) { flush_interval_ = interval; }
+
+  /**
+   * @brief Returns the flush interval in milliseconds.
+   * @return Flush interval (ms).
+   */
+  [[nodiscard]] uint32_t FlushInterval() const { return flush_interval_; }
+
+  /**
+   * @brief Sets the subscription filter of a TCP/IP client.
+   *
+   * The client sends the filter to the server when it connects. The server
+   * then only sends the messages that pass the filter, which saves both
+   * bandwidth and CPU for clients that only needs a few bus channels or
+   * CAN IDs. The filter shall be set before the Start() call.
+   * Older servers ignores the filter and sends all messages.
+   * @param filter Subscription filter. An empty filter selects all messages.
+   */
+  void SubscriptionFilter(BusMessageFilter filter) {
+    subscription_filter_ = std::move(filter);
+  }
+
+  /**
+   * @brief Returns the subscription filter of a TCP/IP client.
+   * @return Subscription filter.
+   */
+  [[nodiscard]] const BusMessageFilter& SubscriptionFilter() const {
+    return subscription_filter_;
+  }
+
+  /**
+   * @brief Sets max number of messages in a client connection send queue.
+   *
+   * A TCP/IP server queues the messages to each client. A client on a slow
+   * link cannot empty its queue, so the queue is limited according to the
+   * slow client policy. 0 means unbounded which isn't recommended.
+   * @param max_messages Max number of messages in the queue.
+   */
+  void SendQueueSize(uint32_t max_messages) {
+    send_queue_size_ = max_messages;
+  }
+
+  /**
+   * @brief Returns max number of messages in a send queue.
+   * @return Max number of messages.
+   */
+  [[nodiscard]] uint32_t SendQueueSize() const { return send_queue_size_; }
+
+  /**
+   * @brief Sets how a TCP/IP server handles a slow client.
+   *
+   * The default policy is to drop the oldest messages.
+   * @param policy Slow client policy.
+   */
+  void SlowClient(SlowClientPolicy policy) { slow_client_ = policy; }
+
+  /**
+   * @brief Returns the slow client policy.
+   * @return Slow client policy.
+   */
+  [[nodiscard]] SlowClientPolicy SlowClient() const { return slow_client_; }
+
+  /**
+   * @brief Sets the slow client timeout.
+   *
+   * A send that doesn't complete within the timeout closes the
+   * connection. With the Disconnect policy, the connection is also closed
+   * if the send queue has been full longer than the timeout.
+   * @param timeout Timeout in milliseconds. 0 disables the timeout.
+   */
+  void SlowClientTimeout(uint32_t timeout) { slow_client_timeout_ = timeout; }
+
+  /**
+   * @brief Returns the slow client timeout.
+   * @return Timeout in milliseconds.
+   */
+  [[nodiscard]] uint32_t SlowClientTimeout() const {
+    return slow_client_timeout_;
+  }
+
+  /**
+   * @brief Sets the retransmit window of a UDP multicast broker.
+   *
+   * The broker keeps the latest sent datagrams. A receiver that detects a
+   * gap in the sequence numbers, requests (NACK) the missing datagrams,
+   * which are sent again if they still are in the window.
+   * Both the senders and the receivers shall enable the window.
+   * @param nof_datagrams Number of datagrams to keep. 0 disables NACK.
+   */
+  void RetransmitWindow(uint32_t nof_datagrams) {
+    retransmit_window_ = nof_datagrams;
+  }
+
+  /**
+   * @brief Returns the retransmit window.
+   * @return Number of datagrams to keep.
+   */
+  [[nodiscard]] uint32_t RetransmitWindow() const {
+    return retransmit_window_;
+  }
+
+  /**
+   * @brief Maps the broker shared memory in a Unix domain socket client.
+   *
+   * The broker passes the shared memory segment over the socket in the
+   * handshake. The client then reads the messages directly from the
+   * shared memory instead of the socket. The published messages are
+   * still sent over the socket. Only the Unix domain socket client
+   * uses this property.
+   * @param zero_copy True if the client shall map the shared memory.
+   */
+  void ZeroCopy(bool zero_copy) { zero_copy_ = zero_copy; }
+
+  /**
+   * @brief Returns true if the client maps the broker shared memory.
+   * @return True if zero-copy reads are requested.
+   */
+  [[nodiscard]] bool ZeroCopy() const { return zero_copy_; }
+
+  /**
+   * @brief Returns statistics of the client connections.
+   *
+   * TCP/IP servers return their client connections. UDP multicast brokers
+   * return the senders they receive from. Other brokers return an
+   * empty list.
+   * @return Statistics for each connection.
+   */
+  [[nodiscard]] virtual std::vector<ConnectionStatistics> Connections() const;
+
   /**
    * @brief Return true if the client is connected.
    *
@@ -136,6 +511,52 @@ public:
    */
   [[nodiscard]] virtual std::shared_ptr<IBusMessageQueue> CreateSubscriber();
 
+  /**
+   * @brief Creates a subscriber queue for a subset of the messages.
+   *
+   * A partitioned shared memory broker only attaches the subscriber to the
+   * partitions that the filter's bus channels or message types selects,
+   * and drops the messages that doesn't pass the filter.
+   * Other brokers return a normal subscriber, i.e. the filter is only
+   * a hint to the broker.
+   * @param filter Message filter. An empty filter selects all messages.
+   * @return Smart pointer to a message queue.
+   */
+  [[nodiscard]] virtual std::shared_ptr<IBusMessageQueue> CreateSubscriber(
+      const BusMessageFilter& filter);
+
+  /**
+   * @brief Subscribes on messages with a callback.
+   *
+   * Creates a subscriber that delivers the messages that pass the filter
+   * to the callback, instead of the application polling a queue.
+   * If an executor is supplied, the callback is called on the executor's
+   * worker threads and the executor's bounded queue handles back-pressure.
+   * Use the Executor() function to get the broker's own worker pool.
+   * Without an executor, the callback is called inline on the transport
+   * thread. This is the lowest latency option but the callback must
+   * return quickly as it blocks the transport.
+   *
+   * Use DetachSubscriber() with the returned queue to unsubscribe. The
+   * broker doesn't hold its queue mutex during the callback, so the
+   * callback may call DetachSubscriber() and the other broker functions.
+   * @param filter Message filter. An empty filter passes all messages.
+   * @param callback Message callback.
+   * @param executor Optional worker pool. Empty means inline calls.
+   * @return Smart pointer to the subscriber queue.
+   */
+  std::shared_ptr<IBusMessageQueue> Subscribe(
+      BusMessageFilter filter, IBusMessageQueue::MessageCallback callback,
+      std::shared_ptr<BusMessageExecutor> executor = {});
+
+  /**
+   * @brief Returns the broker's worker pool.
+   *
+   * The pool is created on the first call and uses one worker thread.
+   * @return Smart pointer to the broker executor.
+   */
+  [[nodiscard]] std::shared_ptr<BusMessageExecutor> Executor();
+
   /**
    * @brief Detach a publisher from its broker.
    *
@@ -193,13 +614,39 @@ protected:
   std::atomic<bool> stop_thread_ = false; ///< True if the thread shall stop.
   std::thread thread_; ///< Working thread
 
+  /** \brief Copies the subscriber list.
+   *
+   * Push to the copy without holding the queue mutex. The subscriber
+   * callbacks may then call the broker, e.g. DetachSubscriber(), and slow
+   * callbacks don't block the application threads.
+   * @param list Destination list. Reuse it to avoid allocations.
+   */
+  void CopySubscribers(
+      std::vector<std::shared_ptr<IBusMessageQueue>>& list) const;
+
 private:
+  std::shared_ptr<BusMessageExecutor> executor_;
   std::string name_;
-  uint32_t memory_size_ = 16'000;
+  uint32_t memory_size_ = 65'536;
+  uint32_t max_subscribers_ = 255;
+  OverrunPolicy overrun_ = OverrunPolicy::Block;
+  uint32_t partitions_ = 1;
+  PartitionKey partition_key_ = PartitionKey::BusChannel;
+  SharedMemoryOptions memory_options_;
   std::string address_;
   uint16_t port_ = 0;
-
-  void Poll(IBusMessageQueue& queue) const;
+  BusCompression compression_ = BusCompression::None;
+  bool compact_encoding_ = false;
+  uint32_t flush_interval_ = 0;
+  BusMessageFilter subscription_filter_;
+  uint32_t send_queue_size_ = 100'000;
+  SlowClientPolicy slow_client_ = SlowClientPolicy::DropOldest;
+  uint32_t slow_client_timeout_ = 10'000;
+  uint32_t retransmit_window_ = 0;
+  bool zero_copy_ = false;
+
+  void Poll(IBusMessageQueue& queue,
+      std::span<const std::shared_ptr<IBusMessageQueue>> subscribers) const;
   void InprocessThread() const;
 };
 
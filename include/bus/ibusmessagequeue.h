@@ -17,16 +17,66 @@
 #include <cstdint>
 #include <deque>
 #include <vector>
+#include <span>
 #include <memory>
 #include <mutex>
 #include <atomic>
 #include <chrono>
 #include <condition_variable>
+#include <functional>
+#include <unordered_set>
 
+#include "bus/busmessagefilter.h"
 #include "bus/ibusmessage.h"
 
 namespace bus {
 
+/**
+ * @brief Defines what a bounded queue does when it is full.
+ */
+enum class QueueFullPolicy : uint8_t {
+  DropOldest = 0, ///< The oldest messages are removed.
+  /** \brief Only the latest message of each ID is kept.
+   *
+   * The queue keeps the newest message for each type, bus channel and
+   * frame ID (CAN, LIN and FlexRay). This suits signal values where only
+   * the latest value is of interest. Other message types, as Ethernet and
+   * MOST, are never collapsed. When the queue is trimmed, the oldest
+   * messages are removed until it is 3/4 full, so the next pushes don't
+   * trigger a new scan.
+   */
+  LatestPerId = 1
+};
+
+/**
+ * @brief Defines how a queue waits for new messages.
+ */
+enum class WaitStrategy : uint8_t {
+  Sleep = 0, ///< Blocks or sleeps between the polls. Low CPU load.
+  /** \brief Busy-polls, then yields and finally sleeps.
+   *
+   * The waiting thread polls with a CPU pause instruction, so a new
+   * message is detected within a microsecond. When nothing arrives, the
+   * thread backs off to yield and then to sleep. The strategy dedicates a
+   * core to the queue thread while the messages are flowing.
+   */
+  Spin = 1
+};
+
+/**
+ * @brief Wait settings of a queue.
+ *
+ * The settings should be set before the queue is started.
+ */
+struct QueueWaitOptions {
+  WaitStrategy strategy = WaitStrategy::Sleep; ///< Wait strategy.
+  uint32_t spin_count = 20'000; ///< Polls with a CPU pause (spin only).
+  uint32_t yield_count = 100; ///< Polls with a yield (spin only).
+  /** \brief Max sleep time after the spin and yield phases (spin only). */
+  std::chrono::microseconds sleep_time = std::chrono::milliseconds(10);
+  int cpu = -1; ///< Pins the queue thread to a CPU. -1 = no pinning.
+};
+
 /**
  * @brief Interface against a message queue.
  *
@@ -40,6 +90,13 @@ namespace bus {
  */
 class IBusMessageQueue {
 public:
+  /** \brief Callback that receives messages instead of the queue. */
+  using MessageCallback =
+      std::function<void(const std::shared_ptr<IBusMessage>& message)>;
+
+  /** \brief Callback that receives serialized messages without a copy. */
+  using InPlaceCallback = std::function<void(std::span<const uint8_t> message)>;
+
   IBusMessageQueue() = default;
   virtual ~IBusMessageQueue(); ///< Destructor
 
@@ -59,6 +116,72 @@ public:
    */
   void Push(const std::vector<uint8_t>& message_buffer);
 
+  /**
+   * @brief Delivers pushed messages to a callback instead of the queue.
+   *
+   * When a callback is set, the Push() and PushBatch() functions call the
+   * callback directly on the pushing (transport) thread. Messages already
+   * in the queue are delivered to the callback.
+   * Setting an empty callback restores the normal queue behavior.
+   * Note that the callback must not push to the same queue.
+   * @param callback Message callback.
+   */
+  void Callback(MessageCallback callback);
+
+  /**
+   * @brief Drops pushed messages that don't pass the filter.
+   *
+   * A serialized message is checked before it is decoded, so an unwanted
+   * message is neither decoded nor counted by a bounded queue. Messages
+   * already in the queue that don't pass the filter are removed. The
+   * filter also applies to the callback. An empty filter passes all
+   * messages.
+   * @param filter Message filter.
+   */
+  void Filter(const BusMessageFilter& filter);
+
+  /**
+   * @brief Returns true if the queue drops messages that don't pass a
+   * filter.
+   * @return True if the queue filters its messages.
+   */
+  [[nodiscard]] virtual bool HasFilter() const;
+
+  /**
+   * @brief Returns true if the queue delivers messages to a callback.
+   * @return True if a callback is set.
+   */
+  [[nodiscard]] bool HasCallback() const;
+
+  /**
+   * @brief Registers a one-shot handler that is called on a new message.
+   *
+   * The handler is called once, when the next message is pushed or
+   * when the queue is stopped. If the queue isn't empty, the handler is
+   * called directly. The handler is called on the pushing thread, so it
+   * should only signal an event or post to an executor.
+   * This is the hook that async (coroutine) waits are built upon, see
+   * bus/interface/asyncmessagequeue.h.
+   * Only one handler can be registered. A new handler replaces any
+   * previous handler.
+   * @param handler Wake-up handler.
+   */
+  void AsyncWait(std::function<void()> handler);
+
+  /**
+   * @brief Removes any registered wake-up handler.
+   */
+  void CancelAsyncWait();
+
+  /**
+   * @brief Adds a list of messages to the end of the queue.
+   *
+   * The queue is locked once and the waiting threads are notified once,
+   * independent of the number of messages.
+   * @param messages List of messages.
+   */
+  void PushBatch(std::span<const std::shared_ptr<IBusMessage>> messages);
+
   /**
    * @brief Adds a message first in the queue.
    *
@@ -90,6 +213,61 @@ public:
   std::shared_ptr<IBusMessage> PopWait(const std::chrono::duration<Rep,
     Period>& rel_time);
 
+  /**
+   * @brief Extracts up to max messages from the front of the queue.
+   *
+   * The messages are appended to the output list.
+   * The queue is only locked once.
+   * @param messages Output list of messages.
+   * @param max Maximum number of messages to extract.
+   * @return Number of extracted messages.
+   */
+  size_t PopBatch(std::vector<std::shared_ptr<IBusMessage>>& messages,
+                  size_t max);
+
+  /**
+   * @brief Blocks a period if queue is empty otherwise extracting messages.
+   *
+   * Waits until the queue have messages or the time expires. The messages
+   * are appended to the output list.
+   * @tparam Rep Type of clock
+   * @tparam Period Duration
+   * @param messages Output list of messages.
+   * @param max Maximum number of messages to extract.
+   * @param rel_time Time period to wait. Use std::chrono_utils.
+   * @return Number of extracted messages.
+   */
+  template < class Rep, class Period >
+  size_t PopBatchWait(std::vector<std::shared_ptr<IBusMessage>>& messages,
+                      size_t max,
+                      const std::chrono::duration<Rep, Period>& rel_time);
+
+  /**
+   * @brief Reads serialized messages without copying them.
+   *
+   * The callback receives each message in its serialized (ToRaw) form.
+   * The span is only valid during the call. Copy the bytes, or decode
+   * them with IBusMessage::Create() and Decode(), to take ownership.
+   * This suits consumers as CRC checkers and bus-load monitors, that only
+   * looks at the bytes.
+   *
+   * A shared memory subscriber hands out spans that points directly into
+   * the shared ring. The ring isn't locked during the callback, but the
+   * callback shall not throw. The message is pinned during the callback,
+   * so the publishers of its partition can't overwrite it, independent of
+   * the overrun policy. A slow callback therefore blocks these publishers.
+   * The first call switches the subscriber to in-place
+   * mode, i.e. its thread stops moving messages to the queue but keeps the
+   * channel alive. Unread messages block the publishers (block policy) or
+   * are overwritten, so the application shall call the function regularly.
+   * Other queues serialize their queued messages.
+   * @param callback Called once per message.
+   * @param max_messages Maximum number of messages to read.
+   * @return Number of messages read.
+   */
+  virtual size_t ReadInPlace(const InPlaceCallback& callback,
+                             size_t max_messages = 1'000);
+
   /**
    * @brief Retuns the size of next message.
    * @return The next message size.
@@ -132,16 +310,98 @@ public:
    */
   void Clear();
 
+  /**
+   * @brief Limits the number of messages in the queue.
+   *
+   * A queue is by default unbounded. A consumer that cannot keep up then
+   * let the queue grow without a limit. A bounded queue removes messages
+   * according to the policy instead. The removed messages are counted as
+   * lost messages.
+   * @param max_size Max number of messages. 0 means unbounded.
+   * @param policy What to remove when the queue is full.
+   */
+  void MaxSize(size_t max_size,
+               QueueFullPolicy policy = QueueFullPolicy::DropOldest);
+
+  /**
+   * @brief Returns max number of messages in the queue.
+   * @return Max number of messages. 0 means unbounded.
+   */
+  [[nodiscard]] size_t MaxSize() const { return max_size_; }
+
+  /**
+   * @brief Returns number of messages lost due to overrun.
+   *
+   * A subscriber that cannot keep up with the publishers may loose
+   * messages, depending on the broker type and its overrun policy.
+   * Messages removed by a bounded queue are also included.
+   * @return Number of lost messages.
+   */
+  [[nodiscard]] uint64_t LostMessages() const { return lost_messages_; }
+
+  /**
+   * @brief Sets how the queue waits for messages.
+   *
+   * The spin strategy applies to the PopWait(), PopBatchWait() and
+   * EmptyWait() functions, and to the internal thread of the shared memory
+   * queues. The CPU pinning applies to the internal thread. Set the
+   * options before the queue is started.
+   * @param options Wait settings.
+   */
+  void WaitOptions(const QueueWaitOptions& options) { wait_options_ = options; }
+
+  /**
+   * @brief Returns the wait settings.
+   * @return Wait settings.
+   */
+  [[nodiscard]] const QueueWaitOptions& WaitOptions() const {
+    return wait_options_;
+  }
+
+protected:
+  /**
+   * @brief Reports that messages have been lost.
+   * @param nof_lost Number of lost messages.
+   */
+  void ReportOverrun(uint64_t nof_lost);
+
+  /**
+   * @brief Busy-polls while the queue is empty (spin strategy).
+   *
+   * Returns when a message is queued, when the spin and yield phases
+   * are over or when the time expires. The function returns directly with
+   * the sleep strategy.
+   * @param max_time Max time to spin.
+   */
+  void SpinWhileEmpty(std::chrono::nanoseconds max_time) const;
+
 private:
   std::deque<std::shared_ptr<IBusMessage>> queue_;
   mutable std::mutex queue_mutex_;
   std::atomic<size_t> queue_size_ = 0;
   std::condition_variable queue_not_empty_;
+  std::atomic<bool> decode_error_ = false; ///< Suppress repeated decode logs.
+  std::shared_ptr<const MessageCallback> callback_; ///< Replaces the queue.
+  std::shared_ptr<const BusMessageFilter> filter_; ///< Drops pushed messages.
+  std::atomic<bool> filtered_ = false; ///< True if a filter is set.
+  std::function<void()> waiter_; ///< One-shot wake-up handler.
+  std::atomic<uint64_t> lost_messages_ = 0;
+  std::atomic<size_t> max_size_ = 0; ///< 0 means unbounded.
+  QueueFullPolicy full_policy_ = QueueFullPolicy::DropOldest;
+  std::unordered_set<uint64_t> latest_keys_; ///< Reused by TrimQueue().
+  QueueWaitOptions wait_options_;
+
+  void NotifyWaiter();
+  void TrimQueue();
+
+  size_t MoveToList(std::vector<std::shared_ptr<IBusMessage>>& messages,
+                    size_t max);
 };
 
 template< class Rep, class Period >
 std::shared_ptr<IBusMessage> IBusMessageQueue::PopWait(const std::chrono::duration<Rep,
                                     Period>& rel_time) {
+  SpinWhileEmpty(rel_time);
   std::unique_lock lock(queue_mutex_);
   queue_not_empty_.wait_for(lock, rel_time, [&] () ->bool {
       return queue_size_.load() > 0;
@@ -159,8 +419,21 @@ std::shared_ptr<IBusMessage> IBusMessageQueue::PopWait(const std::chrono::durati
   return message;
 }
 
+template< class Rep, class Period >
+size_t IBusMessageQueue::PopBatchWait(
+    std::vector<std::shared_ptr<IBusMessage>>& messages, size_t max,
+    const std::chrono::duration<Rep, Period>& rel_time) {
+  SpinWhileEmpty(rel_time);
+  std::unique_lock lock(queue_mutex_);
+  queue_not_empty_.wait_for(lock, rel_time, [&] () ->bool {
+      return queue_size_.load() > 0;
+    });
+  return MoveToList(messages, max);
+}
+
 template< class Rep, class Period >
 void IBusMessageQueue::EmptyWait(const std::chrono::duration<Rep, Period>& rel_time) {
+  SpinWhileEmpty(rel_time);
   std::unique_lock lock(queue_mutex_);
   queue_not_empty_.wait_for(lock, rel_time, [&] () ->bool {
       return queue_size_.load() > 0;
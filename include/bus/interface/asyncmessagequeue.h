@@ -0,0 +1,91 @@
+/*
+* Copyright 2025 Ingemar Hedvall
+* SPDX-License-Identifier: MIT
+*/
+
+/** \file asyncmessagequeue.h
+ * \brief Coroutine (awaitable) functions for the message queues.
+ *
+ * The functions let a boost::asio coroutine wait on a message queue
+ * without blocking a thread. The queue wait and the socket I/O can then
+ * run on the same io_context.
+ */
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/redirect_error.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/this_coro.hpp>
+#include <boost/asio/use_awaitable.hpp>
+
+#include "bus/ibusmessagequeue.h"
+
+namespace bus {
+
+/** \brief Waits for and extracts up to max messages from a queue.
+ *
+ * The coroutine returns directly if the queue have messages. Otherwise it
+ * suspends until a message is pushed, the queue is stopped or the timeout
+ * expires. The messages are appended to the output list.
+ *
+ * The queue signals the coroutine by posting to the coroutine's executor.
+ * Use a single threaded io_context or a strand if the io_context is run
+ * by several threads.
+ * @tparam Rep Type of clock
+ * @tparam Period Duration
+ * @param queue Message queue.
+ * @param messages Output list of messages.
+ * @param max Maximum number of messages to extract.
+ * @param timeout Max time to wait.
+ * @return Number of extracted messages.
+ */
+template <class Rep, class Period>
+boost::asio::awaitable<size_t> AsyncPopBatch(
+    IBusMessageQueue& queue,
+    std::vector<std::shared_ptr<IBusMessage>>& messages, size_t max,
+    std::chrono::duration<Rep, Period> timeout) {
+  if (const size_t count = queue.PopBatch(messages, max); count > 0) {
+    co_return count;
+  }
+
+  auto executor = co_await boost::asio::this_coro::executor;
+  auto timer = std::make_shared<boost::asio::steady_timer>(executor, timeout);
+  queue.AsyncWait([executor, timer] () -> void {
+    boost::asio::post(executor, [timer] () -> void {
+      timer->cancel();
+    });
+  });
+
+  boost::system::error_code error; // Cancel or timeout, both are OK.
+  co_await timer->async_wait(
+      boost::asio::redirect_error(boost::asio::use_awaitable, error));
+  queue.CancelAsyncWait();
+  co_return queue.PopBatch(messages, max);
+}
+
+/** \brief Waits for and extracts one message from a queue.
+ *
+ * See AsyncPopBatch() for details.
+ * @tparam Rep Type of clock
+ * @tparam Period Duration
+ * @param queue Message queue.
+ * @param timeout Max time to wait.
+ * @return Smart pointer to a message or an empty pointer on timeout.
+ */
+template <class Rep, class Period>
+boost::asio::awaitable<std::shared_ptr<IBusMessage>> AsyncPop(
+    IBusMessageQueue& queue, std::chrono::duration<Rep, Period> timeout) {
+  std::vector<std::shared_ptr<IBusMessage>> messages;
+  co_await AsyncPopBatch(queue, messages, 1, timeout);
+  co_return messages.empty() ? std::shared_ptr<IBusMessage>()
+                             : std::move(messages.front());
+}
+
+}  // namespace bus
@@ -26,6 +26,9 @@ enum class BrokerType : int {
   TcpBrokerType, ///< Shared memory broker with a TCP/IP server.
   TcpServerType, ///< TCP/IP TX/RX server.
   TcpClientType, ///< TCP/IP TX/RX client.
+  UdpMulticastType, ///< UDP multicast publisher and subscriber.
+  UnixBrokerType, ///< Shared memory broker with a Unix domain socket server.
+  UnixClientType, ///< Unix domain socket TX/RX client.
 };
 
 /** \brief Factory class that create brokers/servers and clients.
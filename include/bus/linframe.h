@@ -0,0 +1,100 @@
+/*
+* Copyright 2025 Ingemar Hedvall
+* SPDX-License-Identifier: MIT
+*/
+
+/** \file linframe.h
+ * \brief Simple wrapper around a LIN frame.
+ *
+ * The class is a simple wrapper around a LIN frame. It is used when
+ * serializing LIN frames in a general way.
+ */
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <span>
+
+#include "bus/ibusmessage.h"
+
+namespace bus {
+
+/** \class LinFrame linframe.h "bus/linframe.h"
+ * \brief Implements an interface against a LIN frame.
+ *
+ * A LIN frame has a 6-bit frame ID and 0-8 data bytes.
+ * The serialization is according to table below and uses little endian
+ * byte order.
+ * <table>
+ * <caption id="LinFrameLayout">LIN Frame Message Layout</caption>
+ * <tr><th>Byte (Bits) Offset</th><th>Description</th><th>Size</th></tr>
+ * <tr><td>0-17</td><td>Message Header</td><td>18 bytes</td></tr>
+ * <tr><td>18</td><td>Frame ID</td><td>uint8_t</td></tr>
+ * <tr><td>19</td><td>Data Length</td><td>uint8_t</td></tr>
+ * <tr><td>20</td><td>Checksum</td><td>uint8_t</td></tr>
+ * <tr><td>21:0</td><td>Direction (Rx=0, Tx=1)</td><td>1-bit</td></tr>
+ * <tr><td>21:1</td><td>Enhanced Checksum</td><td>1-bit</td></tr>
+ * <tr><td>22</td><td>Frame Duration (ns)</td><td>uint32_t</td></tr>
+ * <tr><td>26</td><td>Data Bytes</td><td>Data Length bytes</td></tr>
+ * </table>
+ */
+class LinFrame : public IBusMessage {
+ public:
+  static constexpr size_t kMaxDataLength = 8; ///< Max number of data bytes.
+
+  LinFrame(); ///< Default constructor.
+
+  void FrameId(uint8_t frame_id); ///< Sets the 6-bit frame ID.
+  [[nodiscard]] uint8_t FrameId() const { return frame_id_; } ///< Frame ID.
+
+  /** \brief Returns the protected ID, i.e. the frame ID with parity bits. */
+  [[nodiscard]] uint8_t ProtectedId() const;
+
+  void Checksum(uint8_t checksum) { checksum_ = checksum; } ///< Checksum.
+  [[nodiscard]] uint8_t Checksum() const { return checksum_; } ///< Checksum.
+
+  /** \brief Set true if the checksum includes the protected ID (LIN 2.x). */
+  void EnhancedChecksum(bool enhanced) { enhanced_checksum_ = enhanced; }
+  /** \brief Returns true if the checksum includes the protected ID. */
+  [[nodiscard]] bool EnhancedChecksum() const { return enhanced_checksum_; }
+
+  /** \brief If set true, the message was transmitted. */
+  void Dir(bool transmit) { dir_ = transmit; }
+  /** \brief Returns true if the message was transmitted. */
+  [[nodiscard]] bool Dir() const { return dir_; }
+
+  void FrameDuration(uint32_t duration); ///< Frame duration in nano-seconds.
+  [[nodiscard]] uint32_t FrameDuration() const; ///< Frame duration in ns.
+
+  /** \brief Sets the payload data bytes (max 8 bytes).
+   *
+   * Bytes above 8 are ignored.
+   * @param data Payload data.
+   */
+  void DataBytes(std::span<const uint8_t> data);
+
+  /** \brief Returns the payload data bytes. */
+  [[nodiscard]] std::span<const uint8_t> DataBytes() const;
+
+  /** \brief Returns number of data bytes. */
+  [[nodiscard]] uint8_t DataLength() const { return data_length_; }
+
+  /** \brief Calculates the classic or enhanced checksum of the data. */
+  [[nodiscard]] uint8_t CalculateChecksum() const;
+
+  void ToRaw(std::vector<uint8_t>& dest) const override;
+  [[nodiscard]] BusDecodeStatus Decode(
+      std::span<const uint8_t> source) noexcept override;
+  std::string ToString(uint64_t loglevel) const override;
+
+ private:
+  uint8_t frame_id_ = 0;
+  uint8_t data_length_ = 0;
+  uint8_t checksum_ = 0;
+  bool dir_ = false;
+  bool enhanced_checksum_ = true;
+  uint32_t frame_duration_ = 0;
+  std::array<uint8_t, kMaxDataLength> data_bytes_ = {};
+};
+
+}  // namespace bus
@@ -0,0 +1,61 @@
+/*
+* Copyright 2025 Ingemar Hedvall
+* SPDX-License-Identifier: MIT
+*/
+
+/** \file lz4codec.h
+ * \brief LZ4 block compression of serialized messages.
+ *
+ * The codec is used by the TCP transport when sending batches of messages
+ * over slow links and may be used when storing messages in files.
+ */
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace bus {
+
+/** \class Lz4Codec lz4codec.h "bus/lz4codec.h"
+ * \brief Compress and decompress byte arrays in the LZ4 block format.
+ *
+ * The output is a raw LZ4 block, compatible with the LZ4_compress_default()
+ * and LZ4_decompress_safe() functions in the reference library. The block
+ * doesn't store the uncompressed size, so the caller needs to store it
+ * beside the block.
+ *
+ * The compressor is a fast greedy matcher with a 4096 entry hash table.
+ * Streams of bus messages compress well as the headers, IDs and often the
+ * payload bytes are repeated.
+ * The decompressor validates all offsets and lengths, so a corrupt block
+ * never reads or writes outside its buffers.
+ */
+class Lz4Codec {
+ public:
+  /** \brief Returns the worst case compressed size. */
+  [[nodiscard]] static size_t MaxCompressedSize(size_t size) {
+    return size + (size / 255) + 16;
+  }
+
+  /** \brief Compresses a byte array into a LZ4 block.
+   *
+   * @param source Bytes to compress.
+   * @param dest Destination block. The size is set by the function.
+   */
+  static void Compress(std::span<const uint8_t> source,
+                       std::vector<uint8_t>& dest);
+
+  /** \brief Decompresses a LZ4 block.
+   *
+   * @param source LZ4 block.
+   * @param size Uncompressed size.
+   * @param dest Destination bytes. The size is set by the function.
+   * @return True if the block was valid and has the expected size.
+   */
+  [[nodiscard]] static bool Decompress(std::span<const uint8_t> source,
+                                       size_t size,
+                                       std::vector<uint8_t>& dest);
+};
+
+}  // namespace bus
@@ -0,0 +1,96 @@
+/*
+* Copyright 2025 Ingemar Hedvall
+* SPDX-License-Identifier: MIT
+*/
+
+/** \file mostmessage.h
+ * \brief Simple wrapper around a MOST control or packet message.
+ *
+ * The class is a simple wrapper around a MOST message. It is used when
+ * serializing MOST messages in a general way.
+ */
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "bus/ibusmessage.h"
+
+namespace bus {
+
+/** \class MostMessage mostmessage.h "bus/mostmessage.h"
+ * \brief Implements an interface against a MOST message.
+ *
+ * The message is either a control message or a packet (MDP) message.
+ * The serialization is according to table below and uses little endian
+ * byte order.
+ * <table>
+ * <caption id="MostMessageLayout">MOST Message Layout</caption>
+ * <tr><th>Byte (Bits) Offset</th><th>Description</th><th>Size</th></tr>
+ * <tr><td>0-17</td><td>Message Header</td><td>18 bytes</td></tr>
+ * <tr><td>18</td><td>Source Address</td><td>uint16_t</td></tr>
+ * <tr><td>20</td><td>Destination Address</td><td>uint16_t</td></tr>
+ * <tr><td>22:0</td><td>Direction (Rx=0, Tx=1)</td><td>1-bit</td></tr>
+ * <tr><td>22:1</td><td>Packet Message</td><td>1-bit</td></tr>
+ * <tr><td>23</td><td>Transmission Status</td><td>uint8_t</td></tr>
+ * <tr><td>24</td><td>Data Length</td><td>uint16_t</td></tr>
+ * <tr><td>26</td><td>Data Bytes</td><td>Data Length bytes</td></tr>
+ * </table>
+ */
+class MostMessage : public IBusMessage {
+ public:
+  static constexpr size_t kMaxDataLength = 1'524; ///< Max data bytes.
+
+  MostMessage(); ///< Default constructor.
+
+  void Source(uint16_t address) { source_ = address; } ///< Source address.
+  [[nodiscard]] uint16_t Source() const { return source_; }
+
+  /** \brief Sets the destination address. */
+  void Destination(uint16_t address) { destination_ = address; }
+  /** \brief Returns the destination address. */
+  [[nodiscard]] uint16_t Destination() const { return destination_; }
+
+  /** \brief If set true, the message was transmitted. */
+  void Dir(bool transmit) { dir_ = transmit; }
+  /** \brief Returns true if the message was transmitted. */
+  [[nodiscard]] bool Dir() const { return dir_; }
+
+  /** \brief Set true for a packet (MDP) message, false for control. */
+  void Packet(bool packet) { packet_ = packet; }
+  /** \brief Returns true for a packet message. */
+  [[nodiscard]] bool Packet() const { return packet_; }
+
+  /** \brief Sets the transmission status (ACK/NAK) of the message. */
+  void TransmissionStatus(uint8_t status) { status_ = status; }
+  /** \brief Returns the transmission status of the message. */
+  [[nodiscard]] uint8_t TransmissionStatus() const { return status_; }
+
+  /** \brief Sets the payload data bytes.
+   *
+   * Bytes above kMaxDataLength are ignored.
+   * @param data Payload data.
+   */
+  void DataBytes(std::span<const uint8_t> data);
+
+  /** \brief Returns a reference to the payload data bytes. */
+  [[nodiscard]] const std::vector<uint8_t>& DataBytes() const {
+    return data_bytes_;
+  }
+
+  void ToRaw(std::vector<uint8_t>& dest) const override;
+  [[nodiscard]] BusDecodeStatus Decode(
+      std::span<const uint8_t> source) noexcept override;
+  std::string ToString(uint64_t loglevel) const override;
+
+ private:
+  uint16_t source_ = 0;
+  uint16_t destination_ = 0;
+  bool dir_ = false;
+  bool packet_ = false;
+  uint8_t status_ = 0;
+  std::vector<uint8_t> data_bytes_;
+};
+
+}  // namespace bus
@@ -0,0 +1,70 @@
+/*
+* Copyright 2025 Ingemar Hedvall
+* SPDX-License-Identifier: MIT
+*/
+
+/** \file spinwait.h
+ * \brief Busy-poll back-off and CPU pinning used by the spin wait strategy.
+ */
+#pragma once
+
+#include <cstdint>
+#include <thread>
+
+#include "bus/ibusmessagequeue.h"
+
+namespace bus {
+
+/** \brief Hints the CPU that the thread is in a busy-poll loop.
+ *
+ * The function executes the pause instruction (x86) or the yield
+ * instruction (ARM). It reduces the power and lets a hyper-thread sibling
+ * run. Other CPU types do nothing.
+ */
+void CpuPause();
+
+/** \class SpinWait spinwait.h "bus/spinwait.h"
+ * \brief Back-off counter of a busy-poll loop.
+ *
+ * The first polls only pause the CPU, the following polls yield the
+ * thread. When both phases are over, the caller shall sleep or block
+ * until it is signalled. Reset() is called when something was received.
+ *
+ * @code
+ * SpinWait spin(options);
+ * while (!HasData()) {
+ *   if (!spin.Pause()) {
+ *     Sleep();
+ *   }
+ * }
+ * @endcode
+ */
+class SpinWait {
+ public:
+  explicit SpinWait(const QueueWaitOptions& options);
+
+  /** \brief Pauses or yields depending on the number of polls.
+   *
+   * @return False if the spin and yield phases are over, i.e. sleep.
+   */
+  bool Pause();
+
+  /** \brief Restarts the spin phase. */
+  void Reset() { count_ = 0; }
+
+ private:
+  uint32_t spin_count_ = 0;
+  uint32_t yield_count_ = 0;
+  uint64_t count_ = 0;
+};
+
+/** \brief Pins the calling thread to a CPU.
+ *
+ * Used by the queue threads when QueueWaitOptions::cpu is set.
+ * Supported on Linux and Windows.
+ * @param cpu CPU index starting at 0.
+ * @return False if the thread couldn't be pinned.
+ */
+bool PinCurrentThread(int cpu);
+
+} // bus
@@ -0,0 +1,74 @@
+/*
+* Copyright 2025 Ingemar Hedvall
+* SPDX-License-Identifier: MIT
+*/
+
+/** \file varint.h
+ * \brief Variable-length encoding of unsigned integer values.
+ *
+ * The values are stored as 7-bit groups, least significant group first.
+ * The highest bit in each byte is set if more bytes follows. Small values
+ * as 11-bit CAN IDs are stored in 1-2 bytes instead of 4 bytes.
+ */
+#pragma once
+
+#include <cstdint>
+#include <span>
+
+namespace bus {
+
+/** \brief Max number of bytes of a 32-bit value. */
+constexpr size_t kMaxVarintSize = 5;
+
+/** \brief Returns number of bytes needed to store the value. */
+[[nodiscard]] constexpr size_t VarintSize(uint32_t value) noexcept {
+  size_t size = 1;
+  for (; value >= 0x80; value >>= 7) {
+    ++size;
+  }
+  return size;
+}
+
+/** \brief Writes a value at an offset in a byte array.
+ *
+ * The caller must make sure that VarintSize() bytes are available.
+ * @param value Value to write.
+ * @param dest Destination byte array.
+ * @param offset Byte offset in the array.
+ * @return Offset of the next byte after the value.
+ */
+inline size_t WriteVarint(uint32_t value, std::span<uint8_t> dest,
+                          size_t offset) noexcept {
+  for (; value >= 0x80; value >>= 7) {
+    dest[offset++] = static_cast<uint8_t>(value | 0x80);
+  }
+  dest[offset++] = static_cast<uint8_t>(value);
+  return offset;
+}
+
+/** \brief Reads a value at an offset in a byte array.
+ *
+ * The value is not read outside the byte array.
+ * @param source Source byte array.
+ * @param offset Byte offset in the array.
+ * @param value Returns the value.
+ * @return Offset of the next byte after the value or 0 if the value is
+ * invalid or outside the array.
+ */
+inline size_t ReadVarint(std::span<const uint8_t> source, size_t offset,
+                         uint32_t& value) noexcept {
+  value = 0;
+  for (size_t index = 0; index < kMaxVarintSize; ++index) {
+    if (offset >= source.size()) {
+      return 0;
+    }
+    const uint8_t byte = source[offset++];
+    value |= static_cast<uint32_t>(byte & 0x7F) << (7 * index);
+    if ((byte & 0x80) == 0) {
+      return offset;
+    }
+  }
+  return 0;
+}
+
+}  // namespace bus
@@ -13,6 +13,9 @@
 #include "tcpmessagebroker.h"
 #include "tcpmessageclient.h"
 #include "tcpmessageserver.h"
+#include "udpmulticastbroker.h"
+#include "unixmessagebroker.h"
+#include "unixmessageclient.h"
 
 namespace bus {
 
@@ -39,6 +42,24 @@ std::unique_ptr<IBusMessageBroker> BusInterfaceFactory::CreateBroker(
       break;
     }
 
+    case BrokerType::UdpMulticastType: {
+      auto multicast_broker = std::make_unique<UdpMulticastBroker>();
+      broker = std::move(multicast_broker);
+      break;
+    }
+
+    case BrokerType::UnixBrokerType: {
+      auto unix_broker = std::make_unique<UnixMessageBroker>();
+      broker = std::move(unix_broker);
+      break;
+    }
+
+    case BrokerType::UnixClientType: {
+      auto unix_client = std::make_unique<UnixMessageClient>();
+      broker = std::move(unix_client);
+      break;
+    }
+
     case BrokerType::SimulateBrokerType: {
       auto simulate_broker = std::make_unique<SimulateBroker>();
       broker = std::move(simulate_broker);
@@ -14,9 +14,15 @@
 #include "bus/buslogstream.h"
 
 #include "sharedmemoryqueue.h"
+#include "sharedmemoryoptions.h"
 
 using namespace std::chrono_literals;
 using namespace boost::interprocess;
+
+namespace {
+constexpr uint32_t kMinBufferSize = 16'000; ///< Fits one jumbo frame.
+}
+
 namespace bus {
 
 SharedMemoryBroker::SharedMemoryBroker()
@@ -43,7 +49,16 @@ void SharedMemoryBroker::Start() {
       err << "Failed to create shared memory. Name: " << Name();
       throw std::runtime_error(err.str());
     }
-    shared_memory_->truncate(sizeof(SharedMemoryObjects));
+    const uint32_t buffer_size = std::max(MemorySize(), kMinBufferSize);
+    const uint32_t nof_partitions = Partitions();
+    const size_t partition_offset = DataOffset(sizeof(SharedMemoryObjects));
+    const size_t partition_size = DataOffset(
+        DataOffset(sizeof(SharedMemoryPartition)) +
+        SharedMemoryRing::DataSize(MaxSubscribers() + 1, buffer_size));
+    const size_t memory_size = SegmentSize(
+        partition_offset + (nof_partitions * partition_size),
+        MemoryOptions());
+    shared_memory_->truncate(static_cast<offset_t>(memory_size));
 
     region_ = std::make_unique<mapped_region>(*shared_memory_, read_write);
     if (!region_ || region_->get_address() == nullptr) {
@@ -51,23 +66,28 @@ void SharedMemoryBroker::Start() {
       err << "Failed to get a region address. Name: " << Name();
       throw std::runtime_error(err.str());
     }
+    // Bind and advise the pages before the memset faults them in.
+    ApplyMemoryOptions(*region_, MemoryOptions(), Name());
     std::memset(region_->get_address(), 0, region_->get_size());
     shm_ = new(region_->get_address()) SharedMemoryObjects();
 
-    scoped_lock lock(shm_->memory_mutex);
-    // Reset the channels in/out indexes.
-    std::ranges::for_each(shm_->channels, [] (Channel& channel) ->void {
-      channel.used = false;
-      channel.queue_index = 0;
-    });
-
-
-    // Allocate the first array item for the publishers.
-    // The other array items are used for the subscribers.
-    // The subscriber tries to allocate a free channal
-    // array at startup.
-    shm_->channels[0].used = true;
-    shm_->initialized = true;
+    scoped_lock lock(shm_->control_mutex);
+    shm_->partition_key = PartitionBy();
+    shm_->partition_offset = partition_offset;
+    shm_->partition_size = partition_size;
+    watchdogs_.assign(nof_partitions, ChannelWatchdog());
+    // The subscriber tries to allocate a free channel at startup.
+    for (uint32_t index = 0; index < nof_partitions; ++index) {
+      auto* address = reinterpret_cast<uint8_t*>(region_->get_address()) +
+          partition_offset + (index * partition_size);
+      auto* partition = new(address) SharedMemoryPartition();
+      partition->ring.Init(MaxSubscribers(), buffer_size, Overrun(),
+                           address + DataOffset(sizeof(SharedMemoryPartition)),
+                           &shm_->commit_signal);
+    }
+    shm_->header.Init(memory_size, nof_partitions, MaxSubscribers(),
+                      buffer_size);
+    shm_->header.initialized = true;
   } catch (std::exception &err) {
     BUS_ERROR() << "Failed to create the shared memory. Name: " << Name()
       << " Error: " << err.what();
@@ -87,11 +107,13 @@ void SharedMemoryBroker::Stop() {
     return;
   }
   stop_master_task_ = true;
-  shm_->buffer_full_condition.notify_all(); // Speed up the stop
+  shm_->full_condition.notify_all(); // Speed up the stop
 
   if (master_task_.joinable()) {
     master_task_.join();
   }
+  // Tells attached processes to map the next segment.
+  shm_->header.initialized = false;
 
   shm_ = nullptr;
   region_.reset();
@@ -99,10 +121,20 @@ void SharedMemoryBroker::Stop() {
   shared_memory_object::remove(Name().c_str());
 }
 
+int SharedMemoryBroker::SegmentDescriptor() const {
+#if defined(_WIN32)
+  return -1;
+#else
+  return shared_memory_ && shm_ != nullptr ?
+    shared_memory_->get_mapping_handle().handle : -1;
+#endif
+}
+
 std::shared_ptr<IBusMessageQueue> SharedMemoryBroker::CreatePublisher() {
   std::shared_ptr<IBusMessageQueue> pub;
   if (!Name().empty()) {
-    auto shm = std::make_shared<SharedMemoryQueue>(Name(), true);
+    auto shm = std::make_shared<SharedMemoryQueue>(Name(), true,
+                                                   MemoryOptions());
     pub = std::move(shm);
   }
   // No need to add the message queue to a list;
@@ -110,9 +142,15 @@ std::shared_ptr<IBusMessageQueue> SharedMemoryBroker::CreatePublisher() {
 }
 
 std::shared_ptr<IBusMessageQueue> SharedMemoryBroker::CreateSubscriber() {
+  return CreateSubscriber(BusMessageFilter());
+}
+
+std::shared_ptr<IBusMessageQueue> SharedMemoryBroker::CreateSubscriber(
+    const BusMessageFilter& filter) {
   std::shared_ptr<IBusMessageQueue> sub;
   if (!Name().empty()) {
-    auto shm = std::make_shared<SharedMemoryQueue>(Name(), false);
+    auto shm = std::make_shared<SharedMemoryQueue>(Name(), false,
+                                                   MemoryOptions(), filter);
     sub = std::move(shm);
   }
   // No need to add the message queue to a list;
@@ -120,57 +158,88 @@ std::shared_ptr<IBusMessageQueue> SharedMemoryBroker::CreateSubscriber() {
 }
 
 void SharedMemoryBroker::BrokerMasterTask() {
-  while (!stop_master_task_ || shm_ == nullptr) {
-    scoped_lock lock(shm_->memory_mutex);
-    shm_->buffer_full_condition.wait_for(lock, 100ms, [&] () -> bool {
-      return stop_master_task_.load() || shm_->buffer_full.load();
-    } );
+  while (!stop_master_task_ && shm_ != nullptr) {
+    {
+      scoped_lock lock(shm_->control_mutex);
+      shm_->full_condition.wait_for(lock, 100ms, [&] () -> bool {
+        return stop_master_task_.load() || AnyFull();
+      } );
+    }
     if (stop_master_task_) {
       return;
     }
-    if (shm_->buffer_full) {
-      HandleBufferFull();
+    bool full = false;
+    for (uint32_t index = 0; index < watchdogs_.size(); ++index) {
+      auto& partition = shm_->Partition(index);
+      scoped_lock lock(partition.memory_mutex);
+      // Free the channels of crashed subscribers, so they don't block the
+      // buffer full handling.
+      watchdogs_[index].Check(partition.ring);
+      if (partition.ring.full) {
+        watchdogs_[index].HandleFull(partition.ring);
+        full = true;
+      }
+    }
+    if (full) {
+      // Let the subscribers catch up instead of spinning on the locks.
+      std::this_thread::sleep_for(1ms);
     }
   }
 }
 
-void SharedMemoryBroker::HandleBufferFull() {
-  if (shm_ == nullptr) {
-    return;
+bool SharedMemoryBroker::AnyFull() {
+  for (uint32_t index = 0; index < watchdogs_.size(); ++index) {
+    if (shm_->Partition(index).ring.full) {
+      return true;
+    }
   }
-  const uint32_t ref_index  = shm_->channels[0].queue_index;
+  return false;
+}
 
-  bool all_index_ok = std::ranges::all_of( shm_->channels,
-    [&] (const Channel& channel)-> bool {
-      if (!channel.used) {
-        return true;
-      }
-      return channel.queue_index == ref_index;
-    });
-
-  if (all_index_ok) {
-    ResetChannels();
-  } else if (shm_->buffer_full) {
-    std::time_t now = std::time(nullptr);
-    if (timeout_ == 0) {
-      timeout_ = now + 10;;
-    } else if (now > timeout_) {
-      BUS_ERROR() << "Buffer full (10s) timeout occurred. Resetting";
-      ResetChannels();
-    }
+SharedMemoryPartition& SharedMemoryObjects::Partition(uint32_t index) {
+  if (index >= header.nof_rings) {
+    std::ostringstream err;
+    err << "Invalid shared memory partition. Partition: " << index
+        << ", Partitions: " << header.nof_rings;
+    throw std::runtime_error(err.str());
   }
+  auto* address = reinterpret_cast<uint8_t*>(this) + partition_offset +
+      (index * partition_size);
+  return *reinterpret_cast<SharedMemoryPartition*>(address);
 }
 
-void SharedMemoryBroker::ResetChannels() {
-  if (shm_ == nullptr) {
-    return;
+uint32_t SharedMemoryObjects::PartitionOf(BusMessageType type,
+                                          uint16_t bus_channel) const {
+  if (header.nof_rings <= 1) {
+    return 0;
   }
-  std::ranges::for_each(shm_->channels, [] (Channel& channel) -> void {
-    channel.queue_index = 0;
-  });
-  shm_->buffer_full= false;
-  timeout_ = 0;
+  const uint32_t key = partition_key == PartitionKey::MessageType
+      ? static_cast<uint32_t>(type) : bus_channel;
+  return key % header.nof_rings;
 }
 
+std::vector<uint32_t> SharedMemoryObjects::Partitions(
+    const BusMessageFilter& filter) const {
+  std::vector<uint32_t> list;
+  if (partition_key == PartitionKey::MessageType) {
+    for (const auto type : filter.Types()) {
+      list.emplace_back(PartitionOf(type, 0));
+    }
+  } else {
+    for (const auto channel : filter.BusChannels()) {
+      list.emplace_back(PartitionOf(BusMessageType::Unknown, channel));
+    }
+  }
+  if (list.empty()) {
+    // No criteria on the key. All partitions are needed.
+    for (uint32_t index = 0; index < header.nof_rings; ++index) {
+      list.emplace_back(index);
+    }
+  }
+  std::ranges::sort(list);
+  const auto [first, last] = std::ranges::unique(list);
+  list.erase(first, last);
+  return list;
+}
 
-} // bus
\ No newline at end of file
+} // bus
@@ -7,23 +7,59 @@
 
 #include <atomic>
 #include <thread>
-#include <ctime>
-#include <array>
+#include <vector>
 
-#include <boost/interprocess/sync/interprocess_mutex.hpp>
 #include <boost/interprocess/sync/interprocess_condition.hpp>
+#include <boost/interprocess/sync/interprocess_mutex.hpp>
 
 #include "bus/ibusmessagebroker.h"
+#include "sharedmemoryring.h"
 
 namespace bus {
 
-struct SharedMemoryObjects {
-  std::atomic<bool> initialized = false; // Indicate that shared memory ready
+/** \brief Independent ring buffer of a broker segment.
+ *
+ * Each partition has its own mutex, so publishers of different partitions
+ * never contend. The channel array and the message buffer follows on the
+ * first page after this object.
+ */
+struct SharedMemoryPartition {
+  alignas(kCacheLineSize)
   boost::interprocess::interprocess_mutex memory_mutex;
-  boost::interprocess::interprocess_condition buffer_full_condition;
-  std::atomic<bool> buffer_full = false;
-  std::array<Channel, 256> channels;
-  std::array<uint8_t, 16'000> buffer;
+  SharedMemoryRing ring;
+};
+
+/** \brief Shared memory layout (control block) of the broker.
+ *
+ * The partitions follows on the first page after this object. The number
+ * of partitions and their sizes are defined when the broker starts.
+ */
+struct SharedMemoryObjects {
+  SharedMemoryHeader header;
+  alignas(kCacheLineSize)
+  boost::interprocess::interprocess_mutex control_mutex;
+  /** \brief Wakes the broker when a partition is full. */
+  boost::interprocess::interprocess_condition full_condition;
+  PartitionKey partition_key = PartitionKey::BusChannel;
+  uint64_t partition_offset = 0; ///< Offset to the first partition.
+  uint64_t partition_size = 0; ///< Page aligned size of a partition.
+  /** \brief Signals a commit in any partition (spin wait strategy). */
+  CommitSignal commit_signal;
+
+  /** \brief Returns the partition with the index (0..nof_rings - 1). */
+  [[nodiscard]] SharedMemoryPartition& Partition(uint32_t index);
+
+  /** \brief Returns the partition of a message. */
+  [[nodiscard]] uint32_t PartitionOf(BusMessageType type,
+                                     uint16_t bus_channel) const;
+
+  /** \brief Returns the partitions that a filter needs.
+   *
+   * An empty filter, or a filter without any criteria on the partition
+   * key, needs all partitions.
+   */
+  [[nodiscard]] std::vector<uint32_t> Partitions(
+      const BusMessageFilter& filter) const;
 };
 
 class SharedMemoryBroker : public IBusMessageBroker {
@@ -35,18 +71,27 @@ public:
 
   [[nodiscard]] std::shared_ptr<IBusMessageQueue> CreatePublisher() override;
   [[nodiscard]] std::shared_ptr<IBusMessageQueue> CreateSubscriber() override;
+  [[nodiscard]] std::shared_ptr<IBusMessageQueue> CreateSubscriber(
+      const BusMessageFilter& filter) override;
+
+  /** \brief Returns the file descriptor of the segment.
+   *
+   * The descriptor is passed to Unix domain socket clients. It is only
+   * valid while the broker runs.
+   * @return File descriptor or -1 if not started or not supported.
+   */
+  [[nodiscard]] int SegmentDescriptor() const;
 
 private:
   std::atomic<bool> stop_master_task_ = true;
   std::thread master_task_;
-  std::time_t timeout_ = 0;
+  std::vector<ChannelWatchdog> watchdogs_; ///< One per partition.
 
   SharedMemoryObjects* shm_ = nullptr;
   std::unique_ptr<boost::interprocess::shared_memory_object>  shared_memory_;
   std::unique_ptr<boost::interprocess::mapped_region>  region_;
   void BrokerMasterTask();
-  void HandleBufferFull();
-  void ResetChannels();
+  [[nodiscard]] bool AnyFull();
 };
 
 
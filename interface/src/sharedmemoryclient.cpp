@@ -26,13 +26,13 @@ void SharedMemoryClient::Stop() {
 
 std::shared_ptr<IBusMessageQueue> SharedMemoryClient::CreatePublisher() {
   auto publisher = std::make_shared<SharedMemoryTxRxQueue>(Name(),
-    false, true);
+    false, true, MemoryOptions());
   return publisher;
 }
 
 std::shared_ptr<IBusMessageQueue> SharedMemoryClient::CreateSubscriber() {
   auto subscriber = std::make_shared<SharedMemoryTxRxQueue>(Name(),
-    true, false);
+    true, false, MemoryOptions());
   return subscriber;
 }
 
@@ -0,0 +1,203 @@
+/*
+* Copyright 2025 Ingemar Hedvall
+* SPDX-License-Identifier: MIT
+*/
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <cerrno>
+#include <cstring>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+
+#include "sharedmemoryoptions.h"
+#include "bus/buslogstream.h"
+
+namespace {
+
+constexpr size_t kHugePageSize = 2 * 1024 * 1024;
+
+#if defined(__linux__)
+constexpr std::string_view kShmemEnabledFile =
+    "/sys/kernel/mm/transparent_hugepage/shmem_enabled";
+constexpr int kMpolBind = 2; ///< MPOL_BIND in linux/mempolicy.h
+constexpr unsigned kMpolMfMove = 1U << 1; ///< MPOL_MF_MOVE
+#endif
+
+size_t PageSize() {
+#if defined(_WIN32)
+  SYSTEM_INFO info;
+  ::GetSystemInfo(&info);
+  return info.dwPageSize;
+#else
+  const long size = ::sysconf(_SC_PAGESIZE);
+  return size > 0 ? static_cast<size_t>(size) : 4096;
+#endif
+}
+
+#if defined(__linux__)
+// The file lists all modes with the selected one within brackets, e.g.
+// "always within_size advise [never] deny force".
+std::string ShmemHugePageMode() {
+  std::ifstream file{std::string(kShmemEnabledFile)};
+  std::string word;
+  while (file >> word) {
+    if (word.size() > 2 && word.front() == '[' && word.back() == ']') {
+      return word.substr(1, word.size() - 2);
+    }
+  }
+  return {};
+}
+
+// Returns the huge page size in kB that are mapped in the segment. The
+// /proc/self/smaps lists each mapping with its address range followed by
+// its memory counters.
+size_t ShmemPmdMapped(const void* address) {
+  std::ifstream file("/proc/self/smaps");
+  const auto start = reinterpret_cast<uintptr_t>(address);
+  bool found = false;
+  std::string line;
+  while (std::getline(file, line)) {
+    if (const auto dash = line.find('-');
+        dash != std::string::npos && line.find(':') > dash) {
+      // New mapping header line: <start>-<end> perms offset ...
+      try {
+        found = std::stoull(line.substr(0, dash), nullptr, 16) == start;
+      } catch (const std::exception&) {
+        found = false;
+      }
+      continue;
+    }
+    if (found && line.starts_with("ShmemPmdMapped:")) {
+      std::istringstream value(line.substr(15));
+      size_t kb = 0;
+      value >> kb;
+      return kb;
+    }
+  }
+  return 0;
+}
+#endif
+
+std::string LastError() {
+#if defined(_WIN32)
+  return std::to_string(::GetLastError());
+#else
+  return std::strerror(errno);
+#endif
+}
+
+}
+
+namespace bus {
+
+bool HugePagesEnabled() {
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+  // Shared memory (tmpfs) only uses transparent huge pages if the
+  // shmem_enabled setting isn't never, deny or missing.
+  static const bool enabled = [] () -> bool {
+    const std::string mode = ShmemHugePageMode();
+    return mode == "always" || mode == "within_size" || mode == "advise" ||
+           mode == "force";
+  }();
+  return enabled;
+#else
+  return false;
+#endif
+}
+
+size_t SegmentSize(size_t size, const SharedMemoryOptions& options) {
+  if (!options.huge_pages || !HugePagesEnabled()) {
+    return size;
+  }
+  return ((size + kHugePageSize - 1) / kHugePageSize) * kHugePageSize;
+}
+
+void ApplyMemoryOptions(boost::interprocess::mapped_region& region,
+                        const SharedMemoryOptions& options,
+                        const std::string& name) {
+  void* address = region.get_address();
+  const size_t size = region.get_size();
+  if (address == nullptr || size == 0) {
+    return;
+  }
+
+  if (options.numa_node >= 0) {
+#if defined(__linux__)
+    // The libnuma mbind() is a thin wrapper around the system call.
+    constexpr size_t kBits = 8 * sizeof(unsigned long);
+    const auto node = static_cast<size_t>(options.numa_node);
+    std::vector<unsigned long> node_mask(node / kBits + 1, 0);
+    node_mask[node / kBits] = 1UL << (node % kBits);
+    if (::syscall(SYS_mbind, address, size, kMpolBind, node_mask.data(),
+                  node_mask.size() * kBits + 1, kMpolMfMove) != 0) {
+      BUS_WARNING() << "Failed to bind the shared memory to a NUMA node. "
+        << "Name: " << name << ", Node: " << options.numa_node
+        << ", Error: " << LastError();
+    }
+#else
+    BUS_WARNING() << "NUMA binding is not supported. Name: " << name;
+#endif
+  }
+
+  const bool huge_pages = options.huge_pages && HugePagesEnabled();
+  if (options.huge_pages && !huge_pages) {
+#if defined(__linux__)
+    BUS_WARNING() << "Huge pages are disabled for shared memory. Name: "
+      << name << ", Mode: " << ShmemHugePageMode()
+      << ", Setting: " << kShmemEnabledFile;
+#else
+    BUS_WARNING() << "Huge pages are not supported. Name: " << name;
+#endif
+  }
+
+#if defined(MADV_HUGEPAGE)
+  if (huge_pages && ::madvise(address, size, MADV_HUGEPAGE) != 0) {
+    BUS_WARNING() << "Failed to use huge pages. Name: " << name
+      << ", Error: " << LastError();
+  }
+#endif
+
+  if (options.prefault) {
+    // Read faults are safe even if other processes are using the memory.
+    const auto* data = static_cast<const volatile uint8_t*>(address);
+    const size_t page_size = PageSize();
+    for (size_t offset = 0; offset < size; offset += page_size) {
+      static_cast<void>(data[offset]);
+    }
+#if defined(__linux__)
+    // The advice is silently ignored if the kernel cannot allocate huge
+    // pages, so check what actually was mapped.
+    if (huge_pages && size >= kHugePageSize && ShmemPmdMapped(address) == 0) {
+      BUS_WARNING() << "The shared memory is not backed by huge pages. Name: "
+        << name;
+    }
+#endif
+  }
+
+  if (options.lock) {
+#if defined(_WIN32)
+    const bool locked = ::VirtualLock(address, size) != FALSE;
+#else
+    const bool locked = ::mlock(address, size) == 0;
+#endif
+    if (!locked) {
+      BUS_WARNING() << "Failed to lock the shared memory in RAM. Name: "
+        << name << ", Error: " << LastError();
+    }
+  }
+}
+
+} // bus
@@ -0,0 +1,50 @@
+/*
+* Copyright 2025 Ingemar Hedvall
+* SPDX-License-Identifier: MIT
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include <boost/interprocess/mapped_region.hpp>
+
+#include "bus/ibusmessagebroker.h"
+
+namespace bus {
+
+/** \brief Returns true if shared memory can use huge pages.
+ *
+ * On Linux, the shared memory is using tmpfs, which only uses transparent
+ * huge pages if /sys/kernel/mm/transparent_hugepage/shmem_enabled is
+ * always, within_size, advise or force. The default is never.
+ * @return True if huge pages can be used.
+ */
+[[nodiscard]] bool HugePagesEnabled();
+
+/** \brief Returns the segment size to allocate.
+ *
+ * The size is rounded up to a whole huge page if huge pages are used and
+ * enabled.
+ * @param size Needed size.
+ * @param options Memory options.
+ * @return Segment size.
+ */
+[[nodiscard]] size_t SegmentSize(size_t size,
+                                 const SharedMemoryOptions& options);
+
+/** \brief Applies the memory options on a mapped segment.
+ *
+ * The NUMA binding and the huge page advice are applied before the pages
+ * are faulted in. A failing option is logged as a warning as the segment
+ * is still usable.
+ * @param region Mapped segment.
+ * @param options Memory options.
+ * @param name Segment name used in log messages.
+ */
+void ApplyMemoryOptions(boost::interprocess::mapped_region& region,
+                        const SharedMemoryOptions& options,
+                        const std::string& name);
+
+} // bus
@@ -3,6 +3,7 @@
 * SPDX-License-Identifier: MIT
 */
 
+#include <algorithm>
 #include <chrono>
 #include <sstream>
 #include <utility>
@@ -14,22 +15,48 @@
 
 #include "sharedmemoryqueue.h"
 #include "sharedmemorybroker.h"
+#include "sharedmemoryoptions.h"
+#include "unixdescriptor.h"
 #include "bus/buslogstream.h"
-#include "bus/littlebuffer.h"
+#include "bus/busmessageview.h"
 using namespace std::chrono_literals;
 using namespace boost::interprocess;
 
+namespace {
+
+#if !defined(_WIN32)
+/** \brief Memory mappable object of a passed segment descriptor. */
+class PassedSegment {
+ public:
+  explicit PassedSegment(int descriptor)
+    : handle_(ipcdetail::mapping_handle_from_file_handle(descriptor)) {
+  }
+  [[nodiscard]] mapping_handle_t get_mapping_handle() const { return handle_; }
+ private:
+  mapping_handle_t handle_;
+};
+#endif
+} // end namespace
+
 namespace bus {
 
 SharedMemoryQueue::SharedMemoryQueue(std::string  shared_memory_name,
-  bool publisher )
+  bool publisher, const SharedMemoryOptions& options, BusMessageFilter filter)
   : publisher_(publisher),
-    shared_memory_name_(std::move(shared_memory_name)) {
+    shared_memory_name_(std::move(shared_memory_name)),
+    options_(options),
+    filter_(std::move(filter)) {
 
 }
 
 SharedMemoryQueue::~SharedMemoryQueue() {
   SharedMemoryQueue::Stop();
+  CloseDescriptor(segment_descriptor_);
+}
+
+void SharedMemoryQueue::SegmentDescriptor(int descriptor) {
+  CloseDescriptor(segment_descriptor_);
+  segment_descriptor_ = descriptor;
 }
 
 void SharedMemoryQueue::Start() {
@@ -42,6 +69,8 @@ void SharedMemoryQueue::Start() {
   if (publisher_) {
     thread_ = std::thread(&SharedMemoryQueue::PublisherTask, this);
   } else {
+    // Attach at once, so no messages published after Start() are lost.
+    ConnectToSharedMemory();
     GetChannel();
     thread_ = std::thread(&SharedMemoryQueue::SubscriberTask, this);
   }
@@ -52,20 +81,30 @@ void SharedMemoryQueue::Stop() {
   if (thread_.joinable()) {
     thread_.join();
   }
-  shm_ = nullptr;
-  region_.reset();
-  shared_memory_.reset();
+  {
+    std::lock_guard channel_lock(channel_mutex_);
+    ReleaseChannel();
+    shm_ = nullptr;
+    region_.reset();
+    shared_memory_.reset();
+  }
   state_ = SharedMemoryState::WaitOnSharedMemory;
   operable_ = false;
+  in_place_ = false;
+  pending_.clear();
 
   IBusMessageQueue::Stop();
   stop_thread_ = false;
 }
 
 void SharedMemoryQueue::PublisherTask() {
+  PinQueueThread(WaitOptions());
   while (!stop_thread_ ) {
     switch (state_) {
       case SharedMemoryState::HandleMessages:
+        if (!IsAttached()) {
+          state_ = SharedMemoryState::WaitOnSharedMemory;
+        }
         break;
 
       case SharedMemoryState::WaitOnSharedMemory:
@@ -74,35 +113,57 @@ void SharedMemoryQueue::PublisherTask() {
         break;
     }
     if (state_ == SharedMemoryState::WaitOnSharedMemory) {
-      std::this_thread::sleep_for(1000ms);
+      AttachBackoff(attach_delay_);
       continue;
     }
 
-    EmptyWait(10ms);
-    if (Empty()) {
-      continue;
+    const bool pending = std::ranges::any_of(pending_,
+        [] (const auto& list) -> bool { return !list.empty(); });
+    if (!pending) {
+      EmptyWait(10ms);
+      if (Empty()) {
+        continue;
+      }
     }
 
     // Connect to shared memory
     // Transfer messages
     // Disconnect
     try {
-      while (!stop_thread_ && shm_ != nullptr && !Empty() && !shm_->buffer_full) {
+      pending_.resize(std::max(shm_->header.nof_rings, 1U));
+      std::vector<uint8_t> msg_buffer;
+      bool full = false;
+      // Retries the messages of the partitions that were full. A full
+      // partition doesn't stop the other partitions, as the message order
+      // only is kept within a partition.
+      for (uint32_t index = 0; index < pending_.size(); ++index) {
+        auto& list = pending_[index];
+        while (!stop_thread_ && !list.empty()) {
+          if (!PublishMessage(index, *list.front(), msg_buffer, full)) {
+            break;
+          }
+          list.pop_front();
+        }
+      }
+      while (!stop_thread_ && shm_ != nullptr && !Empty()) {
         auto msg = Pop();
         if (!msg) {
           continue;
         }
-        bool message_sent;
-        {
-          scoped_lock lock(shm_->memory_mutex);
-          message_sent = PublisherPoll(*shm_, *msg);
-        }
-        if (!message_sent) {
-          PushFront(msg);
+        const uint32_t index =
+            shm_->PartitionOf(msg->Type(), msg->BusChannel());
+        auto& list = pending_[index];
+        if (list.empty() && PublishMessage(index, *msg, msg_buffer, full)) {
+          continue;
         }
+        list.push_back(msg); // Waits behind the older messages
       }
-      if (shm_->buffer_full) {
-        shm_->buffer_full_condition.notify_all();
+      if (full) {
+        shm_->full_condition.notify_all();
+        std::this_thread::sleep_for(1ms); // Wait for the slow subscribers
+      } else if (std::ranges::any_of(pending_,
+          [] (const auto& list) -> bool { return !list.empty(); })) {
+        std::this_thread::yield();
       }
     } catch (const std::exception &err) {
       if (operable_) {
@@ -115,16 +176,37 @@ void SharedMemoryQueue::PublisherTask() {
   }
 }
 
+bool SharedMemoryQueue::PublishMessage(uint32_t index,
+                                       const IBusMessage& msg,
+                                       std::vector<uint8_t>& msg_buffer,
+                                       bool& full) {
+  auto& partition = shm_->Partition(index);
+  // Serialize and copy the message without holding the mutex.
+  msg.ToRaw(msg_buffer);
+  if (partition.ring.Publish(partition.memory_mutex, msg_buffer)) {
+    return true;
+  }
+  // The buffer is full or another publisher is filling in the oldest
+  // record.
+  full |= partition.ring.full;
+  return false;
+}
+
 void SharedMemoryQueue::SubscriberTask() {
+  PinQueueThread(WaitOptions());
+  SpinWait spin(WaitOptions());
+  std::vector<SharedMemoryRing*> rings;
+  uint32_t commits = 0;
   while (!stop_thread_ ) {
-    if (channel_ == 0) {
-      GetChannel();
-      std::this_thread::sleep_for(1000ms);
-      continue;
-    }
-
+    // The application thread may read in-place from the channels.
+    std::unique_lock channel_lock(channel_mutex_);
     switch (state_) {
       case SharedMemoryState::HandleMessages:
+        if (!IsAttached()) {
+          // The broker has restarted. The old channels are gone.
+          channels_.clear();
+          state_ = SharedMemoryState::WaitOnSharedMemory;
+        }
         break;
 
       case SharedMemoryState::WaitOnSharedMemory:
@@ -133,62 +215,161 @@ void SharedMemoryQueue::SubscriberTask() {
         break;
     }
     if (state_ == SharedMemoryState::WaitOnSharedMemory) {
+      channel_lock.unlock();
+      AttachBackoff(attach_delay_);
+      continue;
+    }
+
+    if (channels_.empty()) {
+      GetChannel();
+    }
+    if (channels_.empty()) {
+      channel_lock.unlock();
       std::this_thread::sleep_for(1000ms);
       continue;
     }
 
+    bool received = false;
     try {
+      rings.clear();
+      for (const auto& [index, channel] : channels_) {
+        rings.push_back(&shm_->Partition(index).ring);
+      }
+      // Read before polling, so a commit during the poll isn't missed.
+      commits = CommitCount(rings);
+
       std::vector<uint8_t> message_buffer;
-      bool more = true;
-      while ( more && !stop_thread_) {
-        {
-          scoped_lock lock(shm_->memory_mutex);
-          more = SubscriberPoll(*shm_, message_buffer);
+      for (auto& [index, channel] : channels_) {
+        auto& partition = shm_->Partition(index);
+        if (in_place_ && channel.channel != 0) {
+          // The application may read seldom. Keeps the channel alive.
+          scoped_lock lock(partition.memory_mutex);
+          partition.ring.Heartbeat(channel);
         }
-        if (more && !message_buffer.empty()) {
-          Push(message_buffer);
+        bool more = channel.channel != 0 && !in_place_;
+        while ( more && !stop_thread_) {
+          {
+            scoped_lock lock(partition.memory_mutex);
+            more = SubscriberPoll(partition, channel, message_buffer);
+          }
+          received |= more;
+          // A partition may hold messages that doesn't pass the filter.
+          if (more && !message_buffer.empty() &&
+              (filter_.Empty() ||
+               filter_.Match(BusMessageView(message_buffer)))) {
+            Push(message_buffer);
+          }
         }
       }
+      if (std::ranges::any_of(channels_, [] (const auto& item) -> bool {
+            return item.second.channel == 0;
+          })) {
+        // A channel couldn't be attached again. Attach to all partitions.
+        ReleaseChannel();
+      }
     } catch (const std::exception &err) {
       if (operable_) {
         BUS_ERROR() << "Shared memory failure. Error: " << err.what();
       }
       operable_ = false;
       state_ = SharedMemoryState::WaitOnSharedMemory;
+      rings.clear();
+    }
+    channel_lock.unlock();
+    if (WaitOptions().strategy != WaitStrategy::Spin || in_place_ ||
+        rings.empty()) {
+      std::this_thread::sleep_for(10ms);
+    } else if (received) {
+      spin.Reset(); // Poll again directly
+    } else {
+      WaitForCommits(rings, commits, spin, WaitOptions(), stop_thread_);
     }
-    std::this_thread::sleep_for(10ms);
   }
 }
 
-void SharedMemoryQueue::GetChannel() {
+bool SharedMemoryQueue::HasFilter() const {
+  return !filter_.Empty() || IBusMessageQueue::HasFilter();
+}
+
+size_t SharedMemoryQueue::ReadInPlace(const InPlaceCallback& callback,
+                                      size_t max_messages) {
+  if (publisher_ || !callback) {
+    return IBusMessageQueue::ReadInPlace(callback, max_messages);
+  }
+  in_place_ = true;
+  // Messages that were queued before the switch comes first.
+  size_t count = IBusMessageQueue::ReadInPlace(callback, max_messages);
+
+  std::lock_guard channel_lock(channel_mutex_);
+  if (!IsAttached()) {
+    return count;
+  }
   try {
-    shared_memory_object shared_mem(open_only, shared_memory_name_.c_str(),
-      read_write);
-    mapped_region region(shared_mem, read_write);
-    if (region.get_address() == nullptr) {
-      std::ostringstream err;
-      err << "No shared memory found. Name: " << shared_memory_name_;
-      throw std::runtime_error(err.str());
-    }
-    auto *shm = static_cast<SharedMemoryObjects *>(region.get_address());
-    if (!shm->initialized) {
-      std::ostringstream err;
-      err << "Shared memory not initialized. Name: " << shared_memory_name_;
-      throw std::runtime_error(err.str());
+    for (auto& [index, channel] : channels_) {
+      auto& partition = shm_->Partition(index);
+      scoped_lock lock(partition.memory_mutex);
+      std::span<const uint8_t> message;
+      while (count < max_messages && channel.channel != 0) {
+        if (!partition.ring.IsAttached(channel) &&
+            !Reattach(partition, channel)) {
+          break;
+        }
+        uint64_t nof_lost = 0;
+        const bool more = partition.ring.Peek(channel, message, nof_lost);
+        ReportOverrun(nof_lost);
+        if (!more) {
+          break;
+        }
+        if (filter_.Empty() || filter_.Match(BusMessageView(message))) {
+          // The callback runs without the mutex. The pin stops the
+          // publishers from overwriting the record and the watchdog from
+          // reclaiming the channel while the callback holds it.
+          partition.ring.Pin(channel, true);
+          lock.unlock();
+          try {
+            callback(message);
+          } catch (...) {
+            lock.lock();
+            partition.ring.Pin(channel, false);
+            throw;
+          }
+          ++count;
+          lock.lock();
+          partition.ring.Pin(channel, false);
+          if (!partition.ring.IsAttached(channel)) {
+            // Reclaimed while unlocked. The record is already delivered,
+            // so the new channel resumes after it.
+            ++channel.sequence;
+            continue;
+          }
+        }
+        partition.ring.Advance(channel);
+      }
     }
-    if (!operable_) {
-      BUS_INFO() << "Shared memory connected. Name: " << shared_memory_name_;
-      operable_ = true;
+  } catch (const std::exception &err) {
+    if (operable_) {
+      BUS_ERROR() << "Shared memory failure. Error: " << err.what();
     }
+    operable_ = false;
+  }
+  return count;
+}
 
-    scoped_lock lock(shm->memory_mutex);
-    for (size_t index = 1; index < shm->channels.size(); ++index) {
-      if (shm->channels[index].used) {
-        continue;
+void SharedMemoryQueue::GetChannel() {
+  if (!IsAttached()) {
+    return;
+  }
+  try {
+    for (const uint32_t index : shm_->Partitions(filter_)) {
+      auto& partition = shm_->Partition(index);
+      scoped_lock lock(partition.memory_mutex);
+      const auto channel = partition.ring.AttachChannel();
+      if (channel.channel == 0) {
+        BUS_ERROR() << "No free subscriber channel. Name: "
+          << shared_memory_name_ << ", Partition: " << index;
+        break;
       }
-      channel_ = index;
-      shm->channels[index].used = true;
-      break;
+      channels_.emplace_back(index, channel);
     }
   } catch (const std::exception &err) {
     if (operable_) {
@@ -197,143 +378,111 @@ void SharedMemoryQueue::GetChannel() {
       operable_ = false;
     }
   }
+  if (channels_.size() != shm_->Partitions(filter_).size()) {
+    // Either all needed partitions or none.
+    ReleaseChannel();
+  }
 }
 
-bool SharedMemoryQueue::PublisherPoll(SharedMemoryObjects& shm,
-  const IBusMessage& message) {
-  auto& channel = shm.channels[0];
-  const uint32_t message_size = message.Size();
-
-  auto bytes_left = static_cast<int64_t>(shm.buffer.size());
-  bytes_left -= channel.queue_index;
-  bytes_left -= message_size;
-  bytes_left -= 4;
-
-  if (bytes_left < 0 ) {
-    shm.buffer_full = true;
-    return false;
+void SharedMemoryQueue::ReleaseChannel() {
+  if (channels_.empty() || shm_ == nullptr) {
+    channels_.clear();
+    return;
   }
-
-  std::vector<uint8_t> msg_buffer;
-  message.ToRaw(msg_buffer);
-  if (msg_buffer.size() != message_size) {
-    BUS_ERROR() << "Mismatching message sizes ("
-      << msg_buffer.size() << "/" << message_size
-      << ". Internal error";
-    return false;
+  try {
+    for (const auto& [index, channel] : channels_) {
+      if (channel.channel == 0) {
+        continue;
+      }
+      auto& partition = shm_->Partition(index);
+      scoped_lock lock(partition.memory_mutex);
+      partition.ring.DetachChannel(channel);
+    }
+  } catch (const std::exception& err) {
+    BUS_ERROR() << "Failed to release channel. Error: " << err.what();
   }
-
-  const LittleBuffer length(message_size);
-  std::copy_n(length.cbegin(), length.size(),
-  shm.buffer.begin() + channel.queue_index );
-  channel.queue_index += length.size();
-
-  std::copy_n(msg_buffer.begin(), msg_buffer.size(),
-  shm.buffer.begin() + channel.queue_index );
-  channel.queue_index += msg_buffer.size();
-  return true;
+  channels_.clear();
 }
 
-bool SharedMemoryQueue::SubscriberPoll(SharedMemoryObjects& shm,
-    std::vector<uint8_t>& msg_buffer ) const {
+bool SharedMemoryQueue::SubscriberPoll(SharedMemoryPartition& partition,
+    RingChannelToken& channel, std::vector<uint8_t>& msg_buffer ) {
   msg_buffer.clear();
-  uint8_t out_index = channel_;
-  if (out_index == 0) {
-    BUS_ERROR() << "Invalid subscriber channel index. Index: " <<
-      static_cast<int>(out_index);
-    return false;
-  }
-
-  auto& out_channel = shm.channels[out_index];
-  const auto& in_channel = shm.channels[0];
-  if (!out_channel.used) {
-    // Probably reconnected to the shared memory.
-    out_index = 0; // Trigger a new channel
-    operable_ = false;
-    BUS_ERROR() << "Channel suddennly unused. Channel: "
-      << static_cast<int>(out_index);
+  if (!partition.ring.IsAttached(channel) && !Reattach(partition, channel)) {
     return false;
   }
+  uint64_t nof_lost = 0;
+  const bool more = partition.ring.Read(channel, msg_buffer, nof_lost);
+  ReportOverrun(nof_lost);
+  return more;
+}
 
-  if (in_channel.queue_index < out_channel.queue_index) {
-    BUS_ERROR() << "Invalid channel indexes. Channel: "
-      << static_cast<int>(out_index)
-      << ", Index: " << in_channel.queue_index
-      << "/" << out_channel.queue_index;
-    out_channel.queue_index = in_channel.queue_index;
-    return false;
-  }
-
-  if (out_channel.queue_index == in_channel.queue_index) {
-    return false;
-  }
-
-  if (out_channel.queue_index + 4 > shm.buffer.size()) {
-    BUS_ERROR() << "Length out-of-boound. Index: "
-      << static_cast<int>(out_channel.queue_index)
-      << "/" << shm.buffer.size();
-    out_channel.queue_index = in_channel.queue_index;
-    return false;
-  }
-
-  LittleBuffer<uint32_t> length(shm.buffer.data(),out_channel.queue_index);
-  out_channel.queue_index += length.size();
-  const uint32_t message_length = length.value();
-
-  if (out_channel.queue_index + message_length > shm.buffer.size()) {
-    BUS_ERROR() << "Data out-of-boound. Index: "
-        << static_cast<int>(out_channel.queue_index)
-        << ", Length: " << message_length
-        << ", Size: " << shm.buffer.size();
-    out_channel.queue_index = in_channel.queue_index;
-    return false;
-  }
-
-  try {
-    msg_buffer.resize(message_length);
-    std::copy_n(shm.buffer.cbegin() + out_channel.queue_index,
-      message_length, msg_buffer.begin());
-    out_channel.queue_index += message_length;
-
-
-  } catch (const std::exception& err) {
-    BUS_ERROR() << "Message copy failure. Error: " << err.what();
-    out_channel.queue_index = in_channel.queue_index;
+bool SharedMemoryQueue::Reattach(SharedMemoryPartition& partition,
+                                 RingChannelToken& channel) {
+  // Note that the partition mutex shall be locked by the caller.
+  // The watchdog reclaimed the channel, for example while this process
+  // was stopped. Another subscriber may own it now.
+  BUS_WARNING() << "Subscriber channel was reclaimed. Name: "
+    << shared_memory_name_ << ", Channel: " << channel.channel;
+  uint64_t nof_lost = 0;
+  if (!partition.ring.Reattach(channel, nof_lost)) {
+    BUS_ERROR() << "No free subscriber channel. Name: "
+      << shared_memory_name_;
+    channel = {}; // The subscriber thread attaches again.
     return false;
   }
-
+  ReportOverrun(nof_lost);
   return true;
 }
 
+bool SharedMemoryQueue::IsAttached() const {
+  return shm_ != nullptr && shm_->header.initialized;
+}
+
 void SharedMemoryQueue::ConnectToSharedMemory() {
+  if (IsAttached()) {
+    // Stay attached. Only map the segment again if the broker restarts.
+    state_ = SharedMemoryState::HandleMessages;
+    return;
+  }
   try {
     shm_ = nullptr;
     region_.reset();
     shared_memory_.reset();
 
-    shared_memory_ = std::make_unique<shared_memory_object>(
-      open_only, shared_memory_name_.c_str(), read_write);
-    if (!shared_memory_) {
-      throw std::runtime_error("Shared memory allocation error (null)");
+#if !defined(_WIN32)
+    if (segment_descriptor_ >= 0) {
+      // The segment was passed by the broker and is not opened by name.
+      const PassedSegment segment(segment_descriptor_);
+      region_ = std::make_unique<mapped_region>(segment, read_write);
+    } else
+#endif
+    {
+      shared_memory_ = std::make_unique<shared_memory_object>(
+        open_only, shared_memory_name_.c_str(), read_write);
+      if (!shared_memory_) {
+        throw std::runtime_error("Shared memory allocation error (null)");
+      }
+      region_ = std::make_unique<mapped_region>(*shared_memory_, read_write);
     }
-    region_ = std::make_unique<mapped_region>(*shared_memory_, read_write);
-    if (!shared_memory_) {
+    if (!region_) {
       throw std::runtime_error("Mapped region allocation error (null)");
     }
     if (region_->get_address() == nullptr) {
       throw std::runtime_error("No shared memory found");
     }
-    shm_ = static_cast<SharedMemoryObjects *>(region_->get_address());
-    if (!shm_->initialized) {
-      std::ostringstream err;
-      err << "Shared memory not initialized. Name: " << shared_memory_name_;
-      throw std::runtime_error(err.str());
-    }
+    auto* shm = static_cast<SharedMemoryObjects *>(region_->get_address());
+    shm->header.Validate(shared_memory_name_, region_->get_size());
+    ApplyMemoryOptions(*region_, options_, shared_memory_name_);
+    shm_ = shm;
     if (!operable_) {
       // The connection is back again.
-      BUS_INFO() << "Shared memory connected. Name: " << shared_memory_name_;
+      BUS_INFO() << "Shared memory connected. Name: " << shared_memory_name_
+        << ", Capacity: " << shm_->header.buffer_size
+        << ", Partitions: " << shm_->header.nof_rings
+        << ", Slots: " << shm_->header.max_subscribers;
       operable_ = true;
     }
+    attach_delay_ = {};
     state_ = SharedMemoryState::HandleMessages;
   } catch (const std::exception& err) {
     if (operable_) {
@@ -6,35 +6,62 @@
 #pragma once
 
 #include <cstdint>
+#include <deque>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <atomic>
+#include <chrono>
 #include <thread>
+#include <vector>
 
 #include <boost/interprocess/mapped_region.hpp>
 #include <boost/interprocess/shared_memory_object.hpp>
 
 #include "bus/ibusmessagequeue.h"
+#include "bus/ibusmessagebroker.h"
+#include "bus/busmessagefilter.h"
+#include "sharedmemoryring.h"
 
 namespace bus {
 
 class SharedMemoryBroker;
 struct SharedMemoryObjects;
+struct SharedMemoryPartition;
 
 class SharedMemoryQueue : public IBusMessageQueue {
 public:
   SharedMemoryQueue() = delete;
   explicit SharedMemoryQueue(std::string  shared_memory_name,
-    bool publisher);
+    bool publisher, const SharedMemoryOptions& options = {},
+    BusMessageFilter filter = {});
   ~SharedMemoryQueue() override;
 
   void Start() override;
   void Stop() override;
+  size_t ReadInPlace(const InPlaceCallback& callback,
+                     size_t max_messages) override;
+  [[nodiscard]] bool HasFilter() const override;
+
+  /** \brief Maps a passed segment instead of opening it by name.
+   *
+   * A Unix domain socket client receives the broker segment as a file
+   * descriptor. The queue takes the ownership of the descriptor. The name
+   * is then only used in log messages. Call before Start().
+   * @param descriptor File descriptor of the shared memory segment.
+   */
+  void SegmentDescriptor(int descriptor);
 
 private:
   bool publisher_ = false;
   std::string shared_memory_name_;
-  uint8_t channel_ = 0;
+  SharedMemoryOptions options_;
+  BusMessageFilter filter_; ///< Selects the partitions of a subscriber.
+  /** \brief Attached partitions and their channels (subscriber). */
+  std::vector<std::pair<uint32_t, RingChannelToken>> channels_;
+  std::mutex channel_mutex_; ///< Protects the channels and the mapping.
+  /** \brief The application reads with ReadInPlace() instead of the queue. */
+  std::atomic<bool> in_place_ = false;
   std::atomic<bool> stop_thread_ = true;
   std::thread thread_;
   mutable std::atomic<bool> operable_ = false; ///<  Supress of log messages
@@ -45,17 +72,25 @@ private:
   SharedMemoryState state_ = SharedMemoryState::WaitOnSharedMemory;
   std::unique_ptr<boost::interprocess::shared_memory_object> shared_memory_;
   std::unique_ptr<boost::interprocess::mapped_region> region_;
+  int segment_descriptor_ = -1; ///< Passed segment (Unix domain socket).
   SharedMemoryObjects* shm_ = nullptr;
+  std::chrono::milliseconds attach_delay_ = {};
+  /** \brief Messages waiting on a full partition (publisher). */
+  std::vector<std::deque<std::shared_ptr<IBusMessage>>> pending_;
 
   void PublisherTask();
+  [[nodiscard]] bool PublishMessage(uint32_t index, const IBusMessage& msg,
+                                    std::vector<uint8_t>& msg_buffer,
+                                    bool& full);
   void SubscriberTask();
   void GetChannel();
-  static bool PublisherPoll(SharedMemoryObjects& shm,
-                            const IBusMessage& message);
-  bool SubscriberPoll(SharedMemoryObjects& shm,
-    std::vector<uint8_t>& msg_buffer
-    ) const;
+  void ReleaseChannel();
+  bool SubscriberPoll(SharedMemoryPartition& partition,
+    RingChannelToken& channel, std::vector<uint8_t>& msg_buffer);
+  [[nodiscard]] bool Reattach(SharedMemoryPartition& partition,
+                              RingChannelToken& channel);
 
+  [[nodiscard]] bool IsAttached() const;
   void ConnectToSharedMemory();
 };
 
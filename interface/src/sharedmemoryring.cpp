@@ -0,0 +1,705 @@
+/*
+* Copyright 2025 Ingemar Hedvall
+* SPDX-License-Identifier: MIT
+*/
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <cerrno>
+#include <climits>
+#include <csignal>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+#include <boost/interprocess/sync/interprocess_mutex.hpp>
+#include <boost/interprocess/sync/scoped_lock.hpp>
+
+#include "sharedmemoryring.h"
+#include "bus/buslogstream.h"
+#include "bus/littlebuffer.h"
+
+using namespace std::chrono_literals;
+using namespace boost::interprocess;
+
+namespace {
+
+constexpr auto kHeartbeatTimeout = 3s;
+// A record is a length word, a state word and the message. The records
+// are 8 byte aligned so the state word can be accessed atomically.
+constexpr uint32_t kLengthSize = 4;
+constexpr uint32_t kHeaderSize = 8;
+constexpr uint32_t kWrapMarker = 0xFFFFFFFF; ///< Skip to next lap.
+constexpr uint32_t kCommitted = 0; ///< The record is ready.
+constexpr uint32_t kAborted = 0xFFFFFFFF; ///< The publisher crashed.
+constexpr auto kCheckInterval = 500ms;
+constexpr auto kFullTimeout = 10s;
+constexpr std::chrono::milliseconds kMinAttachDelay = 10ms;
+constexpr std::chrono::milliseconds kMaxAttachDelay = 1s;
+
+#if defined(__linux__)
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t) &&
+              std::atomic<uint32_t>::is_always_lock_free);
+
+// The futex isn't private as the ring is shared between processes.
+long Futex(std::atomic<uint32_t>& word, int operation, uint32_t value,
+           const timespec* timeout) {
+  return ::syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), operation,
+                   value, timeout, nullptr, 0);
+}
+#endif
+
+constexpr uint64_t RecordSize(size_t length) {
+  return (kHeaderSize + length + 7) & ~uint64_t{7};
+}
+
+// The state of a reserved record is the PID of its publisher.
+uint32_t PendingState() {
+  const uint32_t pid = bus::CurrentProcessId();
+  return pid == kCommitted || pid == kAborted ? 1 : pid;
+}
+
+
+}
+
+namespace bus {
+
+void CommitSignal::Notify() {
+  commits.fetch_add(1);
+  if (sleepers > 0) {
+#if defined(__linux__)
+    Futex(commits, FUTEX_WAKE, INT_MAX, nullptr);
+#endif
+  }
+}
+
+void CommitSignal::Wait(uint32_t seen, std::chrono::microseconds timeout) {
+  // The sleeper is registered before the counter is checked, so a commit
+  // after the check always wakes the subscriber.
+  sleepers.fetch_add(1);
+  if (commits == seen) {
+#if defined(__linux__)
+    timespec time = {};
+    time.tv_sec = static_cast<time_t>(timeout.count() / 1'000'000);
+    time.tv_nsec = static_cast<long>((timeout.count() % 1'000'000) * 1'000);
+    Futex(commits, FUTEX_WAIT, seen, &time);
+#else
+    std::this_thread::sleep_for(timeout);
+#endif
+  }
+  sleepers.fetch_sub(1);
+}
+
+void SharedMemoryHeader::Init(size_t size, uint32_t rings,
+                              uint32_t subscribers, uint32_t capacity) {
+  magic = kSharedMemoryMagic;
+  layout_version = kLayoutVersion;
+  abi = Abi();
+  nof_rings = rings;
+  max_subscribers = subscribers;
+  buffer_size = capacity;
+  segment_size = size;
+}
+
+uint32_t SharedMemoryHeader::Abi() {
+  // FNV-1a hash of the sizes that a process must agree on.
+  const std::array<size_t, 7> sizes = {
+    sizeof(void*),
+    sizeof(SharedMemoryHeader),
+    sizeof(SharedMemoryRing),
+    sizeof(RingChannel),
+    sizeof(boost::interprocess::interprocess_mutex),
+    sizeof(boost::interprocess::interprocess_condition),
+    std::endian::native == std::endian::little ? 1U : 2U
+  };
+  uint32_t hash = 2166136261U;
+  for (const size_t size : sizes) {
+    hash ^= static_cast<uint32_t>(size);
+    hash *= 16777619U;
+  }
+  return hash;
+}
+
+void SharedMemoryHeader::Validate(const std::string& name,
+                                  size_t region_size) const {
+  std::ostringstream err;
+  if (region_size < sizeof(SharedMemoryHeader)) {
+    err << "Shared memory too small. Name: " << name
+      << ", Size: " << region_size;
+  } else if (!initialized) {
+    err << "Shared memory not initialized. Name: " << name;
+  } else if (magic != kSharedMemoryMagic) {
+    err << "Not a bus message shared memory. Name: " << name;
+  } else if (layout_version != kLayoutVersion) {
+    err << "Shared memory layout mismatch. Name: " << name
+      << ", Version: " << layout_version << "/" << kLayoutVersion;
+  } else if (abi != Abi()) {
+    err << "Shared memory ABI mismatch. Name: " << name;
+  } else if (segment_size > region_size) {
+    err << "Shared memory size mismatch. Name: " << name
+      << ", Size: " << region_size << "/" << segment_size;
+  } else {
+    return;
+  }
+  throw std::runtime_error(err.str());
+}
+
+size_t SharedMemoryRing::DataSize(uint32_t nof_channels,
+                                  uint32_t buffer_size) {
+  return DataOffset(nof_channels * sizeof(RingChannel)) +
+         DataOffset(buffer_size);
+}
+
+void SharedMemoryRing::Init(uint32_t max_subscribers, uint32_t size,
+                            OverrunPolicy overrun, uint8_t* data,
+                            CommitSignal* segment_signal) {
+  nof_channels = max_subscribers + 1;
+  buffer_size = size & ~uint32_t{7}; // Keeps the records aligned
+  policy = overrun;
+  channel_offset = data - reinterpret_cast<uint8_t*>(this);
+  buffer_offset = channel_offset +
+      DataOffset(nof_channels * sizeof(RingChannel));
+  tail_position = 0;
+  tail_sequence = 0;
+  signal.commits = 0;
+  signal.sleepers = 0;
+  segment_signal_offset = segment_signal == nullptr ? 0 :
+      reinterpret_cast<uint8_t*>(segment_signal) -
+      reinterpret_cast<uint8_t*>(this);
+
+  auto* channel_array = new (data) RingChannel[nof_channels];
+  // Allocate the first array item for the publishers.
+  // The other array items are used for the subscribers.
+  channel_array[0].used = true;
+  full = false;
+}
+
+CommitSignal* SharedMemoryRing::SegmentSignal() {
+  if (segment_signal_offset == 0) {
+    return nullptr;
+  }
+  return reinterpret_cast<CommitSignal*>(
+      reinterpret_cast<uint8_t*>(this) + segment_signal_offset);
+}
+
+std::span<RingChannel> SharedMemoryRing::Channels() {
+  auto* data = reinterpret_cast<uint8_t*>(this) + channel_offset;
+  return {reinterpret_cast<RingChannel*>(data), nof_channels};
+}
+
+std::span<uint8_t> SharedMemoryRing::Buffer() {
+  return {reinterpret_cast<uint8_t*>(this) + buffer_offset, buffer_size};
+}
+
+RingChannelToken SharedMemoryRing::AttachChannel() {
+  auto channels = Channels();
+  for (uint32_t index = 1; index < channels.size(); ++index) {
+    auto& channel = channels[index];
+    if (channel.used) {
+      continue;
+    }
+    channel.used = true;
+    channel.position = tail_position;
+    channel.sequence = tail_sequence;
+    channel.heartbeat = 0;
+    channel.pinned = false;
+    channel.pid = CurrentProcessId();
+    ++channel.generation;
+    return {index, channel.generation, channel.pid, channel.sequence};
+  }
+  return {};
+}
+
+bool SharedMemoryRing::Reattach(RingChannelToken& token, uint64_t& nof_lost) {
+  nof_lost = 0;
+  const uint64_t resume = token.sequence;
+  const auto new_token = AttachChannel();
+  if (new_token.channel == 0) {
+    return false;
+  }
+  token = new_token;
+  auto& reader = Channels()[token.channel];
+  const auto& head = Channels()[0];
+  if (resume < reader.sequence) {
+    // The old position has been overwritten.
+    nof_lost = reader.sequence - resume;
+    return true;
+  }
+  // Skips the messages that the subscriber already has read.
+  while (reader.sequence < resume && reader.position < head.position) {
+    const auto record = RecordAt(reader.position);
+    reader.position = record.next;
+    if (record.message) {
+      ++reader.sequence;
+    }
+  }
+  token.sequence = reader.sequence;
+  return true;
+}
+
+void SharedMemoryRing::DetachChannel(const RingChannelToken& token) {
+  if (IsAttached(token)) {
+    FreeChannel(token.channel);
+  }
+}
+
+void SharedMemoryRing::FreeChannel(uint32_t channel) {
+  if (channel == 0 || channel >= nof_channels) {
+    return;
+  }
+  auto& slot = Channels()[channel];
+  slot.used = false;
+  slot.pinned = false;
+  slot.position = 0;
+  slot.sequence = 0;
+  slot.pid = 0;
+}
+
+bool SharedMemoryRing::IsAttached(const RingChannelToken& token) {
+  if (token.channel == 0 || token.channel >= nof_channels) {
+    return false;
+  }
+  const auto& channel = Channels()[token.channel];
+  return channel.used && channel.generation == token.generation &&
+         channel.pid == token.pid;
+}
+
+SharedMemoryRing::Record SharedMemoryRing::RecordAt(uint64_t position) {
+  const auto buffer = Buffer();
+  const uint64_t offset = position % buffer_size;
+  const uint64_t remaining = buffer_size - offset;
+  const uint64_t next_lap = position + remaining;
+  if (remaining < kHeaderSize) {
+    return {next_lap, 0, false};
+  }
+  const LittleBuffer<uint32_t> length(buffer.data(), offset);
+  if (length.value() == kWrapMarker ||
+      RecordSize(length.value()) > remaining) {
+    return {next_lap, 0, false};
+  }
+  return {position + RecordSize(length.value()), length.value(), true};
+}
+
+std::atomic_ref<uint32_t> SharedMemoryRing::StateAt(uint64_t position) {
+  auto* state = Buffer().data() + (position % buffer_size) + kLengthSize;
+  return std::atomic_ref(*reinterpret_cast<uint32_t*>(state));
+}
+
+bool SharedMemoryRing::TooLarge(size_t length) const {
+  if (RecordSize(length) <= buffer_size) {
+    return false;
+  }
+  BUS_ERROR() << "Message larger than the buffer. Dropped. Size: "
+    << length << "/" << buffer_size;
+  return true;
+}
+
+bool SharedMemoryRing::TailAfter(uint64_t new_head, uint64_t record_start,
+    uint64_t& position, uint64_t& sequence) {
+  const auto& head = Channels()[0];
+  position = tail_position;
+  sequence = tail_sequence;
+  while (new_head - position > buffer_size && position < head.position) {
+    const auto record = RecordAt(position);
+    if (record.message) {
+      const uint32_t state = StateAt(position).load(std::memory_order_acquire);
+      if (state != kCommitted && state != kAborted) {
+        return false; // Still being filled in
+      }
+      ++sequence;
+    }
+    position = record.next;
+  }
+  if (new_head - position > buffer_size || position > head.position) {
+    // All old messages are overwritten
+    position = record_start;
+    sequence = head.sequence;
+  }
+  return true;
+}
+
+bool SharedMemoryRing::Reserve(uint32_t length,
+                               RingReservation& reservation) {
+  auto& head = Channels()[0];
+  const uint64_t record_size = RecordSize(length);
+  if (record_size > buffer_size) {
+    return false;
+  }
+
+  // A record is never split at the end of the buffer. Instead the rest
+  // of the buffer is skipped.
+  const uint64_t remaining = buffer_size - (head.position % buffer_size);
+  const uint64_t padding = remaining < record_size ? remaining : 0;
+  const uint64_t record_start = head.position + padding;
+  const uint64_t new_head = record_start + record_size;
+
+  uint64_t new_tail = 0;
+  uint64_t new_tail_sequence = 0;
+  if (!TailAfter(new_head, record_start, new_tail, new_tail_sequence)) {
+    return false;
+  }
+  // Subscribers that have read all messages never block. A pinned record
+  // blocks with both policies.
+  const auto channels = Channels();
+  const uint64_t unread_end = std::min(new_tail, head.position);
+  const bool blocked = std::any_of(channels.begin() + 1, channels.end(),
+      [&] (const RingChannel& channel) -> bool {
+        return channel.used &&
+               (policy == OverrunPolicy::Block || channel.pinned) &&
+               channel.position >= tail_position &&
+               channel.position < unread_end;
+      });
+  if (blocked) {
+    full = true;
+    return false;
+  }
+
+  tail_position = new_tail;
+  tail_sequence = new_tail_sequence;
+  auto buffer = Buffer();
+  if (padding >= kHeaderSize) {
+    const LittleBuffer marker(kWrapMarker);
+    std::copy_n(marker.cbegin(), marker.size(),
+                buffer.begin() + (head.position % buffer_size));
+  }
+
+  reservation.offset = record_start % buffer_size;
+  reservation.length = length;
+  const LittleBuffer length_field(length);
+  std::copy_n(length_field.cbegin(), length_field.size(),
+              buffer.begin() + reservation.offset);
+  StateAt(record_start).store(PendingState(), std::memory_order_relaxed);
+
+  head.position = new_head;
+  ++head.sequence;
+  full = false;
+  return true;
+}
+
+void SharedMemoryRing::Commit(const RingReservation& reservation,
+                              std::span<const uint8_t> message) {
+  auto buffer = Buffer();
+  std::copy_n(message.begin(), std::min<size_t>(message.size(),
+                                                reservation.length),
+              buffer.begin() + reservation.offset + kHeaderSize);
+  StateAt(reservation.offset).store(kCommitted, std::memory_order_release);
+  signal.Notify();
+  if (auto* segment = SegmentSignal(); segment != nullptr) {
+    segment->Notify();
+  }
+}
+
+bool SharedMemoryRing::Publish(interprocess_mutex& mutex,
+                               std::span<const uint8_t> message) {
+  if (TooLarge(message.size())) {
+    return true;
+  }
+  RingReservation reservation;
+  {
+    scoped_lock lock(mutex);
+    if (!Reserve(static_cast<uint32_t>(message.size()), reservation)) {
+      return false;
+    }
+  }
+  Commit(reservation, message);
+  return true;
+}
+
+bool SharedMemoryRing::Write(const IBusMessage& message) {
+  std::vector<uint8_t> msg_buffer;
+  message.ToRaw(msg_buffer);
+  if (TooLarge(msg_buffer.size())) {
+    return true;
+  }
+  RingReservation reservation;
+  if (!Reserve(static_cast<uint32_t>(msg_buffer.size()), reservation)) {
+    return false;
+  }
+  Commit(reservation, msg_buffer);
+  return true;
+}
+
+bool SharedMemoryRing::Read(RingChannelToken& channel,
+                            std::vector<uint8_t>& msg_buffer,
+                            uint64_t& nof_lost) {
+  msg_buffer.clear();
+  std::span<const uint8_t> message;
+  if (!Peek(channel, message, nof_lost)) {
+    return false;
+  }
+  try {
+    msg_buffer.assign(message.begin(), message.end());
+  } catch (const std::exception& err) {
+    BUS_ERROR() << "Message copy failure. Error: " << err.what();
+    msg_buffer.clear();
+  }
+  Advance(channel);
+  return !msg_buffer.empty();
+}
+
+bool SharedMemoryRing::Peek(RingChannelToken& channel,
+                            std::span<const uint8_t>& message,
+                            uint64_t& nof_lost) {
+  message = {};
+  nof_lost = 0;
+  if (!IsAttached(channel)) {
+    return false;
+  }
+  auto& reader = Channels()[channel.channel];
+  const auto& head = Channels()[0];
+  ++reader.heartbeat;
+
+  if (reader.position > head.position) {
+    BUS_ERROR() << "Invalid channel position. Channel: " << channel.channel
+      << ", Position: " << head.position << "/" << reader.position;
+    reader.position = head.position;
+    reader.sequence = head.sequence;
+    channel.sequence = reader.sequence;
+    return false;
+  }
+
+  if (reader.position < tail_position) {
+    // Overrun. The messages have been overwritten.
+    nof_lost = tail_sequence - reader.sequence;
+    reader.position = tail_position;
+    reader.sequence = tail_sequence;
+  }
+  channel.sequence = reader.sequence;
+
+  while (reader.position < head.position) {
+    const auto record = RecordAt(reader.position);
+    if (!record.message) {
+      reader.position = record.next; // Wrap around
+      continue;
+    }
+    const uint32_t state =
+        StateAt(reader.position).load(std::memory_order_acquire);
+    if (state == kAborted) {
+      reader.position = record.next;
+      ++reader.sequence;
+      ++nof_lost;
+      channel.sequence = reader.sequence;
+      continue;
+    }
+    if (state != kCommitted) {
+      return false; // The publisher is still filling in the record.
+    }
+    const uint64_t offset = (reader.position % buffer_size) + kHeaderSize;
+    message = Buffer().subspan(offset, record.length);
+    return true;
+  }
+  return false;
+}
+
+void SharedMemoryRing::Advance(RingChannelToken& channel) {
+  if (!IsAttached(channel)) {
+    return;
+  }
+  auto& reader = Channels()[channel.channel];
+  if (reader.position >= tail_position &&
+      reader.position < Channels()[0].position) {
+    reader.position = RecordAt(reader.position).next;
+    ++reader.sequence;
+  }
+  channel.sequence = reader.sequence;
+}
+
+void SharedMemoryRing::Heartbeat(const RingChannelToken& channel) {
+  if (IsAttached(channel)) {
+    ++Channels()[channel.channel].heartbeat;
+  }
+}
+
+void SharedMemoryRing::Pin(const RingChannelToken& channel, bool pin) {
+  if (IsAttached(channel)) {
+    Channels()[channel.channel].pinned = pin;
+  }
+}
+
+void SharedMemoryRing::SkipSlowReaders() {
+  const auto channels = Channels();
+  const auto& head = channels[0];
+  uint64_t position = 0;
+  uint64_t sequence = 0;
+  // Stops at a record that is being filled in.
+  static_cast<void>(TailAfter(head.position + (buffer_size / 2),
+                              head.position, position, sequence));
+  // Stops at a record that is read without the mutex.
+  for (const auto& channel : channels.subspan(1)) {
+    if (channel.used && channel.pinned && channel.position >= tail_position &&
+        channel.position < position) {
+      position = channel.position;
+      sequence = channel.sequence;
+    }
+  }
+  tail_position = position;
+  tail_sequence = sequence;
+  full = false;
+}
+
+size_t SharedMemoryRing::AbortDeadWriters() {
+  const auto& head = Channels()[0];
+  size_t aborted = 0;
+  for (uint64_t position = tail_position; position < head.position;) {
+    const auto record = RecordAt(position);
+    if (record.message) {
+      auto state = StateAt(position);
+      const uint32_t pid = state.load(std::memory_order_acquire);
+      if (pid != kCommitted && pid != kAborted && !ProcessExists(pid)) {
+        state.store(kAborted, std::memory_order_release);
+        ++aborted;
+      }
+    }
+    position = record.next;
+  }
+  return aborted;
+}
+
+size_t ChannelWatchdog::Check(SharedMemoryRing& ring) {
+  auto channels = ring.Channels();
+  const auto now = std::chrono::steady_clock::now();
+  if (slots_.size() != channels.size()) {
+    slots_.assign(channels.size(), {0, now});
+    last_check_ = now;
+  }
+  // The caller holds the shared memory lock, so keep the checks rare.
+  if (now - last_check_ < kCheckInterval) {
+    return 0;
+  }
+  last_check_ = now;
+
+  size_t reclaimed = 0;
+  for (uint32_t index = 1; index < channels.size(); ++index) {
+    auto& channel = channels[index];
+    auto& slot = slots_[index];
+    if (!channel.used) {
+      slot.last_change = now;
+      continue;
+    }
+    if (channel.heartbeat != slot.heartbeat) {
+      slot.heartbeat = channel.heartbeat;
+      slot.last_change = now;
+      continue;
+    }
+    const bool dead_process = channel.pid != 0 && !ProcessExists(channel.pid);
+    // A subscriber in an in-place callback doesn't update its heartbeat.
+    if (dead_process ||
+        (!channel.pinned && now - slot.last_change > kHeartbeatTimeout)) {
+      BUS_INFO() << "Reclaimed dead subscriber channel. Channel: " << index
+                 << ", PID: " << channel.pid;
+      ring.FreeChannel(index);
+      slot.last_change = now;
+      ++reclaimed;
+    }
+  }
+
+  const size_t aborted = ring.AbortDeadWriters();
+  if (aborted > 0) {
+    BUS_WARNING() << "Aborted records of crashed publishers. Records: "
+                  << aborted;
+  }
+  return reclaimed;
+}
+
+void ChannelWatchdog::HandleFull(SharedMemoryRing& ring) {
+  const auto now = std::chrono::steady_clock::now();
+  const uint64_t head = ring.Channels()[0].position;
+  if (head != full_position_ || full_timeout_ ==
+      std::chrono::steady_clock::time_point()) {
+    // The publishers are still moving
+    full_position_ = head;
+    full_timeout_ = now + kFullTimeout;
+  } else if (now > full_timeout_) {
+    BUS_ERROR() << "Buffer full (10s) timeout occurred. Skipping slow "
+                   "subscribers";
+    ring.SkipSlowReaders();
+    full_timeout_ = {};
+  }
+  ring.full = false; // Let the publishers retry
+}
+
+uint32_t CommitCount(std::span<SharedMemoryRing* const> rings) {
+  uint32_t count = 0;
+  for (const auto* ring : rings) {
+    count += ring->signal.commits.load(std::memory_order_acquire);
+  }
+  return count;
+}
+
+void WaitForCommits(std::span<SharedMemoryRing* const> rings,
+                    uint32_t commits, SpinWait& spin,
+                    const QueueWaitOptions& options,
+                    const std::atomic<bool>& stop) {
+  if (rings.empty()) {
+    std::this_thread::sleep_for(options.sleep_time);
+    return;
+  }
+  while (!stop && CommitCount(rings) == commits) {
+    if (spin.Pause()) {
+      continue;
+    }
+    auto* signal = &rings.front()->signal;
+    if (rings.size() > 1) {
+      signal = rings.front()->SegmentSignal();
+    }
+    if (signal == nullptr) {
+      // Many rings without a common signal. Polls again after a short nap.
+      std::this_thread::sleep_for(std::min(options.sleep_time,
+          std::chrono::microseconds(std::chrono::milliseconds(1))));
+      return;
+    }
+    // The counter is read before the rings are checked, so a commit after
+    // the check changes the counter and the wait returns directly.
+    const uint32_t seen = signal->commits;
+    if (CommitCount(rings) == commits) {
+      signal->Wait(seen, options.sleep_time);
+    }
+    return;
+  }
+}
+
+void PinQueueThread(const QueueWaitOptions& options) {
+  if (options.cpu >= 0 && !PinCurrentThread(options.cpu)) {
+    BUS_WARNING() << "Failed to pin the queue thread. CPU: " << options.cpu;
+  }
+}
+
+void AttachBackoff(std::chrono::milliseconds& delay) {
+  delay = std::clamp(delay * 2, kMinAttachDelay, kMaxAttachDelay);
+  std::this_thread::sleep_for(delay);
+}
+
+uint32_t CurrentProcessId() {
+#if defined(_WIN32)
+  return static_cast<uint32_t>(::GetCurrentProcessId());
+#else
+  return static_cast<uint32_t>(::getpid());
+#endif
+}
+
+bool ProcessExists(uint32_t pid) {
+#if defined(_WIN32)
+  HANDLE process = ::OpenProcess(SYNCHRONIZE, FALSE, pid);
+  if (process == nullptr) {
+    return ::GetLastError() == ERROR_ACCESS_DENIED;
+  }
+  const bool running = ::WaitForSingleObject(process, 0) == WAIT_TIMEOUT;
+  ::CloseHandle(process);
+  return running;
+#else
+  return ::kill(static_cast<pid_t>(pid), 0) == 0 || errno != ESRCH;
+#endif
+}
+
+} // bus
@@ -0,0 +1,417 @@
+/*
+* Copyright 2025 Ingemar Hedvall
+* SPDX-License-Identifier: MIT
+*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <boost/interprocess/sync/interprocess_condition.hpp>
+#include <boost/interprocess/sync/interprocess_mutex.hpp>
+
+#include "bus/ibusmessagebroker.h"
+#include "bus/spinwait.h"
+
+namespace bus {
+
+constexpr size_t kCacheLineSize = 64; ///< Separates the cursors.
+constexpr size_t kMemoryPageSize = 4'096; ///< Alignment of the data.
+constexpr uint32_t kLayoutVersion = 9; ///< Increment if the layout changes.
+constexpr uint32_t kSharedMemoryMagic = 0x53554243; ///< "CBUS"
+
+/** \brief First block of a shared memory segment.
+ *
+ * The header is checked when a process attaches to the segment, so a
+ * process built with another layout, compiler or buffer size fails
+ * instead of reading garbage. It also holds the ring capacity and the
+ * number of subscriber slots, as they are defined by the broker.
+ */
+struct alignas(kCacheLineSize) SharedMemoryHeader {
+  uint32_t magic = 0; ///< Identifies the segment (kSharedMemoryMagic).
+  uint32_t layout_version = 0; ///< Layout of the segment (kLayoutVersion).
+  uint32_t abi = 0; ///< Fingerprint of the object sizes (Abi()).
+  uint32_t nof_rings = 0; ///< Number of rings in the segment.
+  uint32_t max_subscribers = 0; ///< Number of subscriber slots per ring.
+  uint32_t buffer_size = 0; ///< Message buffer capacity per ring.
+  uint64_t segment_size = 0; ///< Size of the segment.
+  std::atomic<bool> initialized = false; ///< Indicate that shared memory ready
+
+  /** \brief Sets all properties except the initialized flag. */
+  void Init(size_t size, uint32_t rings, uint32_t subscribers,
+            uint32_t capacity);
+
+  /** \brief Returns the fingerprint of this build's shared memory objects. */
+  [[nodiscard]] static uint32_t Abi();
+
+  /** \brief Throws if the segment isn't usable by this process.
+   *
+   * @param name Segment name used in the error message.
+   * @param region_size Mapped size of the segment.
+   */
+  void Validate(const std::string& name, size_t region_size) const;
+};
+
+/** \brief Returns the page aligned offset of the data after an object. */
+[[nodiscard]] constexpr size_t DataOffset(size_t object_size) {
+  return ((object_size + kMemoryPageSize - 1) / kMemoryPageSize) *
+      kMemoryPageSize;
+}
+
+/** \brief Commit counter that spinning subscribers poll and sleep on.
+ *
+ * The counter is a futex word on Linux, so a commit wakes the sleeping
+ * subscribers directly. Other platforms sleep the timeout.
+ */
+struct alignas(kCacheLineSize) CommitSignal {
+  std::atomic<uint32_t> commits = 0; ///< Incremented by each commit.
+  std::atomic<uint32_t> sleepers = 0; ///< Subscribers sleeping on commits.
+
+  /** \brief Counts a commit and wakes the sleeping subscribers. */
+  void Notify();
+
+  /** \brief Sleeps until the next commit or the timeout.
+   *
+   * The function returns directly if the counter differs from the seen
+   * value.
+   * @param seen Counter value that the caller has handled.
+   * @param timeout Max sleep time.
+   */
+  void Wait(uint32_t seen, std::chrono::microseconds timeout);
+};
+
+/** \brief Read or write position of a publisher or subscriber.
+ *
+ * The position is a monotonic byte counter, i.e. it doesn't wrap when
+ * the buffer wraps. The buffer offset is the position modulo the buffer
+ * size. The sequence number counts the messages.
+ * Each channel has its own cache line, so a subscriber updating its
+ * position doesn't invalidate the cache of the other processes.
+ */
+struct alignas(kCacheLineSize) RingChannel {
+  bool used = false; ///< Indicate if the channel is used.
+  uint32_t heartbeat = 0; ///< Incremented by the subscriber when polling.
+  uint32_t pid = 0; ///< Process ID of the subscriber.
+  uint32_t generation = 0; ///< Incremented each time the channel is attached.
+  bool pinned = false; ///< The record at the position is read without mutex.
+  uint64_t position = 0; ///< Monotonic byte position.
+  uint64_t sequence = 0; ///< Sequence number of the next message.
+};
+
+/** \brief Identifies the owner of a subscriber channel.
+ *
+ * The watchdog reclaims a channel with a stale heartbeat, which also
+ * happens to a live subscriber that is stopped or paused in a debugger.
+ * The channel may then be attached by another subscriber. The generation
+ * and the process ID tell the old owner that the channel isn't its own
+ * anymore, so it doesn't move or free the new owner's cursor.
+ */
+struct RingChannelToken {
+  uint32_t channel = 0; ///< Channel index. 0 = not attached.
+  uint32_t generation = 0; ///< Channel generation when attached.
+  uint32_t pid = 0; ///< Process ID of the owner.
+  uint64_t sequence = 0; ///< Next sequence number of the owner.
+};
+
+/** \brief Record reserved by a publisher. */
+struct RingReservation {
+  uint64_t offset = 0; ///< Buffer offset of the record.
+  uint32_t length = 0; ///< Message length.
+};
+
+/** \brief Wrap-around message buffer with reader channels in a shared
+ * memory.
+ *
+ * The ring is placed inside a shared memory object while its channel
+ * array and message buffer are placed after the object. The offsets are
+ * relative to the ring object so the processes may map the shared memory
+ * on different addresses.
+ *
+ * Channel 0 holds the write position of the publishers while the
+ * other channels hold the read position of each subscriber.
+ * The tail is the oldest message still in the buffer. A subscriber
+ * behind the tail have been overrun. It jumps to the tail and the
+ * difference in sequence number is the number of lost messages.
+ *
+ * The read-only properties, the publisher properties and the condition
+ * are placed in separate cache lines. The channel array and the message
+ * buffer are page aligned.
+ *
+ * A message is written in two steps. The publisher reserves a record while
+ * holding the mutex, which only moves the cursors. It then copies the
+ * message into the record and commits it without the mutex, so the
+ * publishers doesn't serialize each other on the copy. Each record has a
+ * state word that is the publisher's process ID until the record is
+ * committed. Subscribers stop at a record that isn't committed.
+ *
+ * Each commit increments a commit counter (signal). A subscriber with the
+ * spin wait strategy polls the counter instead of locking the mutex. When
+ * it backs off to sleep, it sleeps on the counter and the commit wakes it.
+ * The rings of a segment may also share a segment signal, so a subscriber
+ * of many rings can sleep on one counter.
+ *
+ * Note that all functions except Commit() and Publish() require that the
+ * shared memory mutex is locked.
+ */
+struct SharedMemoryRing {
+  OverrunPolicy policy = OverrunPolicy::Block;
+  uint32_t nof_channels = 0; ///< Number of channels including channel 0.
+  uint32_t buffer_size = 0; ///< Message buffer size.
+  uint64_t channel_offset = 0; ///< Channel array offset from this object.
+  uint64_t buffer_offset = 0; ///< Message buffer offset from this object.
+  int64_t segment_signal_offset = 0; ///< Segment signal offset. 0 = none.
+
+  /** \brief Set when a subscriber blocks the publishers. */
+  alignas(kCacheLineSize) std::atomic<bool> full = false;
+  uint64_t tail_position = 0; ///< Position of the oldest message.
+  uint64_t tail_sequence = 0; ///< Sequence number of the oldest message.
+
+  alignas(kCacheLineSize)
+  boost::interprocess::interprocess_condition full_condition;
+
+  CommitSignal signal; ///< Signals the commits of this ring.
+
+  /** \brief Returns the bytes needed for the channels and the buffer. */
+  [[nodiscard]] static size_t DataSize(uint32_t nof_channels,
+                                       uint32_t buffer_size);
+
+  /** \brief Initialize the ring.
+   *
+   * @param max_subscribers Number of subscriber channels.
+   * @param size Message buffer size.
+   * @param overrun Slow subscriber policy.
+   * @param data Page aligned memory for the channels and the buffer
+   * (DataSize bytes).
+   * @param segment_signal Signal shared by the rings of the segment.
+   */
+  void Init(uint32_t max_subscribers, uint32_t size, OverrunPolicy overrun,
+            uint8_t* data, CommitSignal* segment_signal = nullptr);
+
+  /** \brief Returns the segment signal or nullptr if not shared. */
+  [[nodiscard]] CommitSignal* SegmentSignal();
+
+  [[nodiscard]] std::span<RingChannel> Channels();
+  [[nodiscard]] std::span<uint8_t> Buffer();
+
+  /** \brief Allocates a free subscriber channel.
+   *
+   * The subscriber starts reading at the oldest message in the buffer.
+   * @return Owner token. The channel is 0 if no channel is free.
+   */
+  [[nodiscard]] RingChannelToken AttachChannel();
+
+  /** \brief Attaches a new channel after the old one was reclaimed.
+   *
+   * The subscriber continues at the token's sequence number if that
+   * message still is in the buffer. Otherwise, it starts at the oldest
+   * message and the skipped messages are reported as lost.
+   * @param token Owner token of the lost channel. Updated on success.
+   * @param nof_lost Number of messages lost.
+   * @return False if no channel is free.
+   */
+  [[nodiscard]] bool Reattach(RingChannelToken& token, uint64_t& nof_lost);
+
+  /** \brief Frees a subscriber channel if the token still owns it. */
+  void DetachChannel(const RingChannelToken& token);
+
+  /** \brief Frees a subscriber channel independent of its owner.
+   *
+   * Used by the watchdog to reclaim channels of dead subscribers.
+   * @param channel Channel index.
+   */
+  void FreeChannel(uint32_t channel);
+
+  /** \brief Returns true if the token owns an allocated channel. */
+  [[nodiscard]] bool IsAttached(const RingChannelToken& token);
+
+  /** \brief Reserves a record for a message.
+   *
+   * With the overwrite policy, the oldest messages are overwritten if
+   * needed. With the block policy, or if a subscriber has pinned a record,
+   * the function returns false and sets the full flag if the subscriber
+   * haven't read the space needed. It also
+   * returns false if the oldest record is still being filled in by another
+   * publisher.
+   * @param length Serialized message length.
+   * @param reservation Reserved record.
+   * @return False if no record was reserved.
+   */
+  [[nodiscard]] bool Reserve(uint32_t length, RingReservation& reservation);
+
+  /** \brief Copies the message into a reserved record and commits it.
+   *
+   * Doesn't require the mutex.
+   * @param reservation Record reserved by Reserve().
+   * @param message Serialized message.
+   */
+  void Commit(const RingReservation& reservation,
+              std::span<const uint8_t> message);
+
+  /** \brief Reserves and commits a message. Locks the mutex when reserving.
+   *
+   * A message larger than the buffer is dropped.
+   * @param mutex Shared memory mutex.
+   * @param message Serialized message.
+   * @return False if the message wasn't written.
+   */
+  [[nodiscard]] bool Publish(boost::interprocess::interprocess_mutex& mutex,
+                             std::span<const uint8_t> message);
+
+  /** \brief Writes a message to the buffer (Reserve() and Commit()).
+   *
+   * @param message Message to write.
+   * @return False if the message wasn't written.
+   */
+  [[nodiscard]] bool Write(const IBusMessage& message);
+
+  /** \brief Reads the next message for a subscriber channel.
+   *
+   * The call also updates the channel heartbeat.
+   * @param channel Owner token of the subscriber channel.
+   * @param msg_buffer Serialized message.
+   * @param nof_lost Number of messages lost due to an overrun.
+   * @return True if a message was read.
+   */
+  bool Read(RingChannelToken& channel, std::vector<uint8_t>& msg_buffer,
+            uint64_t& nof_lost);
+
+  /** \brief Returns the next message without copying it.
+   *
+   * The message points into the buffer and the channel position isn't
+   * moved. The message is valid until Advance() is called or the ring
+   * mutex is unlocked, unless the message is pinned with Pin().
+   * @param channel Owner token of the subscriber channel.
+   * @param message The serialized message in the buffer.
+   * @param nof_lost Number of messages lost due to an overrun.
+   * @return True if there is a message.
+   */
+  bool Peek(RingChannelToken& channel, std::span<const uint8_t>& message,
+            uint64_t& nof_lost);
+
+  /** \brief Moves the channel past the message returned by Peek().
+   *
+   * The channel isn't moved if the message was overwritten after the
+   * Peek(). The next Peek() then reports the overrun.
+   */
+  void Advance(RingChannelToken& channel);
+
+  /** \brief Updates the channel heartbeat without reading. */
+  void Heartbeat(const RingChannelToken& channel);
+
+  /** \brief Pins the record at the channel position.
+   *
+   * A pinned record is read without the mutex, so the publishers don't
+   * overwrite it, independent of the overrun policy, and the watchdog
+   * doesn't reclaim the channel unless its process is dead. Unpin the
+   * record before calling Advance().
+   * @param channel Owner token of the subscriber channel.
+   * @param pin True to pin, false to unpin.
+   */
+  void Pin(const RingChannelToken& channel, bool pin);
+
+  /** \brief Moves the tail so half the buffer is free.
+   *
+   * Used by the block policy when the publishers have been blocked too
+   * long. Subscribers behind the new tail are overrun. The tail never
+   * passes a pinned record.
+   */
+  void SkipSlowReaders();
+
+  /** \brief Aborts records that crashed publishers never committed.
+   *
+   * The subscribers skip aborted records and report them as lost.
+   * @return Number of aborted records.
+   */
+  size_t AbortDeadWriters();
+
+ private:
+  struct Record {
+    uint64_t next = 0; ///< Position of the next record.
+    uint32_t length = 0; ///< Message length.
+    bool message = false; ///< False if wrap around.
+  };
+  [[nodiscard]] Record RecordAt(uint64_t position);
+  [[nodiscard]] std::atomic_ref<uint32_t> StateAt(uint64_t position);
+  [[nodiscard]] bool TooLarge(size_t length) const;
+  [[nodiscard]] bool TailAfter(uint64_t new_head, uint64_t record_start,
+                               uint64_t& position, uint64_t& sequence);
+};
+
+/** \brief Detects and frees channels of crashed subscribers.
+ *
+ * The watchdog is owned by the broker process. A subscriber is dead if
+ * its process doesn't exist or its heartbeat haven't changed within the
+ * timeout. The channels are checked at most twice a second.
+ *
+ * The watchdog also aborts records of crashed publishers and handles
+ * the full flag of the block policy. If the publishers have been blocked
+ * for 10 seconds, the slow subscribers are skipped.
+ */
+class ChannelWatchdog {
+ public:
+  /** \brief Checks all channels. Requires a locked shared memory mutex.
+   *
+   * @param ring Ring to check.
+   * @return Number of reclaimed channels.
+   */
+  size_t Check(SharedMemoryRing& ring);
+
+  /** \brief Handles a full buffer. Requires a locked shared memory mutex.
+   *
+   * @param ring Ring that is full.
+   */
+  void HandleFull(SharedMemoryRing& ring);
+
+ private:
+  struct Slot {
+    uint32_t heartbeat = 0;
+    std::chrono::steady_clock::time_point last_change;
+  };
+  std::vector<Slot> slots_;
+  std::chrono::steady_clock::time_point last_check_;
+  std::chrono::steady_clock::time_point full_timeout_;
+  uint64_t full_position_ = 0; ///< Head position when the timer started.
+};
+
+/** \brief Returns the sum of the commit counters of the rings. */
+[[nodiscard]] uint32_t CommitCount(std::span<SharedMemoryRing* const> rings);
+
+/** \brief Waits for a commit in any of the rings (spin wait strategy).
+ *
+ * The function busy-polls the commit counters, then yields and finally
+ * sleeps. A single ring is slept on directly. Many rings are slept on
+ * through their segment signal, so a commit in any of them wakes the
+ * caller.
+ * @param rings Rings to watch.
+ * @param commits CommitCount() before the rings were read.
+ * @param spin Back-off state of the calling thread.
+ * @param options Sleep time.
+ * @param stop Stops the wait.
+ */
+void WaitForCommits(std::span<SharedMemoryRing* const> rings,
+                    uint32_t commits, SpinWait& spin,
+                    const QueueWaitOptions& options,
+                    const std::atomic<bool>& stop);
+
+/** \brief Pins the calling queue thread if the options say so. */
+void PinQueueThread(const QueueWaitOptions& options);
+
+/** \brief Sleeps before the next attach attempt.
+ *
+ * The delay starts at 10 ms and is doubled for each attempt up to 1 s.
+ * @param delay Current delay. Set to zero when attached.
+ */
+void AttachBackoff(std::chrono::milliseconds& delay);
+
+/** \brief Returns the ID of this process. */
+[[nodiscard]] uint32_t CurrentProcessId();
+
+/** \brief Returns false if the process doesn't exist. */
+[[nodiscard]] bool ProcessExists(uint32_t pid);
+
+} // bus
@@ -10,11 +10,16 @@
 #include "sharedmemoryserver.h"
 
 #include "sharedmemorytxrxqueue.h"
+#include "sharedmemoryoptions.h"
 #include "bus/buslogstream.h"
 
 using namespace std::chrono_literals;
 using namespace boost::interprocess;
 
+namespace {
+constexpr uint32_t kMinBufferSize = 16'000; ///< Fits one jumbo frame.
+}
+
 namespace bus {
 SharedMemoryServer::~SharedMemoryServer() {
   SharedMemoryServer::Stop();
@@ -46,14 +51,16 @@ void SharedMemoryServer::Stop() {
     return;
   }
   stop_server_threads_ = true;
-  shm_->tx_full_condition.notify_all(); // Speed up the stop
-  shm_->rx_full_condition.notify_all(); // Speed up the stop
+  shm_->tx.full_condition.notify_all(); // Speed up the stop
+  shm_->rx.full_condition.notify_all(); // Speed up the stop
   if (tx_thread_.joinable()) {
     tx_thread_.join();
   }
   if (rx_thread_.joinable()) {
     rx_thread_.join();
   }
+  // Tells attached processes to map the next segment.
+  shm_->header.initialized = false;
   shm_ = nullptr;
   region_.reset();
   shared_memory_.reset();
@@ -62,13 +69,13 @@ void SharedMemoryServer::Stop() {
 
 std::shared_ptr<IBusMessageQueue> SharedMemoryServer::CreatePublisher() {
   auto publisher = std::make_shared<SharedMemoryTxRxQueue>(Name(),
-    true, true);
+    true, true, MemoryOptions());
   return publisher;
 }
 
 std::shared_ptr<IBusMessageQueue> SharedMemoryServer::CreateSubscriber() {
   auto subscriber = std::make_shared<SharedMemoryTxRxQueue>(Name(),
-    false, false);
+    false, false, MemoryOptions());
   return subscriber;
 }
 
@@ -87,7 +94,13 @@ void SharedMemoryServer::ConnectToSharedMemory() {
       err << "Failed to create shared memory. Name: " << Name();
       throw std::runtime_error(err.str());
     }
-    shared_memory_->truncate(sizeof(SharedServerObjects));
+    const uint32_t buffer_size = std::max(MemorySize(), kMinBufferSize);
+    const size_t ring_size = SharedMemoryRing::DataSize(MaxSubscribers() + 1,
+                                                        buffer_size);
+    const size_t memory_size = SegmentSize(
+        DataOffset(sizeof(SharedServerObjects)) + (2 * ring_size),
+        MemoryOptions());
+    shared_memory_->truncate(static_cast<offset_t>(memory_size));
 
     region_ = std::make_unique<mapped_region>(*shared_memory_, read_write);
     if (!region_ || region_->get_address() == nullptr) {
@@ -95,27 +108,21 @@ void SharedMemoryServer::ConnectToSharedMemory() {
       err << "Failed to get a region address. Name: " << Name();
       throw std::runtime_error(err.str());
     }
+    // Bind and advise the pages before the memset faults them in.
+    ApplyMemoryOptions(*region_, MemoryOptions(), Name());
     std::memset(region_->get_address(), 0, region_->get_size());
     shm_ = new(region_->get_address()) SharedServerObjects();
 
     scoped_lock lock(shm_->memory_mutex);
-    // Reset the channels in/out indexes.
-    std::ranges::for_each(shm_->tx_channels, [] (Channel& channel) ->void {
-      channel.used = false;
-      channel.queue_index = 0;
-    });
-    std::ranges::for_each(shm_->rx_channels, [] (Channel& channel) ->void {
-      channel.used = false;
-      channel.queue_index = 0;
-    });
-
-    // Allocate the first array item for the publishers.
-    // The other array items are used for the subscribers.
-    // The subscriber tries to allocate a free channal
-    // array at startup.
-    shm_->tx_channels[0].used = true;
-    shm_->rx_channels[0].used = true;
-    shm_->initialized = true;
+    // The subscriber tries to allocate a free channel at startup.
+    auto* data = static_cast<uint8_t*>(region_->get_address()) +
+        DataOffset(sizeof(SharedServerObjects));
+    shm_->tx.Init(MaxSubscribers(), buffer_size, Overrun(), data);
+    shm_->rx.Init(MaxSubscribers(), buffer_size, Overrun(), data + ring_size);
+    tx_watchdog_ = ChannelWatchdog();
+    rx_watchdog_ = ChannelWatchdog();
+    shm_->header.Init(memory_size, 2, MaxSubscribers(), buffer_size);
+    shm_->header.initialized = true;
 
   } catch (std::exception &err) {
     BUS_ERROR() << "Failed to create the shared memory. Name: " << Name()
@@ -130,14 +137,18 @@ void SharedMemoryServer::ConnectToSharedMemory() {
 void SharedMemoryServer::TxThread() {
   while (!stop_server_threads_ || shm_ == nullptr) {
     scoped_lock lock(shm_->memory_mutex);
-    shm_->tx_full_condition.wait_for(lock, 100ms, [&] () -> bool {
-      return stop_server_threads_.load() || shm_->tx_full.load();
+    shm_->tx.full_condition.wait_for(lock, 100ms, [&] () -> bool {
+      return stop_server_threads_.load() || shm_->tx.full.load();
     } );
     if (stop_server_threads_) {
       return;
     }
-    if (shm_->tx_full) {
+    tx_watchdog_.Check(shm_->tx);
+    if (shm_->tx.full) {
       HandleTxFull();
+      // Let the subscribers catch up instead of spinning on the lock.
+      lock.unlock();
+      std::this_thread::sleep_for(1ms);
     }
   }
 }
@@ -146,52 +157,24 @@ void SharedMemoryServer::HandleTxFull() {
   if (shm_ == nullptr) {
     return;
   }
-  const uint32_t ref_index  = shm_->tx_channels[0].queue_index;
-
-  bool all_index_ok = std::ranges::all_of( shm_->tx_channels,
-    [&] (const Channel& channel)-> bool {
-      if (!channel.used) {
-        return true;
-      }
-      return channel.queue_index == ref_index;
-    });
-
-  if (all_index_ok) {
-    ResetTxChannels();
-  } else if (shm_->tx_full) {
-    std::time_t now = std::time(nullptr);
-    if (tx_timeout_ == 0) {
-      tx_timeout_ = now + 10;;
-    } else if (now > tx_timeout_) {
-      BUS_ERROR() << "TX buffer full (10s) timeout occurred. Resetting";
-      ResetTxChannels();
-    }
-  }
-}
-
-void SharedMemoryServer::ResetTxChannels() {
-  if (shm_ == nullptr) {
-    return;
-  }
-  std::ranges::for_each(shm_->tx_channels, [] (Channel& channel) -> void {
-    channel.queue_index = 0;
-  });
-
-  shm_->tx_full= false;
-  tx_timeout_ = 0;
+  tx_watchdog_.HandleFull(shm_->tx);
 }
 
 void SharedMemoryServer::RxThread() {
   while (!stop_server_threads_ || shm_ == nullptr) {
     scoped_lock lock(shm_->memory_mutex);
-    shm_->rx_full_condition.wait_for(lock, 100ms, [&] () -> bool {
-      return stop_server_threads_.load() || shm_->rx_full.load();
+    shm_->rx.full_condition.wait_for(lock, 100ms, [&] () -> bool {
+      return stop_server_threads_.load() || shm_->rx.full.load();
     } );
     if (stop_server_threads_) {
       return;
     }
-    if (shm_->rx_full) {
+    rx_watchdog_.Check(shm_->rx);
+    if (shm_->rx.full) {
       HandleRxFull();
+      // Let the subscribers catch up instead of spinning on the lock.
+      lock.unlock();
+      std::this_thread::sleep_for(1ms);
     }
   }
 }
@@ -200,38 +183,6 @@ void SharedMemoryServer::HandleRxFull() {
   if (shm_ == nullptr) {
     return;
   }
-  const uint32_t ref_index  = shm_->rx_channels[0].queue_index;
-
-  bool all_index_ok = std::ranges::all_of( shm_->rx_channels,
-    [&] (const Channel& channel)-> bool {
-      if (!channel.used) {
-        return true;
-      }
-      return channel.queue_index == ref_index;
-    });
-
-  if (all_index_ok) {
-    ResetRxChannels();
-  } else if (shm_->rx_full) {
-    std::time_t now = std::time(nullptr);
-    if (rx_timeout_ == 0) {
-      rx_timeout_ = now + 10;;
-    } else if (now > rx_timeout_) {
-      BUS_ERROR() << "RX buffer full (10s) timeout occurred. Resetting";
-      ResetRxChannels();
-    }
-  }
-}
-
-void SharedMemoryServer::ResetRxChannels() {
-  if (shm_ == nullptr) {
-    return;
-  }
-  std::ranges::for_each(shm_->rx_channels, [] (Channel& channel) -> void {
-    channel.queue_index = 0;
-  });
-
-  shm_->rx_full= false;
-  rx_timeout_ = 0;
+  rx_watchdog_.HandleFull(shm_->rx);
 }
 } // bus
\ No newline at end of file
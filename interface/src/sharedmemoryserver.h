@@ -7,35 +7,28 @@
 
 #include <atomic>
 #include <thread>
-#include <array>
 #include <memory>
-#include <ctime>
 
 #include <boost/interprocess/sync/interprocess_mutex.hpp>
-#include <boost/interprocess/sync/interprocess_condition.hpp>
 #include <boost/interprocess/mapped_region.hpp>
 #include <boost/interprocess/shared_memory_object.hpp>
 
 #include "bus/ibusmessagebroker.h"
-
+#include "sharedmemoryring.h"
 
 namespace bus {
 
-
-
+/** \brief Shared memory layout of the server.
+ *
+ * The channel arrays and message buffers of the TX and RX rings
+ * follows on the first page after this object.
+ */
 struct SharedServerObjects {
-  std::atomic<bool> initialized = false; // Indicate that shared memory ready
+  SharedMemoryHeader header;
+  alignas(kCacheLineSize)
   boost::interprocess::interprocess_mutex memory_mutex;
-
-  boost::interprocess::interprocess_condition tx_full_condition;
-  std::atomic<bool> tx_full = false;
-  std::array<Channel, 256> tx_channels;
-  std::array<uint8_t, 16'000> tx_buffer;
-
-  boost::interprocess::interprocess_condition rx_full_condition;
-  std::atomic<bool> rx_full = false;
-  std::array<Channel, 256> rx_channels;
-  std::array<uint8_t, 16'000> rx_buffer;
+  SharedMemoryRing tx;
+  SharedMemoryRing rx;
 };
 
 class SharedMemoryServer : public IBusMessageBroker {
@@ -53,8 +46,8 @@ private:
   std::atomic<bool> stop_server_threads_ = true;
   std::thread tx_thread_;
   std::thread rx_thread_;
-  std::time_t tx_timeout_ = 0;
-  std::time_t rx_timeout_ = 0;
+  ChannelWatchdog tx_watchdog_;
+  ChannelWatchdog rx_watchdog_;
 
   SharedServerObjects* shm_ = nullptr;
   std::unique_ptr<boost::interprocess::shared_memory_object>  shared_memory_;
@@ -62,11 +55,9 @@ private:
 
   void TxThread();
   void HandleTxFull();
-  void ResetTxChannels();
 
   void RxThread();
   void HandleRxFull();
-  void ResetRxChannels();
 };
 
 } // bus
@@ -2,6 +2,7 @@
 * Copyright 2025 Ingemar Hedvall
 * SPDX-License-Identifier: MIT
 */
+#include <array>
 #include <cstdint>
 #include <chrono>
 #include <thread>
@@ -12,8 +13,8 @@
 
 #include "sharedmemorytxrxqueue.h"
 #include "sharedmemoryserver.h"
+#include "sharedmemoryoptions.h"
 #include "bus/buslogstream.h"
-#include "bus/littlebuffer.h"
 
 using namespace std::chrono_literals;
 using namespace boost::interprocess;
@@ -21,10 +22,11 @@ using namespace boost::interprocess;
 namespace bus {
 
 SharedMemoryTxRxQueue::SharedMemoryTxRxQueue(std::string shared_memory_name,
-  bool tx_queue, bool publisher )
+  bool tx_queue, bool publisher, const SharedMemoryOptions& options)
   : tx_queue_(tx_queue),
     publisher_(publisher),
-    shared_memory_name_(std::move(shared_memory_name)) {
+    shared_memory_name_(std::move(shared_memory_name)),
+    options_(options) {
 }
 
 SharedMemoryTxRxQueue::~SharedMemoryTxRxQueue() {
@@ -45,6 +47,11 @@ void SharedMemoryTxRxQueue::Start() {
   if (publisher_) {
     thread_ = std::thread(&SharedMemoryTxRxQueue::PublisherThread, this);
   } else {
+    // Attach at once, so no messages published after Start() are lost.
+    ConnectToSharedMemory();
+    if (state_ == SharedMemoryState::HandleMessages) {
+      GetChannel();
+    }
     thread_ = std::thread(&SharedMemoryTxRxQueue::SubscriberThread, this);
   }
 }
@@ -54,6 +61,7 @@ void SharedMemoryTxRxQueue::Stop() {
   if (thread_.joinable()) {
     thread_.join();
   }
+  ReleaseChannel();
   shm_ = nullptr;
   region_.reset();
   shared_memory_.reset();
@@ -65,10 +73,12 @@ void SharedMemoryTxRxQueue::Stop() {
 }
 
 void SharedMemoryTxRxQueue::PublisherThread() {
+  PinQueueThread(WaitOptions());
+  std::vector<uint8_t> msg_buffer;
   while (!stop_thread_ ) {
     switch (state_) {
       case SharedMemoryState::HandleMessages:
-        if (shm_ == nullptr) {
+        if (!IsAttached()) {
           state_ = SharedMemoryState::WaitOnSharedMemory;
         }
         break;
@@ -79,13 +89,12 @@ void SharedMemoryTxRxQueue::PublisherThread() {
         break;
     }
     if (state_ == SharedMemoryState::WaitOnSharedMemory) {
-      std::this_thread::sleep_for(1000ms);
+      AttachBackoff(attach_delay_);
       continue;
     }
 
 
-    if (const bool buffer_full = tx_queue_ ? shm_->tx_full : shm_->rx_full;
-        buffer_full) {
+    if (Ring().full) {
       std::this_thread::sleep_for(10ms);
       continue;
     }
@@ -94,24 +103,25 @@ void SharedMemoryTxRxQueue::PublisherThread() {
     if (!msg) {
       continue;
     }
-    bool message_sent;
-    {
-      scoped_lock lock(shm_->memory_mutex);
-      message_sent = PublisherPoll(*shm_, *msg);
-    }
-
-    if (!message_sent) {
-      // The buffer should be flagged full
+    // Serialize and copy the message without holding the mutex.
+    msg->ToRaw(msg_buffer);
+    if (!Ring().Publish(shm_->memory_mutex, msg_buffer)) {
+      // The buffer is full or another publisher is filling in the
+      // oldest record.
       PushFront(msg);
     }
   }
 }
 
 void SharedMemoryTxRxQueue::SubscriberThread() {
+  PinQueueThread(WaitOptions());
+  SpinWait spin(WaitOptions());
   while (!stop_thread_ ) {
     switch (state_) {
       case SharedMemoryState::HandleMessages:
-        if (shm_ == nullptr) {
+        if (!IsAttached()) {
+          // The server has restarted. The old channel is gone.
+          channel_ = {};
           state_ = SharedMemoryState::WaitOnSharedMemory;
         }
         break;
@@ -122,165 +132,108 @@ void SharedMemoryTxRxQueue::SubscriberThread() {
         break;
     }
     if (state_ == SharedMemoryState::WaitOnSharedMemory) {
-      std::this_thread::sleep_for(1000ms);
+      AttachBackoff(attach_delay_);
       continue;
     }
 
-    if (channel_ == 0) {
+    if (channel_.channel == 0) {
       GetChannel();
     }
-    if (channel_ == 0) {
+    if (channel_.channel == 0) {
       std::this_thread::sleep_for(1000ms);
       continue;
     }
 
+    std::array<SharedMemoryRing*, 1> rings = {&Ring()};
+    // Read before polling, so a commit during the poll isn't missed.
+    const uint32_t commits = CommitCount(rings);
     std::vector<uint8_t> message_buffer;
+    bool received = false;
     bool more = true;
     while ( more && !stop_thread_) {
       {
         scoped_lock lock(shm_->memory_mutex);
-        more = SubscriberPoll(*shm_, message_buffer);
+        more = SubscriberPoll(message_buffer);
       }
+      received |= more;
       if (more && !message_buffer.empty()) {
         Push(message_buffer);
       }
     }
       // Trig a reset of channels as the in/out indexes should point on the
       // same indexies.
-    auto& condition = tx_queue_ ? shm_->tx_full_condition : shm_->rx_full_condition;
-    condition.notify_all();
-    std::this_thread::sleep_for(10ms);
+    Ring().full_condition.notify_all();
+    if (WaitOptions().strategy != WaitStrategy::Spin) {
+      std::this_thread::sleep_for(10ms);
+    } else if (received) {
+      spin.Reset(); // Poll again directly
+    } else {
+      WaitForCommits(rings, commits, spin, WaitOptions(), stop_thread_);
+    }
   }
 }
 
+SharedMemoryRing& SharedMemoryTxRxQueue::Ring() const {
+  return tx_queue_ ? shm_->tx : shm_->rx;
+}
+
 void SharedMemoryTxRxQueue::GetChannel() {
   if (shm_ == nullptr) {
     return;
   }
   scoped_lock lock(shm_->memory_mutex);
-  auto& channels = tx_queue_ ? shm_->tx_channels : shm_->rx_channels;
-  for (size_t index = 1; index < channels.size(); ++index) {
-    if (channels[index].used) {
-      continue;
-    }
-    channel_ = index;
-    channels[index].used = true;
-    break;
+  channel_ = Ring().AttachChannel();
+  if (channel_.channel == 0) {
+    BUS_ERROR() << "No free subscriber channel. Name: "
+      << shared_memory_name_;
   }
 }
 
-bool SharedMemoryTxRxQueue::PublisherPoll(SharedServerObjects& shm,
-  const IBusMessage& message) const {
-  auto& channel = tx_queue_ ? shm.tx_channels[0] : shm.rx_channels[0];
-  const uint32_t message_size = message.Size();
-  auto& buffer = tx_queue_ ? shm.tx_buffer : shm.rx_buffer;
-  auto bytes_left = static_cast<int64_t>(buffer.size());
-  bytes_left -= channel.queue_index;
-  bytes_left -= message_size;
-  bytes_left -= 4;
-
-  if (bytes_left < 0 ) {
-    if (tx_queue_) {
-      shm.tx_full = true;
-    } else {
-      shm.rx_full = true;
-    }
-    return false;
+void SharedMemoryTxRxQueue::ReleaseChannel() {
+  if (channel_.channel == 0 || shm_ == nullptr) {
+    return;
   }
-
-  std::vector<uint8_t> msg_buffer;
-  message.ToRaw(msg_buffer);
-  if (msg_buffer.size() != message_size) {
-    BUS_ERROR() << "Mismatching message sizes ("
-      << msg_buffer.size() << "/" << message_size
-      << ". Internal error";
-    return false;
+  try {
+    scoped_lock lock(shm_->memory_mutex);
+    Ring().DetachChannel(channel_);
+  } catch (const std::exception& err) {
+    BUS_ERROR() << "Failed to release channel. Error: " << err.what();
   }
-
-  const LittleBuffer length(message_size);
-  std::copy_n(length.cbegin(), length.size(),
-  buffer.begin() + channel.queue_index );
-  channel.queue_index += length.size();
-
-  std::copy_n(msg_buffer.begin(), msg_buffer.size(),
-  buffer.begin() + channel.queue_index );
-  channel.queue_index += msg_buffer.size();
-  return true;
+  channel_ = {};
 }
 
-bool SharedMemoryTxRxQueue::SubscriberPoll(SharedServerObjects& shm,
-    std::vector<uint8_t>& msg_buffer ) {
+bool SharedMemoryTxRxQueue::SubscriberPoll(std::vector<uint8_t>& msg_buffer) {
   msg_buffer.clear();
-  if (channel_ == 0) {
-    BUS_ERROR() << "Invalid subscriber channel index. Index: " <<
-      static_cast<int>(channel_);
-    return false;
-  }
-
-  const auto& buffer = tx_queue_ ? shm.tx_buffer : shm.rx_buffer;
-  auto& out_channel = tx_queue_ ?
-    shm.tx_channels[channel_] : shm.rx_channels[channel_];
-  const auto& in_channel = tx_queue_ ? shm.tx_channels[0] : shm.rx_channels[0];
-
-  if (!out_channel.used) {
-    // Probably reconnected to the shared memory.
-    BUS_ERROR() << "Channel suddenly unused. Channel: "
-          << static_cast<int>(channel_);
-    channel_ = 0; // Trigger a new channel
-    operable_ = false;
-    return false;
-  }
-
-  if (in_channel.queue_index < out_channel.queue_index) {
-    BUS_ERROR() << "Invalid channel indexes. Channel: "
-      << static_cast<int>(channel_)
-      << ", Index: " << in_channel.queue_index
-      << "/" << out_channel.queue_index;
-    out_channel.queue_index = in_channel.queue_index;
-    return false;
-  }
-
-  if (out_channel.queue_index == in_channel.queue_index) {
-    // No message to send
-    return false;
-  }
-
-  if (out_channel.queue_index + 4 > buffer.size()) {
-    BUS_ERROR() << "Length out-of-boound. Index: "
-      << static_cast<int>(out_channel.queue_index)
-      << "/" << buffer.size();
-    out_channel.queue_index = in_channel.queue_index;
-    return false;
-  }
-
-  LittleBuffer<uint32_t> length(buffer.data(),out_channel.queue_index);
-  out_channel.queue_index += length.size();
-  const uint32_t message_length = length.value();
-
-  if (out_channel.queue_index + message_length > buffer.size()) {
-    BUS_ERROR() << "Data out-of-boound. Index: "
-        << static_cast<int>(out_channel.queue_index)
-        << ", Length: " << message_length
-        << ", Size: " << buffer.size();
-    out_channel.queue_index = in_channel.queue_index;
-    return false;
-  }
-
-  try {
-    msg_buffer.resize(message_length);
-    std::copy_n(buffer.cbegin() + out_channel.queue_index,
-      message_length, msg_buffer.begin());
-    out_channel.queue_index += message_length;
-  } catch (const std::exception& err) {
-    BUS_ERROR() << "Message copy failure. Error: " << err.what();
-    out_channel.queue_index = in_channel.queue_index;
-    return false;
+  auto& ring = Ring();
+  uint64_t nof_lost = 0;
+  if (!ring.IsAttached(channel_)) {
+    // The watchdog reclaimed the channel, for example while this process
+    // was stopped. Another subscriber may own it now.
+    BUS_WARNING() << "Subscriber channel was reclaimed. Name: "
+      << shared_memory_name_ << ", Channel: " << channel_.channel;
+    if (!ring.Reattach(channel_, nof_lost)) {
+      BUS_ERROR() << "No free subscriber channel. Name: "
+        << shared_memory_name_;
+      channel_ = {}; // Trigger a new channel
+      return false;
+    }
+    ReportOverrun(nof_lost);
   }
+  const bool more = ring.Read(channel_, msg_buffer, nof_lost);
+  ReportOverrun(nof_lost);
+  return more;
+}
 
-  return true;
+bool SharedMemoryTxRxQueue::IsAttached() const {
+  return shm_ != nullptr && shm_->header.initialized;
 }
 
 void SharedMemoryTxRxQueue::ConnectToSharedMemory() {
+  if (IsAttached()) {
+    // Stay attached. Only map the segment again if the server restarts.
+    state_ = SharedMemoryState::HandleMessages;
+    return;
+  }
   try {
     shm_ = nullptr;
     region_.reset();
@@ -298,17 +251,18 @@ void SharedMemoryTxRxQueue::ConnectToSharedMemory() {
     if (region_->get_address() == nullptr) {
       throw std::runtime_error("No shared memory found");
     }
-    shm_ = static_cast<SharedServerObjects *>(region_->get_address());
-    if (!shm_->initialized) {
-      std::ostringstream err;
-      err << "Shared memory not initialized. Name: " << shared_memory_name_;
-      throw std::runtime_error(err.str());
-    }
+    auto* shm = static_cast<SharedServerObjects *>(region_->get_address());
+    shm->header.Validate(shared_memory_name_, region_->get_size());
+    ApplyMemoryOptions(*region_, options_, shared_memory_name_);
+    shm_ = shm;
     if (!operable_) {
       // The connection is back again.
-      BUS_INFO() << "Shared memory connected. Name: " << shared_memory_name_;
+      BUS_INFO() << "Shared memory connected. Name: " << shared_memory_name_
+        << ", Capacity: " << shm_->header.buffer_size
+        << ", Slots: " << shm_->header.max_subscribers;
       operable_ = true;
     }
+    attach_delay_ = {};
     state_ = SharedMemoryState::HandleMessages;
   } catch (const std::exception& err) {
     if (operable_) {
@@ -9,6 +9,7 @@
 #include <memory>
 #include <string>
 #include <atomic>
+#include <chrono>
 #include <thread>
 #include <vector>
 
@@ -16,17 +17,20 @@
 #include <boost/interprocess/shared_memory_object.hpp>
 
 #include "bus/ibusmessagequeue.h"
+#include "bus/ibusmessagebroker.h"
+#include "sharedmemoryring.h"
 
 
 namespace bus {
 
 struct SharedServerObjects;
+struct SharedMemoryRing;
 
 class SharedMemoryTxRxQueue : public IBusMessageQueue {
 public:
   SharedMemoryTxRxQueue() = delete;
   explicit SharedMemoryTxRxQueue(std::string shared_memory_name,
-    bool tx_queue, bool publisher );
+    bool tx_queue, bool publisher, const SharedMemoryOptions& options = {});
   ~SharedMemoryTxRxQueue() override;
 
   void Start() override;
@@ -36,7 +40,8 @@ private:
   bool tx_queue_ = false;
   bool publisher_ = false;
   std::string shared_memory_name_;
-  uint8_t channel_ = 0;
+  SharedMemoryOptions options_;
+  RingChannelToken channel_; ///< Owner token of the subscriber channel.
   std::atomic<bool> stop_thread_ = true;
   std::thread thread_;
   mutable std::atomic<bool> operable_ = false; ///<  Supress of log messages
@@ -50,16 +55,17 @@ private:
   std::unique_ptr<boost::interprocess::shared_memory_object> shared_memory_;
   std::unique_ptr<boost::interprocess::mapped_region> region_;
   SharedServerObjects* shm_ = nullptr;
+  std::chrono::milliseconds attach_delay_ = {};
 
   void PublisherThread();
   void SubscriberThread();
   void GetChannel();
+  void ReleaseChannel();
+  [[nodiscard]] SharedMemoryRing& Ring() const;
 
-  [[nodiscard]] bool PublisherPoll(SharedServerObjects& shm,
-                            const IBusMessage& message) const;
-  bool SubscriberPoll(SharedServerObjects& shm,
-    std::vector<uint8_t>& msg_buffer) ;
+  bool SubscriberPoll(std::vector<uint8_t>& msg_buffer);
 
+  [[nodiscard]] bool IsAttached() const;
   void ConnectToSharedMemory();
 
 };
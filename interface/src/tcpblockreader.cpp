@@ -0,0 +1,45 @@
+/*
+* Copyright 2025 Ingemar Hedvall
+* SPDX-License-Identifier: MIT
+*/
+
+#include "tcpblockreader.h"
+
+#include "tcpsendbuffer.h"
+#include "bus/littlebuffer.h"
+#include "bus/lz4codec.h"
+
+namespace bus {
+
+bool TcpBlockReader::Unpack(std::span<const uint8_t> block,
+                            const MessageCallback& on_message) {
+  if (block.size() < 4) {
+    return false;
+  }
+  const LittleBuffer<uint32_t> raw_size(block.data(), 0);
+  if (raw_size.value() > kMaxBlockSize ||
+      !Lz4Codec::Decompress(block.subspan(4), raw_size.value(), raw_data_)) {
+    return false;
+  }
+
+  for (size_t offset = 0; offset < raw_data_.size(); ) {
+    if (raw_data_.size() - offset < 4) {
+      return false;
+    }
+    const LittleBuffer<uint32_t> length(raw_data_.data(), offset);
+    offset += 4;
+    if (length.value() > kMaxMessageSize ||
+        length.value() > raw_data_.size() - offset) {
+      return false;
+    }
+    if (length.value() > 0) {
+      message_data_.assign(raw_data_.begin() + offset,
+                           raw_data_.begin() + offset + length.value());
+      on_message(message_data_);
+    }
+    offset += length.value();
+  }
+  return true;
+}
+
+} // bus
@@ -0,0 +1,39 @@
+/*
+* Copyright 2025 Ingemar Hedvall
+* SPDX-License-Identifier: MIT
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <vector>
+
+namespace bus {
+
+/** \brief Unpacks the messages in a received compressed block.
+ *
+ * The block is the data after the length prefix, i.e. the uncompressed
+ * size followed by the LZ4 block. See TcpSendBuffer.
+ */
+class TcpBlockReader {
+ public:
+  /** \brief Called for each serialized message in the block. */
+  using MessageCallback = std::function<void(const std::vector<uint8_t>&)>;
+
+  /** \brief Decompresses a block and delivers its messages.
+   *
+   * @param block Compressed block.
+   * @param on_message Called for each message.
+   * @return False if the block is corrupt.
+   */
+  [[nodiscard]] bool Unpack(std::span<const uint8_t> block,
+                            const MessageCallback& on_message);
+
+ private:
+  std::vector<uint8_t> raw_data_;
+  std::vector<uint8_t> message_data_;
+};
+
+} // bus
@@ -0,0 +1,79 @@
+/*
+* Copyright 2025 Ingemar Hedvall
+* SPDX-License-Identifier: MIT
+*/
+
+#include "tcpframereader.h"
+
+#include <algorithm>
+
+#include "tcphandshake.h"
+#include "tcpsendbuffer.h"
+#include "bus/buslogstream.h"
+#include "bus/littlebuffer.h"
+
+namespace bus {
+
+TcpFrameReader::TcpFrameReader()
+  : buffer_(kReceiveBufferSize, 0) {
+}
+
+std::span<uint8_t> TcpFrameReader::FreeSpace() {
+  if (begin_ == end_) {
+    begin_ = 0;
+    end_ = 0;
+    if (buffer_.size() > kReceiveBufferSize) {
+      // Releases the memory of a large frame.
+      buffer_.resize(kReceiveBufferSize);
+      buffer_.shrink_to_fit();
+    }
+  }
+  if (end_ == buffer_.size() && begin_ > 0) {
+    // Moves the incomplete frame first in the buffer.
+    std::copy(buffer_.begin() + static_cast<ptrdiff_t>(begin_),
+              buffer_.begin() + static_cast<ptrdiff_t>(end_),
+              buffer_.begin());
+    end_ -= begin_;
+    begin_ = 0;
+  }
+  return {buffer_.data() + end_, buffer_.size() - end_};
+}
+
+bool TcpFrameReader::Read(size_t bytes, const FrameCallback& on_frame) {
+  end_ = std::min(end_ + bytes, buffer_.size());
+  while (end_ - begin_ >= 4) {
+    const LittleBuffer<uint32_t> length(buffer_.data(), begin_);
+    const uint32_t flags = length.value() & (kCompressedBlock | kControlFrame);
+    const uint32_t size = length.value() & ~flags;
+    uint32_t max_size = kMaxMessageSize;
+    if (flags == kCompressedBlock) {
+      max_size = kMaxBlockSize;
+    } else if (flags == kControlFrame) {
+      max_size = kMaxControlSize;
+    }
+    if (flags == (kCompressedBlock | kControlFrame) || size > max_size) {
+      BUS_ERROR() << "Message too large. Size: " << size;
+      return false;
+    }
+    if (end_ - begin_ < 4 + static_cast<size_t>(size)) {
+      if (4 + static_cast<size_t>(size) > buffer_.size() - begin_) {
+        // The frame doesn't fit the buffer.
+        try {
+          buffer_.resize(begin_ + 4 + size);
+        } catch (const std::exception& err) {
+          BUS_ERROR() << "Message allocation error. Error: " << err.what();
+          return false;
+        }
+      }
+      break;
+    }
+    const std::span<const uint8_t> frame(buffer_.data() + begin_ + 4, size);
+    begin_ += 4 + size;
+    if (size > 0 && on_frame && !on_frame(flags, frame)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+} // bus
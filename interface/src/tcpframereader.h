@@ -0,0 +1,56 @@
+/*
+* Copyright 2025 Ingemar Hedvall
+* SPDX-License-Identifier: MIT
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <vector>
+
+namespace bus {
+
+/** \brief Splits the received bytes into length prefixed frames.
+ *
+ * The socket reads as many bytes as are available into a fixed receive
+ * buffer, instead of one read for the length and one for the data. A read
+ * then delivers many small frames, which saves two system calls per
+ * message. The buffer grows temporarily if a frame doesn't fit.
+ */
+class TcpFrameReader {
+ public:
+  /** \brief Default size of the receive buffer. */
+  static constexpr size_t kReceiveBufferSize = 64 * 1'024;
+
+  /** \brief Called for each frame with the frame bits of the length
+   * prefix and the frame data. Returns false to close the connection.
+   */
+  using FrameCallback =
+      std::function<bool(uint32_t flags, std::span<const uint8_t> frame)>;
+
+  TcpFrameReader();
+
+  /** \brief Returns the free space that the socket shall read into. */
+  [[nodiscard]] std::span<uint8_t> FreeSpace();
+
+  /** \brief Delivers the complete frames after a socket read.
+   *
+   * Incomplete frames are kept until the next read.
+   * @param bytes Number of bytes read into the free space.
+   * @param on_frame Called for each complete frame.
+   * @return False if a frame is invalid or the callback returned false.
+   */
+  [[nodiscard]] bool Read(size_t bytes, const FrameCallback& on_frame);
+
+  /** \brief Returns the number of buffered bytes. */
+  [[nodiscard]] size_t Size() const { return end_ - begin_; }
+
+ private:
+  std::vector<uint8_t> buffer_;
+  size_t begin_ = 0; ///< First unread byte.
+  size_t end_ = 0; ///< End of the received bytes.
+};
+
+} // bus
@@ -0,0 +1,127 @@
+/*
+* Copyright 2025 Ingemar Hedvall
+* SPDX-License-Identifier: MIT
+*/
+
+#include "tcphandshake.h"
+
+#include <algorithm>
+
+#include "bus/buslogstream.h"
+#include "bus/littlebuffer.h"
+
+namespace {
+
+constexpr size_t kHelloSize = 12; ///< Fixed part after the length prefix.
+
+template <typename T>
+void Append(std::vector<uint8_t>& dest, T value) {
+  const bus::LittleBuffer<T> buffer(value);
+  dest.insert(dest.end(), buffer.cbegin(), buffer.cend());
+}
+
+} // end namespace
+
+namespace bus {
+
+void TcpHello::ToRaw(std::vector<uint8_t>& dest) const {
+  dest.clear();
+  Append<uint32_t>(dest, 0); // Length is set last
+  Append(dest, static_cast<uint16_t>(type));
+  Append(dest, version);
+  Append(dest, encodings);
+  Append<uint16_t>(dest, 0);
+  Append(dest, max_batch_size);
+  for (const auto& option : options) {
+    if (dest.size() - 4 + 3 + option.data.size() > kMaxControlSize) {
+      BUS_ERROR() << "Hello option too large. Type: "
+                  << static_cast<int>(option.type)
+                  << ", Size: " << option.data.size();
+      continue;
+    }
+    dest.push_back(option.type);
+    Append(dest, static_cast<uint16_t>(option.data.size()));
+    dest.insert(dest.end(), option.data.begin(), option.data.end());
+  }
+  const LittleBuffer<uint32_t> length(
+      kControlFrame | static_cast<uint32_t>(dest.size() - 4));
+  std::copy_n(length.cbegin(), length.size(), dest.begin());
+}
+
+bool TcpHello::FromRaw(std::span<const uint8_t> source) {
+  if (source.size() < kHelloSize) {
+    return false;
+  }
+  const LittleBuffer<uint16_t> control_type(source.data(), 0);
+  const LittleBuffer<uint16_t> protocol_version(source.data(), 2);
+  const LittleBuffer<uint16_t> encoding_mask(source.data(), 4);
+  const LittleBuffer<uint32_t> batch_size(source.data(), 8);
+  type = static_cast<TcpControlType>(control_type.value());
+  version = protocol_version.value();
+  encodings = encoding_mask.value();
+  max_batch_size = std::max(batch_size.value(), 1U);
+
+  options.clear();
+  for (size_t offset = kHelloSize; offset < source.size(); ) {
+    if (source.size() - offset < 3) {
+      return false;
+    }
+    TcpHelloOption option;
+    option.type = source[offset];
+    const LittleBuffer<uint16_t> length(source.data(), offset + 1);
+    offset += 3;
+    if (length.value() > source.size() - offset) {
+      return false;
+    }
+    option.data.assign(source.begin() + offset,
+                       source.begin() + offset + length.value());
+    offset += length.value();
+    options.push_back(std::move(option));
+  }
+  return true;
+}
+
+bool TcpHello::AddFilter(const BusMessageFilter& filter) {
+  if (filter.Empty()) {
+    return true;
+  }
+  TcpHelloOption option;
+  option.type = kFilterOption;
+  filter.ToRaw(option.data);
+  if (option.data.size() > kMaxOptionSize) {
+    BUS_ERROR() << "Subscription filter too large. "
+                << "The server sends all messages. Size: "
+                << option.data.size();
+    return false;
+  }
+  options.push_back(std::move(option));
+  return true;
+}
+
+bool TcpHello::ReadFilter(BusMessageFilter& filter) const {
+  filter.Clear();
+  const auto itr = std::ranges::find_if(options,
+      [] (const TcpHelloOption& option) -> bool {
+        return option.type == kFilterOption;
+      });
+  return itr == options.end() || filter.FromRaw(itr->data);
+}
+
+TcpHello TcpHello::Accept(uint16_t server_encodings,
+                          uint32_t server_batch_size) const {
+  TcpHello ack;
+  ack.type = TcpControlType::HelloAck;
+  ack.version = std::min(version, kProtocolVersion);
+  ack.encodings = encodings & server_encodings;
+  ack.max_batch_size = std::min(max_batch_size, server_batch_size);
+  return ack;
+}
+
+void TcpLinkMode::Select(const TcpHello& hello) {
+  compress = (hello.encodings & kEncodingLz4) != 0;
+  compact_can = (hello.encodings & kEncodingCompactCan) != 0;
+  shared_memory = (hello.encodings & kEncodingSharedMemory) != 0;
+  max_batch_size = hello.max_batch_size;
+}
+
+} // bus
@@ -0,0 +1,154 @@
+/*
+* Copyright 2025 Ingemar Hedvall
+* SPDX-License-Identifier: MIT
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <span>
+#include <vector>
+
+#include "bus/busmessagefilter.h"
+
+namespace bus {
+
+/** \brief Bit 30 in the length prefix marks a control frame.
+ *
+ * Control frames are not bus messages. They are used by the handshake.
+ * Older peers take the frame as a huge message size and wait for a body
+ * that never arrives, so the client falls back to the legacy protocol
+ * when the acknowledge times out.
+ */
+constexpr uint32_t kControlFrame = 0x40000000;
+
+/** \brief Max size of a control frame. */
+constexpr uint32_t kMaxControlSize = 0x10000;
+
+/** \brief Current TCP protocol version. */
+constexpr uint16_t kProtocolVersion = 1;
+
+/** \brief Default max number of messages in a send batch. */
+constexpr uint32_t kDefaultBatchSize = 1'000;
+
+/** \brief Encodings that a peer supports (bit mask). */
+enum TcpEncoding : uint16_t {
+  kEncodingLz4 = 0x0001, ///< LZ4 compressed blocks.
+  kEncodingCompactCan = 0x0002, ///< CAN data frames in the compact layout.
+  /** The client maps the broker shared memory that is passed with the
+   * acknowledge (Unix domain sockets only). */
+  kEncodingSharedMemory = 0x0004
+};
+
+/** \brief Type of control frame. */
+enum class TcpControlType : uint16_t {
+  Hello = 1, ///< Sent by the client when it connects.
+  HelloAck = 2 ///< Server reply with the selected modes.
+};
+
+/** \brief Option type of the subscription filter (BusMessageFilter). */
+constexpr uint8_t kFilterOption = 1;
+
+/** \brief Max option data size that fits a hello control frame. */
+constexpr size_t kMaxOptionSize = kMaxControlSize - 12 - 3;
+
+/** \brief Optional handshake data.
+ *
+ * Options are sent as type (uint8_t), length (uint16_t) and data.
+ * Unknown options are ignored, so options can be added without a new
+ * protocol version.
+ */
+struct TcpHelloOption {
+  uint8_t type = 0; ///< Type of option.
+  std::vector<uint8_t> data; ///< Option data.
+};
+
+/** \brief Handshake message.
+ *
+ * The client sends a hello with the encodings it supports. The server
+ * replies with an acknowledge that holds the encodings that both sides
+ * supports. Both sides then use these encodings.
+ * The layout is according to the table below (little endian).
+ * <table>
+ * <tr><th>Byte Offset</th><th>Description</th><th>Size</th></tr>
+ * <tr><td>0</td><td>Length | kControlFrame</td><td>uint32_t</td></tr>
+ * <tr><td>4</td><td>Control Type</td><td>uint16_t</td></tr>
+ * <tr><td>6</td><td>Protocol Version</td><td>uint16_t</td></tr>
+ * <tr><td>8</td><td>Encodings</td><td>uint16_t</td></tr>
+ * <tr><td>10</td><td>Reserved</td><td>uint16_t</td></tr>
+ * <tr><td>12</td><td>Max Batch Size</td><td>uint32_t</td></tr>
+ * <tr><td>16</td><td>Options</td><td>Rest of the frame</td></tr>
+ * </table>
+ */
+struct TcpHello {
+  TcpControlType type = TcpControlType::Hello; ///< Hello or acknowledge.
+  uint16_t version = kProtocolVersion; ///< Protocol version.
+  uint16_t encodings = 0; ///< Supported or selected encodings.
+  uint32_t max_batch_size = kDefaultBatchSize; ///< Messages per batch.
+  std::vector<TcpHelloOption> options; ///< Optional data.
+
+  /** \brief Serializes the frame including the length prefix.
+   *
+   * Options that doesn't fit the control frame are skipped with an error.
+   */
+  void ToRaw(std::vector<uint8_t>& dest) const;
+
+  /** \brief Parses the frame data after the length prefix.
+   *
+   * @param source Frame data.
+   * @return False if the frame is invalid.
+   */
+  [[nodiscard]] bool FromRaw(std::span<const uint8_t> source);
+
+  /** \brief Adds the subscription filter option if the filter isn't empty.
+   *
+   * A filter larger than kMaxOptionSize isn't added. The server then sends
+   * all messages.
+   * @param filter Subscription filter.
+   * @return False if the filter is too large.
+   */
+  bool AddFilter(const BusMessageFilter& filter);
+
+  /** \brief Returns the subscription filter option.
+   *
+   * @param filter Returns the filter. Empty if no option is set.
+   * @return False if the option is invalid.
+   */
+  [[nodiscard]] bool ReadFilter(BusMessageFilter& filter) const;
+
+  /** \brief Creates the server reply to this hello.
+   *
+   * @param encodings Encodings that the server supports.
+   * @param max_batch_size Server max batch size.
+   * @return Acknowledge with the selected modes.
+   */
+  [[nodiscard]] TcpHello Accept(uint16_t encodings,
+                                uint32_t max_batch_size) const;
+};
+
+/** \brief Selected modes of a TCP connection.
+ *
+ * The modes are set by the read handler when the handshake is done and
+ * are read by the send loop. An old peer never does a handshake, so the
+ * default is plain messages.
+ */
+struct TcpLinkMode {
+  std::atomic<bool> compress = false; ///< Sends LZ4 compressed blocks.
+  std::atomic<bool> compact_can = false; ///< Sends compact CAN frames.
+  std::atomic<uint32_t> max_batch_size = kDefaultBatchSize; ///< Batch size.
+  /** \brief The client reads from the shared memory instead of the socket.
+   */
+  std::atomic<bool> shared_memory = false;
+
+  std::atomic<bool> reply_pending = false; ///< A reply shall be sent.
+  std::mutex lock; ///< Protects the reply.
+  std::vector<uint8_t> reply; ///< Control frame to send.
+  int reply_descriptor = -1; ///< File descriptor to pass with the reply.
+
+  /** \brief Sets the modes from a hello or acknowledge. */
+  void Select(const TcpHello& hello);
+};
+
+} // bus
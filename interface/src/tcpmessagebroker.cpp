@@ -39,15 +39,9 @@ void TcpMessageBroker::Start() {
   }
   // Start the TCP/IP server to accept connections
   try {
-    if (Address().empty() || Address() == "0.0.0.0") {
-      const auto address = ip::address_v4::any();
-      const ip::tcp::endpoint endpoint(address, Port());
-      acceptor_ = std::make_unique<ip::tcp::acceptor>(context_, endpoint);
-    } else {
-      const auto address = ip::make_address("127.0.0.1");
-      const ip::tcp::endpoint endpoint(address, Port());
-      acceptor_ = std::make_unique<ip::tcp::acceptor>(context_, endpoint);
-    }
+    acceptor_ = std::make_unique<
+        basic_socket_acceptor<generic::stream_protocol>>(context_,
+                                                         ListenEndpoint());
     DoAccept();
     DoCleanUp();
     server_thread_ = std::thread(&TcpMessageBroker::ServerThread, this);
@@ -77,8 +71,29 @@ void TcpMessageBroker::Stop() {
   SharedMemoryBroker::Stop();
 }
 
+generic::stream_protocol::endpoint TcpMessageBroker::ListenEndpoint() const {
+  if (Address().empty() || Address() == "0.0.0.0") {
+    const auto address = ip::address_v4::any();
+    return ip::tcp::endpoint(address, Port());
+  }
+  const auto address = ip::make_address("127.0.0.1");
+  return ip::tcp::endpoint(address, Port());
+}
+
+std::vector<ConnectionStatistics> TcpMessageBroker::Connections() const {
+  std::vector<ConnectionStatistics> list;
+  std::lock_guard lock(connection_list_lock_);
+  for (const auto& connection : connection_list_) {
+    if (connection && !connection->CleanUp()) {
+      list.push_back(connection->Statistics());
+    }
+  }
+  return list;
+}
+
 void TcpMessageBroker::DoAccept() {
-  connection_socket_ = std::make_unique<ip::tcp::socket>(context_);
+  connection_socket_ =
+      std::make_unique<generic::stream_protocol::socket>(context_);
   acceptor_->async_accept(*connection_socket_,
     [&](const boost::system::error_code& err) {
         if (err) {
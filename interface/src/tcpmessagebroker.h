@@ -24,6 +24,19 @@ public:
 
   void Start() override;
   void Stop() override;
+  [[nodiscard]] std::vector<ConnectionStatistics> Connections() const override;
+
+  /** \brief Returns true if the shared memory is passed to the clients. */
+  [[nodiscard]] virtual bool PassSegment() const { return false; }
+
+protected:
+  /** \brief Returns the endpoint that the server listens on.
+   *
+   * The TCP/IP broker listens on the port. A Unix domain socket broker
+   * listens on a socket path instead.
+   */
+  [[nodiscard]] virtual boost::asio::generic::stream_protocol::endpoint
+    ListenEndpoint() const;
 private:
   /** The stop server task boolean is not used to stop the server thread.
    *  Instead does it actually suppress error message when the ASIO constext
@@ -33,8 +46,11 @@ private:
   std::thread server_thread_;
   boost::asio::io_context context_;
 
-  std::unique_ptr<boost::asio::ip::tcp::acceptor> acceptor_;
-  std::unique_ptr<boost::asio::ip::tcp::socket> connection_socket_;
+  std::unique_ptr<
+    boost::asio::basic_socket_acceptor<boost::asio::generic::stream_protocol>>
+    acceptor_;
+  std::unique_ptr<boost::asio::generic::stream_protocol::socket>
+    connection_socket_;
 
   mutable std::mutex connection_list_lock_;
   std::vector<std::unique_ptr<TcpMessageConnection>> connection_list_;
@@ -2,10 +2,12 @@
 * Copyright 2025 Ingemar Hedvall
 * SPDX-License-Identifier: MIT
 */
+#include <cerrno>
 #include <chrono>
 #include <boost/system.hpp>
 
 #include "tcpmessageclient.h"
+#include "unixdescriptor.h"
 #include "bus/buslogstream.h"
 #include "bus/littlebuffer.h"
 
@@ -13,10 +15,18 @@ using namespace std::chrono_literals;
 using namespace boost::asio;
 using namespace boost::system;
 
+namespace {
+
+/** \brief Max wait on the hello acknowledge before the legacy protocol. */
+constexpr auto kHelloTimeout = 2s;
+
+} // end namespace
+
 namespace bus {
 TcpMessageClient::TcpMessageClient()
   : lookup_(context_),
     retry_timer_(context_),
+    hello_timer_(context_),
     send_timer_(context_) {
 
 }
@@ -32,6 +42,8 @@ void TcpMessageClient::Start() {
   }
   connected_ = false;
   stop_client_thread_ = false;
+  legacy_ = false;
+  hello_timeout_ = false;
 
   DoLookup();
   DoSendMessage();
@@ -54,6 +66,11 @@ void TcpMessageClient::Stop() {
   if (client_thread_.joinable()) {
     client_thread_.join();
   }
+  if (segment_queue_) {
+    segment_queue_->Stop();
+    segment_queue_.reset();
+  }
+  CloseDescriptor(segment_descriptor_);
 }
 
 void TcpMessageClient::ClientThread() {
@@ -79,8 +96,12 @@ void TcpMessageClient::DoLookup() {
                       << ",Error: (" << error.value() << ") " << error.message();
           DoRetryWait();
         } else {
-          socket_ = std::make_unique<ip::tcp::socket>(context_);
-          endpoints_ = std::move(result);
+          socket_ = std::make_unique<generic::stream_protocol::socket>(
+              context_);
+          endpoints_.clear();
+          for (const auto& entry : result) {
+            endpoints_.emplace_back(entry.endpoint());
+          }
           DoConnect();
         }
       });
@@ -101,11 +122,18 @@ void TcpMessageClient::DoRetryWait() {
 void TcpMessageClient::Close() {
   if (socket_ && socket_->is_open() && connected_) {
     error_code shutdown_error;
-    error_code sh_error = socket_->shutdown(ip::tcp::socket::shutdown_both, shutdown_error);
+    error_code sh_error = socket_->shutdown(socket_base::shutdown_both, shutdown_error);
 
     error_code close_error;
     error_code cl_error = socket_->close(close_error);
   }
+  if (segment_queue_) {
+    // The broker passes the shared memory again on the next connect.
+    segment_queue_->Stop();
+    segment_queue_.reset();
+  }
+  CloseDescriptor(segment_descriptor_);
+  hello_timer_.cancel();
   connected_ = false;
 }
 
@@ -120,6 +148,8 @@ void TcpMessageClient::DoConnect() {
         BUS_ERROR() << "Connect error. Error: " << error.message();
         connected_ = false;
         DoRetryWait();
+      } else if (!legacy_) {
+        DoHello();
       } else {
         connected_ = true;
         DoReadSize();
@@ -128,44 +158,188 @@ void TcpMessageClient::DoConnect() {
   }
 }
 
+void TcpMessageClient::DoHello() {
+  link_.Select(TcpHello()); // Plain messages until the server replies
+  TcpHello hello;
+  hello.encodings = Compression() == BusCompression::Lz4 ? kEncodingLz4 : 0;
+  hello.encodings |= CompactEncoding() ? kEncodingCompactCan : 0;
+  segment_requested_ = PassSegment();
+  hello.encodings |= segment_requested_ ? kEncodingSharedMemory : 0;
+  hello.AddFilter(SubscriptionFilter());
+  hello.ToRaw(hello_data_);
+
+  // The send loop is held until the hello is written, as two writes
+  // may not overlap.
+  async_write(*socket_, buffer(hello_data_),
+    [&](const error_code& error, size_t) -> void {
+      if (error) {
+        BUS_ERROR() << "Send hello error. Error: " << error.message();
+        DoRetryWait();
+      } else {
+        hello_pending_ = true;
+        hello_timeout_ = false;
+        connected_ = true;
+        DoHelloWait();
+        DoReadSize();
+      }
+    });
+}
+
+void TcpMessageClient::DoHelloWait() {
+  // An older server takes the hello as a message size and waits for a
+  // message body that never arrives. It neither replies nor closes.
+  hello_timer_.expires_after(kHelloTimeout);
+  hello_timer_.async_wait([&](const error_code error) -> void {
+    if (error || !hello_pending_ || !socket_) {
+      return;
+    }
+    hello_timeout_ = true;
+    error_code close_error;
+    socket_->close(close_error); // Aborts the read, see HandleSize()
+  });
+}
+
+void TcpMessageClient::HandleControl() {
+  TcpHello ack;
+  if (!ack.FromRaw(message_data_) ||
+      ack.type != TcpControlType::HelloAck) {
+    BUS_ERROR() << "Invalid control frame. Size: " << message_data_.size();
+    return;
+  }
+  link_.Select(ack);
+  hello_pending_ = false;
+  hello_timer_.cancel();
+  if (link_.shared_memory && segment_descriptor_ >= 0) {
+    StartSegmentQueue();
+  } else if (segment_requested_) {
+    BUS_INFO() << "The broker didn't pass the shared memory. "
+               << "Reads the messages from the socket.";
+  }
+  CloseDescriptor(segment_descriptor_);
+  BUS_TRACE() << "Server acknowledge. Version: " << ack.version
+              << ", Encodings: " << ack.encodings
+              << ", Batch Size: " << ack.max_batch_size;
+}
+
+void TcpMessageClient::StartSegmentQueue() {
+  auto queue = std::make_shared<SharedMemoryQueue>(Name(), false,
+      MemoryOptions(), SubscriptionFilter());
+  queue->SegmentDescriptor(segment_descriptor_);
+  segment_descriptor_ = -1;
+  queue->Callback([&, subscribers = std::vector<std::shared_ptr<
+      IBusMessageQueue>>()] (const std::shared_ptr<IBusMessage>& message)
+      mutable -> void {
+    CopySubscribers(subscribers);
+    for (auto& subscriber : subscribers) {
+      if (subscriber) {
+        subscriber->Push(message);
+      }
+    }
+  });
+  queue->Start();
+  segment_queue_ = std::move(queue);
+}
+
 void TcpMessageClient::DoReadSize() {
   if (!socket_ || !socket_->is_open()) {
     DoRetryWait();
     return;
   }
   connected_ = true;
+  if (hello_pending_ && segment_requested_) {
+    // The acknowledge may carry the shared memory descriptor.
+    DoReadSegment();
+    return;
+  }
   async_read(*socket_, buffer(size_data_),
              [&](const error_code& error, size_t bytes) {  // NOLINT
-               if (error && error == error::eof) {
-                 BUS_INFO() << "Connection closed by remote";
-                 DoRetryWait();
-               } else if (error) {
-                 BUS_ERROR() << "Reading size error. Error: "
-                   << error.message();
-                 DoRetryWait();
-               } else if (bytes != size_data_.size()) {
-                 BUS_ERROR() << "Reading size length error. Error: "
-                             << error.message();
-                 DoRetryWait();
-               } else {
-                 LittleBuffer<uint32_t> length(size_data_.data(), 0);
-                 if (length.value() > 0) {
-                   try {
-                     message_data_.resize(length.value(), 0);
-                     DoReadMessage();
-                   } catch (const std::exception& err) {
-                     BUS_ERROR() << "Allocation error. Size: " << length.value()
-                      << ", Error: " << err.what();
-                     DoRetryWait();
-                   }
-
-                 } else {
-                   DoReadSize();
-                 }
-               }
+               HandleSize(error, bytes);
              });
 }
 
+void TcpMessageClient::DoReadSegment() {
+  socket_->async_wait(socket_base::wait_read,
+      [&](const error_code& error) -> void {
+        if (error) {
+          HandleSize(error, 0);
+          return;
+        }
+        int descriptor = -1;
+        const int64_t bytes = ReceiveDescriptor(socket_->native_handle(),
+                                                size_data_, descriptor);
+        if (descriptor >= 0) {
+          CloseDescriptor(segment_descriptor_);
+          segment_descriptor_ = descriptor;
+        }
+        if (bytes < 0 &&
+            (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+          DoReadSegment();
+        } else if (bytes < 0) {
+          HandleSize(error_code(errno, system_category()), 0);
+        } else if (bytes == 0) {
+          HandleSize(error::eof, 0);
+        } else if (static_cast<size_t>(bytes) < size_data_.size()) {
+          const auto offset = static_cast<size_t>(bytes);
+          async_read(*socket_, buffer(size_data_.data() + offset,
+                                      size_data_.size() - offset),
+              [&, offset](const error_code& read_error, size_t rest) {
+                HandleSize(read_error, offset + rest);
+              });
+        } else {
+          HandleSize(error_code(), static_cast<size_t>(bytes));
+        }
+      });
+}
+
+void TcpMessageClient::HandleSize(const error_code& error, size_t bytes) {
+  if (error && hello_pending_ && hello_timeout_ && !stop_client_thread_) {
+    // The server didn't acknowledge the hello within the timeout.
+    BUS_INFO() << "Server doesn't support the handshake. "
+               << "Reconnects with the legacy protocol.";
+    hello_pending_ = false;
+    hello_timeout_ = false;
+    legacy_ = true;
+    Close();
+    DoLookup();
+  } else if (error && error == error::eof) {
+    BUS_INFO() << "Connection closed by remote";
+    DoRetryWait();
+  } else if (error) {
+    BUS_ERROR() << "Reading size error. Error: " << error.message();
+    DoRetryWait();
+  } else if (bytes != size_data_.size()) {
+    BUS_ERROR() << "Reading size length error. Error: "
+                << error.message();
+    DoRetryWait();
+  } else {
+    const LittleBuffer<uint32_t> length(size_data_.data(), 0);
+    frame_flags_ = length.value() & (kCompressedBlock | kControlFrame);
+    const uint32_t size = length.value() & ~frame_flags_;
+    uint32_t max_size = kMaxMessageSize;
+    if (frame_flags_ == kCompressedBlock) {
+      max_size = kMaxBlockSize;
+    } else if (frame_flags_ == kControlFrame) {
+      max_size = kMaxControlSize;
+    }
+    if (frame_flags_ == (kCompressedBlock | kControlFrame) ||
+        size > max_size) {
+      BUS_ERROR() << "Message too large. Size: " << size;
+      DoRetryWait();
+    } else if (size > 0) {
+      try {
+        message_data_.resize(size, 0);
+        DoReadMessage();
+      } catch (const std::exception& err) {
+        BUS_ERROR() << "Allocation error. Size: " << size
+                    << ", Error: " << err.what();
+        DoRetryWait();
+      }
+    } else {
+      DoReadSize();
+    }
+  }
+}
+
 void TcpMessageClient::DoReadMessage() {  // NOLINT
   if (!socket_ || !socket_->is_open()) {
     DoRetryWait();
@@ -179,64 +353,95 @@ void TcpMessageClient::DoReadMessage() {  // NOLINT
                } else if (bytes != message_data_.size()) {
                  BUS_ERROR() << "Read message length error. Error: " << error.message();
                  DoRetryWait();
-               } else {
-                 {
-                   std::lock_guard lock(queue_mutex_);
-                   for (auto& subscriber : subscribers_) {
-                     if (subscriber) {
-                       subscriber->Push(message_data_);
-                     }
-                   }
+               } else if (frame_flags_ == kControlFrame) {
+                 HandleControl();
+                 DoReadSize();
+               } else if (frame_flags_ == kCompressedBlock) {
+                 if (!block_reader_.Unpack(message_data_,
+                     [&](const std::vector<uint8_t>& message) {
+                       PushToSubscribers(message);
+                     })) {
+                   BUS_ERROR() << "Invalid compressed block. Size: "
+                               << message_data_.size();
+                   DoRetryWait();
+                   return;
                  }
                  DoReadSize();
+               } else {
+                 PushToSubscribers(message_data_);
+                 DoReadSize();
                }
              });
 }
 
+void TcpMessageClient::PushToSubscribers(const std::vector<uint8_t>& message) {
+  CopySubscribers(subscriber_list_);
+  for (auto& subscriber : subscriber_list_) {
+    if (subscriber) {
+      subscriber->Push(message);
+    }
+  }
+}
+
 void TcpMessageClient::DoSendMessage() {
   if (!connected_ || !socket_ || !socket_->is_open()) {
     DoSendWait();
     return;
   }
-  std::lock_guard lock(queue_mutex_);
-  for (auto& publisher : publishers_) {
-    if (!publisher || publisher->Empty()) {
-      continue;
-    }
-    auto msg = publisher->Pop();
-    if (!msg || msg->Size() <= 0) {
-      continue;
+
+  std::vector<std::shared_ptr<IBusMessage>> messages;
+  {
+    std::lock_guard lock(queue_mutex_);
+    for (auto& publisher : publishers_) {
+      if (publisher && !publisher->Empty()) {
+        publisher->PopBatch(messages, link_.max_batch_size);
+      }
     }
-    LittleBuffer<uint32_t> length(msg->Size());
-    std::vector<uint8_t> data;
-    msg->ToRaw(data);
-
-    try {
-      send_data_.resize(msg->Size() + 4, 0);
-      std::copy_n(length.cbegin(), length.size(),
-        send_data_.begin());
-      std::copy_n(data.cbegin(), msg->Size(),
-        send_data_.begin() + length.size());
-    } catch (const std::exception& err) {
-      BUS_ERROR() << "Send message allocation data error. Error: " << err.what();
-      DoSendWait();
-      return;
+  }
+  if (messages.empty()) {
+    // Nothing to send
+    DoSendWait();
+    return;
+  }
+
+  try {
+    // Serialize all messages into one scatter-gather send
+    send_data_.Clear();
+    send_data_.CompactCan(link_.compact_can);
+    for (const auto& msg : messages) {
+      if (msg && msg->Size() > 0) {
+        send_data_.Add(*msg);
+      }
     }
-    async_write(*socket_, buffer(send_data_),
-      [&](const error_code& error, size_t bytes) -> void {
-        if (error) {
-          BUS_ERROR() << "Send message data error. Error: " << error.message();
-        }
-        DoSendMessage();
-      });
+  } catch (const std::exception& err) {
+    BUS_ERROR() << "Send message allocation data error. Error: " << err.what();
+    DoSendWait();
+    return;
+  }
+  if (send_data_.Empty()) {
+    DoSendWait();
     return;
   }
-  // Nothing to send
-  DoSendWait();
+
+  send_data_.Compression(link_.compress ? BusCompression::Lz4
+                                        : BusCompression::None);
+  async_write(*socket_, send_data_.Buffers(),
+    [&](const error_code& error, size_t bytes) -> void {
+      if (error) {
+        BUS_ERROR() << "Send message data error. Error: " << error.message();
+      }
+      if (FlushInterval() > 0) {
+        DoSendWait(); // Collects messages during the flush interval
+      } else {
+        DoSendMessage();
+      }
+    });
 }
 
 void TcpMessageClient::DoSendWait() {
-  send_timer_.expires_after(10ms);
+  send_timer_.expires_after(
+      std::max(std::chrono::milliseconds(FlushInterval()),
+               std::chrono::milliseconds(10)));
   send_timer_.async_wait([&](const error_code error) ->void {
     if (error) {
       BUS_ERROR() << "Send timer error. Error: " << error.message();
@@ -14,6 +14,10 @@
 #include <boost/asio.hpp>
 
 #include "bus/ibusmessagebroker.h"
+#include "tcpsendbuffer.h"
+#include "tcpblockreader.h"
+#include "tcphandshake.h"
+#include "sharedmemoryqueue.h"
 
 namespace bus {
 
@@ -25,6 +29,20 @@ public:
   void Start() override;
   void Stop() override;
 
+protected:
+  boost::asio::io_context context_;
+  /** \brief TCP/IP or Unix domain socket. */
+  std::unique_ptr<boost::asio::generic::stream_protocol::socket> socket_;
+  std::vector<boost::asio::generic::stream_protocol::endpoint> endpoints_;
+
+  /** \brief Creates the socket and the endpoints, and then connects. */
+  virtual void DoLookup();
+  void DoConnect();
+
+  /** \brief Returns true if the client requests the broker shared memory.
+   */
+  [[nodiscard]] virtual bool PassSegment() const { return false; }
+
 private:
   /** The stop server task boolean is not used to stop the server thread.
    *  Instead does it actually suppress error message when the ASIO context
@@ -33,25 +51,41 @@ private:
   std::atomic<bool> stop_client_thread_;
 
   std::thread client_thread_;
-  boost::asio::io_context context_;
   boost::asio::ip::tcp::resolver lookup_;
   boost::asio::steady_timer retry_timer_;
-  std::unique_ptr<boost::asio::ip::tcp::socket> socket_;
-  boost::asio::ip::tcp::resolver::results_type endpoints_;
 
   std::array<uint8_t, 4> size_data_ = {0};
   std::vector<uint8_t> message_data_;
+  std::vector<std::shared_ptr<IBusMessageQueue>> subscriber_list_;
+  uint32_t frame_flags_ = 0; ///< Compressed block or control frame bits.
+  TcpBlockReader block_reader_;
+
+  std::vector<uint8_t> hello_data_;
+  bool hello_pending_ = false; ///< Hello sent but no acknowledge.
+  bool hello_timeout_ = false; ///< No acknowledge within the timeout.
+  boost::asio::steady_timer hello_timer_;
+  bool legacy_ = false; ///< The server doesn't support the handshake.
+  TcpLinkMode link_; ///< Modes selected by the handshake.
+  bool segment_requested_ = false; ///< The hello requests the shared memory.
+  int segment_descriptor_ = -1; ///< Shared memory passed by the broker.
+  /** \brief Reads the broker shared memory instead of the socket. */
+  std::shared_ptr<SharedMemoryQueue> segment_queue_;
 
   boost::asio::steady_timer send_timer_;
-  std::vector<uint8_t> send_data_;
+  TcpSendBuffer send_data_;
   void ClientThread();
 
-  void DoLookup();
   void DoRetryWait();
   void Close();
-  void DoConnect();
+  void DoHello();
+  void DoHelloWait();
+  void HandleControl();
+  void StartSegmentQueue();
   void DoReadSize();
+  void DoReadSegment();
+  void HandleSize(const boost::system::error_code& error, size_t bytes);
   void DoReadMessage();
+  void PushToSubscribers(const std::vector<uint8_t>& message);
   void DoSendMessage();
   void DoSendWait();
 };
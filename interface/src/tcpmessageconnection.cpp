@@ -2,23 +2,126 @@
 * Copyright 2025 Ingemar Hedvall
 * SPDX-License-Identifier: MIT
 */
+#include <cerrno>
 #include <chrono>
+#include <cstring>
+#include <sstream>
 
 #include "tcpmessageconnection.h"
 #include "tcpmessagebroker.h"
 #include "tcpmessageserver.h"
+#include "tcpsendbuffer.h"
+#include "unixdescriptor.h"
 #include "bus/buslogstream.h"
-#include "bus/littlebuffer.h"
+#include "bus/interface/asyncmessagequeue.h"
 
 using namespace std::chrono_literals;
+using namespace std::chrono;
 using namespace boost::asio;
 using namespace boost::system;
 
+namespace {
+
+using StreamSocket = generic::stream_protocol::socket;
+
+/** \brief Writes the buffers and closes the socket on a timeout.
+ *
+ * The timeout closes the socket, which aborts the write. This is the
+ * only way to stop a write to a client that doesn't read.
+ */
+template <typename ConstBuffers>
+awaitable<error_code> WriteWithTimeout(
+    const std::shared_ptr<StreamSocket>& socket, steady_timer& timer,
+    const ConstBuffers& buffers, uint32_t timeout) {
+  auto done = std::make_shared<bool>(false);
+  if (timeout > 0) {
+    timer.expires_after(milliseconds(timeout));
+    timer.async_wait([socket, done] (const error_code& error) -> void {
+      if (!error && !*done) {
+        error_code dummy;
+        socket->close(dummy);
+      }
+    });
+  }
+  error_code error;
+  co_await async_write(*socket, buffers, redirect_error(use_awaitable, error));
+  *done = true;
+  timer.cancel();
+  co_return error;
+}
+
+/** \brief Writes a control frame together with a file descriptor.
+ *
+ * The descriptor is attached to the first bytes. The rest of the frame is
+ * sent as normal, if the socket buffer is full.
+ */
+awaitable<error_code> WriteWithDescriptor(
+    const std::shared_ptr<StreamSocket>& socket,
+    std::span<const uint8_t> data, int descriptor) {
+  error_code error;
+  while (true) {
+    co_await socket->async_wait(socket_base::wait_write,
+                                redirect_error(use_awaitable, error));
+    if (error) {
+      co_return error;
+    }
+    const int64_t bytes = bus::SendDescriptor(socket->native_handle(), data,
+                                              descriptor);
+    if (bytes >= 0) {
+      data = data.subspan(static_cast<size_t>(bytes));
+      break;
+    }
+    if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+      co_return error_code(errno, system_category());
+    }
+  }
+  if (!data.empty()) {
+    co_await async_write(*socket, buffer(data.data(), data.size()),
+                         redirect_error(use_awaitable, error));
+  }
+  co_return error;
+}
+
+/** \brief Returns the address and port of a TCP/IP endpoint. */
+std::string EndpointText(const generic::stream_protocol::endpoint& endpoint) {
+  const auto family = endpoint.protocol().family();
+  if (family != AF_INET && family != AF_INET6) {
+    return "local";
+  }
+  ip::tcp::endpoint tcp_endpoint;
+  std::memcpy(tcp_endpoint.data(), endpoint.data(), endpoint.size());
+  tcp_endpoint.resize(endpoint.size());
+  std::ostringstream remote;
+  remote << tcp_endpoint;
+  return remote.str();
+}
+
+} // end namespace
+
 namespace bus {
 
+uint64_t TcpSendMetrics::Lag(bool queue_empty) {
+  const int64_t now = steady_clock::now().time_since_epoch().count();
+  if (queue_empty) {
+    drained_time = now;
+  }
+  // Another thread may have updated the drained time after the now call.
+  const int64_t elapsed = std::max<int64_t>(now - drained_time, 0);
+  const auto lag = static_cast<uint64_t>(duration_cast<milliseconds>(
+      steady_clock::duration(elapsed)).count());
+  uint64_t max_lag_value = max_lag;
+  while (lag > max_lag_value &&
+         !max_lag.compare_exchange_weak(max_lag_value, lag)) {
+  }
+  return lag;
+}
+
 TcpMessageConnection::TcpMessageConnection(TcpMessageBroker& broker,
-    std::unique_ptr<boost::asio::ip::tcp::socket>& socket)
+    std::unique_ptr<StreamSocket>& socket)
       : socket_(std::move(socket)) {
+  if (broker.PassSegment()) {
+    segment_descriptor_ = broker.SegmentDescriptor();
+  }
   publisher_ = std::move(broker.CreatePublisher());
   if (publisher_) {
     publisher_->Start();
@@ -29,13 +132,13 @@ TcpMessageConnection::TcpMessageConnection(TcpMessageBroker& broker,
     subscriber_->Start();
   }
 
-  DoReadSize();
-  stop_connection_thread_ = false;
-  connection_thread_ = std::thread(&TcpMessageConnection::ConnectionThread, this);
+  Init(broker);
+  DoRead();
+  StartSending();
 }
 
 TcpMessageConnection::TcpMessageConnection(TcpMessageServer& server,
-    std::unique_ptr<boost::asio::ip::tcp::socket>& socket)
+    std::unique_ptr<StreamSocket>& socket)
       : socket_(std::move(socket)) {
   publisher_ = std::move(server.IBusMessageBroker::CreatePublisher());
   if (publisher_) {
@@ -47,20 +150,18 @@ TcpMessageConnection::TcpMessageConnection(TcpMessageServer& server,
     subscriber_->Start();
   }
 
-  DoReadSize();
-  stop_connection_thread_ = false;
-  connection_thread_ = std::thread(&TcpMessageConnection::ConnectionThread, this);
+  Init(server);
+  DoRead();
+  StartSending();
 }
 TcpMessageConnection::~TcpMessageConnection() {
+  *stop_sending_ = true;
   if (publisher_) {
     publisher_->Stop();
   }
   if (subscriber_) {
-    subscriber_->Stop();
-  }
-  stop_connection_thread_ = true;
-  if (connection_thread_.joinable()) {
-    connection_thread_.join();
+    subscriber_->Stop(); // Wakes up the send coroutine
+    subscriber_->CancelAsyncWait();
   }
 
   publisher_.reset();
@@ -68,91 +169,245 @@ TcpMessageConnection::~TcpMessageConnection() {
 
 }
 
+void TcpMessageConnection::Init(const IBusMessageBroker& broker) {
+  encodings_ = broker.Compression() == BusCompression::Lz4 ? kEncodingLz4 : 0;
+  encodings_ |= broker.CompactEncoding() ? kEncodingCompactCan : 0;
+  encodings_ |= segment_descriptor_ >= 0 ? kEncodingSharedMemory : 0;
+  send_options_.flush_interval = broker.FlushInterval();
+  send_options_.slow_client = broker.SlowClient();
+  send_options_.slow_client_timeout = broker.SlowClientTimeout();
+  if (subscriber_) {
+    // The send queue is bounded, so a slow client cannot grow the memory
+    // without a limit.
+    subscriber_->MaxSize(broker.SendQueueSize(),
+        broker.SlowClient() == SlowClientPolicy::LatestPerId ?
+        QueueFullPolicy::LatestPerId : QueueFullPolicy::DropOldest);
+  }
+  error_code error;
+  const auto endpoint = socket_->remote_endpoint(error);
+  if (!error) {
+    remote_ = EndpointText(endpoint);
+  }
+}
+
 bool TcpMessageConnection::CleanUp() const {
   return !socket_ || !socket_->is_open();
 }
 
-void TcpMessageConnection::DoReadSize() {  // NOLINT
+ConnectionStatistics TcpMessageConnection::Statistics() const {
+  ConnectionStatistics statistics;
+  statistics.remote = remote_;
+  if (subscriber_) {
+    statistics.queue_size = subscriber_->Size();
+    statistics.lost_messages = subscriber_->LostMessages();
+  }
+  statistics.sent_messages = metrics_->sent_messages;
+  statistics.sent_bytes = metrics_->sent_bytes;
+  statistics.lag = metrics_->Lag(statistics.queue_size == 0);
+  statistics.max_lag = metrics_->max_lag;
+  return statistics;
+}
+
+void TcpMessageConnection::DoRead() {  // NOLINT
   if (CleanUp()) {
     return;
   }
-
-  async_read(*socket_, buffer(size_data_),
-      [&](const boost::system::error_code& error, size_t bytes) {  // NOLINT
+  // Reads all available bytes, so one read may deliver many messages.
+  const auto space = frame_reader_.FreeSpace();
+  socket_->async_read_some(buffer(space.data(), space.size()),
+      [&](const error_code& error, size_t bytes) {  // NOLINT
         if (error && error == error::eof) {
           BUS_INFO() << "Connection closed by remote";
           Close();
+        } else if (error && error == error::operation_aborted) {
+          BUS_INFO() << "Connection closed. Remote: " << remote_;
         } else if (error) {
-          BUS_ERROR() << "Message size error. Error: " << error.message();
+          BUS_ERROR() << "Read message error. Error: " << error.message();
           Close();
-        } else if (bytes != size_data_.size()) {
-          BUS_ERROR() << "Message size length error. Error: "
-                      << error.message();
+        } else if (!frame_reader_.Read(bytes,
+                     [&](uint32_t flags, std::span<const uint8_t> frame) {
+                       return HandleFrame(flags, frame);
+                     })) {
           Close();
         } else {
-          LittleBuffer<uint32_t> length(size_data_.data(), 0);
-          if (length.value() > 0) {
-            try {
-              message_data_.resize(length.value(), 0);
-              DoReadMessage();
-            } catch (const std::exception& erre) {
-              BUS_ERROR() << "Message allocation  error. Error: " << erre.what();
-              Close();
-            }
-          } else {
-            DoReadSize();
-          }
+          DoRead();
         }
       });
 }
 
-void TcpMessageConnection::DoReadMessage() {  // NOLINT
-  if (!socket_ || !socket_->is_open()) {
+bool TcpMessageConnection::HandleFrame(uint32_t flags,
+                                       std::span<const uint8_t> frame) {
+  if (flags == kControlFrame) {
+    HandleControl(frame);
+  } else if (flags == kCompressedBlock) {
+    if (!block_reader_.Unpack(frame,
+          [&](const std::vector<uint8_t>& message) {
+            if (publisher_) {
+              publisher_->Push(message);
+            }
+          })) {
+      BUS_ERROR() << "Invalid compressed block. Size: " << frame.size();
+      return false;
+    }
+  } else if (publisher_) {
+    message_data_.assign(frame.begin(), frame.end());
+    publisher_->Push(message_data_);
+  }
+  return true;
+}
+
+void TcpMessageConnection::HandleControl(std::span<const uint8_t> frame) {
+  TcpHello hello;
+  if (!hello.FromRaw(frame) || hello.type != TcpControlType::Hello) {
+    BUS_ERROR() << "Invalid control frame. Size: " << frame.size();
     return;
   }
-  async_read(*socket_, boost::asio::buffer(message_data_),
-      [&](const error_code& error, size_t bytes) {  // NOLINT
-        if (error) {
-          BUS_ERROR() << "Read message error. Error: " << error.message();
-          Close();
-        } else if (bytes != message_data_.size()) {
-          BUS_ERROR() << "Message length error. Error: " << error.message();
-          Close();
-        } else {
-          if (publisher_) {
-            publisher_->Push(message_data_);
-          }
-          DoReadSize();
-        }
-      });
+  BusMessageFilter filter;
+  if (!hello.ReadFilter(filter)) {
+    BUS_ERROR() << "Invalid subscription filter. Sends all messages.";
+  }
+  const auto ack = hello.Accept(encodings_, kDefaultBatchSize);
+  link_->Select(ack);
+  {
+    // The send coroutine sends the reply before the next batch.
+    std::lock_guard lock(link_->lock);
+    ack.ToRaw(link_->reply);
+    link_->reply_descriptor = link_->shared_memory ? segment_descriptor_ : -1;
+  }
+  if (subscriber_) {
+    // Unwanted messages are dropped before they are decoded and queued.
+    subscriber_->Filter(filter);
+  }
+  link_->reply_pending = true;
+  BUS_TRACE() << "Client hello. Version: " << hello.version
+              << ", Encodings: " << ack.encodings
+              << ", Batch Size: " << ack.max_batch_size;
 }
 
 void TcpMessageConnection::Close() const {
   boost::system::error_code dummy;
-  socket_->shutdown(ip::tcp::socket::shutdown_both, dummy);
+  socket_->shutdown(socket_base::shutdown_both, dummy);
   socket_->close(dummy);
 }
 
-void TcpMessageConnection::ConnectionThread() {
-  while (!stop_connection_thread_ && subscriber_) {
-    auto msg = subscriber_->PopWait(100ms);
-    if (msg && socket_ && socket_->is_open()) {
-      LittleBuffer length(msg->Size());
-      try {
-        std::vector<uint8_t> data;
-        msg->ToRaw(data);
-        send_data_.resize(msg->Size() + 4);
-        std::copy_n(length.cbegin(), length.size(), send_data_.data());
-        std::copy_n(data.cbegin(), data.size(),
-          send_data_.data() + length.size());
-        socket_->send(buffer(send_data_));
-
-      } catch (const std::exception& err) {
-        BUS_ERROR() << "Send message error. Error: " << err.what();
+void TcpMessageConnection::StartSending() {
+  if (!socket_ || !subscriber_) {
+    return;
+  }
+  // The send coroutine runs on the same io_context as the socket reads,
+  // so no extra thread is needed for each connection.
+  co_spawn(socket_->get_executor(),
+           SendMessages(socket_, subscriber_, stop_sending_, link_,
+                        metrics_, send_options_), detached);
+}
+
+awaitable<void> TcpMessageConnection::SendMessages(
+    std::shared_ptr<StreamSocket> socket,
+    std::shared_ptr<IBusMessageQueue> subscriber,
+    std::shared_ptr<std::atomic<bool>> stop,
+    std::shared_ptr<TcpLinkMode> link,
+    std::shared_ptr<TcpSendMetrics> metrics,
+    TcpSendOptions options) {
+  std::vector<std::shared_ptr<IBusMessage>> messages;
+  std::vector<uint8_t> reply;
+  TcpSendBuffer send_data;
+  steady_timer flush_timer(socket->get_executor());
+  steady_timer write_timer(socket->get_executor());
+  uint64_t reported_lost = subscriber->LostMessages();
+  metrics->Lag(true);
+  while (!*stop && socket->is_open()) {
+    if (link->reply_pending) {
+      int descriptor = -1;
+      {
+        std::lock_guard lock(link->lock);
+        reply.swap(link->reply);
+        descriptor = link->reply_descriptor;
+        link->reply_descriptor = -1;
+        link->reply_pending = false;
+      }
+      error_code error;
+      if (descriptor >= 0) {
+        error = co_await WriteWithDescriptor(socket, reply, descriptor);
+      } else {
+        error = co_await WriteWithTimeout(socket, write_timer, buffer(reply),
+                                          options.slow_client_timeout);
+      }
+      if (error) {
+        BUS_ERROR() << "Send reply error. Error: " << error.message();
+      } else if (descriptor >= 0) {
+        // The client reads the shared memory from now on. The subscriber
+        // is stopped, so it doesn't hold back the ring buffer.
+        BUS_TRACE() << "Passed the shared memory to the client.";
+        subscriber->Stop();
+        co_return;
       }
     }
+    messages.clear();
+    const size_t max_batch_size = link->max_batch_size;
+    const size_t count = co_await AsyncPopBatch(*subscriber, messages,
+                                                max_batch_size, 100ms);
 
+    // The connection lags if the queue wasn't emptied by the last pop.
+    const bool behind = count >= max_batch_size;
+    const uint64_t lag = metrics->Lag(!behind);
+    if (behind && options.slow_client == SlowClientPolicy::Disconnect &&
+        options.slow_client_timeout > 0 &&
+        lag > options.slow_client_timeout) {
+      BUS_WARNING() << "Slow client disconnected. Lag: " << lag << " ms";
+      error_code dummy;
+      socket->close(dummy);
+      break;
+    }
+    if (const uint64_t lost = subscriber->LostMessages();
+        lost != reported_lost && !behind) {
+      // Reports the dropped messages when the client has caught up, so
+      // a slow client doesn't flood the log.
+      BUS_WARNING() << "Slow client. Dropped messages: "
+                    << lost - reported_lost << ", Total: " << lost;
+      reported_lost = lost;
+    }
+
+    if (count == 0 || *stop || !socket->is_open()) {
+      continue;
+    }
+    uint64_t nof_messages = 0;
+    try {
+      // Serialize all messages into one scatter-gather send
+      send_data.Clear();
+      send_data.CompactCan(link->compact_can);
+      for (const auto& msg : messages) {
+        if (msg) {
+          send_data.Add(*msg);
+          ++nof_messages;
+        }
+      }
+    } catch (const std::exception& err) {
+      BUS_ERROR() << "Send message allocation error. Error: " << err.what();
+      continue;
+    }
+    if (send_data.Empty()) {
+      continue;
+    }
+    send_data.Compression(link->compress ? BusCompression::Lz4
+                                         : BusCompression::None);
+    const auto error = co_await WriteWithTimeout(socket, write_timer,
+        send_data.Buffers(), options.slow_client_timeout);
+    if (error == error::operation_aborted && !socket->is_open()) {
+      BUS_WARNING() << "Send timeout. Closed the connection.";
+    } else if (error) {
+      BUS_ERROR() << "Send message error. Error: " << error.message();
+    } else {
+      metrics->sent_messages += nof_messages;
+      metrics->sent_bytes += send_data.Size();
+      if (options.flush_interval > 0) {
+        // Collects the messages during the interval into the next batch.
+        flush_timer.expires_after(milliseconds(options.flush_interval));
+        error_code timer_error;
+        co_await flush_timer.async_wait(
+            redirect_error(use_awaitable, timer_error));
+      }
+    }
   }
 }
 
-} // bus
\ No newline at end of file
+} // bus
@@ -6,47 +6,103 @@
 #pragma once
 
 #include <memory>
-#include <thread>
 #include <atomic>
+#include <string>
 
 #include <boost/asio.hpp>
 #include "bus/ibusmessagequeue.h"
+#include "bus/ibusmessagebroker.h"
+#include "tcpblockreader.h"
+#include "tcpframereader.h"
+#include "tcphandshake.h"
 
 namespace bus {
 
 class TcpMessageBroker;
 class TcpMessageServer;
 
+/** \brief Send settings of a connection. */
+struct TcpSendOptions {
+  uint32_t flush_interval = 0; ///< Wait after each send (ms).
+  SlowClientPolicy slow_client = SlowClientPolicy::DropOldest;
+  uint32_t slow_client_timeout = 0; ///< Send and lag timeout (ms).
+};
+
+/** \brief Metrics updated by the send coroutine.
+ *
+ * The drained time is updated each time the coroutine empties the send
+ * queue. The lag is the time since then, so a blocked send also shows up
+ * as a lag.
+ */
+struct TcpSendMetrics {
+  std::atomic<uint64_t> sent_messages = 0; ///< Number of sent messages.
+  std::atomic<uint64_t> sent_bytes = 0; ///< Number of sent bytes.
+  std::atomic<int64_t> drained_time = 0; ///< Steady clock (ns).
+  std::atomic<uint64_t> max_lag = 0; ///< Max lag (ms).
+
+  /** \brief Returns the lag (ms) and updates the max lag. */
+  uint64_t Lag(bool queue_empty);
+};
+
 class TcpMessageConnection {
  public:
   TcpMessageConnection() = delete;
   TcpMessageConnection(TcpMessageBroker& broker,
-                         std::unique_ptr<boost::asio::ip::tcp::socket>& socket);
+      std::unique_ptr<boost::asio::generic::stream_protocol::socket>& socket);
   TcpMessageConnection(TcpMessageServer& server,
-                         std::unique_ptr<boost::asio::ip::tcp::socket>& socket);
+      std::unique_ptr<boost::asio::generic::stream_protocol::socket>& socket);
   virtual ~TcpMessageConnection();
 
   bool CleanUp() const;
+  [[nodiscard]] ConnectionStatistics Statistics() const;
 
  private:
 
   // TcpMessageBroker& broker_;
-  std::unique_ptr<boost::asio::ip::tcp::socket> socket_;
-
-  std::atomic<bool> stop_connection_thread_ = true;
-  std::thread connection_thread_;
+  /** \brief The socket is shared with the send coroutine. It is a TCP/IP
+   * or a Unix domain socket.
+   */
+  std::shared_ptr<boost::asio::generic::stream_protocol::socket> socket_;
+
+  /** \brief Stops the send coroutine. Shared as the coroutine may
+   * outlive the connection object.
+   */
+  std::shared_ptr<std::atomic<bool>> stop_sending_ =
+      std::make_shared<std::atomic<bool>>(false);
+
+  /** \brief Modes selected by the handshake. Shared with the send
+   * coroutine.
+   */
+  std::shared_ptr<TcpLinkMode> link_ = std::make_shared<TcpLinkMode>();
+  uint16_t encodings_ = 0; ///< Encodings that the server supports.
+  TcpSendOptions send_options_;
+  std::shared_ptr<TcpSendMetrics> metrics_ =
+      std::make_shared<TcpSendMetrics>();
+  std::string remote_; ///< Client address and port.
+  /** \brief Segment passed to Unix domain socket clients (broker owned). */
+  int segment_descriptor_ = -1;
 
   std::shared_ptr<IBusMessageQueue> publisher_;
   std::shared_ptr<IBusMessageQueue> subscriber_;
 
-  std::array<uint8_t, 4> size_data_;
+  TcpFrameReader frame_reader_;
   std::vector<uint8_t> message_data_;
-  std::vector<uint8_t> send_data_;
-  void DoReadSize();
-  void DoReadMessage();
+  TcpBlockReader block_reader_;
+
+  void Init(const IBusMessageBroker& broker);
+  void DoRead();
+  bool HandleFrame(uint32_t flags, std::span<const uint8_t> frame);
+  void HandleControl(std::span<const uint8_t> frame);
   void Close() const;
 
-  void ConnectionThread();
+  void StartSending();
+  static boost::asio::awaitable<void> SendMessages(
+      std::shared_ptr<boost::asio::generic::stream_protocol::socket> socket,
+      std::shared_ptr<IBusMessageQueue> subscriber,
+      std::shared_ptr<std::atomic<bool>> stop,
+      std::shared_ptr<TcpLinkMode> link,
+      std::shared_ptr<TcpSendMetrics> metrics,
+      TcpSendOptions options);
 
 
 
@@ -13,6 +13,10 @@ using namespace boost::asio;
 using namespace boost::system;
 using namespace std::chrono_literals;
 
+namespace {
+constexpr size_t kMaxBatchSize = 1'000;
+}
+
 namespace bus {
 TcpMessageServer::TcpMessageServer()
   : IBusMessageBroker(),
@@ -95,8 +99,20 @@ void TcpMessageServer::Stop() {
   }
 }
 
+std::vector<ConnectionStatistics> TcpMessageServer::Connections() const {
+  std::vector<ConnectionStatistics> list;
+  std::lock_guard lock(connection_list_lock_);
+  for (const auto& connection : connection_list_) {
+    if (connection && !connection->CleanUp()) {
+      list.push_back(connection->Statistics());
+    }
+  }
+  return list;
+}
+
 void TcpMessageServer::DoAccept() {
-  connection_socket_ = std::make_unique<ip::tcp::socket>(context_);
+  connection_socket_ =
+      std::make_unique<generic::stream_protocol::socket>(context_);
   acceptor_->async_accept(*connection_socket_,
     [&](const boost::system::error_code& err) {
         if (err) {
@@ -145,26 +161,29 @@ void TcpMessageServer::ServerThread() {
 }
 
 void TcpMessageServer::MessageThread() const {
+  std::vector<std::shared_ptr<IBusMessage>> messages;
+  std::vector<std::shared_ptr<IBusMessageQueue>> subscribers;
   while (!stop_server_thread_ && tx_queue_ && rx_queue_) {
-    tx_queue_->EmptyWait(10ms);
-    while (!tx_queue_->Empty()) {
-      auto msg = tx_queue_->Pop();
-      std::lock_guard lock(queue_mutex_);
-      for (auto& subscriber : subscribers_) {
+    messages.clear();
+    if (tx_queue_->PopBatchWait(messages, kMaxBatchSize, 10ms) > 0) {
+      CopySubscribers(subscribers);
+      for (auto& subscriber : subscribers) {
         if (subscriber) {
-          subscriber->Push(msg);
+          subscriber->PushBatch(messages);
         }
       }
     }
+
+    messages.clear();
     {
       std::lock_guard lock(queue_mutex_);
       for (auto& publisher : publishers_) {
-        while (publisher && !publisher->Empty()) {
-          auto msg = publisher->Pop();
-          rx_queue_->Push(msg);
+        if (publisher) {
+          publisher->PopBatch(messages, kMaxBatchSize);
         }
       }
     }
+    rx_queue_->PushBatch(messages);
   }
 }
 } // bus
\ No newline at end of file
@@ -26,6 +26,7 @@ public:
   [[nodiscard]] virtual std::shared_ptr<IBusMessageQueue> CreateSubscriber();
   void Start() override;
   void Stop() override;
+  [[nodiscard]] std::vector<ConnectionStatistics> Connections() const override;
 private:
   /** The stop server task boolean is not used to stop the server thread.
    *  Instead does it actually suppress error message when the ASIO constext
@@ -38,7 +39,8 @@ private:
   boost::asio::io_context context_;
 
   std::unique_ptr<boost::asio::ip::tcp::acceptor> acceptor_;
-  std::unique_ptr<boost::asio::ip::tcp::socket> connection_socket_;
+  std::unique_ptr<boost::asio::generic::stream_protocol::socket>
+    connection_socket_;
 
   mutable std::mutex connection_list_lock_;
   std::vector<std::unique_ptr<TcpMessageConnection>> connection_list_;
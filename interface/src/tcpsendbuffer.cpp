@@ -0,0 +1,111 @@
+/*
+* Copyright 2025 Ingemar Hedvall
+* SPDX-License-Identifier: MIT
+*/
+
+#include "tcpsendbuffer.h"
+
+#include "bus/buslogstream.h"
+#include "bus/littlebuffer.h"
+#include "bus/lz4codec.h"
+
+namespace bus {
+
+void TcpSendBuffer::Clear() {
+  small_block_.clear();
+  nof_large_ = 0;
+  segments_.clear();
+  buffers_.clear();
+  size_ = 0;
+  send_size_ = 0;
+}
+
+void TcpSendBuffer::AddSmall(const uint8_t* data, size_t size) {
+  if (segments_.empty() || segments_.back().large) {
+    segments_.push_back({small_block_.size(), 0, false});
+  }
+  small_block_.insert(small_block_.end(), data, data + size);
+  segments_.back().size += size;
+}
+
+void TcpSendBuffer::Add(const IBusMessage& message) {
+  const bool large = message.Size() >= kGatherSize;
+  if (large && nof_large_ >= large_messages_.size()) {
+    large_messages_.emplace_back();
+  }
+  // Large messages are serialized directly into their send buffer.
+  auto& data = large ? large_messages_[nof_large_] : message_data_;
+  const auto* can_frame = compact_can_ &&
+      message.Type() == BusMessageType::CAN_DataFrame &&
+      message.Version() != CanDataFrame::kCompactVersion
+      ? dynamic_cast<const CanDataFrame*>(&message) : nullptr;
+  if (can_frame != nullptr) {
+    compact_frame_ = *can_frame;
+    compact_frame_.Version(CanDataFrame::kCompactVersion);
+    compact_frame_.ToRaw(data);
+  } else {
+    message.ToRaw(data);
+  }
+  if (data.empty()) {
+    return;
+  }
+  if (data.size() > kMaxMessageSize) {
+    BUS_ERROR() << "Message too large. Dropped. Size: " << data.size();
+    return;
+  }
+  const LittleBuffer length(static_cast<uint32_t>(data.size()));
+  AddSmall(length.data(), length.size());
+  if (large) {
+    segments_.push_back({nof_large_, data.size(), true});
+    ++nof_large_;
+  } else {
+    AddSmall(data.data(), data.size());
+  }
+  size_ += length.size() + data.size();
+  send_size_ = size_;
+}
+
+const std::vector<boost::asio::const_buffer>& TcpSendBuffer::Buffers() {
+  // The small block may have moved, so the buffers are built last.
+  buffers_.clear();
+  for (const auto& segment : segments_) {
+    if (segment.large) {
+      buffers_.emplace_back(boost::asio::buffer(
+          large_messages_[segment.offset]));
+    } else {
+      buffers_.emplace_back(small_block_.data() + segment.offset,
+                            segment.size);
+    }
+  }
+  send_size_ = size_;
+  if (compression_ == BusCompression::Lz4 && size_ >= kMinCompressSize &&
+      size_ <= kMaxBlockSize) {
+    CompressBuffers();
+  }
+  return buffers_;
+}
+
+void TcpSendBuffer::CompressBuffers() {
+  raw_block_.clear();
+  for (const auto& buffer : buffers_) {
+    const auto* data = static_cast<const uint8_t*>(buffer.data());
+    raw_block_.insert(raw_block_.end(), data, data + buffer.size());
+  }
+  Lz4Codec::Compress(raw_block_, compressed_block_);
+  const size_t size = block_header_.size() + compressed_block_.size();
+  if (size >= size_) {
+    return; // Doesn't compress. Send as is.
+  }
+
+  const LittleBuffer<uint32_t> length(kCompressedBlock |
+      static_cast<uint32_t>(size - 4));
+  const LittleBuffer<uint32_t> raw_size(static_cast<uint32_t>(size_));
+  std::copy_n(length.cbegin(), length.size(), block_header_.begin());
+  std::copy_n(raw_size.cbegin(), raw_size.size(), block_header_.begin() + 4);
+  buffers_.clear();
+  buffers_.emplace_back(boost::asio::buffer(block_header_));
+  buffers_.emplace_back(boost::asio::buffer(compressed_block_));
+  send_size_ = size;
+}
+
+} // bus
@@ -0,0 +1,105 @@
+/*
+* Copyright 2025 Ingemar Hedvall
+* SPDX-License-Identifier: MIT
+*/
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include <boost/asio/buffer.hpp>
+
+#include "bus/candataframe.h"
+#include "bus/ibusmessage.h"
+#include "bus/ibusmessagebroker.h"
+
+namespace bus {
+
+/** \brief Bit 31 in the length prefix marks a compressed block.
+ *
+ * A compressed block is the uncompressed size (uint32_t) followed by a
+ * LZ4 block. The uncompressed bytes are normal length prefixed messages.
+ */
+constexpr uint32_t kCompressedBlock = 0x80000000;
+
+/** \brief Max uncompressed size of a compressed block. */
+constexpr uint32_t kMaxBlockSize = 16 * kMaxMessageSize;
+
+/** \brief Builds the scatter-gather buffers of a TCP send.
+ *
+ * Each message is sent as a 4 byte length followed by the serialized
+ * message. Small messages are copied into one contiguous block, as a
+ * buffer per CAN frame costs more than the copy. Large messages, e.g.
+ * Ethernet frames, are serialized into their own buffer, which is sent
+ * as is. The buffers keep their capacity between the sends.
+ *
+ * If LZ4 compression is enabled, the batch is sent as one compressed block
+ * unless the batch is small or doesn't compress. If the compact CAN
+ * encoding is enabled, CAN data frames are serialized in the compact
+ * layout.
+ */
+class TcpSendBuffer {
+ public:
+  /** \brief Messages from this size are sent from their own buffer. */
+  static constexpr size_t kGatherSize = 1'024;
+  /** \brief Smaller batches are not compressed. */
+  static constexpr size_t kMinCompressSize = 128;
+
+  /** \brief Sets the compression of the following sends. */
+  void Compression(BusCompression compression) { compression_ = compression; }
+
+  /** \brief Serializes CAN data frames in the compact layout. */
+  void CompactCan(bool compact) { compact_can_ = compact; }
+
+  void Clear(); ///< Removes all messages but keeps the memory.
+
+  /** \brief Serializes and adds a message.
+   *
+   * Messages larger than kMaxMessageSize are dropped with an error.
+   * @param message Message to send.
+   */
+  void Add(const IBusMessage& message);
+
+  [[nodiscard]] bool Empty() const { return segments_.empty(); }
+
+  /** \brief Returns the number of bytes to send. */
+  [[nodiscard]] size_t Size() const { return send_size_; }
+
+  /** \brief Returns the buffer sequence to send.
+   *
+   * The batch is compressed by this call, so the Size() is the compressed
+   * size after the call.
+   * The sequence is valid until the next Clear() or Add() call.
+   */
+  [[nodiscard]] const std::vector<boost::asio::const_buffer>& Buffers();
+
+ private:
+  /** \brief Part of the small block or a large message. */
+  struct Segment {
+    size_t offset = 0; ///< Offset in the small block.
+    size_t size = 0; ///< Size in the small block.
+    bool large = false; ///< The offset is the index of a large message.
+  };
+  std::vector<uint8_t> small_block_;
+  std::vector<std::vector<uint8_t>> large_messages_;
+  size_t nof_large_ = 0;
+  std::vector<uint8_t> message_data_;
+  std::vector<Segment> segments_;
+  std::vector<boost::asio::const_buffer> buffers_;
+  size_t size_ = 0; ///< Uncompressed size.
+  size_t send_size_ = 0; ///< Size after compression.
+
+  BusCompression compression_ = BusCompression::None;
+  bool compact_can_ = false;
+  CanDataFrame compact_frame_; ///< Copy with the compact version.
+  std::vector<uint8_t> raw_block_;
+  std::vector<uint8_t> compressed_block_;
+  std::array<uint8_t, 8> block_header_ = {};
+
+  void AddSmall(const uint8_t* data, size_t size);
+  void CompressBuffers();
+};
+
+} // bus
@@ -0,0 +1,198 @@
+/*
+* Copyright 2025 Ingemar Hedvall
+* SPDX-License-Identifier: MIT
+*/
+
+#include "udpdatagram.h"
+
+#include <algorithm>
+
+#include "bus/buslogstream.h"
+#include "bus/littlebuffer.h"
+
+namespace {
+
+template <typename T>
+void WriteAt(std::span<uint8_t> dest, size_t offset, T value) {
+  const bus::LittleBuffer<T> buffer(value);
+  std::copy_n(buffer.cbegin(), buffer.size(), dest.begin() + offset);
+}
+
+} // end namespace
+
+namespace bus {
+
+void UdpDatagramHeader::ToRaw(std::span<uint8_t> dest) const {
+  WriteAt(dest, 0, kDatagramMagic);
+  dest[2] = static_cast<uint8_t>(type);
+  dest[3] = 0;
+  WriteAt(dest, 4, sender);
+  WriteAt(dest, 8, sequence);
+  WriteAt(dest, 12, count);
+  WriteAt<uint16_t>(dest, 14, 0);
+}
+
+bool UdpDatagramHeader::FromRaw(std::span<const uint8_t> source) {
+  if (source.size() < kDatagramHeaderSize) {
+    return false;
+  }
+  const LittleBuffer<uint16_t> magic(source.data(), 0);
+  if (magic.value() != kDatagramMagic || source[2] > 1) {
+    return false;
+  }
+  type = static_cast<UdpDatagramType>(source[2]);
+  sender = LittleBuffer<uint32_t>(source.data(), 4).value();
+  sequence = LittleBuffer<uint32_t>(source.data(), 8).value();
+  count = LittleBuffer<uint16_t>(source.data(), 12).value();
+  return true;
+}
+
+UdpDatagramPacker::UdpDatagramPacker(uint32_t sender)
+    : sender_(sender) {
+}
+
+void UdpDatagramPacker::Add(const IBusMessage& message) {
+  message.ToRaw(message_data_);
+  const size_t size = message_data_.size();
+  if (size == 0 || size > kMaxUdpPayload - kDatagramHeaderSize - 2) {
+    BUS_ERROR() << "Message too large for a datagram. Size: " << size;
+    return;
+  }
+  if (!current_.empty() &&
+      (current_.size() + 2 + size > kMaxDatagramSize ||
+       nof_messages_ == 0xFFFF)) {
+    Flush();
+  }
+  if (current_.empty()) {
+    current_.resize(kDatagramHeaderSize);
+  }
+  const LittleBuffer<uint16_t> length(static_cast<uint16_t>(size));
+  current_.insert(current_.end(), length.cbegin(), length.cend());
+  current_.insert(current_.end(), message_data_.cbegin(),
+                  message_data_.cend());
+  ++nof_messages_;
+  if (current_.size() >= kMaxDatagramSize) {
+    Flush(); // A large message is sent alone
+  }
+}
+
+void UdpDatagramPacker::Flush() {
+  if (current_.empty()) {
+    return;
+  }
+  UdpDatagramHeader header;
+  header.type = UdpDatagramType::Data;
+  header.sender = sender_;
+  header.sequence = sequence_++;
+  header.count = nof_messages_;
+  header.ToRaw(current_);
+  datagrams_.push_back(std::move(current_));
+  current_.clear();
+  nof_messages_ = 0;
+}
+
+bool UnpackDatagram(std::span<const uint8_t> datagram,
+    const std::function<void(std::span<const uint8_t>)>& callback) {
+  UdpDatagramHeader header;
+  if (!header.FromRaw(datagram) || header.type != UdpDatagramType::Data) {
+    return false;
+  }
+  size_t offset = kDatagramHeaderSize;
+  for (uint16_t message = 0; message < header.count; ++message) {
+    if (datagram.size() - offset < 2) {
+      return false;
+    }
+    const LittleBuffer<uint16_t> length(datagram.data(), offset);
+    offset += 2;
+    if (length.value() > datagram.size() - offset) {
+      return false;
+    }
+    if (callback) {
+      callback(datagram.subspan(offset, length.value()));
+    }
+    offset += length.value();
+  }
+  return offset == datagram.size();
+}
+
+bool UdpSequenceTracker::Receive(uint32_t sequence, uint32_t& first_missing,
+                                 uint32_t& nof_missing) {
+  first_missing = 0;
+  nof_missing = 0;
+  if (!started_) {
+    started_ = true;
+    expected_ = sequence + 1;
+    return true;
+  }
+  // Signed difference, so the sequence number may wrap around.
+  const auto diff = static_cast<int32_t>(sequence - expected_);
+  if (diff == 0) {
+    ++expected_;
+    return true;
+  }
+  if (diff > 0) {
+    first_missing = expected_;
+    nof_missing = static_cast<uint32_t>(diff);
+    lost_ += nof_missing;
+    const uint32_t remember = std::min<uint32_t>(nof_missing, kMaxMissing);
+    for (uint32_t index = nof_missing - remember; index < nof_missing;
+         ++index) {
+      missing_.insert(expected_ + index);
+    }
+    expected_ = sequence + 1;
+    if (missing_.size() > kMaxMissing) {
+      std::erase_if(missing_, [&] (uint32_t missing) -> bool {
+        return expected_ - missing > kMaxMissing;
+      });
+    }
+    return true;
+  }
+  // A late or retransmitted datagram is only delivered once.
+  if (missing_.erase(sequence) > 0) {
+    --lost_;
+    return true;
+  }
+  return false;
+}
+
+void UdpRetransmitWindow::Size(size_t size) {
+  slots_.assign(size, {});
+}
+
+void UdpRetransmitWindow::Add(uint32_t sequence,
+                              const std::vector<uint8_t>& datagram) {
+  if (slots_.empty()) {
+    return;
+  }
+  auto& slot = slots_[sequence % slots_.size()];
+  slot.used = true;
+  slot.sequence = sequence;
+  slot.datagram.assign(datagram.cbegin(), datagram.cend());
+  slot.resent = false;
+}
+
+const std::vector<uint8_t>* UdpRetransmitWindow::Find(
+    uint32_t sequence) const {
+  if (slots_.empty()) {
+    return nullptr;
+  }
+  const auto& slot = slots_[sequence % slots_.size()];
+  return slot.used && slot.sequence == sequence ? &slot.datagram : nullptr;
+}
+
+const std::vector<uint8_t>* UdpRetransmitWindow::Resend(uint32_t sequence,
+    std::chrono::steady_clock::time_point now,
+    std::chrono::steady_clock::duration holdoff) {
+  if (Find(sequence) == nullptr) {
+    return nullptr;
+  }
+  auto& slot = slots_[sequence % slots_.size()];
+  if (slot.resent && now - slot.resend_time < holdoff) {
+    return nullptr; // Another receiver already requested it
+  }
+  slot.resent = true;
+  slot.resend_time = now;
+  return &slot.datagram;
+}
+
+} // bus
@@ -0,0 +1,182 @@
+/*
+* Copyright 2025 Ingemar Hedvall
+* SPDX-License-Identifier: MIT
+*/
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <set>
+#include <span>
+#include <vector>
+
+#include "bus/ibusmessage.h"
+
+namespace bus {
+
+/** \brief Max datagram size that fits an Ethernet frame (1500 - 28). */
+constexpr size_t kMaxDatagramSize = 1'472;
+
+/** \brief Max UDP payload. Used by messages that don't fit a datagram. */
+constexpr size_t kMaxUdpPayload = 65'507;
+
+/** \brief Size of the datagram header. */
+constexpr size_t kDatagramHeaderSize = 16;
+
+/** \brief Identifies the datagrams of this library. */
+constexpr uint16_t kDatagramMagic = 0x4D42;
+
+/** \brief Type of datagram. */
+enum class UdpDatagramType : uint8_t {
+  Data = 0, ///< Length prefixed messages.
+  Nack = 1  ///< Request to retransmit missing data datagrams.
+};
+
+/** \brief Header of a multicast datagram.
+ *
+ * The header is followed by the messages, each prefixed with its
+ * length (uint16_t). A NACK datagram holds the number of missing datagrams
+ * (uint32_t) instead, starting at the sequence number. The sender ID is
+ * then the sender that shall retransmit.
+ * <table>
+ * <tr><th>Byte Offset</th><th>Description</th><th>Size</th></tr>
+ * <tr><td>0</td><td>Magic (0x4D42)</td><td>uint16_t</td></tr>
+ * <tr><td>2</td><td>Datagram Type</td><td>uint8_t</td></tr>
+ * <tr><td>3</td><td>Reserved</td><td>uint8_t</td></tr>
+ * <tr><td>4</td><td>Sender ID</td><td>uint32_t</td></tr>
+ * <tr><td>8</td><td>Sequence Number</td><td>uint32_t</td></tr>
+ * <tr><td>12</td><td>Number of Messages</td><td>uint16_t</td></tr>
+ * <tr><td>14</td><td>Reserved</td><td>uint16_t</td></tr>
+ * <tr><td>16</td><td>Messages or NACK count</td><td>Rest of datagram</td></tr>
+ * </table>
+ */
+struct UdpDatagramHeader {
+  UdpDatagramType type = UdpDatagramType::Data; ///< Type of datagram.
+  uint32_t sender = 0; ///< Random ID of the sender.
+  uint32_t sequence = 0; ///< Sequence number of the sender.
+  uint16_t count = 0; ///< Number of messages.
+
+  /** \brief Writes the header first in the datagram. */
+  void ToRaw(std::span<uint8_t> dest) const;
+
+  /** \brief Reads the header. Returns false if not a valid datagram. */
+  [[nodiscard]] bool FromRaw(std::span<const uint8_t> source);
+};
+
+/** \brief Packs messages into MTU sized datagrams.
+ *
+ * Each datagram gets the next sequence number. A message that doesn't fit
+ * an empty datagram is sent alone in a larger datagram, which the IP layer
+ * fragments.
+ */
+class UdpDatagramPacker {
+ public:
+  explicit UdpDatagramPacker(uint32_t sender);
+
+  /** \brief Serializes and adds a message.
+   *
+   * Messages larger than kMaxUdpPayload are dropped with an error.
+   * @param message Message to send.
+   */
+  void Add(const IBusMessage& message);
+
+  /** \brief Ends the current datagram. */
+  void Flush();
+
+  /** \brief Returns the completed datagrams. */
+  [[nodiscard]] std::vector<std::vector<uint8_t>>& Datagrams() {
+    return datagrams_;
+  }
+
+  /** \brief Returns the next sequence number. */
+  [[nodiscard]] uint32_t Sequence() const { return sequence_; }
+
+ private:
+  uint32_t sender_ = 0;
+  uint32_t sequence_ = 0;
+  std::vector<uint8_t> current_;
+  uint16_t nof_messages_ = 0;
+  std::vector<uint8_t> message_data_;
+  std::vector<std::vector<uint8_t>> datagrams_;
+};
+
+/** \brief Reads the messages in a data datagram.
+ *
+ * @param datagram Datagram including the header.
+ * @param callback Called with each serialized message.
+ * @return False if the datagram is truncated.
+ */
+[[nodiscard]] bool UnpackDatagram(std::span<const uint8_t> datagram,
+    const std::function<void(std::span<const uint8_t>)>& callback);
+
+/** \brief Tracks the sequence numbers of one sender.
+ *
+ * The tracker detects gaps and duplicates. Missing sequence numbers are
+ * remembered, so a late (retransmitted) datagram is accepted once.
+ */
+class UdpSequenceTracker {
+ public:
+  /** \brief Max number of remembered missing datagrams. */
+  static constexpr size_t kMaxMissing = 4'096;
+
+  /** \brief Registers a received sequence number.
+   *
+   * @param sequence Sequence number.
+   * @param first_missing Returns the first missing number if a gap.
+   * @param nof_missing Returns the number of missing datagrams.
+   * @return True if the datagram shall be delivered, false if a duplicate.
+   */
+  [[nodiscard]] bool Receive(uint32_t sequence, uint32_t& first_missing,
+                             uint32_t& nof_missing);
+
+  /** \brief Returns number of datagrams that still are missing. */
+  [[nodiscard]] uint64_t Lost() const { return lost_; }
+
+ private:
+  bool started_ = false;
+  uint32_t expected_ = 0;
+  std::set<uint32_t> missing_;
+  uint64_t lost_ = 0;
+};
+
+/** \brief Keeps the latest sent datagrams for retransmission. */
+class UdpRetransmitWindow {
+ public:
+  /** \brief Sets the number of datagrams to keep. 0 disables the window. */
+  void Size(size_t size);
+
+  /** \brief Stores a copy of a sent datagram. */
+  void Add(uint32_t sequence, const std::vector<uint8_t>& datagram);
+
+  /** \brief Returns a stored datagram or nullptr if outside the window. */
+  [[nodiscard]] const std::vector<uint8_t>* Find(uint32_t sequence) const;
+
+  /** \brief Returns a datagram to retransmit.
+   *
+   * All receivers that lost a datagram request it, but the multicast
+   * retransmit reaches all of them. A datagram is therefore only
+   * retransmitted once within the hold-off time.
+   * @param sequence Requested sequence number.
+   * @param now Current time.
+   * @param holdoff Minimum time between retransmits of a datagram.
+   * @return The datagram or nullptr if outside the window or recently sent.
+   */
+  [[nodiscard]] const std::vector<uint8_t>* Resend(uint32_t sequence,
+      std::chrono::steady_clock::time_point now,
+      std::chrono::steady_clock::duration holdoff);
+
+ private:
+  /** \brief Ring of datagrams. The slot is the sequence modulo size. */
+  struct Slot {
+    bool used = false;
+    uint32_t sequence = 0;
+    std::vector<uint8_t> datagram;
+    bool resent = false;
+    std::chrono::steady_clock::time_point resend_time; ///< Last retransmit.
+  };
+  std::vector<Slot> slots_;
+};
+
+} // bus
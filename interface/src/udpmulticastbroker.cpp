@@ -0,0 +1,309 @@
+/*
+* Copyright 2025 Ingemar Hedvall
+* SPDX-License-Identifier: MIT
+*/
+#include <chrono>
+#include <random>
+#include <sstream>
+
+#include "udpmulticastbroker.h"
+#include "bus/buslogstream.h"
+#include "bus/littlebuffer.h"
+
+using namespace std::chrono_literals;
+using namespace boost::asio;
+using namespace boost::system;
+
+namespace {
+
+constexpr size_t kMaxBatchSize = 1'000; ///< Messages popped per send.
+constexpr int kReceiveBufferSize = 4 * 1024 * 1024;
+/** \brief Minimum time between retransmits of the same datagram.
+ *
+ * Each receiver that lost a datagram sends a NACK. The first NACK triggers
+ * the retransmit, which reaches all receivers, so the following NACKs are
+ * ignored.
+ */
+constexpr auto kRetransmitHoldoff = 20ms;
+
+} // end namespace
+
+namespace bus {
+
+UdpMulticastBroker::UdpMulticastBroker()
+  : send_timer_(context_) {
+}
+
+UdpMulticastBroker::~UdpMulticastBroker() {
+  UdpMulticastBroker::Stop();
+}
+
+void UdpMulticastBroker::Start() {
+  Stop();
+  if (Address().empty()) {
+    BUS_ERROR() << "A multicast group address is required. Name: " << Name();
+    return;
+  }
+  if (context_.stopped()) {
+    context_.restart();
+  }
+  stop_multicast_thread_ = false;
+
+  try {
+    const auto group = ip::make_address(Address());
+    group_endpoint_ = ip::udp::endpoint(group, Port());
+
+    receive_socket_ = std::make_unique<ip::udp::socket>(context_);
+    receive_socket_->open(group_endpoint_.protocol());
+    receive_socket_->set_option(ip::udp::socket::reuse_address(true));
+    receive_socket_->set_option(
+        socket_base::receive_buffer_size(kReceiveBufferSize));
+    receive_socket_->bind(ip::udp::endpoint(group_endpoint_.protocol(),
+                                            Port()));
+    receive_socket_->set_option(ip::multicast::join_group(group));
+
+    send_socket_ = std::make_unique<ip::udp::socket>(
+        context_, group_endpoint_.protocol());
+    send_socket_->set_option(ip::multicast::hops(1)); // Only the LAN
+    send_socket_->set_option(ip::multicast::enable_loopback(true));
+  } catch (const std::exception& err) {
+    BUS_ERROR() << "Failed to join the multicast group. Name: " << Name()
+                << ", Group: " << Address() << ":" << Port()
+                << ", Error: " << err.what();
+    receive_socket_.reset();
+    send_socket_.reset();
+    return;
+  }
+
+  std::random_device random;
+  sender_id_ = random();
+  packer_ = std::make_unique<UdpDatagramPacker>(sender_id_);
+  window_.Size(RetransmitWindow());
+  send_error_ = false;
+  receive_data_.resize(kMaxUdpPayload);
+  {
+    std::lock_guard lock(sender_lock_);
+    senders_.clear();
+  }
+
+  DoReceive();
+  DoSendMessage();
+  multicast_thread_ = std::thread(&UdpMulticastBroker::MulticastThread, this);
+  connected_ = true;
+}
+
+void UdpMulticastBroker::Stop() {
+  connected_ = false;
+  stop_multicast_thread_ = true;
+  if (!context_.stopped()) {
+    context_.stop();
+  }
+  if (multicast_thread_.joinable()) {
+    multicast_thread_.join();
+  }
+  receive_socket_.reset();
+  send_socket_.reset();
+}
+
+std::vector<ConnectionStatistics> UdpMulticastBroker::Connections() const {
+  std::vector<ConnectionStatistics> list;
+  std::lock_guard lock(sender_lock_);
+  for (const auto& [id, sender] : senders_) {
+    ConnectionStatistics statistics;
+    statistics.remote = sender.remote;
+    statistics.received_messages = sender.received_messages;
+    statistics.lost_datagrams = sender.tracker.Lost();
+    list.push_back(statistics);
+  }
+  return list;
+}
+
+void UdpMulticastBroker::MulticastThread() {
+  try {
+    const auto& count = context_.run();
+    BUS_TRACE() << "Stopped main worker thread. Name: " << Name()
+                << ", Count: " << count;
+  } catch (const std::exception& err) {
+    if (!stop_multicast_thread_) {
+      BUS_ERROR() << "Context error. Name: " << Name()
+                  << ", Error: " << err.what();
+    }
+  }
+}
+
+void UdpMulticastBroker::DoReceive() {
+  if (!receive_socket_) {
+    return;
+  }
+  receive_socket_->async_receive_from(buffer(receive_data_), remote_endpoint_,
+      [&](const error_code& error, size_t bytes) -> void {
+        if (error == error::operation_aborted) {
+          return;
+        }
+        if (error) {
+          BUS_ERROR() << "Receive error. Error: " << error.message();
+        } else {
+          HandleDatagram(std::span<const uint8_t>(receive_data_.data(),
+                                                  bytes));
+        }
+        DoReceive();
+      });
+}
+
+void UdpMulticastBroker::HandleDatagram(std::span<const uint8_t> datagram) {
+  UdpDatagramHeader header;
+  if (!header.FromRaw(datagram)) {
+    // Other applications may use the same group.
+    BUS_TRACE() << "Unknown datagram. Size: " << datagram.size();
+    return;
+  }
+  if (header.type == UdpDatagramType::Nack) {
+    HandleNack(header, datagram);
+    return;
+  }
+
+  uint32_t first_missing = 0;
+  uint32_t nof_missing = 0;
+  {
+    std::lock_guard lock(sender_lock_);
+    auto& sender = senders_[header.sender];
+    if (sender.remote.empty()) {
+      std::ostringstream remote;
+      remote << remote_endpoint_;
+      sender.remote = remote.str();
+    }
+    if (!sender.tracker.Receive(header.sequence, first_missing,
+                                nof_missing)) {
+      return; // Duplicate
+    }
+    sender.received_messages += header.count;
+  }
+  if (nof_missing > 0) {
+    BUS_TRACE() << "Lost datagrams. Sender: " << header.sender
+                << ", Sequence: " << first_missing
+                << ", Count: " << nof_missing;
+    if (RetransmitWindow() > 0) {
+      SendNack(header.sender, first_missing, nof_missing);
+    }
+  }
+
+  CopySubscribers(subscriber_list_);
+  const bool valid = UnpackDatagram(datagram,
+      [&](std::span<const uint8_t> message) -> void {
+        message_data_.assign(message.begin(), message.end());
+        for (auto& subscriber : subscriber_list_) {
+          if (subscriber) {
+            subscriber->Push(message_data_);
+          }
+        }
+      });
+  if (!valid) {
+    BUS_ERROR() << "Invalid datagram. Size: " << datagram.size();
+  }
+}
+
+void UdpMulticastBroker::HandleNack(const UdpDatagramHeader& header,
+                                    std::span<const uint8_t> datagram) {
+  if (header.sender != sender_id_ ||
+      datagram.size() < kDatagramHeaderSize + 4) {
+    return; // Not for this sender
+  }
+  const LittleBuffer<uint32_t> count(datagram.data(), kDatagramHeaderSize);
+  const uint32_t nof_datagrams = std::min(count.value(), RetransmitWindow());
+  const auto now = std::chrono::steady_clock::now();
+  for (uint32_t index = 0; index < nof_datagrams; ++index) {
+    if (const auto* resend = window_.Resend(header.sequence + index, now,
+                                            kRetransmitHoldoff);
+        resend != nullptr) {
+      SendDatagram(*resend);
+    }
+  }
+}
+
+void UdpMulticastBroker::SendNack(uint32_t sender, uint32_t first,
+                                  uint32_t count) {
+  std::vector<uint8_t> nack(kDatagramHeaderSize + 4, 0);
+  UdpDatagramHeader header;
+  header.type = UdpDatagramType::Nack;
+  header.sender = sender;
+  header.sequence = first;
+  header.ToRaw(nack);
+  const LittleBuffer<uint32_t> nof_datagrams(count);
+  std::copy_n(nof_datagrams.cbegin(), nof_datagrams.size(),
+              nack.begin() + kDatagramHeaderSize);
+  SendDatagram(nack);
+}
+
+void UdpMulticastBroker::SendDatagram(const std::vector<uint8_t>& datagram) {
+  if (!send_socket_) {
+    return;
+  }
+  error_code error;
+  send_socket_->send_to(buffer(datagram), group_endpoint_, 0, error);
+  if (error && !send_error_) {
+    BUS_ERROR() << "Send datagram error. Group: " << group_endpoint_
+                << ", Error: " << error.message();
+  }
+  send_error_ = static_cast<bool>(error);
+}
+
+void UdpMulticastBroker::DoSendMessage() {
+  if (!send_socket_ || !packer_) {
+    DoSendWait();
+    return;
+  }
+  std::vector<std::shared_ptr<IBusMessage>> messages;
+  {
+    std::lock_guard lock(queue_mutex_);
+    for (auto& publisher : publishers_) {
+      if (publisher && !publisher->Empty()) {
+        publisher->PopBatch(messages, kMaxBatchSize);
+      }
+    }
+  }
+  if (messages.empty()) {
+    DoSendWait();
+    return;
+  }
+
+  try {
+    for (const auto& msg : messages) {
+      if (msg && msg->Size() > 0) {
+        packer_->Add(*msg);
+      }
+    }
+    packer_->Flush();
+  } catch (const std::exception& err) {
+    BUS_ERROR() << "Send message allocation error. Error: " << err.what();
+  }
+
+  auto& datagrams = packer_->Datagrams();
+  for (const auto& datagram : datagrams) {
+    SendDatagram(datagram);
+    UdpDatagramHeader header;
+    if (header.FromRaw(datagram)) {
+      window_.Add(header.sequence, datagram);
+    }
+  }
+  datagrams.clear();
+
+  if (FlushInterval() > 0) {
+    DoSendWait(); // Collects messages during the flush interval
+  } else {
+    post(context_, [&] () -> void { DoSendMessage(); });
+  }
+}
+
+void UdpMulticastBroker::DoSendWait() {
+  send_timer_.expires_after(
+      std::max(std::chrono::milliseconds(FlushInterval()),
+               std::chrono::milliseconds(10)));
+  send_timer_.async_wait([&](const error_code error) -> void {
+    if (error == error::operation_aborted) {
+      return;
+    }
+    DoSendMessage();
+  });
+}
+
+} // bus
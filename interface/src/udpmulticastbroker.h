@@ -0,0 +1,87 @@
+/*
+* Copyright 2025 Ingemar Hedvall
+* SPDX-License-Identifier: MIT
+*/
+
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+#include "bus/ibusmessagebroker.h"
+#include "udpdatagram.h"
+
+namespace bus {
+
+/** \brief UDP multicast publisher and subscriber.
+ *
+ * The broker sends the published messages to a multicast group and
+ * receives the messages that other brokers send to the group. The
+ * Address() is the group address and the Port() is the UDP port. A
+ * message is sent once independent of the number of receivers.
+ *
+ * The messages are packed into MTU sized datagrams with sequence numbers.
+ * Receivers detect lost datagrams as gaps in the sequence numbers and
+ * may request a retransmit, see RetransmitWindow(). UDP doesn't keep the
+ * order between senders, and a retransmitted datagram is delivered out of
+ * order.
+ */
+class UdpMulticastBroker : public IBusMessageBroker {
+ public:
+  UdpMulticastBroker();
+  ~UdpMulticastBroker() override;
+
+  void Start() override;
+  void Stop() override;
+  [[nodiscard]] std::vector<ConnectionStatistics> Connections() const override;
+
+ private:
+  /** \brief Receive state of a remote sender. */
+  struct Sender {
+    std::string remote; ///< Address and port of the sender.
+    UdpSequenceTracker tracker;
+    uint64_t received_messages = 0;
+  };
+
+  /** The stop boolean suppress error messages when the ASIO context
+   *  is stopped.
+   */
+  std::atomic<bool> stop_multicast_thread_ = false;
+  std::thread multicast_thread_;
+  boost::asio::io_context context_;
+  boost::asio::steady_timer send_timer_;
+  std::unique_ptr<boost::asio::ip::udp::socket> receive_socket_;
+  std::unique_ptr<boost::asio::ip::udp::socket> send_socket_;
+  boost::asio::ip::udp::endpoint group_endpoint_;
+  boost::asio::ip::udp::endpoint remote_endpoint_;
+  std::vector<uint8_t> receive_data_;
+  std::vector<uint8_t> message_data_;
+  std::vector<std::shared_ptr<IBusMessageQueue>> subscriber_list_;
+
+  uint32_t sender_id_ = 0; ///< Random ID that identifies this sender.
+  std::unique_ptr<UdpDatagramPacker> packer_;
+  UdpRetransmitWindow window_;
+  bool send_error_ = false; ///< Suppress repeated send errors.
+
+  mutable std::mutex sender_lock_;
+  std::map<uint32_t, Sender> senders_;
+
+  void MulticastThread();
+  void DoReceive();
+  void HandleDatagram(std::span<const uint8_t> datagram);
+  void HandleNack(const UdpDatagramHeader& header,
+                  std::span<const uint8_t> datagram);
+  void SendNack(uint32_t sender, uint32_t first, uint32_t count);
+  void SendDatagram(const std::vector<uint8_t>& datagram);
+  void DoSendMessage();
+  void DoSendWait();
+};
+
+} // bus
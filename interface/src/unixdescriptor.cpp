@@ -0,0 +1,105 @@
+/*
+* Copyright 2025 Ingemar Hedvall
+* SPDX-License-Identifier: MIT
+*/
+
+#include "unixdescriptor.h"
+
+#if defined(_WIN32)
+#include <cerrno>
+#else
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+namespace bus {
+
+#if defined(_WIN32)
+
+int64_t SendDescriptor(int, std::span<const uint8_t>, int) {
+  errno = ENOSYS;
+  return -1;
+}
+
+int64_t ReceiveDescriptor(int, std::span<uint8_t>, int& descriptor) {
+  descriptor = -1;
+  errno = ENOSYS;
+  return -1;
+}
+
+void CloseDescriptor(int& descriptor) {
+  descriptor = -1;
+}
+
+#else
+
+int64_t SendDescriptor(int socket, std::span<const uint8_t> data,
+                       int descriptor) {
+  iovec vector {};
+  vector.iov_base = const_cast<uint8_t*>(data.data());
+  vector.iov_len = data.size();
+
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+  msghdr message {};
+  message.msg_iov = &vector;
+  message.msg_iovlen = 1;
+  message.msg_control = control;
+  message.msg_controllen = sizeof(control);
+
+  cmsghdr* header = CMSG_FIRSTHDR(&message);
+  header->cmsg_level = SOL_SOCKET;
+  header->cmsg_type = SCM_RIGHTS;
+  header->cmsg_len = CMSG_LEN(sizeof(int));
+  std::memcpy(CMSG_DATA(header), &descriptor, sizeof(int));
+
+  int flags = 0;
+#if defined(MSG_NOSIGNAL)
+  flags |= MSG_NOSIGNAL;
+#endif
+  return ::sendmsg(socket, &message, flags);
+}
+
+int64_t ReceiveDescriptor(int socket, std::span<uint8_t> data,
+                          int& descriptor) {
+  descriptor = -1;
+  iovec vector {};
+  vector.iov_base = data.data();
+  vector.iov_len = data.size();
+
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+  msghdr message {};
+  message.msg_iov = &vector;
+  message.msg_iovlen = 1;
+  message.msg_control = control;
+  message.msg_controllen = sizeof(control);
+
+  int flags = 0;
+#if defined(MSG_CMSG_CLOEXEC)
+  flags |= MSG_CMSG_CLOEXEC;
+#endif
+  const auto bytes = ::recvmsg(socket, &message, flags);
+  if (bytes < 0) {
+    return bytes;
+  }
+  for (cmsghdr* header = CMSG_FIRSTHDR(&message); header != nullptr;
+       header = CMSG_NXTHDR(&message, header)) {
+    if (header->cmsg_level == SOL_SOCKET && header->cmsg_type == SCM_RIGHTS &&
+        header->cmsg_len >= CMSG_LEN(sizeof(int))) {
+      std::memcpy(&descriptor, CMSG_DATA(header), sizeof(int));
+    }
+  }
+  return bytes;
+}
+
+void CloseDescriptor(int& descriptor) {
+  if (descriptor >= 0) {
+    ::close(descriptor);
+  }
+  descriptor = -1;
+}
+
+#endif
+
+} // bus
@@ -0,0 +1,41 @@
+/*
+* Copyright 2025 Ingemar Hedvall
+* SPDX-License-Identifier: MIT
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <span>
+
+namespace bus {
+
+/** \brief Sends data and a file descriptor over a Unix domain socket.
+ *
+ * The descriptor is sent as ancillary data (SCM_RIGHTS) together with the
+ * first byte of the data. The receiver gets its own descriptor that refers
+ * to the same open file.
+ * @param socket Native handle of a connected Unix domain socket.
+ * @param data Data to send. Must not be empty.
+ * @param descriptor File descriptor to pass.
+ * @return Number of sent bytes or -1 on error (errno).
+ */
+[[nodiscard]] int64_t SendDescriptor(int socket,
+                                     std::span<const uint8_t> data,
+                                     int descriptor);
+
+/** \brief Receives data and an optional file descriptor.
+ *
+ * @param socket Native handle of a connected Unix domain socket.
+ * @param data Buffer for the data.
+ * @param descriptor Returns a received descriptor or -1. The caller owns
+ * the descriptor.
+ * @return Number of received bytes or -1 on error (errno).
+ */
+[[nodiscard]] int64_t ReceiveDescriptor(int socket, std::span<uint8_t> data,
+                                        int& descriptor);
+
+/** \brief Closes a descriptor that ReceiveDescriptor() returned. */
+void CloseDescriptor(int& descriptor);
+
+} // bus
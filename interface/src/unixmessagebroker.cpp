@@ -0,0 +1,57 @@
+/*
+* Copyright 2025 Ingemar Hedvall
+* SPDX-License-Identifier: MIT
+*/
+
+#include <filesystem>
+#include <stdexcept>
+
+#include "unixmessagebroker.h"
+#include "bus/buslogstream.h"
+
+using namespace boost::asio;
+
+namespace bus {
+
+UnixMessageBroker::~UnixMessageBroker() {
+  UnixMessageBroker::Stop();
+}
+
+void UnixMessageBroker::Stop() {
+  TcpMessageBroker::Stop();
+  RemoveSocketFile();
+}
+
+bool UnixMessageBroker::PassSegment() const {
+  return SegmentDescriptor() >= 0;
+}
+
+generic::stream_protocol::endpoint UnixMessageBroker::ListenEndpoint() const {
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+  if (Address().empty()) {
+    throw std::runtime_error("A socket path is required");
+  }
+  RemoveSocketFile();
+  return local::stream_protocol::endpoint(Address());
+#else
+  throw std::runtime_error("Unix domain sockets are not supported");
+#endif
+}
+
+void UnixMessageBroker::RemoveSocketFile() const {
+  if (Address().empty()) {
+    return;
+  }
+  try {
+    // Only remove sockets. The address may be a wrong path to a file.
+    const std::filesystem::path path(Address());
+    if (std::filesystem::is_socket(path)) {
+      std::filesystem::remove(path);
+    }
+  } catch (const std::exception& err) {
+    BUS_ERROR() << "Failed to remove the socket file. Path: " << Address()
+                << ", Error: " << err.what();
+  }
+}
+
+} // bus
@@ -0,0 +1,38 @@
+/*
+* Copyright 2025 Ingemar Hedvall
+* SPDX-License-Identifier: MIT
+*/
+
+#pragma once
+
+#include "tcpmessagebroker.h"
+
+namespace bus {
+
+/** \brief Shared memory broker with a Unix domain socket server.
+ *
+ * The broker uses the same framing and handshake as the TCP/IP broker but
+ * listens on a Unix domain socket. The Address() is the socket path. A
+ * stale socket file is removed when the broker starts and stops.
+ *
+ * Clients on the same host may request the shared memory in the
+ * handshake. The broker then passes the segment as a file descriptor and
+ * stops sending messages on that connection. The client reads the
+ * messages directly from the shared memory.
+ */
+class UnixMessageBroker : public TcpMessageBroker {
+ public:
+  ~UnixMessageBroker() override;
+
+  void Stop() override;
+  [[nodiscard]] bool PassSegment() const override;
+
+ protected:
+  [[nodiscard]] boost::asio::generic::stream_protocol::endpoint
+    ListenEndpoint() const override;
+
+ private:
+  void RemoveSocketFile() const;
+};
+
+} // bus
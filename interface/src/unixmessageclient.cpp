@@ -0,0 +1,45 @@
+/*
+* Copyright 2025 Ingemar Hedvall
+* SPDX-License-Identifier: MIT
+*/
+
+#include "unixmessageclient.h"
+#include "bus/buslogstream.h"
+
+using namespace boost::asio;
+
+namespace bus {
+
+UnixMessageClient::~UnixMessageClient() {
+  UnixMessageClient::Stop();
+}
+
+void UnixMessageClient::DoLookup() {
+  connected_ = false;
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+  try {
+    // No lookup is needed. The address is the socket path.
+    const local::stream_protocol::endpoint endpoint(Address());
+    socket_ = std::make_unique<generic::stream_protocol::socket>(context_);
+    endpoints_.clear();
+    endpoints_.emplace_back(endpoint);
+  } catch (const std::exception& err) {
+    BUS_ERROR() << "Invalid socket path. Path: " << Address()
+                << ", Error: " << err.what();
+    return;
+  }
+  DoConnect();
+#else
+  BUS_ERROR() << "Unix domain sockets are not supported. Path: " << Address();
+#endif
+}
+
+bool UnixMessageClient::PassSegment() const {
+#if defined(_WIN32)
+  return false;
+#else
+  return ZeroCopy();
+#endif
+}
+
+} // bus
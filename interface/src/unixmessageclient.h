@@ -0,0 +1,28 @@
+/*
+* Copyright 2025 Ingemar Hedvall
+* SPDX-License-Identifier: MIT
+*/
+
+#pragma once
+
+#include "tcpmessageclient.h"
+
+namespace bus {
+
+/** \brief Unix domain socket TX/RX client.
+ *
+ * The client connects to a UnixMessageBroker. The Address() is the
+ * socket path. If ZeroCopy() is set, the client maps the broker shared
+ * memory that the broker passes in the handshake and reads the messages
+ * from the shared memory instead of the socket.
+ */
+class UnixMessageClient : public TcpMessageClient {
+ public:
+  ~UnixMessageClient() override;
+
+ protected:
+  void DoLookup() override;
+  [[nodiscard]] bool PassSegment() const override;
+};
+
+} // bus
@@ -0,0 +1,24 @@
+# Copyright 2025 Ingemar Hedvall
+# SPDX-License-Identifier: MIT
+
+# Asio uses io_uring instead of epoll if BOOST_ASIO_HAS_IO_URING is defined.
+# The support requires Linux, Boost 1.78 or later and the liburing library.
+if (NOT URING_FOUND)
+    set(URING_FOUND OFF)
+    if (NOT CMAKE_SYSTEM_NAME STREQUAL "Linux")
+        message(WARNING "io_uring is only supported on Linux. Uses epoll.")
+    elseif (Boost_VERSION_STRING VERSION_LESS 1.78)
+        message(WARNING "io_uring requires Boost 1.78 or later. Uses epoll.")
+    else()
+        find_path(URING_INCLUDE_DIR liburing.h)
+        find_library(URING_LIBRARY uring)
+        if (URING_INCLUDE_DIR AND URING_LIBRARY)
+            set(URING_FOUND ON)
+        else()
+            message(WARNING "The liburing library is missing. Uses epoll.")
+        endif()
+    endif()
+    message(STATUS "liburing Found: " ${URING_FOUND})
+    message(STATUS "liburing Include Dirs: " ${URING_INCLUDE_DIR})
+    message(STATUS "liburing Libraries: " ${URING_LIBRARY})
+endif()
@@ -0,0 +1,89 @@
+/*
+* Copyright 2025 Ingemar Hedvall
+* SPDX-License-Identifier: MIT
+*/
+
+#include "bus/busmessageexecutor.h"
+
+#include <algorithm>
+
+#include "bus/buslogstream.h"
+
+namespace bus {
+
+BusMessageExecutor::BusMessageExecutor(size_t nof_workers, size_t max_tasks)
+  : max_tasks_(std::max(max_tasks, size_t{1})) {
+  nof_workers = std::max(nof_workers, size_t{1});
+  workers_.reserve(nof_workers);
+  for (size_t worker = 0; worker < nof_workers; ++worker) {
+    workers_.emplace_back(&BusMessageExecutor::WorkerThread, this);
+  }
+}
+
+BusMessageExecutor::~BusMessageExecutor() {
+  Stop();
+}
+
+bool BusMessageExecutor::Post(Task task) {
+  if (!task) {
+    return false;
+  }
+  {
+    std::unique_lock task_lock(task_mutex_);
+    task_not_full_.wait(task_lock, [&] () -> bool {
+      return stop_workers_ || tasks_.size() < max_tasks_;
+    });
+    if (stop_workers_) {
+      return false;
+    }
+    tasks_.emplace_back(std::move(task));
+  }
+  task_not_empty_.notify_one();
+  return true;
+}
+
+size_t BusMessageExecutor::Size() const {
+  std::lock_guard task_lock(task_mutex_);
+  return tasks_.size();
+}
+
+void BusMessageExecutor::Stop() {
+  {
+    std::lock_guard task_lock(task_mutex_);
+    stop_workers_ = true;
+  }
+  task_not_empty_.notify_all();
+  task_not_full_.notify_all();
+  for (auto& worker : workers_) {
+    if (worker.joinable()) {
+      worker.join();
+    }
+  }
+}
+
+void BusMessageExecutor::WorkerThread() {
+  while (true) {
+    Task task;
+    {
+      std::unique_lock task_lock(task_mutex_);
+      task_not_empty_.wait(task_lock, [&] () -> bool {
+        return stop_workers_ || !tasks_.empty();
+      });
+      if (tasks_.empty()) {
+        break; // Stopped and drained
+      }
+      task = std::move(tasks_.front());
+      tasks_.pop_front();
+    }
+    task_not_full_.notify_one();
+    try {
+      task();
+    } catch (const std::exception& err) {
+      BUS_ERROR() << "Subscription callback error. Error: " << err.what();
+    } catch (...) {
+      BUS_ERROR() << "Subscription callback error. Error: Unknown exception";
+    }
+  }
+}
+
+}  // namespace bus
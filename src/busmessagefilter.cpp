@@ -0,0 +1,131 @@
+/*
+* Copyright 2025 Ingemar Hedvall
+* SPDX-License-Identifier: MIT
+*/
+
+#include "bus/busmessagefilter.h"
+
+#include <algorithm>
+
+#include "bus/candataframe.h"
+#include "bus/canframeview.h"
+#include "bus/littlebuffer.h"
+
+namespace {
+
+template <typename T>
+void Append(std::vector<uint8_t>& dest, T value) {
+  const bus::LittleBuffer<T> buffer(value);
+  dest.insert(dest.end(), buffer.cbegin(), buffer.cend());
+}
+
+/** \brief Reads a list of 16-bit values with a 16-bit count. */
+bool ReadList(std::span<const uint8_t> source, size_t& offset,
+              std::vector<uint16_t>& list) {
+  list.clear();
+  if (source.size() - offset < 2) {
+    return false;
+  }
+  const bus::LittleBuffer<uint16_t> count(source.data(), offset);
+  offset += 2;
+  if (count.value() > (source.size() - offset) / 2) {
+    return false;
+  }
+  for (uint16_t index = 0; index < count.value(); ++index) {
+    list.push_back(bus::LittleBuffer<uint16_t>(source.data(), offset).value());
+    offset += 2;
+  }
+  return true;
+}
+
+} // end namespace
+
+namespace bus {
+
+void BusMessageFilter::AddBusChannel(uint16_t channel) {
+  if (std::ranges::find(channels_, channel) == channels_.end()) {
+    channels_.push_back(channel);
+  }
+}
+
+void BusMessageFilter::AddType(BusMessageType type) {
+  if (std::ranges::find(types_, type) == types_.end()) {
+    types_.push_back(type);
+  }
+}
+
+void BusMessageFilter::Clear() {
+  channels_.clear();
+  types_.clear();
+  can_ids_.Clear();
+}
+
+bool BusMessageFilter::Empty() const {
+  return channels_.empty() && types_.empty() && can_ids_.Empty();
+}
+
+void BusMessageFilter::ToRaw(std::vector<uint8_t>& dest) const {
+  dest.clear();
+  Append(dest, static_cast<uint16_t>(channels_.size()));
+  for (const uint16_t channel : channels_) {
+    Append(dest, channel);
+  }
+  Append(dest, static_cast<uint16_t>(types_.size()));
+  for (const auto type : types_) {
+    Append(dest, static_cast<uint16_t>(type));
+  }
+  can_ids_.ToRaw(dest);
+}
+
+bool BusMessageFilter::FromRaw(std::span<const uint8_t> source) {
+  Clear();
+  size_t offset = 0;
+  std::vector<uint16_t> types;
+  if (!ReadList(source, offset, channels_) ||
+      !ReadList(source, offset, types) ||
+      !can_ids_.FromRaw(source, offset)) {
+    Clear();
+    return false;
+  }
+  for (const uint16_t type : types) {
+    types_.push_back(static_cast<BusMessageType>(type));
+  }
+  return true;
+}
+
+bool BusMessageFilter::MatchHeader(BusMessageType type,
+                                   uint16_t channel) const {
+  if (!channels_.empty() && std::ranges::find(channels_, channel) ==
+      channels_.end()) {
+    return false;
+  }
+  if (!types_.empty() && std::ranges::find(types_, type) == types_.end()) {
+    return false;
+  }
+  return true;
+}
+
+bool BusMessageFilter::Match(const IBusMessage& message) const {
+  if (!MatchHeader(message.Type(), message.BusChannel())) {
+    return false;
+  }
+  if (can_ids_.Empty() || message.Type() != BusMessageType::CAN_DataFrame) {
+    return true;
+  }
+  const auto* frame = dynamic_cast<const CanDataFrame*>(&message);
+  return frame != nullptr && can_ids_.Match(frame->MessageId());
+}
+
+bool BusMessageFilter::Match(const BusMessageView& message) const {
+  if (!message.Valid() ||
+      !MatchHeader(message.Type(), message.BusChannel())) {
+    return false;
+  }
+  if (can_ids_.Empty() || message.Type() != BusMessageType::CAN_DataFrame) {
+    return true;
+  }
+  const CanFrameView frame(message.Raw());
+  return frame.Valid() && can_ids_.Match(frame.MessageId());
+}
+
+}  // namespace bus
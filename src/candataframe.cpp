@@ -4,12 +4,15 @@
  */
 #include "bus/candataframe.h"
 
+#include <algorithm>
 #include <array>
 #include <iomanip>
 #include <stdexcept>
 
+#include "bus/cancompactlayout.h"
 #include "bus/littlebuffer.h"
 #include "bus/buslogstream.h"
+#include "bus/varint.h"
 
 namespace {
 
@@ -115,7 +118,7 @@ void CanDataFrame::DataBytes(const std::vector<uint8_t>& data) {
   for (size_t index = 0; index < data.size() && index < data_bytes_.size(); ++index) {
     data_bytes_[index] = data[index];
   }
-  Size(kCanDataFrameSize + data_bytes_.size());
+  Size(RawSize());
 }
 
 const std::vector<uint8_t>& CanDataFrame::DataBytes() const {
@@ -230,9 +233,37 @@ size_t CanDataFrame::DlcToLength(uint8_t dlc) {
   return dlc < kDataLengthCode.size() ? kDataLengthCode[dlc] : 0;
 }
 
+uint32_t CanDataFrame::CompactOptions() const {
+  uint32_t options = 0;
+  options |= crc_ != 0 ? kOptionCrc : 0;
+  options |= frame_duration_ != 0 ? kOptionDuration : 0;
+  options |= Srr() ? kOptionSrr : 0;
+  options |= Esi() ? kOptionEsi : 0;
+  options |= Rtr() ? kOptionRtr : 0;
+  options |= R0() ? kOptionR0 : 0;
+  options |= R1() ? kOptionR1 : 0;
+  options |= WakeUp() ? kOptionWakeUp : 0;
+  options |= SingleWire() ? kOptionSingleWire : 0;
+  return options;
+}
+
+uint32_t CanDataFrame::RawSize() const {
+  if (Version() != kCompactVersion) {
+    return static_cast<uint32_t>(kCanDataFrameSize + data_bytes_.size());
+  }
+  size_t size = 19 + VarintSize((CanId() << 1) | (ExtendedId() ? 1 : 0));
+  if (const uint32_t options = CompactOptions(); options != 0) {
+    size += VarintSize(options);
+    size += (options & kOptionCrc) != 0 ? VarintSize(crc_) : 0;
+    size += (options & kOptionDuration) != 0
+        ? VarintSize(frame_duration_) : 0;
+  }
+  return static_cast<uint32_t>(size + data_bytes_.size());
+}
+
 void CanDataFrame::ToRaw(std::vector<uint8_t>& dest) const {
   Valid(true);
-  Size(kCanDataFrameSize + DataLength());
+  Size(RawSize());
   IBusMessage::ToRaw(dest);
   if (dest.size() != Size() || !Valid()) {
     BUS_ERROR() << "Allocation or size mismatch. Size: " << Size() << "/"
@@ -240,6 +271,10 @@ void CanDataFrame::ToRaw(std::vector<uint8_t>& dest) const {
     Valid(false);
     return;
   }
+  if (Version() == kCompactVersion) {
+    CompactToRaw(dest);
+    return;
+  }
 
   LittleBuffer<uint32_t> message_id(MessageId());
   std::copy_n(message_id.cbegin(), message_id.size(), dest.begin() + 18);
@@ -260,7 +295,7 @@ void CanDataFrame::ToRaw(std::vector<uint8_t>& dest) const {
   dest[28] |= (R1() ? 0x01 : 0x00) << 7;
 
   dest[29] = WakeUp() ? 0x01 : 0x00;
-  dest[29] |= (SingleWire() ? 0x01 : 0x00) << 8;
+  dest[29] |= (SingleWire() ? 0x01 : 0x00) << 1;
 
   LittleBuffer<uint32_t> frame_duration(FrameDuration());
   std::copy_n(frame_duration.cbegin(), frame_duration.size(),
@@ -272,55 +307,131 @@ void CanDataFrame::ToRaw(std::vector<uint8_t>& dest) const {
   }
 
 }
-void CanDataFrame::FromRaw(const std::vector<uint8_t>& source) {
-  try {
-    Size(source.size());
-    if (Size() < kCanDataFrameSize) {
-      std::ostringstream error;
-      error << "CAN Data Frame message is to small. Size :" << kCanDataFrameSize
-            << "/" << Size();
-      throw std::runtime_error(error.str());
-    }
-
-    // Parse the header
-    Valid(true);
-    IBusMessage::FromRaw(source);
+void CanDataFrame::CompactToRaw(std::vector<uint8_t>& dest) const {
+  const uint32_t options = CompactOptions();
+  dest[18] = Dlc() & kCompactDlcMask;
+  dest[18] |= Dir() ? kCompactDir : 0;
+  dest[18] |= Edl() ? kCompactEdl : 0;
+  dest[18] |= Brs() ? kCompactBrs : 0;
+  dest[18] |= options != 0 ? kCompactOptions : 0;
 
-    if (!Valid()) {
-      throw std::runtime_error("Message is not valid");
-    }
-
-    LittleBuffer<uint32_t> message_id(source, 18);
-    MessageId(message_id.value());
+  size_t offset = WriteVarint((CanId() << 1) | (ExtendedId() ? 1 : 0),
+                              dest, 19);
+  if (options != 0) {
+    offset = WriteVarint(options, dest, offset);
+  }
+  if ((options & kOptionCrc) != 0) {
+    offset = WriteVarint(crc_, dest, offset);
+  }
+  if ((options & kOptionDuration) != 0) {
+    offset = WriteVarint(frame_duration_, dest, offset);
+  }
+  std::ranges::copy(data_bytes_, dest.begin() + offset);
+}
 
-    Dlc(source[22]);
-    DataLength(source[23]);
+BusDecodeStatus CanDataFrame::Decode(std::span<const uint8_t> source) noexcept {
+  if (source.size() < kCompactMinSize) {
+    Valid(false);
+    return BusDecodeStatus::TooSmall;
+  }
 
-    LittleBuffer<uint32_t> crc(source, 24);
-    Crc(crc.value());
+  // Parse the header
+  if (const auto status = IBusMessage::Decode(source);
+      status != BusDecodeStatus::Ok) {
+    return status;
+  }
+  if (Version() == kCompactVersion) {
+    return DecodeCompact(source.first(Size()));
+  }
+  if (Size() < kCanDataFrameSize) {
+    Valid(false);
+    return BusDecodeStatus::TooSmall;
+  }
 
-    Dir(source[28] & 0x01 != 0);
-    Srr(source[28] & 0x02 != 0);
-    Edl(source[28] & 0x04 != 0);
-    Brs(source[28] & 0x08 != 0);
-    Esi(source[28] & 0x10 != 0);
-    Rtr(source[28] & 0x20 != 0);
-    R0(source[28] & 0x40 != 0);
-    R1(source[28] & 0x80 != 0);
+  const uint8_t data_length = source[23];
+  if (Size() < kCanDataFrameSize + data_length) {
+    Valid(false);
+    return BusDecodeStatus::InvalidData;
+  }
 
-    WakeUp(source[29] & 0x01 != 0);
-    SingleWire(source[29] & 0x02 != 0);
+  try {
+    data_bytes_.assign(source.begin() + kCanDataFrameSize,
+                       source.begin() + kCanDataFrameSize + data_length);
+  } catch (const std::exception&) {
+    Valid(false);
+    return BusDecodeStatus::AllocationError;
+  }
 
-    LittleBuffer<uint32_t> duration(source, 30);
-    FrameDuration(duration.value());
+  const LittleBuffer<uint32_t> message_id(source.data(), 18);
+  MessageId(message_id.value());
+  Dlc(source[22]);
+
+  const LittleBuffer<uint32_t> crc(source.data(), 24);
+  crc_ = crc.value();
+
+  Dir((source[28] & 0x01) != 0);
+  Srr((source[28] & 0x02) != 0);
+  Edl((source[28] & 0x04) != 0);
+  Brs((source[28] & 0x08) != 0);
+  Esi((source[28] & 0x10) != 0);
+  Rtr((source[28] & 0x20) != 0);
+  R0((source[28] & 0x40) != 0);
+  R1((source[28] & 0x80) != 0);
+
+  WakeUp((source[29] & 0x01) != 0);
+  SingleWire((source[29] & 0x02) != 0);
+
+  const LittleBuffer<uint32_t> duration(source.data(), 30);
+  frame_duration_ = duration.value();
+  return BusDecodeStatus::Ok;
+}
+
+BusDecodeStatus CanDataFrame::DecodeCompact(
+    std::span<const uint8_t> source) noexcept {
+  uint32_t id = 0;
+  uint32_t options = 0;
+  uint32_t crc = 0;
+  uint32_t duration = 0;
+  size_t offset = ReadVarint(source, 19, id);
+  if (offset > 0 && (source[18] & kCompactOptions) != 0) {
+    offset = ReadVarint(source, offset, options);
+  }
+  if (offset > 0 && (options & kOptionCrc) != 0) {
+    offset = ReadVarint(source, offset, crc);
+  }
+  if (offset > 0 && (options & kOptionDuration) != 0) {
+    offset = ReadVarint(source, offset, duration);
+  }
+  if (offset == 0 || source.size() - offset > DlcToLength(kCompactDlcMask)) {
+    Valid(false);
+    return BusDecodeStatus::InvalidData;
+  }
 
-    data_bytes_.resize(DataLength());
-    std::copy_n(source.cbegin() + 34, DataLength(), data_bytes_.begin());
-  } catch (const std::exception& err) {
-    BUS_ERROR() << "Deserialization error. Error: " << err.what();
+  try {
+    data_bytes_.assign(source.begin() + offset, source.end());
+  } catch (const std::exception&) {
     Valid(false);
+    return BusDecodeStatus::AllocationError;
   }
+
+  message_id_ = (id >> 1) | ((id & 0x01) != 0 ? kExtendedBit : 0);
+  Dlc(source[18] & kCompactDlcMask);
+  crc_ = crc;
+  frame_duration_ = duration;
+  flags_.reset();
+  Dir((source[18] & kCompactDir) != 0);
+  Edl((source[18] & kCompactEdl) != 0);
+  Brs((source[18] & kCompactBrs) != 0);
+  Srr((options & kOptionSrr) != 0);
+  Esi((options & kOptionEsi) != 0);
+  Rtr((options & kOptionRtr) != 0);
+  R0((options & kOptionR0) != 0);
+  R1((options & kOptionR1) != 0);
+  WakeUp((options & kOptionWakeUp) != 0);
+  SingleWire((options & kOptionSingleWire) != 0);
+  return BusDecodeStatus::Ok;
 }
+
 std::string CanDataFrame::ToString(uint64_t loglevel) const {
 
   switch (loglevel) {
@@ -0,0 +1,285 @@
+/*
+* Copyright 2025 Ingemar Hedvall
+* SPDX-License-Identifier: MIT
+*/
+
+#include "bus/canidfilter.h"
+
+#include <algorithm>
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+#include "bus/canframeview.h"
+#include "bus/ibusmessage.h"
+#include "bus/littlebuffer.h"
+
+namespace {
+
+constexpr size_t kMessageIdOffset = 18;
+constexpr size_t kCanDataFrameSize = 34;
+constexpr size_t kMinFrameSize = 20; ///< Compact layout minimum size.
+constexpr size_t kMaxChunk = 64; ///< IDs tested for each MatchMask() call.
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+// SIMD only have signed compares. Flipping the sign bit makes the signed
+// compare behave as an unsigned compare.
+constexpr uint32_t kSignBit = 0x80000000;
+#endif
+
+}  // namespace
+
+namespace bus {
+
+void CanIdFilter::AddId(uint32_t message_id) {
+  if (message_id < kNofStandardIds) {
+    standard_ids_[message_id / 32] |= 1U << (message_id % 32);
+    has_standard_ids_ = true;
+  } else {
+    AddRange(message_id, message_id);
+  }
+}
+
+void CanIdFilter::AddRange(uint32_t first, uint32_t last) {
+  if (first > last) {
+    std::swap(first, last);
+  }
+  if (last < kNofStandardIds) {
+    for (uint32_t id = first; id <= last; ++id) {
+      AddId(id);
+    }
+    return;
+  }
+  first_ids_.push_back(first);
+  last_ids_.push_back(last);
+}
+
+void CanIdFilter::Clear() {
+  standard_ids_.fill(0);
+  has_standard_ids_ = false;
+  first_ids_.clear();
+  last_ids_.clear();
+}
+
+bool CanIdFilter::Empty() const {
+  return !has_standard_ids_ && first_ids_.empty();
+}
+
+bool CanIdFilter::Match(uint32_t message_id) const noexcept {
+  if (message_id < kNofStandardIds &&
+      (standard_ids_[message_id / 32] & (1U << (message_id % 32))) != 0) {
+    return true;
+  }
+  for (size_t range = 0; range < first_ids_.size(); ++range) {
+    if (message_id >= first_ids_[range] && message_id <= last_ids_[range]) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void CanIdFilter::ToRaw(std::vector<uint8_t>& dest) const {
+  dest.push_back(has_standard_ids_ ? 1 : 0);
+  if (has_standard_ids_) {
+    for (const uint32_t word : standard_ids_) {
+      const LittleBuffer<uint32_t> value(word);
+      dest.insert(dest.end(), value.cbegin(), value.cend());
+    }
+  }
+  const LittleBuffer<uint32_t> nof_ranges(
+      static_cast<uint32_t>(first_ids_.size()));
+  dest.insert(dest.end(), nof_ranges.cbegin(), nof_ranges.cend());
+  for (size_t range = 0; range < first_ids_.size(); ++range) {
+    const LittleBuffer<uint32_t> first(first_ids_[range]);
+    const LittleBuffer<uint32_t> last(last_ids_[range]);
+    dest.insert(dest.end(), first.cbegin(), first.cend());
+    dest.insert(dest.end(), last.cbegin(), last.cend());
+  }
+}
+
+bool CanIdFilter::FromRaw(std::span<const uint8_t> source, size_t& offset) {
+  Clear();
+  if (offset >= source.size()) {
+    return false;
+  }
+  has_standard_ids_ = source[offset++] != 0;
+  if (has_standard_ids_) {
+    if (source.size() - offset < standard_ids_.size() * 4) {
+      return false;
+    }
+    for (auto& word : standard_ids_) {
+      word = LittleBuffer<uint32_t>(source.data(), offset).value();
+      offset += 4;
+    }
+  }
+  if (source.size() - offset < 4) {
+    return false;
+  }
+  const LittleBuffer<uint32_t> nof_ranges(source.data(), offset);
+  offset += 4;
+  if (nof_ranges.value() > (source.size() - offset) / 8) {
+    return false;
+  }
+  for (uint32_t range = 0; range < nof_ranges.value(); ++range) {
+    first_ids_.push_back(LittleBuffer<uint32_t>(source.data(), offset).value());
+    last_ids_.push_back(
+        LittleBuffer<uint32_t>(source.data(), offset + 4).value());
+    offset += 8;
+  }
+  return true;
+}
+
+uint64_t CanIdFilter::MatchMask(
+    std::span<const uint32_t> message_ids) const noexcept {
+  const size_t count = std::min(message_ids.size(), kMaxChunk);
+  uint64_t mask = 0;
+  size_t index = 0;
+
+#if defined(__AVX2__)
+  const __m256i sign = _mm256_set1_epi32(static_cast<int>(kSignBit));
+  const __m256i ones = _mm256_set1_epi32(-1);
+  const __m256i one = _mm256_set1_epi32(1);
+  const __m256i max_standard =
+      _mm256_set1_epi32(static_cast<int>(kNofStandardIds ^ kSignBit));
+  for (; index + 8 <= count; index += 8) {
+    const __m256i ids = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(message_ids.data() + index));
+    const __m256i biased = _mm256_xor_si256(ids, sign);
+    __m256i match = _mm256_setzero_si256();
+
+    if (has_standard_ids_) {
+      // Gather the bitmap words and test the ID bit in each lane.
+      const __m256i is_standard = _mm256_cmpgt_epi32(max_standard, biased);
+      const __m256i word_index =
+          _mm256_srli_epi32(_mm256_and_si256(ids, _mm256_set1_epi32(0x7FF)), 5);
+      const __m256i words = _mm256_i32gather_epi32(
+          reinterpret_cast<const int*>(standard_ids_.data()), word_index, 4);
+      const __m256i bit = _mm256_and_si256(ids, _mm256_set1_epi32(31));
+      const __m256i bit_set = _mm256_cmpeq_epi32(
+          _mm256_and_si256(_mm256_srlv_epi32(words, bit), one), one);
+      match = _mm256_and_si256(is_standard, bit_set);
+    }
+
+    for (size_t range = 0; range < first_ids_.size(); ++range) {
+      const __m256i first = _mm256_set1_epi32(
+          static_cast<int>(first_ids_[range] ^ kSignBit));
+      const __m256i last = _mm256_set1_epi32(
+          static_cast<int>(last_ids_[range] ^ kSignBit));
+      const __m256i above_last = _mm256_cmpgt_epi32(biased, last);
+      const __m256i below_first = _mm256_cmpgt_epi32(first, biased);
+      const __m256i in_range = _mm256_andnot_si256(
+          below_first, _mm256_andnot_si256(above_last, ones));
+      match = _mm256_or_si256(match, in_range);
+    }
+    const auto bits = static_cast<uint32_t>(
+        _mm256_movemask_ps(_mm256_castsi256_ps(match)));
+    mask |= static_cast<uint64_t>(bits) << index;
+  }
+#elif defined(__SSE2__) || defined(_M_X64)
+  if (!first_ids_.empty()) {
+    const __m128i sign = _mm_set1_epi32(static_cast<int>(kSignBit));
+    const __m128i ones = _mm_set1_epi32(-1);
+    for (; index + 4 <= count; index += 4) {
+      const __m128i ids = _mm_loadu_si128(
+          reinterpret_cast<const __m128i*>(message_ids.data() + index));
+      const __m128i biased = _mm_xor_si128(ids, sign);
+      __m128i match = _mm_setzero_si128();
+      for (size_t range = 0; range < first_ids_.size(); ++range) {
+        const __m128i first =
+            _mm_set1_epi32(static_cast<int>(first_ids_[range] ^ kSignBit));
+        const __m128i last =
+            _mm_set1_epi32(static_cast<int>(last_ids_[range] ^ kSignBit));
+        const __m128i above_last = _mm_cmpgt_epi32(biased, last);
+        const __m128i below_first = _mm_cmpgt_epi32(first, biased);
+        const __m128i in_range = _mm_andnot_si128(
+            below_first, _mm_andnot_si128(above_last, ones));
+        match = _mm_or_si128(match, in_range);
+      }
+      auto bits = static_cast<uint32_t>(
+          _mm_movemask_ps(_mm_castsi128_ps(match)));
+      // SSE2 have no gather so the bitmap is tested lane by lane.
+      for (size_t lane = 0; has_standard_ids_ && lane < 4; ++lane) {
+        const uint32_t id = message_ids[index + lane];
+        if (id < kNofStandardIds &&
+            (standard_ids_[id / 32] & (1U << (id % 32))) != 0) {
+          bits |= 1U << lane;
+        }
+      }
+      mask |= static_cast<uint64_t>(bits) << index;
+    }
+  }
+#endif
+
+  for (; index < count; ++index) {
+    if (Match(message_ids[index])) {
+      mask |= uint64_t{1} << index;
+    }
+  }
+  return mask;
+}
+
+size_t CanIdFilter::Scan(std::span<const uint8_t> batch,
+                         std::vector<size_t>& matches) const {
+  matches.clear();
+  std::array<uint32_t, kMaxChunk> ids = {};
+  std::array<size_t, kMaxChunk> offsets = {};
+  size_t nof_ids = 0;
+
+  const auto flush = [&]() -> void {
+    uint64_t mask = MatchMask(std::span<const uint32_t>(ids.data(), nof_ids));
+    for (size_t index = 0; mask != 0; ++index, mask >>= 1) {
+      if ((mask & 1) != 0) {
+        matches.push_back(offsets[index]);
+      }
+    }
+    nof_ids = 0;
+  };
+
+  // Gather the message IDs of all CAN frames. The message walk is serial
+  // as each message has its own length, while the ID test is done on
+  // chunks of IDs.
+  size_t offset = 0;
+  while (offset + 4 <= batch.size()) {
+    const LittleBuffer<uint32_t> length(batch.data(), offset);
+    const size_t message_offset = offset + 4;
+    if (length.value() == 0 ||
+        length.value() > batch.size() - message_offset) {
+      break;
+    }
+    offset = message_offset + length.value();
+
+    if (length.value() < kMinFrameSize) {
+      continue;
+    }
+    const LittleBuffer<uint16_t> type(batch.data(), message_offset);
+    if (static_cast<BusMessageType>(type.value()) !=
+        BusMessageType::CAN_DataFrame) {
+      continue;
+    }
+    const LittleBuffer<uint16_t> version(batch.data(), message_offset + 2);
+    if (version.value() == 0) {
+      if (length.value() < kCanDataFrameSize) {
+        continue;
+      }
+      const LittleBuffer<uint32_t> message_id(
+          batch.data(), message_offset + kMessageIdOffset);
+      ids[nof_ids] = message_id.value();
+    } else {
+      // Compact layout
+      const CanFrameView frame(batch.subspan(message_offset, length.value()));
+      if (!frame.Valid()) {
+        continue;
+      }
+      ids[nof_ids] = frame.MessageId();
+    }
+    offsets[nof_ids] = message_offset;
+    if (++nof_ids == kMaxChunk) {
+      flush();
+    }
+  }
+  flush();
+  return matches.size();
+}
+
+}  // namespace bus
@@ -0,0 +1,166 @@
+/*
+* Copyright 2025 Ingemar Hedvall
+* SPDX-License-Identifier: MIT
+*/
+#include "bus/ethernetframe.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+#include "bus/littlebuffer.h"
+#include "bus/buslogstream.h"
+
+namespace {
+
+constexpr uint32_t kEthernetFrameSize = 30;
+constexpr size_t kMacSize = 6;
+constexpr uint16_t kVlanTag = 0x8100;
+
+uint16_t BigEndian16(std::span<const uint8_t> data, size_t offset) {
+  return static_cast<uint16_t>((data[offset] << 8) | data[offset + 1]);
+}
+
+} // end namespace
+
+namespace bus {
+
+EthernetFrame::EthernetFrame() : IBusMessage(BusMessageType::ETH_Frame) {
+  Size(kEthernetFrameSize);
+}
+
+uint64_t EthernetFrame::MacAt(size_t offset) const {
+  const auto data = DataBytes();
+  if (data.size() < offset + kMacSize) {
+    return 0;
+  }
+  uint64_t mac = 0;
+  for (size_t index = 0; index < kMacSize; ++index) {
+    mac = (mac << 8) | data[offset + index];
+  }
+  return mac;
+}
+
+uint64_t EthernetFrame::Destination() const {
+  return MacAt(0);
+}
+
+uint64_t EthernetFrame::Source() const {
+  return MacAt(kMacSize);
+}
+
+uint16_t EthernetFrame::EtherType() const {
+  const auto data = DataBytes();
+  constexpr size_t kTypeOffset = 2 * kMacSize;
+  if (data.size() < kTypeOffset + 2) {
+    return 0;
+  }
+  const uint16_t type = BigEndian16(data, kTypeOffset);
+  if (type == kVlanTag && data.size() >= kTypeOffset + 6) {
+    return BigEndian16(data, kTypeOffset + 4);
+  }
+  return type;
+}
+
+void EthernetFrame::FrameDuration(uint32_t duration) {
+  frame_duration_ = duration;
+}
+
+uint32_t EthernetFrame::FrameDuration() const {
+  return frame_duration_;
+}
+
+uint8_t* EthernetFrame::Data(size_t length) {
+  if (length <= kInlineLength) {
+    return inline_bytes_.data();
+  }
+  jumbo_bytes_.resize(length); // Keeps the capacity of earlier frames.
+  return jumbo_bytes_.data();
+}
+
+void EthernetFrame::DataBytes(std::span<const uint8_t> data) {
+  const size_t length = std::min(data.size(), kMaxDataLength);
+  std::copy_n(data.begin(), length, Data(length));
+  data_length_ = static_cast<uint16_t>(length);
+  Size(static_cast<uint32_t>(kEthernetFrameSize + data_length_));
+}
+
+std::span<const uint8_t> EthernetFrame::DataBytes() const {
+  if (data_length_ <= kInlineLength) {
+    return {inline_bytes_.data(), data_length_};
+  }
+  return {jumbo_bytes_.data(), data_length_};
+}
+
+void EthernetFrame::ToRaw(std::vector<uint8_t>& dest) const {
+  Valid(true);
+  Size(static_cast<uint32_t>(kEthernetFrameSize + data_length_));
+  IBusMessage::ToRaw(dest);
+  if (dest.size() != Size() || !Valid()) {
+    BUS_ERROR() << "Allocation or size mismatch. Size: " << Size() << "/"
+                << dest.size();
+    Valid(false);
+    return;
+  }
+
+  dest[18] = dir_ ? 0x01 : 0x00;
+  dest[18] |= (crc_valid_ ? 0x01 : 0x00) << 1;
+  dest[19] = 0;
+  LittleBuffer<uint16_t> data_length(data_length_);
+  std::copy_n(data_length.cbegin(), data_length.size(), dest.begin() + 20);
+  LittleBuffer<uint32_t> crc(crc_);
+  std::copy_n(crc.cbegin(), crc.size(), dest.begin() + 22);
+  LittleBuffer<uint32_t> frame_duration(frame_duration_);
+  std::copy_n(frame_duration.cbegin(), frame_duration.size(),
+              dest.begin() + 26);
+  std::ranges::copy(DataBytes(), dest.begin() + kEthernetFrameSize);
+}
+
+BusDecodeStatus EthernetFrame::Decode(
+    std::span<const uint8_t> source) noexcept {
+  if (source.size() < kEthernetFrameSize) {
+    Valid(false);
+    return BusDecodeStatus::TooSmall;
+  }
+
+  if (const auto status = IBusMessage::Decode(source);
+      status != BusDecodeStatus::Ok) {
+    return status;
+  }
+
+  const LittleBuffer<uint16_t> data_length(source.data(), 20);
+  const size_t length = data_length.value();
+  if (length > kMaxDataLength || Size() < kEthernetFrameSize + length) {
+    Valid(false);
+    return BusDecodeStatus::InvalidData;
+  }
+
+  try {
+    std::copy_n(source.begin() + kEthernetFrameSize, length, Data(length));
+  } catch (const std::exception&) {
+    Valid(false);
+    return BusDecodeStatus::AllocationError;
+  }
+  data_length_ = static_cast<uint16_t>(length);
+
+  dir_ = (source[18] & 0x01) != 0;
+  crc_valid_ = (source[18] & 0x02) != 0;
+  const LittleBuffer<uint32_t> crc(source.data(), 22);
+  crc_ = crc.value();
+  const LittleBuffer<uint32_t> duration(source.data(), 26);
+  frame_duration_ = duration.value();
+  return BusDecodeStatus::Ok;
+}
+
+std::string EthernetFrame::ToString(uint64_t loglevel) const {
+  if (loglevel > 1) {
+    return {};
+  }
+  std::ostringstream ss;
+  ss << "Type: EthernetFrame, EtherType: " << std::hex << std::setw(4)
+     << std::setfill('0') << EtherType() << std::dec
+     << ", Length: " << data_length_;
+  return ss.str();
+}
+
+}  // namespace bus
@@ -0,0 +1,124 @@
+/*
+* Copyright 2025 Ingemar Hedvall
+* SPDX-License-Identifier: MIT
+*/
+#include "bus/flexrayframe.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+#include "bus/littlebuffer.h"
+#include "bus/buslogstream.h"
+
+namespace {
+
+constexpr uint32_t kFlexRayFrameSize = 34;
+
+} // end namespace
+
+namespace bus {
+
+FlexRayFrame::FlexRayFrame() : IBusMessage(BusMessageType::FlexRay_Frame) {
+  Size(kFlexRayFrameSize);
+}
+
+void FlexRayFrame::FrameDuration(uint32_t duration) {
+  frame_duration_ = duration;
+}
+
+uint32_t FlexRayFrame::FrameDuration() const {
+  return frame_duration_;
+}
+
+void FlexRayFrame::DataBytes(std::span<const uint8_t> data) {
+  data_length_ = static_cast<uint8_t>(std::min(data.size(), kMaxDataLength));
+  std::copy_n(data.begin(), data_length_, data_bytes_.begin());
+  Size(kFlexRayFrameSize + data_length_);
+}
+
+std::span<const uint8_t> FlexRayFrame::DataBytes() const {
+  return {data_bytes_.data(), data_length_};
+}
+
+void FlexRayFrame::ToRaw(std::vector<uint8_t>& dest) const {
+  Valid(true);
+  Size(kFlexRayFrameSize + data_length_);
+  IBusMessage::ToRaw(dest);
+  if (dest.size() != Size() || !Valid()) {
+    BUS_ERROR() << "Allocation or size mismatch. Size: " << Size() << "/"
+                << dest.size();
+    Valid(false);
+    return;
+  }
+
+  LittleBuffer<uint16_t> frame_id(frame_id_);
+  std::copy_n(frame_id.cbegin(), frame_id.size(), dest.begin() + 18);
+  dest[20] = cycle_;
+  dest[21] = static_cast<uint8_t>(channel_);
+  dest[22] = flags_;
+  dest[23] = data_length_;
+
+  LittleBuffer<uint16_t> header_crc(header_crc_);
+  std::copy_n(header_crc.cbegin(), header_crc.size(), dest.begin() + 24);
+  LittleBuffer<uint32_t> crc(crc_);
+  std::copy_n(crc.cbegin(), crc.size(), dest.begin() + 26);
+  LittleBuffer<uint32_t> frame_duration(frame_duration_);
+  std::copy_n(frame_duration.cbegin(), frame_duration.size(),
+              dest.begin() + 30);
+  std::copy_n(data_bytes_.cbegin(), data_length_,
+              dest.begin() + kFlexRayFrameSize);
+}
+
+BusDecodeStatus FlexRayFrame::Decode(
+    std::span<const uint8_t> source) noexcept {
+  if (source.size() < kFlexRayFrameSize) {
+    Valid(false);
+    return BusDecodeStatus::TooSmall;
+  }
+
+  if (const auto status = IBusMessage::Decode(source);
+      status != BusDecodeStatus::Ok) {
+    return status;
+  }
+
+  const uint8_t data_length = source[23];
+  if (data_length > kMaxDataLength ||
+      Size() < kFlexRayFrameSize + data_length) {
+    Valid(false);
+    return BusDecodeStatus::InvalidData;
+  }
+  data_length_ = data_length;
+  std::copy_n(source.begin() + kFlexRayFrameSize, data_length_,
+              data_bytes_.begin());
+
+  const LittleBuffer<uint16_t> frame_id(source.data(), 18);
+  frame_id_ = frame_id.value();
+  cycle_ = source[20];
+  channel_ = static_cast<FlexRayChannel>(source[21]);
+  flags_ = source[22];
+
+  const LittleBuffer<uint16_t> header_crc(source.data(), 24);
+  header_crc_ = header_crc.value();
+  const LittleBuffer<uint32_t> crc(source.data(), 26);
+  crc_ = crc.value();
+  const LittleBuffer<uint32_t> duration(source.data(), 30);
+  frame_duration_ = duration.value();
+  return BusDecodeStatus::Ok;
+}
+
+std::string FlexRayFrame::ToString(uint64_t loglevel) const {
+  if (loglevel > 1) {
+    return {};
+  }
+  std::ostringstream ss;
+  ss << "Type: FlexRayFrame, FrameId: " << frame_id_
+     << ", Cycle: " << static_cast<int>(cycle_) << ", Data: ";
+  for (const uint8_t data_byte : DataBytes()) {
+    ss << std::hex << std::setw(2) << std::setfill('0')
+       << static_cast<int>(data_byte) << " ";
+  }
+  return ss.str();
+}
+
+}  // namespace bus
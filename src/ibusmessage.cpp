@@ -5,29 +5,83 @@
 #include "bus/ibusmessage.h"
 
 #include <algorithm>
+#include <array>
 #include <stdexcept>
 
 #include "bus/littlebuffer.h"
 #include "bus/buslogstream.h"
 #include "bus/candataframe.h"
+#include "bus/ethernetframe.h"
+#include "bus/flexrayframe.h"
+#include "bus/linframe.h"
+#include "bus/mostmessage.h"
+
+namespace {
+
+constexpr size_t kMaxFactories = 256;
+
+template <typename T>
+std::shared_ptr<bus::IBusMessage> MakeMessage() {
+  return std::make_shared<T>();
+}
+
+/** \brief Factory table indexed by the message type. */
+class FactoryList {
+ public:
+  FactoryList() {
+    for (auto& factory : list_) {
+      factory = nullptr;
+    }
+    Add(bus::BusMessageType::CAN_DataFrame, &MakeMessage<bus::CanDataFrame>);
+    Add(bus::BusMessageType::LIN_Frame, &MakeMessage<bus::LinFrame>);
+    Add(bus::BusMessageType::FlexRay_Frame, &MakeMessage<bus::FlexRayFrame>);
+    Add(bus::BusMessageType::MOST_Message, &MakeMessage<bus::MostMessage>);
+    Add(bus::BusMessageType::ETH_Frame, &MakeMessage<bus::EthernetFrame>);
+  }
+
+  std::atomic<bus::IBusMessage::MessageFactory>& operator[](size_t index) {
+    return list_[index];
+  }
+
+ private:
+  std::array<std::atomic<bus::IBusMessage::MessageFactory>,
+             kMaxFactories> list_;
+
+  void Add(bus::BusMessageType type, bus::IBusMessage::MessageFactory factory) {
+    list_[static_cast<size_t>(type)] = factory;
+  }
+};
+
+FactoryList& Factories() {
+  static FactoryList factories;
+  return factories;
+}
+
+} // end namespace
 
 namespace bus {
 
 IBusMessage::IBusMessage(BusMessageType type) : type_(type) {}
 
 std::shared_ptr<IBusMessage> IBusMessage::Create(BusMessageType type) {
-  std::shared_ptr<IBusMessage> message;
-  switch (type) {
-    case BusMessageType::CAN_DataFrame:
-      message = std::make_shared<CanDataFrame>();
-      break;
-
-    case BusMessageType::Unknown:
-    default:
-      message = std::make_shared<IBusMessage>(type);
-      break;
+  const auto index = static_cast<size_t>(type);
+  if (index < kMaxFactories) {
+    if (const auto factory = Factories()[index].load(
+          std::memory_order_acquire);
+        factory != nullptr) {
+      return factory();
+    }
+  }
+  return std::make_shared<IBusMessage>(type);
+}
+
+bool IBusMessage::Register(BusMessageType type, MessageFactory factory) {
+  const auto index = static_cast<size_t>(type);
+  if (index >= kMaxFactories || type == BusMessageType::Unknown) {
+    return false;
   }
-  return message;
+  Factories()[index].store(factory, std::memory_order_release);
+  return true;
 }
 
 void IBusMessage::ToRaw(std::vector<uint8_t>& dest) const {
@@ -43,7 +97,7 @@ void IBusMessage::ToRaw(std::vector<uint8_t>& dest) const {
     LittleBuffer version(version_);
     LittleBuffer length(Size());
     LittleBuffer timestamp(timestamp_);
-    LittleBuffer channel(bus_channel_);
+    LittleBuffer<uint16_t> channel(bus_channel_);
 
     std::copy_n(type.cbegin(), type.size(), dest.begin());
     std::copy_n(version.cbegin(), version.size(), dest.begin() + 2);
@@ -57,28 +111,38 @@ void IBusMessage::ToRaw(std::vector<uint8_t>& dest) const {
 }
 
 void IBusMessage::FromRaw(const std::vector<uint8_t>& source) {
-  try {
-    if (source.size() < 18) {
-      throw std::runtime_error("The input array is to small");
-    }
-
-    LittleBuffer<uint16_t> type(source, 0);
-    LittleBuffer<uint16_t> version(source, 2);
-    LittleBuffer<uint32_t> length(source, 4);
-    LittleBuffer<uint64_t> timestamp(source, 8);
-    LittleBuffer<uint16_t> channel(source, 16);
+  if (const auto status = Decode(source); status != BusDecodeStatus::Ok) {
+    BUS_ERROR() << "Message deserialization error. Status: "
+                << static_cast<int>(status) << ", Size: " << source.size();
+  }
+}
 
-    type_ = static_cast<BusMessageType>(type.value());
-    version_ = version.value();
-    size_ = length.value();
-    timestamp_ = timestamp.value();
-    bus_channel_ = channel.value();
+BusDecodeStatus IBusMessage::Decode(std::span<const uint8_t> source) noexcept {
+  if (source.size() < 18) {
+    Valid(false);
+    return BusDecodeStatus::TooSmall;
+  }
 
-  } catch (const std::exception& err) {
-    BUS_ERROR() << "Message deserialization errror. Error: " << err.what();
+  const LittleBuffer<uint32_t> length(source.data(), 4);
+  if (length.value() < 18 || length.value() > source.size()) {
     Valid(false);
+    return BusDecodeStatus::LengthMismatch;
   }
+
+  const LittleBuffer<uint16_t> type(source.data(), 0);
+  const LittleBuffer<uint16_t> version(source.data(), 2);
+  const LittleBuffer<uint64_t> timestamp(source.data(), 8);
+  const LittleBuffer<uint16_t> channel(source.data(), 16);
+
+  type_ = static_cast<BusMessageType>(type.value());
+  version_ = version.value();
+  size_ = length.value();
+  timestamp_ = timestamp.value();
+  bus_channel_ = static_cast<uint8_t>(channel.value());
+  Valid(true);
+  return BusDecodeStatus::Ok;
 }
+
 std::string IBusMessage::ToString(uint64_t loglevel) const {
   std::ostringstream ss;
   ss << "Size: " << size_ << " Version: " << version_
@@ -35,6 +35,10 @@ bool IBusMessageBroker::IsConnected() const {
   return connected_;
 }
 
+std::vector<ConnectionStatistics> IBusMessageBroker::Connections() const {
+  return {};
+}
+
 std::shared_ptr<IBusMessageQueue> IBusMessageBroker::CreatePublisher() {
   auto publisher = std::make_shared<IBusMessageQueue>();
 
@@ -53,6 +57,61 @@ std::shared_ptr<IBusMessageQueue> IBusMessageBroker::CreateSubscriber() {
   return subscriber;
 }
 
+std::shared_ptr<IBusMessageQueue> IBusMessageBroker::CreateSubscriber(
+    const BusMessageFilter&) {
+  return CreateSubscriber();
+}
+
+std::shared_ptr<IBusMessageQueue> IBusMessageBroker::Subscribe(
+    BusMessageFilter filter, IBusMessageQueue::MessageCallback callback,
+    std::shared_ptr<BusMessageExecutor> executor) {
+  if (!callback) {
+    return {};
+  }
+  auto subscriber = CreateSubscriber(filter);
+  if (!subscriber) {
+    return {};
+  }
+  // Shared memory subscribers filter before the messages are copied.
+  // Otherwise the queue filters the serialized messages before decoding.
+  if (!filter.Empty() && !subscriber->HasFilter()) {
+    subscriber->Filter(filter);
+  }
+
+  if (executor) {
+    // The queued tasks may outlive the subscriber, so they share the
+    // callback.
+    auto task_callback = std::make_shared<const IBusMessageQueue::
+        MessageCallback>(std::move(callback));
+    subscriber->Callback(
+      [task_callback, executor = std::move(executor)]
+      (const std::shared_ptr<IBusMessage>& message) -> void {
+        if (message) {
+          executor->Post([task_callback, message] () -> void {
+            (*task_callback)(message);
+          });
+        }
+      });
+  } else {
+    subscriber->Callback(
+      [callback = std::move(callback)]
+      (const std::shared_ptr<IBusMessage>& message) -> void {
+        if (message) {
+          callback(message);
+        }
+      });
+  }
+  return subscriber;
+}
+
+std::shared_ptr<BusMessageExecutor> IBusMessageBroker::Executor() {
+  std::lock_guard queue_lock(queue_mutex_);
+  if (!executor_) {
+    executor_ = std::make_shared<BusMessageExecutor>();
+  }
+  return executor_;
+}
+
 void IBusMessageBroker::DetachPublisher(
     const std::shared_ptr<IBusMessageQueue>& publisher) {
   std::lock_guard queue_lock(queue_mutex_);
@@ -99,29 +158,40 @@ void IBusMessageBroker::Stop() {
   stop_thread_ = false;
 }
 
-void IBusMessageBroker::Poll(IBusMessageQueue& queue) const {
-  for (auto msg = queue.Pop(); msg && !stop_thread_;
-      msg = queue.Pop()) {
-    for (auto& subscriber : subscribers_) {
-      if (!subscriber) {
-        continue;
+void IBusMessageBroker::CopySubscribers(
+    std::vector<std::shared_ptr<IBusMessageQueue>>& list) const {
+  std::lock_guard queue_lock(queue_mutex_);
+  list.assign(subscribers_.begin(), subscribers_.end());
+}
+
+void IBusMessageBroker::Poll(IBusMessageQueue& queue,
+    std::span<const std::shared_ptr<IBusMessageQueue>> subscribers) const {
+  std::vector<std::shared_ptr<IBusMessage>> messages;
+  while (!stop_thread_ && queue.PopBatch(messages, 1'000) > 0) {
+    for (const auto& subscriber : subscribers) {
+      if (subscriber) {
+        subscriber->PushBatch(messages);
       }
-      auto copy = msg;
-      subscriber->Push(copy);
     }
+    messages.clear();
   }
 }
 
 void IBusMessageBroker::InprocessThread() const {
+  std::vector<std::shared_ptr<IBusMessageQueue>> publishers;
+  std::vector<std::shared_ptr<IBusMessageQueue>> subscribers;
   while (!stop_thread_) {
+    // The subscriber callbacks run without the queue mutex.
     {
       std::scoped_lock queue_lock(queue_mutex_);
-      for (auto& publisher : publishers_) {
-        if (stop_thread_ || !publisher) {
-          continue;
-        }
-        Poll(*publisher);
+      publishers.assign(publishers_.begin(), publishers_.end());
+      subscribers.assign(subscribers_.begin(), subscribers_.end());
+    }
+    for (const auto& publisher : publishers) {
+      if (stop_thread_ || !publisher) {
+        continue;
       }
+      Poll(*publisher, subscribers);
     }
     sleep_for( 10ms);
   }
@@ -3,15 +3,54 @@
 * SPDX-License-Identifier: MIT
 */
 #include <thread>
+#include <algorithm>
+#include <iterator>
+#include <optional>
 
 #include "bus/ibusmessagequeue.h"
 
 #include <queue>
 
 #include "bus/buslogstream.h"
+#include "bus/busmessageview.h"
+#include "bus/candataframe.h"
+#include "bus/flexrayframe.h"
+#include "bus/linframe.h"
+#include "bus/spinwait.h"
 
 #include "bus/littlebuffer.h"
 
+namespace {
+
+/** \brief Returns the key used by the LatestPerId policy.
+ *
+ * Only messages with a frame ID have a key. Other messages, as Ethernet
+ * and MOST messages, are never collapsed.
+ */
+std::optional<uint64_t> LatestKey(const bus::IBusMessage& message) {
+  uint64_t frame_id = 0;
+  switch (message.Type()) {
+    case bus::BusMessageType::CAN_DataFrame:
+      frame_id = static_cast<const bus::CanDataFrame&>(message).MessageId();
+      break;
+
+    case bus::BusMessageType::LIN_Frame:
+      frame_id = static_cast<const bus::LinFrame&>(message).FrameId();
+      break;
+
+    case bus::BusMessageType::FlexRay_Frame:
+      frame_id = static_cast<const bus::FlexRayFrame&>(message).FrameId();
+      break;
+
+    default:
+      return std::nullopt;
+  }
+  return (static_cast<uint64_t>(message.Type()) << 48) |
+         (static_cast<uint64_t>(message.BusChannel()) << 32) | frame_id;
+}
+
+} // end namespace
+
 namespace bus {
 
 IBusMessageQueue::~IBusMessageQueue() {
@@ -20,37 +59,218 @@ IBusMessageQueue::~IBusMessageQueue() {
 }
 
 void IBusMessageQueue::Push(const std::shared_ptr<IBusMessage>& message) {
+  std::shared_ptr<const MessageCallback> callback;
+  std::function<void()> waiter;
   {
     std::lock_guard<std::mutex> queue_lock(queue_mutex_);
-    queue_.emplace_back(message);
-    queue_size_ = queue_.size();
+    if (filter_ && (!message || !filter_->Match(*message))) {
+      return;
+    }
+    if (callback_) {
+      callback = callback_;
+    } else {
+      queue_.emplace_back(message);
+      TrimQueue();
+      queue_size_ = queue_.size();
+      waiter.swap(waiter_);
+    }
+  }
+  if (callback) {
+    (*callback)(message);
+    return;
   }
   queue_not_empty_.notify_one();
+  if (waiter) {
+    waiter();
+  }
+}
+
+void IBusMessageQueue::PushBatch(
+    std::span<const std::shared_ptr<IBusMessage>> messages) {
+  if (messages.empty()) {
+    return;
+  }
+  std::shared_ptr<const MessageCallback> callback;
+  std::shared_ptr<const BusMessageFilter> filter;
+  std::function<void()> waiter;
+  {
+    std::lock_guard<std::mutex> queue_lock(queue_mutex_);
+    filter = filter_;
+    if (callback_) {
+      callback = callback_;
+    } else if (filter) {
+      for (const auto& message : messages) {
+        if (message && filter->Match(*message)) {
+          queue_.push_back(message);
+        }
+      }
+    } else {
+      queue_.insert(queue_.end(), messages.begin(), messages.end());
+    }
+    if (!callback) {
+      TrimQueue();
+      queue_size_ = queue_.size();
+      waiter.swap(waiter_);
+    }
+  }
+  if (callback) {
+    for (const auto& message : messages) {
+      if (!filter || (message && filter->Match(*message))) {
+        (*callback)(message);
+      }
+    }
+    return;
+  }
+  queue_not_empty_.notify_all();
+  if (waiter) {
+    waiter();
+  }
+}
+
+void IBusMessageQueue::Callback(MessageCallback callback) {
+  std::shared_ptr<const MessageCallback> new_callback;
+  if (callback) {
+    new_callback = std::make_shared<const MessageCallback>(
+        std::move(callback));
+  }
+
+  std::deque<std::shared_ptr<IBusMessage>> pending;
+  {
+    std::lock_guard<std::mutex> queue_lock(queue_mutex_);
+    callback_ = new_callback;
+    if (callback_) {
+      pending.swap(queue_);
+      queue_size_ = 0;
+    }
+  }
+  for (const auto& message : pending) {
+    (*new_callback)(message);
+  }
+  queue_not_empty_.notify_all(); // Releases any waiting pop call
 }
+
+void IBusMessageQueue::Filter(const BusMessageFilter& filter) {
+  std::lock_guard<std::mutex> queue_lock(queue_mutex_);
+  if (filter.Empty()) {
+    filter_.reset();
+    filtered_ = false;
+    return;
+  }
+  filter_ = std::make_shared<const BusMessageFilter>(filter);
+  filtered_ = true;
+  std::erase_if(queue_, [&] (const auto& message) -> bool {
+    return !message || !filter_->Match(*message);
+  });
+  queue_size_ = queue_.size();
+}
+
+bool IBusMessageQueue::HasFilter() const {
+  return filtered_;
+}
+
+bool IBusMessageQueue::HasCallback() const {
+  std::lock_guard<std::mutex> queue_lock(queue_mutex_);
+  return static_cast<bool>(callback_);
+}
+
 void IBusMessageQueue::PushFront(const std::shared_ptr<IBusMessage>& message) {
+  std::function<void()> waiter;
   {
     std::lock_guard<std::mutex> queue_lock(queue_mutex_);
     queue_.emplace_front(message);
     queue_size_ = queue_.size();
+    waiter.swap(waiter_);
   }
   queue_not_empty_.notify_one();
+  if (waiter) {
+    waiter();
+  }
+}
+
+void IBusMessageQueue::AsyncWait(std::function<void()> handler) {
+  {
+    std::lock_guard<std::mutex> queue_lock(queue_mutex_);
+    waiter_ = std::move(handler);
+    if (queue_.empty()) {
+      return;
+    }
+  }
+  NotifyWaiter();
+}
+
+void IBusMessageQueue::CancelAsyncWait() {
+  std::lock_guard<std::mutex> queue_lock(queue_mutex_);
+  waiter_ = nullptr;
+}
+
+void IBusMessageQueue::NotifyWaiter() {
+  std::function<void()> waiter;
+  {
+    std::lock_guard<std::mutex> queue_lock(queue_mutex_);
+    if (!waiter_) {
+      return;
+    }
+    waiter.swap(waiter_);
+  }
+  waiter();
 }
 
 void IBusMessageQueue::Push(const std::vector<uint8_t>& message_buffer) {
 
-  // Convert to byte array to message
-  IBusMessage header;
-  header.FromRaw(message_buffer);
-  auto message = IBusMessage::Create(header.Type());
-  if (!message) {
-    BUS_ERROR() << "Unknown IBusMessage header type "
-        << static_cast<int>(header.Type());
+  // Convert to byte array to message. The decode doesn't throw, so a
+  // burst of malformed buffers only costs a branch each. Only the first
+  // error in a burst is logged.
+  const BusMessageView header(message_buffer);
+  if (filtered_ && header.Valid()) {
+    std::shared_ptr<const BusMessageFilter> filter;
+    {
+      std::lock_guard<std::mutex> queue_lock(queue_mutex_);
+      filter = filter_;
+    }
+    if (filter && !filter->Match(header)) {
+      return; // Not decoded
+    }
+  }
+  auto status = BusDecodeStatus::LengthMismatch;
+  std::shared_ptr<IBusMessage> message;
+  if (header.Valid()) {
+    message = IBusMessage::Create(header.Type());
+    status = message ? message->Decode(message_buffer)
+                     : BusDecodeStatus::InvalidData;
+  }
+
+  if (status != BusDecodeStatus::Ok) {
+    if (!decode_error_) {
+      decode_error_ = true;
+      BUS_ERROR() << "Message decode error. Status: "
+          << static_cast<int>(status) << ", Type: "
+          << static_cast<int>(header.Type())
+          << ", Size: " << message_buffer.size();
+    }
     return;
   }
-  message->FromRaw(message_buffer);
+  decode_error_ = false;
   Push(message);
 }
 
+size_t IBusMessageQueue::ReadInPlace(const InPlaceCallback& callback,
+                                     size_t max_messages) {
+  if (!callback) {
+    return 0;
+  }
+  std::vector<uint8_t> message_buffer;
+  size_t count = 0;
+  for (; count < max_messages; ++count) {
+    const auto message = Pop();
+    if (!message) {
+      break;
+    }
+    message->ToRaw(message_buffer);
+    callback(message_buffer);
+  }
+  return count;
+}
+
 std::shared_ptr<IBusMessage> IBusMessageQueue::Pop() {
   std::shared_ptr<IBusMessage> message;
   {
@@ -67,6 +287,26 @@ std::shared_ptr<IBusMessage> IBusMessageQueue::Pop() {
   return message;
 }
 
+size_t IBusMessageQueue::PopBatch(
+    std::vector<std::shared_ptr<IBusMessage>>& messages, size_t max) {
+  std::lock_guard<std::mutex> queue_lock(queue_mutex_);
+  return MoveToList(messages, max);
+}
+
+size_t IBusMessageQueue::MoveToList(
+    std::vector<std::shared_ptr<IBusMessage>>& messages, size_t max) {
+  // Note that the queue mutex shall be locked by the caller.
+  const size_t count = std::min(max, queue_.size());
+  if (count > 0) {
+    const auto last = queue_.begin() + static_cast<std::ptrdiff_t>(count);
+    messages.insert(messages.end(), std::make_move_iterator(queue_.begin()),
+                    std::make_move_iterator(last));
+    queue_.erase(queue_.begin(), last);
+  }
+  queue_size_ = queue_.size();
+  return count;
+}
+
 size_t IBusMessageQueue::MessageSize() const {
   std::lock_guard<std::mutex> queue_lock(queue_mutex_);
   if (queue_.empty()) {
@@ -92,6 +332,80 @@ void IBusMessageQueue::Start() {
 
 void IBusMessageQueue::Stop() {
   queue_not_empty_.notify_all(); // Just releases any waiting call
+  NotifyWaiter();
+}
+
+void IBusMessageQueue::SpinWhileEmpty(std::chrono::nanoseconds max_time) const {
+  if (wait_options_.strategy != WaitStrategy::Spin || queue_size_ > 0 ||
+      max_time <= std::chrono::nanoseconds::zero()) {
+    return;
+  }
+  const auto stop_time = std::chrono::steady_clock::now() + max_time;
+  SpinWait spin(wait_options_);
+  for (uint32_t polls = 1; queue_size_ == 0 && spin.Pause(); ++polls) {
+    // Reading the clock costs more than a pause.
+    if (polls % 64 == 0 && std::chrono::steady_clock::now() >= stop_time) {
+      break;
+    }
+  }
+}
+
+void IBusMessageQueue::ReportOverrun(uint64_t nof_lost) {
+  if (nof_lost == 0) {
+    return;
+  }
+  lost_messages_ += nof_lost;
+  BUS_WARNING() << "Subscriber overrun. Lost messages: " << nof_lost
+                << ", Total: " << lost_messages_;
+}
+
+void IBusMessageQueue::MaxSize(size_t max_size, QueueFullPolicy policy) {
+  std::lock_guard<std::mutex> queue_lock(queue_mutex_);
+  max_size_ = max_size;
+  full_policy_ = policy;
+  TrimQueue();
+  queue_size_ = queue_.size();
+}
+
+void IBusMessageQueue::TrimQueue() {
+  // Note that the queue mutex shall be locked by the caller.
+  const size_t max_size = max_size_;
+  if (max_size == 0 || queue_.size() <= max_size) {
+    return;
+  }
+  const size_t size_before = queue_.size();
+  size_t new_size = max_size;
+  if (full_policy_ == QueueFullPolicy::LatestPerId) {
+    // Scans from the newest message and removes older messages with the
+    // same key. The kept messages are moved toward the back, so the order
+    // is unchanged.
+    latest_keys_.clear();
+    auto dest = queue_.rbegin();
+    for (auto itr = queue_.rbegin(); itr != queue_.rend(); ++itr) {
+      if (!*itr) {
+        continue;
+      }
+      if (const auto key = LatestKey(**itr);
+          key.has_value() && !latest_keys_.insert(key.value()).second) {
+        continue;
+      }
+      if (dest != itr) {
+        *dest = std::move(*itr);
+      }
+      ++dest;
+    }
+    queue_.erase(queue_.begin(), dest.base());
+    // Leaves some room, so the next pushes don't have to scan the queue
+    // again.
+    new_size = max_size - (max_size / 4);
+  }
+  if (queue_.size() > new_size) {
+    const auto remove = static_cast<std::ptrdiff_t>(queue_.size() - new_size);
+    queue_.erase(queue_.begin(), queue_.begin() + remove);
+  }
+  // The owner of the queue reports the loss, as a log line per push
+  // would flood the log.
+  lost_messages_ += size_before - queue_.size();
 }
 
 void IBusMessageQueue::Clear() {
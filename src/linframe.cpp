@@ -0,0 +1,138 @@
+/*
+* Copyright 2025 Ingemar Hedvall
+* SPDX-License-Identifier: MIT
+*/
+#include "bus/linframe.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+#include "bus/littlebuffer.h"
+#include "bus/buslogstream.h"
+
+namespace {
+
+constexpr uint32_t kLinFrameSize = 26;
+constexpr uint8_t kFrameIdMask = 0x3F;
+
+} // end namespace
+
+namespace bus {
+
+LinFrame::LinFrame() : IBusMessage(BusMessageType::LIN_Frame) {
+  Size(kLinFrameSize);
+}
+
+void LinFrame::FrameId(uint8_t frame_id) {
+  frame_id_ = frame_id & kFrameIdMask;
+}
+
+uint8_t LinFrame::ProtectedId() const {
+  const auto bit = [&] (int index) -> uint8_t {
+    return (frame_id_ >> index) & 0x01;
+  };
+  const uint8_t p0 = bit(0) ^ bit(1) ^ bit(2) ^ bit(4);
+  const uint8_t p1 = (bit(1) ^ bit(3) ^ bit(4) ^ bit(5)) ^ 0x01;
+  return frame_id_ | (p0 << 6) | (p1 << 7);
+}
+
+void LinFrame::FrameDuration(uint32_t duration) {
+  frame_duration_ = duration;
+}
+
+uint32_t LinFrame::FrameDuration() const {
+  return frame_duration_;
+}
+
+void LinFrame::DataBytes(std::span<const uint8_t> data) {
+  data_length_ = static_cast<uint8_t>(std::min(data.size(), kMaxDataLength));
+  std::copy_n(data.begin(), data_length_, data_bytes_.begin());
+  Size(kLinFrameSize + data_length_);
+}
+
+std::span<const uint8_t> LinFrame::DataBytes() const {
+  return {data_bytes_.data(), data_length_};
+}
+
+uint8_t LinFrame::CalculateChecksum() const {
+  uint16_t sum = enhanced_checksum_ ? ProtectedId() : 0;
+  for (const uint8_t data_byte : DataBytes()) {
+    sum += data_byte;
+    if (sum > 0xFF) {
+      sum -= 0xFF; // Add the carry
+    }
+  }
+  return static_cast<uint8_t>(~sum);
+}
+
+void LinFrame::ToRaw(std::vector<uint8_t>& dest) const {
+  Valid(true);
+  Size(kLinFrameSize + data_length_);
+  IBusMessage::ToRaw(dest);
+  if (dest.size() != Size() || !Valid()) {
+    BUS_ERROR() << "Allocation or size mismatch. Size: " << Size() << "/"
+                << dest.size();
+    Valid(false);
+    return;
+  }
+
+  dest[18] = frame_id_;
+  dest[19] = data_length_;
+  dest[20] = checksum_;
+  dest[21] = dir_ ? 0x01 : 0x00;
+  dest[21] |= (enhanced_checksum_ ? 0x01 : 0x00) << 1;
+
+  LittleBuffer<uint32_t> frame_duration(frame_duration_);
+  std::copy_n(frame_duration.cbegin(), frame_duration.size(),
+              dest.begin() + 22);
+  std::copy_n(data_bytes_.cbegin(), data_length_,
+              dest.begin() + kLinFrameSize);
+}
+
+BusDecodeStatus LinFrame::Decode(std::span<const uint8_t> source) noexcept {
+  if (source.size() < kLinFrameSize) {
+    Valid(false);
+    return BusDecodeStatus::TooSmall;
+  }
+
+  if (const auto status = IBusMessage::Decode(source);
+      status != BusDecodeStatus::Ok) {
+    return status;
+  }
+
+  const uint8_t data_length = source[19];
+  if (data_length > kMaxDataLength ||
+      Size() < kLinFrameSize + data_length) {
+    Valid(false);
+    return BusDecodeStatus::InvalidData;
+  }
+  data_length_ = data_length;
+  std::copy_n(source.begin() + kLinFrameSize, data_length_,
+              data_bytes_.begin());
+
+  FrameId(source[18]);
+  checksum_ = source[20];
+  dir_ = (source[21] & 0x01) != 0;
+  enhanced_checksum_ = (source[21] & 0x02) != 0;
+
+  const LittleBuffer<uint32_t> duration(source.data(), 22);
+  frame_duration_ = duration.value();
+  return BusDecodeStatus::Ok;
+}
+
+std::string LinFrame::ToString(uint64_t loglevel) const {
+  if (loglevel > 1) {
+    return {};
+  }
+  std::ostringstream ss;
+  ss << "Type: LinFrame, FrameId: " << static_cast<int>(frame_id_)
+     << ", Data: ";
+  for (const uint8_t data_byte : DataBytes()) {
+    ss << std::hex << std::setw(2) << std::setfill('0')
+       << static_cast<int>(data_byte) << " ";
+  }
+  return ss.str();
+}
+
+}  // namespace bus
@@ -0,0 +1,164 @@
+/*
+* Copyright 2025 Ingemar Hedvall
+* SPDX-License-Identifier: MIT
+*/
+#include "bus/lz4codec.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace {
+
+constexpr size_t kMinMatch = 4;
+constexpr size_t kLastLiterals = 5; ///< The block ends with literals.
+constexpr size_t kMatchFindLimit = 12; ///< No match starts after this.
+constexpr size_t kMaxOffset = 65'535;
+constexpr uint32_t kHashLog = 12;
+constexpr uint32_t kNoPosition = 0xFFFFFFFF;
+
+uint32_t Read32(const uint8_t* data) {
+  uint32_t value = 0;
+  std::memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+uint32_t Hash(uint32_t sequence) {
+  return (sequence * 2'654'435'761U) >> (32 - kHashLog);
+}
+
+void WriteLength(std::vector<uint8_t>& dest, size_t length) {
+  for (; length >= 255; length -= 255) {
+    dest.push_back(255);
+  }
+  dest.push_back(static_cast<uint8_t>(length));
+}
+
+/** \brief Reads the extra length bytes after a token. */
+bool ReadLength(std::span<const uint8_t> source, size_t& offset,
+                size_t& length) {
+  for (;;) {
+    if (offset >= source.size()) {
+      return false;
+    }
+    const uint8_t byte = source[offset++];
+    length += byte;
+    if (byte != 255) {
+      return true;
+    }
+  }
+}
+
+/** \brief Writes a sequence. A match length of 0 is the last literals. */
+void WriteSequence(std::vector<uint8_t>& dest,
+                   std::span<const uint8_t> literals, size_t offset,
+                   size_t match_length) {
+  const size_t match_code = match_length > 0 ? match_length - kMinMatch : 0;
+  uint8_t token = static_cast<uint8_t>(std::min<size_t>(literals.size(), 15)
+                                       << 4);
+  token |= static_cast<uint8_t>(std::min<size_t>(match_code, 15));
+  dest.push_back(token);
+  if (literals.size() >= 15) {
+    WriteLength(dest, literals.size() - 15);
+  }
+  dest.insert(dest.end(), literals.begin(), literals.end());
+  if (match_length == 0) {
+    return;
+  }
+  dest.push_back(static_cast<uint8_t>(offset & 0xFF));
+  dest.push_back(static_cast<uint8_t>(offset >> 8));
+  if (match_code >= 15) {
+    WriteLength(dest, match_code - 15);
+  }
+}
+
+} // end namespace
+
+namespace bus {
+
+void Lz4Codec::Compress(std::span<const uint8_t> source,
+                        std::vector<uint8_t>& dest) {
+  dest.clear();
+  dest.reserve(MaxCompressedSize(source.size()));
+  const size_t size = source.size();
+  const uint8_t* data = source.data();
+  size_t anchor = 0;
+
+  if (size > kMatchFindLimit) {
+    std::array<uint32_t, 1 << kHashLog> table; // NOLINT
+    table.fill(kNoPosition);
+    const size_t match_limit = size - kLastLiterals;
+    const size_t find_limit = size - kMatchFindLimit;
+    for (size_t pos = 0; pos < find_limit; ) {
+      const uint32_t sequence = Read32(data + pos);
+      const uint32_t hash = Hash(sequence);
+      const uint32_t candidate = table[hash];
+      table[hash] = static_cast<uint32_t>(pos);
+      if (candidate == kNoPosition || pos - candidate > kMaxOffset ||
+          Read32(data + candidate) != sequence) {
+        ++pos;
+        continue;
+      }
+
+      size_t length = kMinMatch;
+      while (pos + length < match_limit &&
+             data[candidate + length] == data[pos + length]) {
+        ++length;
+      }
+      WriteSequence(dest, source.subspan(anchor, pos - anchor),
+                    pos - candidate, length);
+      pos += length;
+      anchor = pos;
+    }
+  }
+  WriteSequence(dest, source.subspan(anchor), 0, 0);
+}
+
+bool Lz4Codec::Decompress(std::span<const uint8_t> source, size_t size,
+                          std::vector<uint8_t>& dest) {
+  dest.resize(size);
+  size_t input = 0;
+  size_t output = 0;
+  while (input < source.size()) {
+    const uint8_t token = source[input++];
+
+    size_t literal_length = token >> 4;
+    if (literal_length == 15 && !ReadLength(source, input, literal_length)) {
+      return false;
+    }
+    if (literal_length > source.size() - input ||
+        literal_length > size - output) {
+      return false;
+    }
+    std::memcpy(dest.data() + output, source.data() + input, literal_length);
+    input += literal_length;
+    output += literal_length;
+    if (input == source.size()) {
+      break; // Last sequence has no match
+    }
+
+    if (source.size() - input < 2) {
+      return false;
+    }
+    const size_t offset = source[input] | (source[input + 1] << 8);
+    input += 2;
+    if (offset == 0 || offset > output) {
+      return false;
+    }
+    size_t match_length = token & 0x0F;
+    if (match_length == 15 && !ReadLength(source, input, match_length)) {
+      return false;
+    }
+    match_length += kMinMatch;
+    if (match_length > size - output) {
+      return false;
+    }
+    // The match may overlap the output, so it's copied byte by byte.
+    for (size_t index = 0; index < match_length; ++index, ++output) {
+      dest[output] = dest[output - offset];
+    }
+  }
+  return output == size;
+}
+
+}  // namespace bus
@@ -0,0 +1,106 @@
+/*
+* Copyright 2025 Ingemar Hedvall
+* SPDX-License-Identifier: MIT
+*/
+#include "bus/mostmessage.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+#include "bus/littlebuffer.h"
+#include "bus/buslogstream.h"
+
+namespace {
+
+constexpr uint32_t kMostMessageSize = 26;
+
+} // end namespace
+
+namespace bus {
+
+MostMessage::MostMessage() : IBusMessage(BusMessageType::MOST_Message) {
+  Size(kMostMessageSize);
+}
+
+void MostMessage::DataBytes(std::span<const uint8_t> data) {
+  const size_t length = std::min(data.size(), kMaxDataLength);
+  data_bytes_.assign(data.begin(), data.begin() + length);
+  Size(static_cast<uint32_t>(kMostMessageSize + data_bytes_.size()));
+}
+
+void MostMessage::ToRaw(std::vector<uint8_t>& dest) const {
+  Valid(true);
+  Size(static_cast<uint32_t>(kMostMessageSize + data_bytes_.size()));
+  IBusMessage::ToRaw(dest);
+  if (dest.size() != Size() || !Valid()) {
+    BUS_ERROR() << "Allocation or size mismatch. Size: " << Size() << "/"
+                << dest.size();
+    Valid(false);
+    return;
+  }
+
+  LittleBuffer<uint16_t> source(source_);
+  std::copy_n(source.cbegin(), source.size(), dest.begin() + 18);
+  LittleBuffer<uint16_t> destination(destination_);
+  std::copy_n(destination.cbegin(), destination.size(), dest.begin() + 20);
+  dest[22] = dir_ ? 0x01 : 0x00;
+  dest[22] |= (packet_ ? 0x01 : 0x00) << 1;
+  dest[23] = status_;
+  LittleBuffer<uint16_t> data_length(
+      static_cast<uint16_t>(data_bytes_.size()));
+  std::copy_n(data_length.cbegin(), data_length.size(), dest.begin() + 24);
+  std::ranges::copy(data_bytes_, dest.begin() + kMostMessageSize);
+}
+
+BusDecodeStatus MostMessage::Decode(std::span<const uint8_t> source) noexcept {
+  if (source.size() < kMostMessageSize) {
+    Valid(false);
+    return BusDecodeStatus::TooSmall;
+  }
+
+  if (const auto status = IBusMessage::Decode(source);
+      status != BusDecodeStatus::Ok) {
+    return status;
+  }
+
+  const LittleBuffer<uint16_t> data_length(source.data(), 24);
+  if (data_length.value() > kMaxDataLength ||
+      Size() < kMostMessageSize + data_length.value()) {
+    Valid(false);
+    return BusDecodeStatus::InvalidData;
+  }
+
+  try {
+    data_bytes_.assign(source.begin() + kMostMessageSize,
+        source.begin() + kMostMessageSize + data_length.value());
+  } catch (const std::exception&) {
+    Valid(false);
+    return BusDecodeStatus::AllocationError;
+  }
+
+  const LittleBuffer<uint16_t> source_address(source.data(), 18);
+  source_ = source_address.value();
+  const LittleBuffer<uint16_t> destination(source.data(), 20);
+  destination_ = destination.value();
+  dir_ = (source[22] & 0x01) != 0;
+  packet_ = (source[22] & 0x02) != 0;
+  status_ = source[23];
+  return BusDecodeStatus::Ok;
+}
+
+std::string MostMessage::ToString(uint64_t loglevel) const {
+  if (loglevel > 1) {
+    return {};
+  }
+  std::ostringstream ss;
+  ss << "Type: MostMessage, Source: " << source_
+     << ", Destination: " << destination_ << ", Data: ";
+  for (const uint8_t data_byte : data_bytes_) {
+    ss << std::hex << std::setw(2) << std::setfill('0')
+       << static_cast<int>(data_byte) << " ";
+  }
+  return ss.str();
+}
+
+}  // namespace bus
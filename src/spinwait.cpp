@@ -0,0 +1,74 @@
+/*
+* Copyright 2025 Ingemar Hedvall
+* SPDX-License-Identifier: MIT
+*/
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#endif
+
+#include "bus/spinwait.h"
+
+namespace bus {
+
+void CpuPause() {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+  _mm_pause();
+#elif defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+  asm volatile("yield" ::: "memory");
+#endif
+}
+
+SpinWait::SpinWait(const QueueWaitOptions& options)
+  : spin_count_(options.spin_count),
+    yield_count_(options.yield_count) {
+}
+
+bool SpinWait::Pause() {
+  if (count_ < spin_count_) {
+    ++count_;
+    CpuPause();
+    return true;
+  }
+  if (count_ < static_cast<uint64_t>(spin_count_) + yield_count_) {
+    ++count_;
+    std::this_thread::yield();
+    return true;
+  }
+  return false;
+}
+
+bool PinCurrentThread(int cpu) {
+  if (cpu < 0) {
+    return false;
+  }
+#if defined(_WIN32)
+  if (cpu >= static_cast<int>(sizeof(DWORD_PTR) * 8)) {
+    return false;
+  }
+  const DWORD_PTR mask = static_cast<DWORD_PTR>(1) << cpu;
+  return ::SetThreadAffinityMask(::GetCurrentThread(), mask) != 0;
+#elif defined(__linux__)
+  if (cpu >= CPU_SETSIZE) {
+    return false;
+  }
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  CPU_SET(cpu, &cpu_set);
+  return ::pthread_setaffinity_np(::pthread_self(), sizeof(cpu_set),
+                                  &cpu_set) == 0;
+#else
+  return false;
+#endif
+}
+
+} // bus
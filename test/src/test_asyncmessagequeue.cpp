@@ -0,0 +1,59 @@
+/*
+* Copyright 2025 Ingemar Hedvall
+* SPDX-License-Identifier: MIT
+ */
+
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <boost/asio.hpp>
+
+#include "bus/ibusmessagequeue.h"
+#include "bus/interface/asyncmessagequeue.h"
+
+using namespace std::chrono_literals;
+using namespace boost::asio;
+
+namespace bus {
+
+TEST(AsyncMessageQueue, TestAsyncPop) {
+  IBusMessageQueue queue;
+  io_context context;
+
+  size_t nof_messages = 0;
+  bool timeout = false;
+  co_spawn(context, [&] () -> awaitable<void> {
+    // Already in queue
+    auto msg = co_await AsyncPop(queue, 1s);
+    nof_messages += msg ? 1 : 0;
+
+    // Pushed by another thread
+    std::vector<std::shared_ptr<IBusMessage>> messages;
+    co_await AsyncPopBatch(queue, messages, 100, 5s);
+    nof_messages += messages.size();
+
+    // Nothing pushed
+    msg = co_await AsyncPop(queue, 10ms);
+    timeout = !msg;
+  }, detached);
+
+  queue.Push(std::make_shared<IBusMessage>());
+  std::thread publisher([&] () {
+    std::this_thread::sleep_for(50ms);
+    queue.Push(std::make_shared<IBusMessage>());
+  });
+
+  const auto start = std::chrono::steady_clock::now();
+  context.run();
+  const auto duration = std::chrono::steady_clock::now() - start;
+  publisher.join();
+
+  EXPECT_EQ(nof_messages, 2);
+  EXPECT_TRUE(timeout);
+  EXPECT_LT(duration, 2s); // Woken by the push, not the timeout
+}
+
+}  // namespace bus
@@ -0,0 +1,71 @@
+/*
+* Copyright 2025 Ingemar Hedvall
+* SPDX-License-Identifier: MIT
+ */
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "bus/busmessageexecutor.h"
+
+using namespace std::chrono_literals;
+
+namespace bus {
+
+TEST(BusMessageExecutor, TestPost) {
+  std::atomic<size_t> count = 0;
+  {
+    BusMessageExecutor executor(4, 10);
+    EXPECT_EQ(executor.NofWorkers(), 4);
+    EXPECT_EQ(executor.MaxTasks(), 10);
+
+    for (size_t index = 0; index < 1'000; ++index) {
+      EXPECT_TRUE(executor.Post([&count] () { ++count; }));
+    }
+    executor.Stop();
+    EXPECT_FALSE(executor.Post([&count] () { ++count; }));
+  }
+  EXPECT_EQ(count, 1'000);
+}
+
+TEST(BusMessageExecutor, TestBackPressure) {
+  BusMessageExecutor executor(1, 2);
+  std::atomic<bool> release = false;
+  const auto blocking_task = [&release] () {
+    while (!release) {
+      std::this_thread::sleep_for(1ms);
+    }
+  };
+  EXPECT_TRUE(executor.Post(blocking_task)); // Taken by the worker
+  std::this_thread::sleep_for(50ms);
+  EXPECT_TRUE(executor.Post(blocking_task));
+  EXPECT_TRUE(executor.Post(blocking_task));
+  EXPECT_EQ(executor.Size(), 2);
+
+  std::atomic<bool> posted = false;
+  std::thread producer([&] () {
+    posted = executor.Post([] () {});
+  });
+  std::this_thread::sleep_for(50ms);
+  EXPECT_FALSE(posted); // Blocked by the full queue
+
+  release = true;
+  producer.join();
+  EXPECT_TRUE(posted);
+}
+
+TEST(BusMessageExecutor, TestThrowingTask) {
+  std::atomic<size_t> count = 0;
+  BusMessageExecutor executor(1, 10);
+  EXPECT_TRUE(executor.Post([] () { throw std::runtime_error("Error"); }));
+  EXPECT_TRUE(executor.Post([] () { throw 1; }));
+  EXPECT_TRUE(executor.Post([&count] () { ++count; }));
+  executor.Stop();
+  EXPECT_EQ(count, 1); // The worker survived the exceptions
+}
+
+}  // namespace bus
@@ -0,0 +1,90 @@
+/*
+* Copyright 2025 Ingemar Hedvall
+* SPDX-License-Identifier: MIT
+ */
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "bus/busmessagefilter.h"
+#include "bus/candataframe.h"
+
+namespace bus {
+
+TEST(BusMessageFilter, TestMatch) {
+  BusMessageFilter filter;
+  EXPECT_TRUE(filter.Empty());
+
+  CanDataFrame frame;
+  frame.BusChannel(2);
+  frame.MessageId(0x123);
+  IBusMessage message;
+  message.BusChannel(1);
+  EXPECT_TRUE(filter.Match(frame));
+  EXPECT_TRUE(filter.Match(message));
+
+  filter.AddBusChannel(2);
+  EXPECT_FALSE(filter.Empty());
+  EXPECT_TRUE(filter.Match(frame));
+  EXPECT_FALSE(filter.Match(message));
+
+  filter.CanIds().AddId(0x100);
+  EXPECT_FALSE(filter.Match(frame));
+  frame.MessageId(0x100);
+  EXPECT_TRUE(filter.Match(frame));
+
+  filter.AddType(BusMessageType::Unknown);
+  EXPECT_FALSE(filter.Match(frame));
+
+  filter.Clear();
+  EXPECT_TRUE(filter.Empty());
+  EXPECT_TRUE(filter.Match(message));
+}
+
+TEST(BusMessageFilter, TestMatchView) {
+  BusMessageFilter filter;
+  filter.AddBusChannel(2);
+  filter.CanIds().AddRange(0x100, 0x1FF);
+
+  CanDataFrame frame;
+  frame.BusChannel(2);
+  frame.MessageId(0x180);
+  std::vector<uint8_t> raw;
+  frame.ToRaw(raw);
+  EXPECT_TRUE(filter.Match(BusMessageView(raw)));
+
+  frame.MessageId(0x280);
+  frame.ToRaw(raw);
+  EXPECT_FALSE(filter.Match(BusMessageView(raw)));
+
+  raw.resize(10);
+  EXPECT_FALSE(filter.Match(BusMessageView(raw)));
+}
+
+TEST(BusMessageFilter, TestRaw) {
+  BusMessageFilter filter;
+  filter.AddBusChannel(2);
+  filter.AddBusChannel(5);
+  filter.AddType(BusMessageType::CAN_DataFrame);
+  filter.CanIds().AddRange(0x100, 0x1FF);
+
+  std::vector<uint8_t> raw;
+  filter.ToRaw(raw);
+  BusMessageFilter copy;
+  ASSERT_TRUE(copy.FromRaw(raw));
+  EXPECT_EQ(copy.BusChannels(), filter.BusChannels());
+  EXPECT_EQ(copy.Types(), filter.Types());
+
+  CanDataFrame frame;
+  frame.BusChannel(5);
+  frame.MessageId(0x180);
+  EXPECT_TRUE(copy.Match(frame));
+  frame.MessageId(0x280);
+  EXPECT_FALSE(copy.Match(frame));
+
+  raw.resize(raw.size() - 1);
+  EXPECT_FALSE(copy.FromRaw(raw));
+}
+
+}  // namespace bus
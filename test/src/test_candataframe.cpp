@@ -7,6 +7,7 @@
 
 #include "bus/candataframe.h"
 #include "bus/buslogstream.h"
+#include "bus/littlebuffer.h"
 
 namespace bus {
 
@@ -159,4 +160,144 @@ TEST(CanDataFrame, TestSerialize) {
   BusLogStream::UserLogFunction = BusLogStream::BusNoLogFunction;
 }
 
-}
\ No newline at end of file
+TEST(CanDataFrame, TestDecode) {
+  BusLogStream::UserLogFunction = BusLogStream::BusConsoleLogFunction;
+  BusLogStream::ResetErrorCount();
+
+  CanDataFrame msg;
+  msg.MessageId(0x123);
+  msg.DataBytes({1, 2, 3, 4});
+  msg.SingleWire(true);
+  msg.Brs(true);
+
+  std::vector<uint8_t> buffer;
+  msg.ToRaw(buffer);
+  ASSERT_EQ(buffer.size(), 34 + 4);
+
+  CanDataFrame msg1;
+  EXPECT_EQ(msg1.Decode(buffer), BusDecodeStatus::Ok);
+  EXPECT_TRUE(msg1.Valid());
+  EXPECT_EQ(msg1.MessageId(), 0x123);
+  EXPECT_EQ(msg1.DataBytes(), msg.DataBytes());
+  EXPECT_TRUE(msg1.SingleWire());
+  EXPECT_TRUE(msg1.Brs());
+  EXPECT_FALSE(msg1.Dir());
+  EXPECT_FALSE(msg1.WakeUp());
+  EXPECT_FALSE(msg1.Rtr());
+
+  // Truncated buffers shall be rejected without any log messages.
+  for (size_t size = 0; size < buffer.size(); ++size) {
+    const std::span<const uint8_t> truncated(buffer.data(), size);
+    CanDataFrame msg2;
+    EXPECT_NE(msg2.Decode(truncated), BusDecodeStatus::Ok) << size;
+    EXPECT_FALSE(msg2.Valid());
+  }
+
+  // Data length outside the message.
+  auto invalid = buffer;
+  invalid[23] = 200;
+  CanDataFrame msg3;
+  EXPECT_EQ(msg3.Decode(invalid), BusDecodeStatus::InvalidData);
+  EXPECT_FALSE(msg3.Valid());
+
+  EXPECT_EQ(BusLogStream::ErrorCount(), 0);
+  BusLogStream::UserLogFunction = BusLogStream::BusNoLogFunction;
+}
+
+TEST(CanDataFrame, TestCompact) {
+  BusLogStream::UserLogFunction = BusLogStream::BusConsoleLogFunction;
+  BusLogStream::ResetErrorCount();
+
+  CanDataFrame msg;
+  msg.Version(CanDataFrame::kCompactVersion);
+  msg.Timestamp(1234567);
+  msg.BusChannel(3);
+  msg.MessageId(0x123);
+  msg.DataBytes({1, 2, 3, 4, 5, 6, 7, 8});
+  msg.Dir(true);
+
+  // Classic CAN frame with an 11-bit ID and no options.
+  std::vector<uint8_t> buffer;
+  msg.ToRaw(buffer);
+  EXPECT_EQ(buffer.size(), 18 + 1 + 2 + 8);
+  EXPECT_EQ(msg.Size(), buffer.size());
+
+  CanDataFrame msg1;
+  EXPECT_EQ(msg1.Decode(buffer), BusDecodeStatus::Ok);
+  EXPECT_TRUE(msg1.Valid());
+  EXPECT_EQ(msg1.Version(), CanDataFrame::kCompactVersion);
+  EXPECT_EQ(msg1.Timestamp(), 1234567);
+  EXPECT_EQ(msg1.BusChannel(), 3);
+  EXPECT_EQ(msg1.MessageId(), 0x123);
+  EXPECT_FALSE(msg1.ExtendedId());
+  EXPECT_EQ(msg1.Dlc(), 8);
+  EXPECT_EQ(msg1.DataBytes(), msg.DataBytes());
+  EXPECT_TRUE(msg1.Dir());
+  EXPECT_FALSE(msg1.SingleWire());
+  EXPECT_EQ(msg1.Crc(), 0);
+  EXPECT_EQ(msg1.FrameDuration(), 0);
+
+  // CAN FD frame with extended ID and all options.
+  msg.MessageId(0x1ABCDEF | 0x80000000);
+  msg.DataBytes(std::vector<uint8_t>(20, 0x55));
+  msg.Crc(0x12345);
+  msg.FrameDuration(123);
+  msg.Srr(true);
+  msg.Edl(true);
+  msg.Brs(true);
+  msg.Esi(true);
+  msg.Rtr(true);
+  msg.WakeUp(true);
+  msg.SingleWire(true);
+  msg.R0(true);
+  msg.R1(true);
+  msg.ToRaw(buffer);
+  EXPECT_LT(buffer.size(), 34 + 20);
+
+  CanDataFrame msg2;
+  EXPECT_EQ(msg2.Decode(buffer), BusDecodeStatus::Ok);
+  EXPECT_EQ(msg2.MessageId(), msg.MessageId());
+  EXPECT_TRUE(msg2.ExtendedId());
+  EXPECT_EQ(msg2.Dlc(), msg.Dlc());
+  EXPECT_EQ(msg2.DataBytes(), msg.DataBytes());
+  EXPECT_EQ(msg2.Crc(), 0x12345);
+  EXPECT_EQ(msg2.FrameDuration(), 123);
+  EXPECT_TRUE(msg2.Dir());
+  EXPECT_TRUE(msg2.Srr());
+  EXPECT_TRUE(msg2.Edl());
+  EXPECT_TRUE(msg2.Brs());
+  EXPECT_TRUE(msg2.Esi());
+  EXPECT_TRUE(msg2.Rtr());
+  EXPECT_TRUE(msg2.WakeUp());
+  EXPECT_TRUE(msg2.SingleWire());
+  EXPECT_TRUE(msg2.R0());
+  EXPECT_TRUE(msg2.R1());
+
+  // A version 0 frame is still decoded by the same object.
+  msg.Version(0);
+  msg.ToRaw(buffer);
+  EXPECT_EQ(buffer.size(), 34 + 20);
+  EXPECT_EQ(msg2.Decode(buffer), BusDecodeStatus::Ok);
+  EXPECT_EQ(msg2.Version(), 0);
+  EXPECT_EQ(msg2.MessageId(), msg.MessageId());
+  EXPECT_EQ(msg2.DataBytes(), msg.DataBytes());
+
+  // Truncated varint values shall be rejected.
+  msg.Version(CanDataFrame::kCompactVersion);
+  msg.DataBytes({});
+  msg.ToRaw(buffer);
+  for (uint32_t size = 18; size < buffer.size(); ++size) {
+    auto invalid = buffer;
+    invalid.resize(size);
+    LittleBuffer<uint32_t> length(size);
+    std::copy_n(length.cbegin(), length.size(), invalid.begin() + 4);
+    CanDataFrame msg3;
+    EXPECT_NE(msg3.Decode(invalid), BusDecodeStatus::Ok) << size;
+    EXPECT_FALSE(msg3.Valid());
+  }
+
+  EXPECT_EQ(BusLogStream::ErrorCount(), 0);
+  BusLogStream::UserLogFunction = BusLogStream::BusNoLogFunction;
+}
+
+}
@@ -0,0 +1,120 @@
+/*
+* Copyright 2025 Ingemar Hedvall
+* SPDX-License-Identifier: MIT
+ */
+
+#include <gtest/gtest.h>
+
+#include "bus/busmessageview.h"
+#include "bus/candataframe.h"
+#include "bus/canframeview.h"
+
+namespace bus {
+
+TEST(CanFrameView, TestProperties) {
+  CanDataFrame msg;
+  msg.Timestamp(1234567);
+  msg.BusChannel(3);
+  msg.MessageId(0x12345);
+  msg.DataBytes({1, 2, 3, 4, 5, 6, 7, 8});
+  msg.Crc(0x5432);
+  msg.Dir(true);
+  msg.Edl(true);
+  msg.SingleWire(true);
+  msg.FrameDuration(123);
+
+  std::vector<uint8_t> buffer;
+  msg.ToRaw(buffer);
+
+  const BusMessageView header(buffer);
+  ASSERT_TRUE(header.Valid());
+  EXPECT_EQ(header.Type(), BusMessageType::CAN_DataFrame);
+  EXPECT_EQ(header.Size(), buffer.size());
+  EXPECT_EQ(header.Timestamp(), 1234567);
+  EXPECT_EQ(header.BusChannel(), 3);
+  EXPECT_EQ(header.Raw().size(), buffer.size());
+
+  const CanFrameView view(buffer);
+  ASSERT_TRUE(view.Valid());
+  EXPECT_EQ(view.MessageId(), msg.MessageId());
+  EXPECT_EQ(view.CanId(), 0x12345);
+  EXPECT_TRUE(view.ExtendedId());
+  EXPECT_EQ(view.Dlc(), 8);
+  EXPECT_EQ(view.DataLength(), 8);
+  EXPECT_EQ(view.Crc(), 0x5432);
+  EXPECT_TRUE(view.Dir());
+  EXPECT_TRUE(view.Edl());
+  EXPECT_FALSE(view.Brs());
+  EXPECT_FALSE(view.WakeUp());
+  EXPECT_TRUE(view.SingleWire());
+  EXPECT_EQ(view.FrameDuration(), 123);
+
+  const auto data = view.DataBytes();
+  ASSERT_EQ(data.size(), 8);
+  EXPECT_TRUE(std::equal(data.begin(), data.end(),
+                         msg.DataBytes().cbegin()));
+  EXPECT_EQ(data.data(), buffer.data() + 34); // No copy
+}
+
+TEST(CanFrameView, TestInvalid) {
+  CanDataFrame msg;
+  msg.DataBytes({1, 2, 3, 4});
+  std::vector<uint8_t> buffer;
+  msg.ToRaw(buffer);
+
+  EXPECT_FALSE(CanFrameView().Valid());
+  for (size_t size = 0; size < buffer.size(); ++size) {
+    const CanFrameView view(std::span<const uint8_t>(buffer.data(), size));
+    EXPECT_FALSE(view.Valid()) << size;
+    EXPECT_TRUE(view.DataBytes().empty());
+  }
+  buffer[23] = 100; // Data length outside the message
+  EXPECT_FALSE(CanFrameView(buffer).Valid());
+}
+
+TEST(CanFrameView, TestCompact) {
+  CanDataFrame msg;
+  msg.Version(CanDataFrame::kCompactVersion);
+  msg.Timestamp(1234567);
+  msg.BusChannel(3);
+  msg.MessageId(0x12345);
+  msg.DataBytes({1, 2, 3, 4, 5, 6, 7, 8});
+  msg.Crc(0x5432);
+  msg.Dir(true);
+  msg.Edl(true);
+  msg.SingleWire(true);
+  msg.FrameDuration(123);
+
+  std::vector<uint8_t> buffer;
+  msg.ToRaw(buffer);
+
+  const CanFrameView view(buffer);
+  ASSERT_TRUE(view.Valid());
+  EXPECT_EQ(view.Timestamp(), 1234567);
+  EXPECT_EQ(view.BusChannel(), 3);
+  EXPECT_EQ(view.MessageId(), msg.MessageId());
+  EXPECT_TRUE(view.ExtendedId());
+  EXPECT_EQ(view.Dlc(), 8);
+  EXPECT_EQ(view.DataLength(), 8);
+  EXPECT_EQ(view.Crc(), 0x5432);
+  EXPECT_TRUE(view.Dir());
+  EXPECT_TRUE(view.Edl());
+  EXPECT_FALSE(view.Brs());
+  EXPECT_FALSE(view.WakeUp());
+  EXPECT_TRUE(view.SingleWire());
+  EXPECT_EQ(view.FrameDuration(), 123);
+
+  const auto data = view.DataBytes();
+  ASSERT_EQ(data.size(), 8);
+  EXPECT_TRUE(std::equal(data.begin(), data.end(),
+                         msg.DataBytes().cbegin()));
+  EXPECT_EQ(data.data(), buffer.data() + buffer.size() - 8);
+
+  for (size_t size = 0; size < buffer.size(); ++size) {
+    const CanFrameView truncated(
+        std::span<const uint8_t>(buffer.data(), size));
+    EXPECT_FALSE(truncated.Valid()) << size;
+  }
+}
+
+} // namespace bus
@@ -0,0 +1,181 @@
+/*
+* Copyright 2025 Ingemar Hedvall
+* SPDX-License-Identifier: MIT
+ */
+
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "bus/candataframe.h"
+#include "bus/canframeview.h"
+#include "bus/canidfilter.h"
+#include "bus/littlebuffer.h"
+
+namespace {
+
+void AddToBatch(const bus::IBusMessage& msg, std::vector<uint8_t>& batch) {
+  std::vector<uint8_t> raw;
+  msg.ToRaw(raw);
+  const bus::LittleBuffer length(static_cast<uint32_t>(raw.size()));
+  batch.insert(batch.end(), length.cbegin(), length.cend());
+  batch.insert(batch.end(), raw.cbegin(), raw.cend());
+}
+
+}  // namespace
+
+namespace bus {
+
+TEST(CanIdFilter, TestMatch) {
+  CanIdFilter filter;
+  EXPECT_TRUE(filter.Empty());
+  EXPECT_FALSE(filter.Match(0x100));
+
+  filter.AddId(0x100);
+  filter.AddRange(0x200, 0x20F);
+  filter.AddId(0x80012345); // Extended ID
+  filter.AddRange(0x80020000, 0x8002FFFF);
+  EXPECT_FALSE(filter.Empty());
+
+  EXPECT_TRUE(filter.Match(0x100));
+  EXPECT_FALSE(filter.Match(0x101));
+  EXPECT_TRUE(filter.Match(0x200));
+  EXPECT_TRUE(filter.Match(0x20F));
+  EXPECT_FALSE(filter.Match(0x210));
+  EXPECT_TRUE(filter.Match(0x80012345));
+  EXPECT_FALSE(filter.Match(0x12345));
+  EXPECT_FALSE(filter.Match(0x80000100)); // Extended is not standard
+  EXPECT_TRUE(filter.Match(0x80025555));
+  EXPECT_FALSE(filter.Match(0x80030000));
+
+  filter.Clear();
+  EXPECT_TRUE(filter.Empty());
+  EXPECT_FALSE(filter.Match(0x100));
+}
+
+TEST(CanIdFilter, TestMatchMask) {
+  CanIdFilter filter;
+  for (uint32_t id = 0; id < 2048; id += 7) {
+    filter.AddId(id);
+  }
+  filter.AddRange(0x80001000, 0x80001FFF);
+  filter.AddRange(0x9000, 0x9FFF);
+
+  // The vectorized mask shall give the same result as the scalar test.
+  std::mt19937 random(1234);
+  std::uniform_int_distribution<uint32_t> standard(0, 0x7FF);
+  std::uniform_int_distribution<uint32_t> extended(0x800, 0xFFFF);
+  std::vector<uint32_t> ids(64);
+  for (size_t loop = 0; loop < 100; ++loop) {
+    for (size_t index = 0; index < ids.size(); ++index) {
+      switch (index % 3) {
+        case 0:
+          ids[index] = standard(random);
+          break;
+        case 1:
+          ids[index] = 0x80000000 | extended(random) / 8;
+          break;
+        default:
+          ids[index] = extended(random);
+          break;
+      }
+    }
+    const uint64_t mask = filter.MatchMask(ids);
+    for (size_t index = 0; index < ids.size(); ++index) {
+      EXPECT_EQ((mask >> index) & 1, filter.Match(ids[index]) ? 1 : 0)
+          << std::hex << ids[index];
+    }
+  }
+}
+
+TEST(CanIdFilter, TestScan) {
+  CanIdFilter filter;
+  filter.AddId(0x10);
+  filter.AddRange(0x80001000, 0x80001FFF);
+
+  std::vector<uint8_t> batch;
+  size_t expected = 0;
+  for (uint32_t index = 0; index < 1000; ++index) {
+    CanDataFrame msg;
+    const uint32_t message_id = (index % 2) == 0 ?
+        index % 32 : 0x80000F00 + index;
+    msg.MessageId(message_id);
+    msg.DataBytes({static_cast<uint8_t>(index)});
+    AddToBatch(msg, batch);
+    if (filter.Match(msg.MessageId())) {
+      ++expected;
+    }
+    if (index % 10 == 0) {
+      AddToBatch(IBusMessage(BusMessageType::Unknown), batch); // Skipped
+    }
+  }
+
+  std::vector<size_t> matches;
+  EXPECT_EQ(filter.Scan(batch, matches), expected);
+  EXPECT_EQ(matches.size(), expected);
+  for (const size_t offset : matches) {
+    const CanFrameView view(std::span<const uint8_t>(batch).subspan(offset));
+    ASSERT_TRUE(view.Valid());
+    EXPECT_TRUE(filter.Match(view.MessageId()));
+  }
+
+  // A truncated batch stops the scan without errors.
+  batch.resize(batch.size() - 3);
+  const size_t nof_matches = filter.Scan(batch, matches);
+  EXPECT_EQ(nof_matches, matches.size());
+  EXPECT_LE(nof_matches, expected);
+}
+
+TEST(CanIdFilter, TestScanCompact) {
+  CanIdFilter filter;
+  filter.AddId(0x10);
+  filter.AddId(0x80001234);
+
+  std::vector<uint8_t> batch;
+  for (const uint32_t message_id : {0x10U, 0x11U, 0x80001234U, 0x80001235U}) {
+    CanDataFrame msg;
+    msg.Version(CanDataFrame::kCompactVersion);
+    msg.MessageId(message_id);
+    msg.DataBytes({1, 2});
+    AddToBatch(msg, batch);
+  }
+  std::vector<size_t> matches;
+  ASSERT_EQ(filter.Scan(batch, matches), 2);
+  const CanFrameView view(
+      std::span<const uint8_t>(batch).subspan(matches[1]));
+  ASSERT_TRUE(view.Valid());
+  EXPECT_EQ(view.MessageId(), 0x80001234);
+}
+
+TEST(CanIdFilter, TestRaw) {
+  CanIdFilter filter;
+  std::vector<uint8_t> raw;
+  filter.ToRaw(raw);
+  CanIdFilter empty;
+  size_t offset = 0;
+  ASSERT_TRUE(empty.FromRaw(raw, offset));
+  EXPECT_EQ(offset, raw.size());
+  EXPECT_TRUE(empty.Empty());
+
+  filter.AddId(0x10);
+  filter.AddRange(0x700, 0x7FF);
+  filter.AddRange(0x80001000, 0x80001FFF);
+  raw.clear();
+  filter.ToRaw(raw);
+
+  CanIdFilter copy;
+  offset = 0;
+  ASSERT_TRUE(copy.FromRaw(raw, offset));
+  EXPECT_EQ(offset, raw.size());
+  for (const uint32_t message_id : {0x10U, 0x11U, 0x700U, 0x800U,
+                                    0x80001000U, 0x80002000U}) {
+    EXPECT_EQ(copy.Match(message_id), filter.Match(message_id));
+  }
+
+  offset = 0;
+  raw.pop_back();
+  EXPECT_FALSE(copy.FromRaw(raw, offset));
+}
+
+}  // namespace bus
@@ -0,0 +1,74 @@
+/*
+* Copyright 2025 Ingemar Hedvall
+* SPDX-License-Identifier: MIT
+ */
+
+#include <gtest/gtest.h>
+
+#include "bus/ethernetframe.h"
+#include "bus/buslogstream.h"
+
+namespace bus {
+
+TEST(EthernetFrame, TestProperties) {
+  EthernetFrame msg;
+  EXPECT_EQ(msg.Type(), BusMessageType::ETH_Frame);
+  EXPECT_EQ(msg.Size(), 30);
+  EXPECT_EQ(msg.EtherType(), 0);
+
+  // VLAN tagged IPv4 frame
+  std::vector<uint8_t> frame = {
+      0x01, 0x02, 0x03, 0x04, 0x05, 0x06,
+      0x11, 0x12, 0x13, 0x14, 0x15, 0x16,
+      0x81, 0x00, 0x00, 0x05, 0x08, 0x00};
+  frame.resize(64);
+  msg.DataBytes(frame);
+  EXPECT_EQ(msg.Destination(), 0x010203040506);
+  EXPECT_EQ(msg.Source(), 0x111213141516);
+  EXPECT_EQ(msg.EtherType(), 0x0800);
+  EXPECT_EQ(msg.Size(), 30 + 64);
+  EXPECT_FALSE(msg.CrcValid());
+  msg.Crc(0x12345678);
+  EXPECT_TRUE(msg.CrcValid());
+}
+
+TEST(EthernetFrame, TestSerialize) {
+  BusLogStream::UserLogFunction = BusLogStream::BusConsoleLogFunction;
+  BusLogStream::ResetErrorCount();
+
+  for (const size_t length : {60, 1'518, 1'519, 9'000}) {
+    std::vector<uint8_t> data(length);
+    for (size_t index = 0; index < data.size(); ++index) {
+      data[index] = static_cast<uint8_t>(index);
+    }
+    EthernetFrame msg;
+    msg.Dir(true);
+    msg.Crc(0xCAFE);
+    msg.FrameDuration(12'000);
+    msg.DataBytes(data);
+
+    std::vector<uint8_t> buffer;
+    msg.ToRaw(buffer);
+    ASSERT_EQ(buffer.size(), 30 + length);
+
+    EthernetFrame msg1;
+    ASSERT_EQ(msg1.Decode(buffer), BusDecodeStatus::Ok) << length;
+    EXPECT_TRUE(msg1.Dir());
+    EXPECT_TRUE(msg1.CrcValid());
+    EXPECT_EQ(msg1.Crc(), 0xCAFE);
+    EXPECT_EQ(msg1.FrameDuration(), 12'000);
+    EXPECT_EQ(msg1.DataLength(), length);
+    EXPECT_TRUE(std::ranges::equal(msg1.DataBytes(), data)) << length;
+  }
+
+  // Larger than a jumbo frame
+  const std::vector<uint8_t> too_large(EthernetFrame::kMaxDataLength + 1);
+  EthernetFrame msg2;
+  msg2.DataBytes(too_large);
+  EXPECT_EQ(msg2.DataLength(), EthernetFrame::kMaxDataLength);
+
+  EXPECT_EQ(BusLogStream::ErrorCount(), 0);
+  BusLogStream::UserLogFunction = BusLogStream::BusNoLogFunction;
+}
+
+}  // namespace bus
@@ -0,0 +1,63 @@
+/*
+* Copyright 2025 Ingemar Hedvall
+* SPDX-License-Identifier: MIT
+ */
+
+#include <gtest/gtest.h>
+
+#include "bus/flexrayframe.h"
+#include "bus/buslogstream.h"
+
+namespace bus {
+
+TEST(FlexRayFrame, TestSerialize) {
+  BusLogStream::UserLogFunction = BusLogStream::BusConsoleLogFunction;
+  BusLogStream::ResetErrorCount();
+
+  FlexRayFrame msg;
+  EXPECT_EQ(msg.Type(), BusMessageType::FlexRay_Frame);
+  EXPECT_EQ(msg.Size(), 34);
+
+  msg.FrameId(1023);
+  msg.Cycle(63);
+  msg.Channel(FlexRayChannel::B);
+  msg.Sync(true);
+  msg.Startup(true);
+  msg.HeaderCrc(0x7FF);
+  msg.Crc(0xABCDEF);
+  msg.FrameDuration(5'000);
+  const std::vector<uint8_t> data(254, 0xAA);
+  msg.DataBytes(data);
+  EXPECT_EQ(msg.DataLength(), 254);
+  EXPECT_TRUE(msg.Sync());
+  EXPECT_FALSE(msg.NullFrame());
+
+  std::vector<uint8_t> buffer;
+  msg.ToRaw(buffer);
+  ASSERT_EQ(buffer.size(), 34 + 254);
+
+  FlexRayFrame msg1;
+  ASSERT_EQ(msg1.Decode(buffer), BusDecodeStatus::Ok);
+  EXPECT_EQ(msg1.FrameId(), 1023);
+  EXPECT_EQ(msg1.Cycle(), 63);
+  EXPECT_EQ(msg1.Channel(), FlexRayChannel::B);
+  EXPECT_TRUE(msg1.Sync());
+  EXPECT_TRUE(msg1.Startup());
+  EXPECT_FALSE(msg1.Dir());
+  EXPECT_FALSE(msg1.PayloadPreamble());
+  EXPECT_EQ(msg1.HeaderCrc(), 0x7FF);
+  EXPECT_EQ(msg1.Crc(), 0xABCDEF);
+  EXPECT_EQ(msg1.FrameDuration(), 5'000);
+  EXPECT_TRUE(std::ranges::equal(msg1.DataBytes(), data));
+
+  // Data length outside the message.
+  buffer.resize(40);
+  FlexRayFrame msg2;
+  EXPECT_NE(msg2.Decode(buffer), BusDecodeStatus::Ok);
+  EXPECT_FALSE(msg2.Valid());
+
+  EXPECT_EQ(BusLogStream::ErrorCount(), 0);
+  BusLogStream::UserLogFunction = BusLogStream::BusNoLogFunction;
+}
+
+}  // namespace bus
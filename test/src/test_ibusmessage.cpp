@@ -7,6 +7,8 @@
 
 #include "bus/ibusmessage.h"
 #include "bus/buslogstream.h"
+#include "bus/candataframe.h"
+#include "bus/ethernetframe.h"
 
 namespace bus {
 
@@ -89,4 +91,38 @@ TEST(IBusMessage, TestValid) {
   BusLogStream::UserLogFunction = BusLogStream::BusNoLogFunction;
 }
 
+TEST(IBusMessage, TestCreate) {
+  for (const auto type : {BusMessageType::CAN_DataFrame,
+                          BusMessageType::LIN_Frame,
+                          BusMessageType::FlexRay_Frame,
+                          BusMessageType::MOST_Message,
+                          BusMessageType::ETH_Frame,
+                          BusMessageType::Unknown,
+                          static_cast<BusMessageType>(1'000)}) {
+    const auto msg = IBusMessage::Create(type);
+    ASSERT_TRUE(msg);
+    EXPECT_EQ(msg->Type(), type);
+  }
+  EXPECT_TRUE(std::dynamic_pointer_cast<EthernetFrame>(
+      IBusMessage::Create(BusMessageType::ETH_Frame)));
+
+  // Application specific type
+  constexpr auto kUserType = static_cast<BusMessageType>(200);
+  EXPECT_FALSE(std::dynamic_pointer_cast<CanDataFrame>(
+      IBusMessage::Create(kUserType)));
+  EXPECT_TRUE(IBusMessage::Register(kUserType, [] ()
+      -> std::shared_ptr<IBusMessage> {
+    return std::make_shared<CanDataFrame>();
+  }));
+  EXPECT_TRUE(std::dynamic_pointer_cast<CanDataFrame>(
+      IBusMessage::Create(kUserType)));
+  EXPECT_TRUE(IBusMessage::Register(kUserType, nullptr));
+  EXPECT_FALSE(std::dynamic_pointer_cast<CanDataFrame>(
+      IBusMessage::Create(kUserType)));
+
+  EXPECT_FALSE(IBusMessage::Register(static_cast<BusMessageType>(1'000),
+                                     nullptr));
+  EXPECT_FALSE(IBusMessage::Register(BusMessageType::Unknown, nullptr));
+}
+
 }
@@ -20,6 +20,10 @@ TEST(IBusMessageBroker, TestProperties) {
   broker.Name("Olle");
   EXPECT_EQ(broker.Name(), "Olle");
 
+  EXPECT_EQ(broker.Overrun(), OverrunPolicy::Block);
+  broker.Overrun(OverrunPolicy::Overwrite);
+  EXPECT_EQ(broker.Overrun(), OverrunPolicy::Overwrite);
+
   EXPECT_EQ(broker.NofPublishers(), 0);
   EXPECT_EQ(broker.NofSubscribers(), 0);
 
@@ -75,4 +79,77 @@ TEST(IBusMessageBroker, TestOneInOneOut) {
 
 }
 
-}
\ No newline at end of file
+TEST(IBusMessageBroker, TestSubscribe) {
+  constexpr size_t max_messages = 10'000;
+
+  IBusMessageBroker broker;
+  auto publisher = broker.CreatePublisher();
+
+  std::atomic<size_t> inline_count = 0;
+  BusMessageFilter channel_filter;
+  channel_filter.AddBusChannel(1);
+  auto inline_subscriber = broker.Subscribe(channel_filter,
+    [&] (const std::shared_ptr<IBusMessage>&) {
+      ++inline_count;
+    });
+  EXPECT_TRUE(inline_subscriber);
+
+  std::atomic<size_t> pool_count = 0;
+  auto pool_subscriber = broker.Subscribe({},
+    [&] (const std::shared_ptr<IBusMessage>&) {
+      ++pool_count;
+    }, broker.Executor());
+  EXPECT_TRUE(pool_subscriber);
+  EXPECT_EQ(broker.NofSubscribers(), 2);
+
+  broker.Start();
+  for (size_t index = 0; index < max_messages; ++index) {
+    auto msg = std::make_shared<IBusMessage>();
+    msg->BusChannel(index % 2 == 0 ? 1 : 2);
+    publisher->Push(msg);
+  }
+
+  size_t timeout = 0;
+  while ((inline_count < max_messages / 2 || pool_count < max_messages) &&
+         timeout < 100) {
+    std::this_thread::sleep_for(100ms);
+    ++timeout;
+  }
+  broker.Stop();
+
+  EXPECT_EQ(inline_count, max_messages / 2);
+  EXPECT_EQ(pool_count, max_messages);
+  EXPECT_TRUE(inline_subscriber->Empty());
+  EXPECT_TRUE(pool_subscriber->Empty());
+}
+
+TEST(IBusMessageBroker, TestDetachInCallback) {
+  IBusMessageBroker broker;
+  auto publisher = broker.CreatePublisher();
+
+  // The callback unsubscribes itself, which needs the queue mutex.
+  std::atomic<size_t> count = 0;
+  std::shared_ptr<IBusMessageQueue> subscriber;
+  subscriber = broker.Subscribe({},
+    [&] (const std::shared_ptr<IBusMessage>&) {
+      if (++count == 1) {
+        broker.DetachSubscriber(subscriber);
+      }
+    });
+  ASSERT_TRUE(subscriber);
+
+  broker.Start();
+  publisher->Push(std::make_shared<IBusMessage>());
+  for (size_t timeout = 0; timeout < 100 && broker.NofSubscribers() > 0;
+       ++timeout) {
+    std::this_thread::sleep_for(10ms);
+  }
+  EXPECT_EQ(broker.NofSubscribers(), 0);
+
+  publisher->Push(std::make_shared<IBusMessage>());
+  std::this_thread::sleep_for(100ms);
+  broker.Stop();
+  EXPECT_EQ(count, 1);
+}
+
+}
@@ -12,6 +12,7 @@
 #include <gtest/gtest.h>
 
 #include "bus/candataframe.h"
+#include "bus/ethernetframe.h"
 #include "bus/ibusmessagequeue.h"
 
 using namespace std::chrono_literals;
@@ -150,4 +151,200 @@ TEST(IBusMessageQueue, TestTenInTenOut) {
   EXPECT_EQ(kNofMessages, publishers.size() * kMaxMessage);
 }
 
+TEST(IBusMessageQueue, TestBatch) {
+  IBusMessageQueue queue;
+
+  std::vector<std::shared_ptr<IBusMessage>> input;
+  for (size_t index = 0; index < 10; ++index) {
+    input.push_back(std::make_shared<CanDataFrame>());
+  }
+  queue.PushBatch(input);
+  EXPECT_EQ(queue.Size(), 10);
+
+  std::vector<std::shared_ptr<IBusMessage>> output;
+  EXPECT_EQ(queue.PopBatch(output, 4), 4);
+  EXPECT_EQ(output.size(), 4);
+  EXPECT_EQ(output[0], input[0]);
+  EXPECT_EQ(queue.Size(), 6);
+
+  EXPECT_EQ(queue.PopBatchWait(output, 100, 10ms), 6);
+  EXPECT_EQ(output.size(), 10);
+  EXPECT_EQ(output[9], input[9]);
+  EXPECT_TRUE(queue.Empty());
+
+  EXPECT_EQ(queue.PopBatchWait(output, 100, 10ms), 0);
+  EXPECT_EQ(output.size(), 10);
+}
+
+TEST(IBusMessageQueue, TestReadInPlace) {
+  IBusMessageQueue queue;
+  for (size_t index = 0; index < 10; ++index) {
+    auto frame = std::make_shared<CanDataFrame>();
+    frame->MessageId(static_cast<uint32_t>(index));
+    queue.Push(frame);
+  }
+
+  std::vector<uint32_t> id_list;
+  const auto callback = [&] (std::span<const uint8_t> message) -> void {
+    CanDataFrame frame;
+    EXPECT_EQ(frame.Decode(message), BusDecodeStatus::Ok);
+    id_list.push_back(frame.MessageId());
+  };
+  EXPECT_EQ(queue.ReadInPlace(callback, 4), 4);
+  EXPECT_EQ(queue.ReadInPlace(callback), 6);
+  EXPECT_EQ(queue.ReadInPlace(callback), 0);
+  EXPECT_EQ(queue.ReadInPlace({}), 0);
+  ASSERT_EQ(id_list.size(), 10);
+  EXPECT_EQ(id_list[9], 9);
+  EXPECT_TRUE(queue.Empty());
+}
+
+TEST(IBusMessageQueue, TestMaxSize) {
+  IBusMessageQueue queue;
+  EXPECT_EQ(queue.MaxSize(), 0);
+  queue.MaxSize(5);
+  EXPECT_EQ(queue.MaxSize(), 5);
+  for (uint32_t index = 0; index < 8; ++index) {
+    auto frame = std::make_shared<CanDataFrame>();
+    frame->MessageId(index);
+    queue.Push(frame);
+  }
+  EXPECT_EQ(queue.Size(), 5);
+  EXPECT_EQ(queue.LostMessages(), 3);
+  auto first = std::dynamic_pointer_cast<CanDataFrame>(queue.Pop());
+  ASSERT_TRUE(first);
+  EXPECT_EQ(first->MessageId(), 3); // Oldest are dropped
+
+  queue.Clear();
+  queue.MaxSize(10, QueueFullPolicy::LatestPerId);
+  std::vector<std::shared_ptr<IBusMessage>> input;
+  for (uint32_t index = 0; index < 12; ++index) {
+    auto frame = std::make_shared<CanDataFrame>();
+    frame->MessageId(index % 3);
+    frame->DataBytes({static_cast<uint8_t>(index)});
+    input.push_back(frame);
+  }
+  queue.PushBatch(input);
+  // Only the latest frame of each ID is kept.
+  ASSERT_EQ(queue.Size(), 3);
+  std::vector<std::shared_ptr<IBusMessage>> output;
+  queue.PopBatch(output, 10);
+  for (size_t index = 0; index < output.size(); ++index) {
+    const auto frame = std::dynamic_pointer_cast<CanDataFrame>(output[index]);
+    ASSERT_TRUE(frame);
+    EXPECT_EQ(frame->MessageId(), index);
+    EXPECT_EQ(frame->DataBytes()[0], 9 + index);
+  }
+
+  // More IDs than room in the queue.
+  input.clear();
+  for (uint32_t index = 0; index < 20; ++index) {
+    auto frame = std::make_shared<CanDataFrame>();
+    frame->MessageId(index);
+    input.push_back(frame);
+  }
+  queue.PushBatch(input);
+  // Trimmed to 3/4 of the max size, leaving room for the next pushes.
+  EXPECT_EQ(queue.Size(), 8);
+  output.clear();
+  queue.PopBatch(output, 10);
+  ASSERT_FALSE(output.empty());
+  EXPECT_EQ(std::dynamic_pointer_cast<CanDataFrame>(output.back())->MessageId(),
+            19);
+
+  // Messages without frame ID are never collapsed.
+  input.clear();
+  for (uint32_t index = 0; index < 8; ++index) {
+    auto frame = std::make_shared<EthernetFrame>();
+    frame->BusChannel(1);
+    input.push_back(frame);
+  }
+  for (uint32_t index = 0; index < 3; ++index) {
+    auto frame = std::make_shared<CanDataFrame>();
+    frame->MessageId(1);
+    input.push_back(frame);
+  }
+  queue.PushBatch(input);
+  EXPECT_EQ(queue.Size(), 8);
+  output.clear();
+  queue.PopBatch(output, 10);
+  ASSERT_EQ(output.size(), 8);
+  EXPECT_EQ(output.back()->Type(), BusMessageType::CAN_DataFrame);
+  EXPECT_EQ(output.front()->Type(), BusMessageType::ETH_Frame);
+}
+
+TEST(IBusMessageQueue, TestSpinWait) {
+  IBusMessageQueue queue;
+  QueueWaitOptions options;
+  options.strategy = WaitStrategy::Spin;
+  options.cpu = 0;
+  queue.WaitOptions(options);
+  EXPECT_EQ(queue.WaitOptions().strategy, WaitStrategy::Spin);
+  EXPECT_EQ(queue.WaitOptions().cpu, 0);
+
+  // An empty queue still returns after the wait time.
+  const auto start = std::chrono::steady_clock::now();
+  EXPECT_FALSE(queue.PopWait(10ms));
+  EXPECT_LT(std::chrono::steady_clock::now() - start, 1s);
+
+  constexpr size_t kNofFrames = 1'000;
+  std::thread publisher([&] () -> void {
+    for (uint32_t index = 0; index < kNofFrames; ++index) {
+      auto frame = std::make_shared<CanDataFrame>();
+      frame->MessageId(index);
+      queue.Push(frame);
+    }
+  });
+  std::vector<std::shared_ptr<IBusMessage>> messages;
+  for (size_t timeout = 0; messages.size() < kNofFrames && timeout < 1'000;
+       ++timeout) {
+    queue.PopBatchWait(messages, kNofFrames, 10ms);
+  }
+  publisher.join();
+  ASSERT_EQ(messages.size(), kNofFrames);
+  const auto last = std::dynamic_pointer_cast<CanDataFrame>(messages.back());
+  ASSERT_TRUE(last);
+  EXPECT_EQ(last->MessageId(), kNofFrames - 1);
+}
+
+TEST(IBusMessageQueue, TestFilter) {
+  IBusMessageQueue queue;
+  queue.MaxSize(5);
+  for (uint32_t index = 0; index < 4; ++index) {
+    auto frame = std::make_shared<CanDataFrame>();
+    frame->MessageId(index);
+    queue.Push(frame);
+  }
+  // Queued messages that don't pass are removed.
+  BusMessageFilter filter;
+  filter.CanIds().AddId(1);
+  queue.Filter(filter);
+  EXPECT_EQ(queue.Size(), 1);
+
+  // Dropped messages don't count as lost.
+  std::vector<uint8_t> raw;
+  for (uint32_t index = 0; index < 20; ++index) {
+    CanDataFrame frame;
+    frame.MessageId(index % 2);
+    frame.ToRaw(raw);
+    queue.Push(raw);
+  }
+  EXPECT_EQ(queue.Size(), 5);
+  EXPECT_EQ(queue.LostMessages(), 6);
+
+  queue.Clear();
+  std::vector<std::shared_ptr<IBusMessage>> input;
+  for (uint32_t index = 0; index < 4; ++index) {
+    auto frame = std::make_shared<CanDataFrame>();
+    frame->MessageId(index);
+    input.push_back(frame);
+  }
+  queue.PushBatch(input);
+  EXPECT_EQ(queue.Size(), 1);
+
+  queue.Filter(BusMessageFilter());
+  queue.PushBatch(input);
+  EXPECT_EQ(queue.Size(), 5);
+}
+
 }
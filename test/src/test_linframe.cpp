@@ -0,0 +1,80 @@
+/*
+* Copyright 2025 Ingemar Hedvall
+* SPDX-License-Identifier: MIT
+ */
+
+#include <gtest/gtest.h>
+
+#include "bus/linframe.h"
+#include "bus/buslogstream.h"
+
+namespace bus {
+
+TEST(LinFrame, TestProperties) {
+  LinFrame msg;
+  EXPECT_EQ(msg.Type(), BusMessageType::LIN_Frame);
+  EXPECT_EQ(msg.Size(), 26);
+
+  msg.FrameId(0xFF); // Only 6 bits
+  EXPECT_EQ(msg.FrameId(), 0x3F);
+  msg.FrameId(0x10);
+  EXPECT_EQ(msg.ProtectedId(), 0x50);
+
+  const std::vector<uint8_t> data = {1,2,3,4,5,6,7,8,9};
+  msg.DataBytes(data);
+  EXPECT_EQ(msg.DataLength(), 8);
+  EXPECT_EQ(msg.Size(), 26 + 8);
+
+  // Classic checksum: the inverted sum with carry.
+  const std::vector<uint8_t> classic = {0x4A, 0x55, 0x93, 0xE5};
+  msg.DataBytes(classic);
+  msg.EnhancedChecksum(false);
+  EXPECT_EQ(msg.CalculateChecksum(), 0xE6);
+}
+
+TEST(LinFrame, TestSerialize) {
+  BusLogStream::UserLogFunction = BusLogStream::BusConsoleLogFunction;
+  BusLogStream::ResetErrorCount();
+
+  LinFrame msg;
+  msg.BusChannel(3);
+  msg.FrameId(0x21);
+  msg.DataBytes(std::vector<uint8_t>{1, 2, 3});
+  msg.Checksum(msg.CalculateChecksum());
+  msg.Dir(true);
+  msg.FrameDuration(1234);
+
+  std::vector<uint8_t> buffer;
+  msg.ToRaw(buffer);
+  ASSERT_EQ(buffer.size(), 26 + 3);
+
+  const auto msg1 = IBusMessage::Create(BusMessageType::LIN_Frame);
+  ASSERT_EQ(msg1->Decode(buffer), BusDecodeStatus::Ok);
+  const auto* lin = dynamic_cast<const LinFrame*>(msg1.get());
+  ASSERT_TRUE(lin != nullptr);
+  EXPECT_EQ(lin->BusChannel(), 3);
+  EXPECT_EQ(lin->FrameId(), 0x21);
+  EXPECT_EQ(lin->Checksum(), msg.Checksum());
+  EXPECT_TRUE(lin->Dir());
+  EXPECT_TRUE(lin->EnhancedChecksum());
+  EXPECT_EQ(lin->FrameDuration(), 1234);
+  ASSERT_EQ(lin->DataLength(), 3);
+  EXPECT_EQ(lin->DataBytes()[2], 3);
+
+  // Data length above 8 bytes.
+  auto invalid = buffer;
+  invalid[19] = 9;
+  LinFrame msg2;
+  EXPECT_EQ(msg2.Decode(invalid), BusDecodeStatus::InvalidData);
+
+  for (size_t size = 0; size < buffer.size(); ++size) {
+    LinFrame msg3;
+    EXPECT_NE(msg3.Decode(std::span(buffer.data(), size)),
+              BusDecodeStatus::Ok) << size;
+  }
+
+  EXPECT_EQ(BusLogStream::ErrorCount(), 0);
+  BusLogStream::UserLogFunction = BusLogStream::BusNoLogFunction;
+}
+
+}  // namespace bus
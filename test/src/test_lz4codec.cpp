@@ -0,0 +1,82 @@
+/*
+* Copyright 2025 Ingemar Hedvall
+* SPDX-License-Identifier: MIT
+ */
+
+#include <gtest/gtest.h>
+
+#include <random>
+
+#include "bus/lz4codec.h"
+#include "bus/candataframe.h"
+
+namespace bus {
+
+TEST(Lz4Codec, TestRoundTrip) {
+  std::mt19937 random(4711);
+  std::vector<std::vector<uint8_t>> inputs;
+  inputs.emplace_back(); // Empty
+  inputs.emplace_back(std::vector<uint8_t>{1, 2, 3});
+  inputs.emplace_back(std::vector<uint8_t>(100'000, 0x55));
+  std::vector<uint8_t> noise(10'000);
+  for (auto& byte : noise) {
+    byte = static_cast<uint8_t>(random());
+  }
+  inputs.push_back(noise);
+
+  std::vector<uint8_t> compressed;
+  std::vector<uint8_t> output;
+  for (const auto& input : inputs) {
+    Lz4Codec::Compress(input, compressed);
+    EXPECT_LE(compressed.size(), Lz4Codec::MaxCompressedSize(input.size()));
+    ASSERT_TRUE(Lz4Codec::Decompress(compressed, input.size(), output))
+        << input.size();
+    EXPECT_EQ(output, input);
+  }
+}
+
+TEST(Lz4Codec, TestCanFrames) {
+  // A stream of CAN frames where the IDs and payloads repeats.
+  std::vector<uint8_t> stream;
+  std::vector<uint8_t> raw;
+  CanDataFrame frame;
+  for (uint64_t index = 0; index < 1'000; ++index) {
+    frame.Timestamp(1'700'000'000'000'000'000 + (index * 1'000'000));
+    frame.MessageId(0x100 + (index % 10));
+    frame.DataBytes({0, 0, 0, 0, static_cast<uint8_t>(index % 4), 0, 0, 0});
+    frame.ToRaw(raw);
+    stream.insert(stream.end(), raw.begin(), raw.end());
+  }
+
+  std::vector<uint8_t> compressed;
+  Lz4Codec::Compress(stream, compressed);
+  EXPECT_LT(compressed.size() * 3, stream.size());
+
+  std::vector<uint8_t> output;
+  ASSERT_TRUE(Lz4Codec::Decompress(compressed, stream.size(), output));
+  EXPECT_EQ(output, stream);
+}
+
+TEST(Lz4Codec, TestCorrupt) {
+  std::vector<uint8_t> input(1'000);
+  for (size_t index = 0; index < input.size(); ++index) {
+    input[index] = static_cast<uint8_t>(index % 7);
+  }
+  std::vector<uint8_t> compressed;
+  Lz4Codec::Compress(input, compressed);
+
+  std::vector<uint8_t> output;
+  EXPECT_FALSE(Lz4Codec::Decompress(compressed, input.size() - 1, output));
+  EXPECT_FALSE(Lz4Codec::Decompress(compressed, input.size() + 1, output));
+  for (size_t size = 0; size < compressed.size(); ++size) {
+    const std::span<const uint8_t> truncated(compressed.data(), size);
+    EXPECT_FALSE(Lz4Codec::Decompress(truncated, input.size(), output))
+        << size;
+  }
+
+  // Offset before the start of the output.
+  const std::vector<uint8_t> invalid = {0x10, 0xAA, 0xFF, 0x00, 0x00};
+  EXPECT_FALSE(Lz4Codec::Decompress(invalid, 10, output));
+}
+
+}  // namespace bus
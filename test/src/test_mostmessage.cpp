@@ -0,0 +1,49 @@
+/*
+* Copyright 2025 Ingemar Hedvall
+* SPDX-License-Identifier: MIT
+ */
+
+#include <gtest/gtest.h>
+
+#include "bus/mostmessage.h"
+#include "bus/buslogstream.h"
+
+namespace bus {
+
+TEST(MostMessage, TestSerialize) {
+  BusLogStream::UserLogFunction = BusLogStream::BusConsoleLogFunction;
+  BusLogStream::ResetErrorCount();
+
+  MostMessage msg;
+  EXPECT_EQ(msg.Type(), BusMessageType::MOST_Message);
+  EXPECT_EQ(msg.Size(), 26);
+
+  msg.Source(0x0101);
+  msg.Destination(0x0172);
+  msg.Packet(true);
+  msg.TransmissionStatus(0x20);
+  const std::vector<uint8_t> data = {0x52, 0x01, 0x0C, 0x00, 0x11};
+  msg.DataBytes(data);
+
+  std::vector<uint8_t> buffer;
+  msg.ToRaw(buffer);
+  ASSERT_EQ(buffer.size(), 26 + data.size());
+
+  MostMessage msg1;
+  ASSERT_EQ(msg1.Decode(buffer), BusDecodeStatus::Ok);
+  EXPECT_EQ(msg1.Source(), 0x0101);
+  EXPECT_EQ(msg1.Destination(), 0x0172);
+  EXPECT_TRUE(msg1.Packet());
+  EXPECT_FALSE(msg1.Dir());
+  EXPECT_EQ(msg1.TransmissionStatus(), 0x20);
+  EXPECT_EQ(msg1.DataBytes(), data);
+
+  buffer.pop_back();
+  MostMessage msg2;
+  EXPECT_NE(msg2.Decode(buffer), BusDecodeStatus::Ok);
+
+  EXPECT_EQ(BusLogStream::ErrorCount(), 0);
+  BusLogStream::UserLogFunction = BusLogStream::BusNoLogFunction;
+}
+
+}  // namespace bus
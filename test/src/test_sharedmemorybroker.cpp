@@ -4,6 +4,7 @@
  */
 
 #include <chrono>
+#include <iostream>
 #include <algorithm>
 #include <array>
 #include <memory>
@@ -13,6 +14,8 @@
 #include "bus/interface/businterfacefactory.h"
 #include "bus/buslogstream.h"
 #include "bus/candataframe.h"
+#include "bus/ethernetframe.h"
+#include "sharedmemoryoptions.h"
 
 using namespace std::chrono_literals;
 
@@ -117,6 +120,503 @@ TEST(SharedMemoryBroker, TestOneInOneOut) {
   BusLogStream::UserLogFunction = BusLogStream::BusNoLogFunction;
 }
 
+TEST(SharedMemoryBroker, TestMemoryOptions) {
+  BusLogStream::UserLogFunction = BusLogStream::BusConsoleLogFunction;
+  BusLogStream::ResetErrorCount();
+
+  constexpr size_t max_messages = 1'000;
+
+  auto broker = BusInterfaceFactory::CreateBroker(
+    BrokerType::SharedMemoryBrokerType);
+  ASSERT_TRUE(broker);
+  broker->Name("BusMemTest");
+
+  // The options are only hints. A sandbox without huge pages, NUMA or
+  // mlock rights only generate warnings.
+  SharedMemoryOptions options;
+  options.huge_pages = true;
+  options.prefault = true;
+  options.lock = true;
+  options.numa_node = 0;
+  broker->MemoryOptions(options);
+  EXPECT_TRUE(broker->MemoryOptions().huge_pages);
+  // The segment is only rounded up if the huge pages are used.
+  EXPECT_EQ(SegmentSize(1'000, options),
+            HugePagesEnabled() ? size_t{2 * 1024 * 1024} : size_t{1'000});
+  EXPECT_EQ(broker->MemoryOptions().numa_node, 0);
+  broker->Start();
+  EXPECT_TRUE(broker->IsConnected());
+
+  auto publisher = broker->CreatePublisher();
+  ASSERT_TRUE(publisher);
+  publisher->Start();
+
+  auto subscriber = broker->CreateSubscriber();
+  ASSERT_TRUE(subscriber);
+  subscriber->Start();
+
+  for (size_t index = 0; index < max_messages; ++index) {
+    auto msg = std::make_shared<CanDataFrame>();
+    msg->MessageId(123);
+    publisher->Push(msg);
+  }
+
+  for (size_t timeout = 0;
+       subscriber->Size() < max_messages && timeout < 100; ++timeout) {
+    std::this_thread::sleep_for(100ms);
+  }
+  EXPECT_EQ(subscriber->Size(), max_messages);
+
+  publisher->Stop();
+  subscriber->Stop();
+  broker->Stop();
+
+  EXPECT_EQ(BusLogStream::ErrorCount(), 0);
+  BusLogStream::UserLogFunction = BusLogStream::BusNoLogFunction;
+}
+
+TEST(SharedMemoryBroker, TestSpinWait) {
+  BusLogStream::UserLogFunction = BusLogStream::BusConsoleLogFunction;
+  BusLogStream::ResetErrorCount();
+
+  constexpr size_t max_messages = 1'000;
+
+  auto broker = BusInterfaceFactory::CreateBroker(
+    BrokerType::SharedMemoryBrokerType);
+  ASSERT_TRUE(broker);
+  broker->Name("BusMemTest");
+  broker->Start();
+  EXPECT_TRUE(broker->IsConnected());
+
+  QueueWaitOptions options;
+  options.strategy = WaitStrategy::Spin;
+
+  auto publisher = broker->CreatePublisher();
+  ASSERT_TRUE(publisher);
+  publisher->WaitOptions(options);
+  publisher->Start();
+
+  auto subscriber = broker->CreateSubscriber();
+  ASSERT_TRUE(subscriber);
+  subscriber->WaitOptions(options);
+  subscriber->Start();
+
+  // Ping one message at a time and measure the latency.
+  std::vector<std::chrono::nanoseconds> latencies;
+  for (size_t index = 0; index < max_messages; ++index) {
+    auto msg = std::make_shared<CanDataFrame>();
+    msg->MessageId(123);
+    const auto start = std::chrono::steady_clock::now();
+    publisher->Push(msg);
+    auto received = subscriber->PopWait(1s);
+    if (!received) {
+      break;
+    }
+    latencies.push_back(std::chrono::steady_clock::now() - start);
+  }
+  ASSERT_EQ(latencies.size(), max_messages);
+  std::ranges::sort(latencies);
+  std::cout << "Median latency: "
+            << latencies[latencies.size() / 2].count() / 1'000.0 << " us"
+            << std::endl;
+
+  publisher->Stop();
+  subscriber->Stop();
+  broker->Stop();
+
+  EXPECT_EQ(BusLogStream::ErrorCount(), 0);
+  BusLogStream::UserLogFunction = BusLogStream::BusNoLogFunction;
+}
+
+TEST(SharedMemoryBroker, TestSpinWaitPartitions) {
+  BusLogStream::UserLogFunction = BusLogStream::BusConsoleLogFunction;
+  BusLogStream::ResetErrorCount();
+
+  constexpr size_t max_messages = 100;
+
+  auto broker = BusInterfaceFactory::CreateBroker(
+    BrokerType::SharedMemoryBrokerType);
+  ASSERT_TRUE(broker);
+  broker->Name("BusMemTest");
+  broker->Partitions(4);
+  broker->Start();
+  EXPECT_TRUE(broker->IsConnected());
+
+  auto publisher = broker->CreatePublisher();
+  ASSERT_TRUE(publisher);
+  publisher->Start();
+
+  // The subscriber sleeps directly, so a commit in any partition must wake
+  // it well before the sleep time.
+  QueueWaitOptions options;
+  options.strategy = WaitStrategy::Spin;
+  options.spin_count = 0;
+  options.yield_count = 0;
+  options.sleep_time = 1s;
+  auto subscriber = broker->CreateSubscriber();
+  ASSERT_TRUE(subscriber);
+  subscriber->WaitOptions(options);
+  subscriber->Start();
+
+  std::vector<std::chrono::nanoseconds> latencies;
+  for (size_t index = 0; index < max_messages; ++index) {
+    auto msg = std::make_shared<CanDataFrame>();
+    msg->MessageId(123);
+    msg->BusChannel(static_cast<uint16_t>((index % 4) + 1));
+    const auto start = std::chrono::steady_clock::now();
+    publisher->Push(msg);
+    auto received = subscriber->PopWait(2s);
+    if (!received) {
+      break;
+    }
+    EXPECT_EQ(received->BusChannel(), msg->BusChannel());
+    latencies.push_back(std::chrono::steady_clock::now() - start);
+  }
+  ASSERT_EQ(latencies.size(), max_messages);
+  std::ranges::sort(latencies);
+  std::cout << "Median latency: "
+            << latencies[latencies.size() / 2].count() / 1'000.0 << " us"
+            << std::endl;
+  EXPECT_LT(latencies.back(), 500ms);
+
+  publisher->Stop();
+  subscriber->Stop();
+  broker->Stop();
+
+  EXPECT_EQ(BusLogStream::ErrorCount(), 0);
+  BusLogStream::UserLogFunction = BusLogStream::BusNoLogFunction;
+}
+
+TEST(SharedMemoryBroker, TestPartitions) {
+  BusLogStream::UserLogFunction = BusLogStream::BusConsoleLogFunction;
+  BusLogStream::ResetErrorCount();
+
+  constexpr size_t max_messages = 1'000;
+
+  auto broker = BusInterfaceFactory::CreateBroker(
+    BrokerType::SharedMemoryBrokerType);
+  ASSERT_TRUE(broker);
+  broker->Name("BusMemTest");
+  EXPECT_EQ(broker->Partitions(), 1);
+  EXPECT_EQ(broker->PartitionBy(), PartitionKey::BusChannel);
+  broker->Partitions(0);
+  EXPECT_EQ(broker->Partitions(), 1);
+  broker->Partitions(4);
+  EXPECT_EQ(broker->Partitions(), 4);
+  broker->Start();
+  EXPECT_TRUE(broker->IsConnected());
+
+  auto publisher = broker->CreatePublisher();
+  ASSERT_TRUE(publisher);
+  publisher->Start();
+
+  // Each bus channel subscriber only attach to its own partition.
+  std::array<std::shared_ptr<IBusMessageQueue>, 2> channel_subscribers;
+  for (uint16_t channel = 0; channel < channel_subscribers.size(); ++channel) {
+    BusMessageFilter filter;
+    filter.AddBusChannel(channel + 1);
+    auto& subscriber = channel_subscribers[channel];
+    subscriber = broker->CreateSubscriber(filter);
+    ASSERT_TRUE(subscriber);
+    subscriber->Start();
+  }
+  auto subscriber = broker->CreateSubscriber();
+  ASSERT_TRUE(subscriber);
+  subscriber->Start();
+
+  for (size_t index = 0; index < max_messages; ++index) {
+    auto msg = std::make_shared<CanDataFrame>();
+    msg->MessageId(123);
+    msg->BusChannel(static_cast<uint16_t>((index % 2) + 1));
+    publisher->Push(msg);
+  }
+
+  for (size_t timeout = 0;
+       subscriber->Size() < max_messages && timeout < 100; ++timeout) {
+    std::this_thread::sleep_for(100ms);
+  }
+  EXPECT_EQ(subscriber->Size(), max_messages);
+  for (uint16_t channel = 0; channel < channel_subscribers.size(); ++channel) {
+    auto& channel_subscriber = channel_subscribers[channel];
+    EXPECT_EQ(channel_subscriber->Size(), max_messages / 2);
+    for (auto msg = channel_subscriber->Pop(); msg;
+         msg = channel_subscriber->Pop()) {
+      EXPECT_EQ(msg->BusChannel(), channel + 1);
+    }
+  }
+
+  publisher->Stop();
+  subscriber->Stop();
+  for (auto& channel_subscriber : channel_subscribers) {
+    channel_subscriber->Stop();
+  }
+  broker->Stop();
+
+  EXPECT_EQ(BusLogStream::ErrorCount(), 0);
+  BusLogStream::UserLogFunction = BusLogStream::BusNoLogFunction;
+}
+
+TEST(SharedMemoryBroker, TestBlockedPartition) {
+  BusLogStream::UserLogFunction = BusLogStream::BusConsoleLogFunction;
+  BusLogStream::ResetErrorCount();
+
+  constexpr size_t max_messages = 100;
+
+  auto broker = BusInterfaceFactory::CreateBroker(
+    BrokerType::SharedMemoryBrokerType);
+  ASSERT_TRUE(broker);
+  broker->Name("BusMemTest");
+  broker->Partitions(2);
+  EXPECT_EQ(broker->Overrun(), OverrunPolicy::Block);
+  broker->Start();
+
+  auto publisher = broker->CreatePublisher();
+  ASSERT_TRUE(publisher);
+  publisher->Start();
+
+  // The in-place subscriber never reads, so it blocks its partition.
+  BusMessageFilter slow_filter;
+  slow_filter.AddBusChannel(1);
+  auto slow_subscriber = broker->CreateSubscriber(slow_filter);
+  ASSERT_TRUE(slow_subscriber);
+  slow_subscriber->Start();
+  slow_subscriber->ReadInPlace([] (std::span<const uint8_t>) -> void {});
+
+  BusMessageFilter fast_filter;
+  fast_filter.AddBusChannel(2);
+  auto fast_subscriber = broker->CreateSubscriber(fast_filter);
+  ASSERT_TRUE(fast_subscriber);
+  fast_subscriber->Start();
+
+  // Fills the blocked partition before the other partition's messages.
+  for (size_t index = 0; index < 10 * broker->MemorySize() / 32; ++index) {
+    auto msg = std::make_shared<CanDataFrame>();
+    msg->BusChannel(1);
+    publisher->Push(msg);
+  }
+  for (size_t index = 0; index < max_messages; ++index) {
+    auto msg = std::make_shared<CanDataFrame>();
+    msg->BusChannel(2);
+    publisher->Push(msg);
+  }
+
+  // Well before the 10 s timeout that skips the slow subscriber.
+  for (size_t timeout = 0;
+       fast_subscriber->Size() < max_messages && timeout < 30; ++timeout) {
+    std::this_thread::sleep_for(100ms);
+  }
+  EXPECT_EQ(fast_subscriber->Size(), max_messages);
+  EXPECT_EQ(fast_subscriber->LostMessages(), 0);
+
+  publisher->Stop();
+  slow_subscriber->Stop();
+  fast_subscriber->Stop();
+  broker->Stop();
+
+  EXPECT_EQ(BusLogStream::ErrorCount(), 0);
+  BusLogStream::UserLogFunction = BusLogStream::BusNoLogFunction;
+}
+
+TEST(SharedMemoryBroker, TestReadInPlace) {
+  BusLogStream::UserLogFunction = BusLogStream::BusConsoleLogFunction;
+  BusLogStream::ResetErrorCount();
+
+  constexpr size_t max_messages = 1'000;
+
+  auto broker = BusInterfaceFactory::CreateBroker(
+    BrokerType::SharedMemoryBrokerType);
+  ASSERT_TRUE(broker);
+  broker->Name("BusMemTest");
+  broker->Start();
+
+  auto publisher = broker->CreatePublisher();
+  ASSERT_TRUE(publisher);
+  publisher->Start();
+
+  auto subscriber = broker->CreateSubscriber();
+  ASSERT_TRUE(subscriber);
+  subscriber->Start();
+
+  // A bus-load monitor only counts the bytes.
+  size_t nof_messages = 0;
+  size_t nof_bytes = 0;
+  const auto monitor = [&] (std::span<const uint8_t> message) -> void {
+    ++nof_messages;
+    nof_bytes += message.size();
+  };
+  subscriber->ReadInPlace(monitor);
+
+  for (size_t index = 0; index < max_messages; ++index) {
+    auto msg = std::make_shared<CanDataFrame>();
+    msg->MessageId(123);
+    publisher->Push(msg);
+  }
+
+  for (size_t timeout = 0; nof_messages < max_messages && timeout < 1000;
+       ++timeout) {
+    subscriber->ReadInPlace(monitor);
+    std::this_thread::sleep_for(10ms);
+  }
+  EXPECT_EQ(nof_messages, max_messages);
+  EXPECT_EQ(nof_bytes, max_messages * CanDataFrame().Size());
+  EXPECT_TRUE(subscriber->Empty()); // Nothing copied to the queue.
+
+  publisher->Stop();
+  subscriber->Stop();
+  broker->Stop();
+
+  EXPECT_EQ(BusLogStream::ErrorCount(), 0);
+  BusLogStream::UserLogFunction = BusLogStream::BusNoLogFunction;
+}
+
+TEST(SharedMemoryBroker, TestReadInPlaceUnlocked) {
+  BusLogStream::UserLogFunction = BusLogStream::BusConsoleLogFunction;
+  BusLogStream::ResetErrorCount();
+
+  auto broker = BusInterfaceFactory::CreateBroker(
+    BrokerType::SharedMemoryBrokerType);
+  ASSERT_TRUE(broker);
+  broker->Name("BusMemTest");
+  broker->Start();
+
+  auto publisher = broker->CreatePublisher();
+  ASSERT_TRUE(publisher);
+  publisher->Start();
+
+  auto in_place = broker->CreateSubscriber();
+  ASSERT_TRUE(in_place);
+  in_place->Start();
+  auto subscriber = broker->CreateSubscriber();
+  ASSERT_TRUE(subscriber);
+  subscriber->Start();
+  in_place->ReadInPlace([] (std::span<const uint8_t>) -> void {});
+
+  auto msg = std::make_shared<CanDataFrame>();
+  msg->MessageId(123);
+  publisher->Push(msg);
+
+  // The publishers are not blocked by a slow callback.
+  bool published = false;
+  const auto callback = [&] (std::span<const uint8_t>) -> void {
+    if (published) {
+      return;
+    }
+    publisher->Push(msg);
+    for (size_t timeout = 0; subscriber->Size() < 2 && timeout < 200;
+         ++timeout) {
+      std::this_thread::sleep_for(10ms);
+    }
+    published = subscriber->Size() >= 2;
+  };
+  size_t count = 0;
+  for (size_t timeout = 0; count < 2 && timeout < 500; ++timeout) {
+    count += in_place->ReadInPlace(callback);
+    std::this_thread::sleep_for(10ms);
+  }
+  EXPECT_TRUE(published);
+  EXPECT_EQ(count, 2);
+
+  publisher->Stop();
+  in_place->Stop();
+  subscriber->Stop();
+  broker->Stop();
+
+  EXPECT_EQ(BusLogStream::ErrorCount(), 0);
+  BusLogStream::UserLogFunction = BusLogStream::BusNoLogFunction;
+}
+
+TEST(SharedMemoryBroker, TestReadInPlaceIdle) {
+  BusLogStream::UserLogFunction = BusLogStream::BusConsoleLogFunction;
+  BusLogStream::ResetErrorCount();
+
+  auto broker = BusInterfaceFactory::CreateBroker(
+    BrokerType::SharedMemoryBrokerType);
+  ASSERT_TRUE(broker);
+  broker->Name("BusMemTest");
+  broker->Start();
+
+  auto publisher = broker->CreatePublisher();
+  ASSERT_TRUE(publisher);
+  publisher->Start();
+
+  auto subscriber = broker->CreateSubscriber();
+  ASSERT_TRUE(subscriber);
+  subscriber->Start();
+
+  size_t nof_messages = 0;
+  const auto monitor = [&] (std::span<const uint8_t>) -> void {
+    ++nof_messages;
+  };
+  subscriber->ReadInPlace(monitor);
+
+  // Idles longer than the heartbeat timeout (3 s). The channel shall
+  // not be reclaimed.
+  std::this_thread::sleep_for(4s);
+
+  auto msg = std::make_shared<CanDataFrame>();
+  msg->MessageId(123);
+  publisher->Push(msg);
+  for (size_t timeout = 0; nof_messages < 1 && timeout < 200; ++timeout) {
+    subscriber->ReadInPlace(monitor);
+    std::this_thread::sleep_for(10ms);
+  }
+  EXPECT_EQ(nof_messages, 1);
+
+  publisher->Stop();
+  subscriber->Stop();
+  broker->Stop();
+
+  EXPECT_EQ(BusLogStream::ErrorCount(), 0);
+  BusLogStream::UserLogFunction = BusLogStream::BusNoLogFunction;
+}
+
+TEST(SharedMemoryBroker, TestJumboFrames) {
+  BusLogStream::UserLogFunction = BusLogStream::BusConsoleLogFunction;
+  BusLogStream::ResetErrorCount();
+
+  constexpr size_t max_messages = 1'000;
+
+  auto broker = BusInterfaceFactory::CreateBroker(
+    BrokerType::SharedMemoryBrokerType);
+  ASSERT_TRUE(broker);
+  broker->Name("BusMemTest");
+  broker->MemorySize(1'000'000);
+  broker->Start();
+  EXPECT_TRUE(broker->IsConnected());
+
+  auto publisher = broker->CreatePublisher();
+  ASSERT_TRUE(publisher);
+  publisher->Start();
+
+  auto subscriber = broker->CreateSubscriber();
+  ASSERT_TRUE(subscriber);
+  subscriber->Start();
+
+  const std::vector<uint8_t> data(EthernetFrame::kMaxDataLength, 0xAA);
+  for (size_t index = 0; index < max_messages; ++index) {
+    auto msg = std::make_shared<EthernetFrame>();
+    msg->DataBytes(data);
+    publisher->Push(msg);
+  }
+
+  for (size_t timeout = 0;
+       subscriber->Size() < max_messages && timeout < 100; ++timeout) {
+    std::this_thread::sleep_for(100ms);
+  }
+  EXPECT_EQ(subscriber->Size(), max_messages);
+  const auto msg = std::dynamic_pointer_cast<EthernetFrame>(
+      subscriber->Pop());
+  ASSERT_TRUE(msg);
+  EXPECT_EQ(msg->DataLength(), EthernetFrame::kMaxDataLength);
+
+  publisher->Stop();
+  subscriber->Stop();
+  broker->Stop();
+
+  EXPECT_EQ(BusLogStream::ErrorCount(), 0);
+  BusLogStream::UserLogFunction = BusLogStream::BusNoLogFunction;
+}
+
 TEST(SharedMemoryBroker, TestTenInTenOut) {
   BusLogStream::UserLogFunction = BusLogStream::BusConsoleLogFunction;
   BusLogStream::ResetErrorCount();
@@ -0,0 +1,557 @@
+/*
+* Copyright 2025 Ingemar Hedvall
+* SPDX-License-Identifier: MIT
+ */
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <boost/interprocess/sync/interprocess_mutex.hpp>
+#include <boost/interprocess/sync/scoped_lock.hpp>
+
+#include <gtest/gtest.h>
+
+#include "sharedmemoryring.h"
+#include "bus/candataframe.h"
+
+namespace {
+
+// Ring object followed by its channels and buffer, as in the shared memory.
+struct TestMemory {
+  explicit TestMemory(uint32_t max_subscribers, uint32_t buffer_size,
+      bus::OverrunPolicy policy = bus::OverrunPolicy::Overwrite,
+      bus::CommitSignal* segment_signal = nullptr)
+    : size(bus::DataOffset(sizeof(bus::SharedMemoryRing)) +
+           bus::SharedMemoryRing::DataSize(max_subscribers + 1,
+                                           buffer_size)),
+      memory(new (std::align_val_t(bus::kMemoryPageSize)) uint8_t[size]) {
+    ring = new (memory) bus::SharedMemoryRing();
+    ring->Init(max_subscribers, buffer_size, policy,
+               memory + bus::DataOffset(sizeof(bus::SharedMemoryRing)),
+               segment_signal);
+  }
+  ~TestMemory() {
+    ring->~SharedMemoryRing();
+    ::operator delete[](memory, std::align_val_t(bus::kMemoryPageSize));
+  }
+
+  size_t size = 0;
+  uint8_t* memory = nullptr;
+  bus::SharedMemoryRing* ring = nullptr;
+};
+
+}  // namespace
+
+using namespace std::chrono_literals;
+
+namespace bus {
+
+TEST(SharedMemoryRing, TestHeader) {
+  constexpr size_t kSize = 100'000;
+  SharedMemoryHeader header;
+  EXPECT_THROW(header.Validate("Olle", kSize), std::runtime_error);
+
+  header.Init(kSize, 1, 10, 16'000);
+  header.initialized = true;
+  EXPECT_NO_THROW(header.Validate("Olle", kSize));
+  EXPECT_EQ(header.max_subscribers, 10);
+  EXPECT_EQ(header.buffer_size, 16'000);
+
+  // Mapped region smaller than the segment or the header.
+  EXPECT_THROW(header.Validate("Olle", kSize - 1), std::runtime_error);
+  EXPECT_THROW(header.Validate("Olle", 8), std::runtime_error);
+
+  header.layout_version = kLayoutVersion + 1;
+  EXPECT_THROW(header.Validate("Olle", kSize), std::runtime_error);
+  header.layout_version = kLayoutVersion;
+
+  header.abi = SharedMemoryHeader::Abi() + 1;
+  EXPECT_THROW(header.Validate("Olle", kSize), std::runtime_error);
+  header.abi = SharedMemoryHeader::Abi();
+
+  header.magic = 0;
+  EXPECT_THROW(header.Validate("Olle", kSize), std::runtime_error);
+}
+
+TEST(SharedMemoryRing, TestChannels) {
+  TestMemory test(2, 1'000);
+  auto& ring = *test.ring;
+  EXPECT_EQ(ring.nof_channels, 3);
+  EXPECT_EQ(ring.Buffer().size(), 1'000);
+
+  // Each cursor on its own cache line and the data page aligned.
+  EXPECT_EQ(sizeof(RingChannel), kCacheLineSize);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(ring.Channels().data()) %
+            kMemoryPageSize, 0);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(ring.Buffer().data()) %
+            kMemoryPageSize, 0);
+
+  auto first = ring.AttachChannel();
+  auto second = ring.AttachChannel();
+  EXPECT_EQ(first.channel, 1);
+  EXPECT_EQ(second.channel, 2);
+  EXPECT_EQ(ring.AttachChannel().channel, 0); // No free channel
+  EXPECT_TRUE(ring.IsAttached(first));
+  EXPECT_EQ(ring.Channels()[first.channel].pid, CurrentProcessId());
+  EXPECT_EQ(first.pid, CurrentProcessId());
+
+  ring.DetachChannel(first);
+  EXPECT_FALSE(ring.IsAttached(first));
+  const auto again = ring.AttachChannel();
+  EXPECT_EQ(again.channel, first.channel);
+  EXPECT_NE(again.generation, first.generation);
+  EXPECT_FALSE(ring.IsAttached(first));
+}
+
+TEST(SharedMemoryRing, TestReclaimedChannel) {
+  TestMemory test(2, 1'000);
+  auto& ring = *test.ring;
+  auto old_owner = ring.AttachChannel();
+
+  CanDataFrame frame;
+  for (uint32_t index = 0; index < 5; ++index) {
+    frame.MessageId(index);
+    EXPECT_TRUE(ring.Write(frame));
+  }
+  std::vector<uint8_t> msg_buffer;
+  uint64_t nof_lost = 0;
+  EXPECT_TRUE(ring.Read(old_owner, msg_buffer, nof_lost));
+  EXPECT_TRUE(ring.Read(old_owner, msg_buffer, nof_lost));
+  EXPECT_EQ(old_owner.sequence, 2);
+
+  // The watchdog reclaims the channel of a paused process and a new
+  // subscriber gets the same channel.
+  ring.FreeChannel(old_owner.channel);
+  auto new_owner = ring.AttachChannel();
+  EXPECT_EQ(new_owner.channel, old_owner.channel);
+  EXPECT_FALSE(ring.IsAttached(old_owner));
+  EXPECT_TRUE(ring.IsAttached(new_owner));
+
+  // The old owner can neither move nor free the new owner's cursor.
+  std::span<const uint8_t> message;
+  EXPECT_FALSE(ring.Peek(old_owner, message, nof_lost));
+  EXPECT_FALSE(ring.Read(old_owner, msg_buffer, nof_lost));
+  ring.Advance(old_owner);
+  ring.Heartbeat(old_owner);
+  ring.DetachChannel(old_owner);
+  EXPECT_TRUE(ring.IsAttached(new_owner));
+  EXPECT_EQ(ring.Channels()[new_owner.channel].sequence, 0);
+
+  // The old owner continues where it was on a new channel.
+  EXPECT_TRUE(ring.Reattach(old_owner, nof_lost));
+  EXPECT_EQ(nof_lost, 0);
+  EXPECT_NE(old_owner.channel, new_owner.channel);
+  EXPECT_TRUE(ring.Read(old_owner, msg_buffer, nof_lost));
+  CanDataFrame read_frame;
+  EXPECT_EQ(read_frame.Decode(msg_buffer), BusDecodeStatus::Ok);
+  EXPECT_EQ(read_frame.MessageId(), 2);
+
+  // The messages it should continue at have been overwritten.
+  ring.FreeChannel(old_owner.channel);
+  for (uint32_t index = 0; index < 100; ++index) {
+    EXPECT_TRUE(ring.Write(frame));
+    while (ring.Read(new_owner, msg_buffer, nof_lost)) {
+    }
+  }
+  EXPECT_TRUE(ring.Reattach(old_owner, nof_lost));
+  EXPECT_GT(nof_lost, 0);
+  EXPECT_EQ(old_owner.sequence, ring.tail_sequence);
+}
+
+TEST(SharedMemoryRing, TestWriteRead) {
+  TestMemory test(2, 1'000);
+  auto& ring = *test.ring;
+  auto channel = ring.AttachChannel();
+
+  CanDataFrame frame;
+  frame.MessageId(0x123);
+  // Wraps around the buffer a couple of times.
+  std::vector<uint8_t> msg_buffer;
+  uint64_t nof_lost = 0;
+  size_t nof_read = 0;
+  for (size_t index = 0; index < 1'000; ++index) {
+    EXPECT_TRUE(ring.Write(frame));
+    EXPECT_TRUE(ring.Read(channel, msg_buffer, nof_lost));
+    EXPECT_EQ(nof_lost, 0);
+    EXPECT_EQ(msg_buffer.size(), frame.Size());
+    ++nof_read;
+  }
+  EXPECT_FALSE(ring.Read(channel, msg_buffer, nof_lost));
+  EXPECT_EQ(nof_read, 1'000);
+  EXPECT_EQ(ring.Channels()[0].sequence, 1'000);
+  EXPECT_EQ(ring.Channels()[channel.channel].sequence, 1'000);
+  EXPECT_EQ(ring.Channels()[channel.channel].heartbeat, nof_read + 1);
+  EXPECT_FALSE(ring.full);
+}
+
+TEST(SharedMemoryRing, TestPeek) {
+  TestMemory test(2, 1'000);
+  auto& ring = *test.ring;
+  auto channel = ring.AttachChannel();
+
+  CanDataFrame frame;
+  frame.MessageId(0x123);
+  EXPECT_TRUE(ring.Write(frame));
+
+  std::span<const uint8_t> message;
+  uint64_t nof_lost = 0;
+  ASSERT_TRUE(ring.Peek(channel, message, nof_lost));
+  EXPECT_EQ(message.size(), frame.Size());
+  // The message points into the buffer.
+  EXPECT_GE(message.data(), ring.Buffer().data());
+  EXPECT_LT(message.data(), ring.Buffer().data() + ring.Buffer().size());
+
+  // Peek doesn't move the position.
+  std::span<const uint8_t> again;
+  ASSERT_TRUE(ring.Peek(channel, again, nof_lost));
+  EXPECT_EQ(again.data(), message.data());
+  EXPECT_EQ(ring.Channels()[channel.channel].sequence, 0);
+
+  ring.Advance(channel);
+  EXPECT_EQ(ring.Channels()[channel.channel].sequence, 1);
+  EXPECT_FALSE(ring.Peek(channel, message, nof_lost));
+  EXPECT_TRUE(message.empty());
+
+  // The peeked message is overwritten before the Advance().
+  EXPECT_TRUE(ring.Write(frame));
+  ASSERT_TRUE(ring.Peek(channel, message, nof_lost));
+  for (size_t index = 0; index < 100; ++index) {
+    EXPECT_TRUE(ring.Write(frame));
+  }
+  const uint64_t sequence = ring.Channels()[channel.channel].sequence;
+  ring.Advance(channel);
+  EXPECT_EQ(ring.Channels()[channel.channel].sequence, sequence);
+  ASSERT_TRUE(ring.Peek(channel, message, nof_lost));
+  EXPECT_GT(nof_lost, 0);
+}
+
+TEST(SharedMemoryRing, TestPin) {
+  TestMemory test(2, 1'000);
+  auto& ring = *test.ring;
+  auto channel = ring.AttachChannel();
+
+  CanDataFrame frame;
+  frame.MessageId(0x123);
+  EXPECT_TRUE(ring.Write(frame));
+  std::span<const uint8_t> message;
+  uint64_t nof_lost = 0;
+  ASSERT_TRUE(ring.Peek(channel, message, nof_lost));
+  const std::vector<uint8_t> pinned(message.begin(), message.end());
+
+  // The pinned record blocks the publishers, also with the overwrite policy.
+  ring.Pin(channel, true);
+  frame.MessageId(0x456);
+  size_t nof_written = 0;
+  while (ring.Write(frame)) {
+    ++nof_written;
+  }
+  EXPECT_GT(nof_written, 0);
+  EXPECT_TRUE(ring.full);
+  ring.SkipSlowReaders();
+  EXPECT_FALSE(ring.Write(frame));
+  EXPECT_TRUE(std::equal(message.begin(), message.end(), pinned.begin()));
+
+  ring.Pin(channel, false);
+  ring.Advance(channel);
+  EXPECT_EQ(ring.Channels()[channel.channel].sequence, 1);
+  EXPECT_TRUE(ring.Write(frame));
+}
+
+TEST(SharedMemoryRing, TestOverwrite) {
+  TestMemory test(2, 1'000);
+  auto& ring = *test.ring;
+  auto fast = ring.AttachChannel();
+  auto slow = ring.AttachChannel();
+
+  CanDataFrame frame;
+  const size_t record_size = (8 + frame.Size() + 7) & ~size_t{7};
+  const size_t capacity = 1'000 / record_size;
+  const size_t nof_messages = 3 * capacity;
+
+  std::vector<uint8_t> msg_buffer;
+  uint64_t nof_lost = 0;
+  size_t nof_fast = 0;
+  for (size_t index = 0; index < nof_messages; ++index) {
+    EXPECT_TRUE(ring.Write(frame)); // Never blocks
+    while (ring.Read(fast, msg_buffer, nof_lost)) {
+      EXPECT_EQ(nof_lost, 0);
+      ++nof_fast;
+    }
+  }
+  EXPECT_EQ(nof_fast, nof_messages);
+
+  // The slow reader gets the last messages and a count of the lost ones.
+  EXPECT_TRUE(ring.Read(slow, msg_buffer, nof_lost));
+  EXPECT_GT(nof_lost, 0);
+  size_t nof_slow = 1;
+  uint64_t more_lost = 0;
+  while (ring.Read(slow, msg_buffer, more_lost)) {
+    EXPECT_EQ(more_lost, 0);
+    ++nof_slow;
+  }
+  EXPECT_LE(nof_slow, capacity);
+  EXPECT_EQ(nof_slow + nof_lost, nof_messages);
+  EXPECT_EQ(ring.Channels()[slow.channel].sequence, nof_messages);
+}
+
+TEST(SharedMemoryRing, TestBlock) {
+  TestMemory test(2, 1'000, OverrunPolicy::Block);
+  auto& ring = *test.ring;
+  auto fast = ring.AttachChannel();
+  auto slow = ring.AttachChannel();
+
+  CanDataFrame frame;
+  std::vector<uint8_t> msg_buffer;
+  uint64_t nof_lost = 0;
+  size_t nof_written = 0;
+  while (ring.Write(frame)) {
+    ++nof_written;
+    while (ring.Read(fast, msg_buffer, nof_lost)) {
+    }
+  }
+  EXPECT_TRUE(ring.full);
+  EXPECT_GT(nof_written, 0);
+
+  // The slow reader frees one message.
+  EXPECT_TRUE(ring.Read(slow, msg_buffer, nof_lost));
+  EXPECT_TRUE(ring.Write(frame));
+  ++nof_written;
+  EXPECT_FALSE(ring.Write(frame));
+
+  // Skip the slow reader instead of waiting for it.
+  ring.SkipSlowReaders();
+  EXPECT_FALSE(ring.full);
+  EXPECT_TRUE(ring.Write(frame));
+  ++nof_written;
+
+  size_t nof_slow = 0;
+  EXPECT_TRUE(ring.Read(slow, msg_buffer, nof_lost));
+  EXPECT_GT(nof_lost, 0);
+  ++nof_slow;
+  while (ring.Read(slow, msg_buffer, nof_lost)) {
+    ++nof_slow;
+  }
+  EXPECT_EQ(ring.Channels()[slow.channel].sequence, nof_written);
+}
+
+TEST(SharedMemoryRing, TestReserveCommit) {
+  TestMemory test(2, 1'000);
+  auto& ring = *test.ring;
+  auto channel = ring.AttachChannel();
+
+  const std::vector<uint8_t> first(10, 1);
+  const std::vector<uint8_t> second(20, 2);
+  RingReservation first_record;
+  RingReservation second_record;
+  ASSERT_TRUE(ring.Reserve(first.size(), first_record));
+  ASSERT_TRUE(ring.Reserve(second.size(), second_record));
+
+  // The messages are read in reservation order, not in commit order.
+  ring.Commit(second_record, second);
+  std::vector<uint8_t> msg_buffer;
+  uint64_t nof_lost = 0;
+  EXPECT_FALSE(ring.Read(channel, msg_buffer, nof_lost));
+
+  ring.Commit(first_record, first);
+  EXPECT_TRUE(ring.Read(channel, msg_buffer, nof_lost));
+  EXPECT_EQ(msg_buffer, first);
+  EXPECT_TRUE(ring.Read(channel, msg_buffer, nof_lost));
+  EXPECT_EQ(msg_buffer, second);
+  EXPECT_FALSE(ring.Read(channel, msg_buffer, nof_lost));
+
+  // A publisher that crashed before the commit.
+  RingReservation crashed;
+  ASSERT_TRUE(ring.Reserve(first.size(), crashed));
+  const uint32_t dead_pid = 0x7FFFFFF0;
+  std::memcpy(ring.Buffer().data() + crashed.offset + 4, &dead_pid,
+              sizeof(dead_pid));
+  EXPECT_TRUE(ring.Write(CanDataFrame()));
+  EXPECT_FALSE(ring.Read(channel, msg_buffer, nof_lost));
+
+  EXPECT_EQ(ring.AbortDeadWriters(), 1);
+  EXPECT_TRUE(ring.Read(channel, msg_buffer, nof_lost));
+  EXPECT_EQ(nof_lost, 1);
+  EXPECT_EQ(msg_buffer.size(), CanDataFrame().Size());
+}
+
+TEST(SharedMemoryRing, TestMultiWriter) {
+  constexpr size_t kNofWriters = 4;
+  constexpr size_t kNofMessages = 10'000;
+  TestMemory test(2, 4'000, OverrunPolicy::Block);
+  auto& ring = *test.ring;
+  boost::interprocess::interprocess_mutex mutex;
+  auto channel = ring.AttachChannel();
+
+  std::vector<std::thread> writers;
+  for (size_t writer = 0; writer < kNofWriters; ++writer) {
+    writers.emplace_back([&, writer] () -> void {
+      const std::vector<uint8_t> message(8 + writer,
+                                         static_cast<uint8_t>(writer));
+      for (size_t index = 0; index < kNofMessages; ++index) {
+        while (!ring.Publish(mutex, message)) {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+
+  std::array<size_t, kNofWriters> nof_read = {};
+  std::vector<uint8_t> msg_buffer;
+  uint64_t nof_lost = 0;
+  size_t total = 0;
+  for (size_t retry = 0; total < kNofWriters * kNofMessages &&
+       retry < 1'000'000; ++retry) {
+    bool more;
+    {
+      boost::interprocess::scoped_lock lock(mutex);
+      more = ring.Read(channel, msg_buffer, nof_lost);
+    }
+    EXPECT_EQ(nof_lost, 0);
+    if (!more) {
+      std::this_thread::yield();
+      continue;
+    }
+    const size_t writer = msg_buffer.size() - 8;
+    ASSERT_LT(writer, kNofWriters);
+    EXPECT_TRUE(std::ranges::all_of(msg_buffer, [&] (uint8_t value) {
+      return value == writer;
+    }));
+    ++nof_read[writer];
+    ++total;
+  }
+  for (auto& thread : writers) {
+    thread.join();
+  }
+  for (const size_t count : nof_read) {
+    EXPECT_EQ(count, kNofMessages);
+  }
+}
+
+TEST(SharedMemoryRing, TestWatchdog) {
+  TestMemory test(2, 1'000, OverrunPolicy::Block);
+  auto& ring = *test.ring;
+  auto alive = ring.AttachChannel();
+  auto crashed = ring.AttachChannel();
+  ring.Channels()[crashed.channel].pid = 0x7FFFFFF0; // Process that doesn't exist
+
+  ChannelWatchdog watchdog;
+  EXPECT_EQ(watchdog.Check(ring), 0); // First call only initialize
+  std::this_thread::sleep_for(600ms);
+  EXPECT_EQ(watchdog.Check(ring), 1);
+  EXPECT_TRUE(ring.IsAttached(alive));
+  EXPECT_FALSE(ring.IsAttached(crashed));
+
+  // The dead subscriber no longer blocks the publishers.
+  CanDataFrame frame;
+  std::vector<uint8_t> msg_buffer;
+  uint64_t nof_lost = 0;
+  for (size_t index = 0; index < 100; ++index) {
+    EXPECT_TRUE(ring.Write(frame));
+    EXPECT_TRUE(ring.Read(alive, msg_buffer, nof_lost));
+  }
+  EXPECT_FALSE(ring.full);
+}
+
+TEST(SharedMemoryRing, TestPinnedWatchdog) {
+  TestMemory test(2, 1'000);
+  auto& ring = *test.ring;
+  auto idle = ring.AttachChannel();
+  auto pinned = ring.AttachChannel();
+  ring.Pin(pinned, true);
+
+  // A pinned channel is in an in-place callback and keeps its channel.
+  ChannelWatchdog watchdog;
+  EXPECT_EQ(watchdog.Check(ring), 0);
+  std::this_thread::sleep_for(3'500ms);
+  EXPECT_EQ(watchdog.Check(ring), 1);
+  EXPECT_FALSE(ring.IsAttached(idle));
+  EXPECT_TRUE(ring.IsAttached(pinned));
+}
+
+TEST(SharedMemoryRing, TestWaitForCommit) {
+  TestMemory test(1, 1'000);
+  auto& ring = *test.ring;
+  boost::interprocess::interprocess_mutex mutex;
+  EXPECT_EQ(ring.signal.commits, 0);
+
+  CanDataFrame frame;
+  frame.MessageId(1);
+  std::vector<uint8_t> message;
+  frame.ToRaw(message);
+
+  // Returns directly if a commit already was done.
+  EXPECT_TRUE(ring.Publish(mutex, message));
+  EXPECT_EQ(ring.signal.commits, 1);
+  auto start = std::chrono::steady_clock::now();
+  ring.signal.Wait(0, 5s);
+  EXPECT_LT(std::chrono::steady_clock::now() - start, 1s);
+
+  // Times out without a commit.
+  start = std::chrono::steady_clock::now();
+  ring.signal.Wait(ring.signal.commits, 20ms);
+  EXPECT_GE(std::chrono::steady_clock::now() - start, 10ms);
+  EXPECT_EQ(ring.signal.sleepers, 0);
+
+  // A commit from another thread wakes or is seen by the spinning thread.
+  QueueWaitOptions options;
+  options.strategy = WaitStrategy::Spin;
+  options.spin_count = 1'000;
+  options.yield_count = 10;
+  options.sleep_time = 5s;
+  SpinWait spin(options);
+  std::array<SharedMemoryRing*, 1> rings = {&ring};
+  const uint32_t commits = CommitCount(rings);
+  std::atomic<bool> stop = false;
+  std::thread publisher([&] () -> void {
+    std::this_thread::sleep_for(50ms);
+    EXPECT_TRUE(ring.Publish(mutex, message));
+  });
+  start = std::chrono::steady_clock::now();
+  WaitForCommits(rings, commits, spin, options, stop);
+  EXPECT_LT(std::chrono::steady_clock::now() - start, 4s);
+  EXPECT_NE(CommitCount(rings), commits);
+  publisher.join();
+}
+
+TEST(SharedMemoryRing, TestSegmentSignal) {
+  // Two rings that share a segment signal, as the broker partitions.
+  CommitSignal segment;
+  TestMemory first(1, 1'000, OverrunPolicy::Overwrite, &segment);
+  TestMemory second(1, 1'000, OverrunPolicy::Overwrite, &segment);
+  EXPECT_EQ(first.ring->SegmentSignal(), &segment);
+  boost::interprocess::interprocess_mutex mutex;
+
+  CanDataFrame frame;
+  std::vector<uint8_t> message;
+  frame.ToRaw(message);
+
+  QueueWaitOptions options;
+  options.strategy = WaitStrategy::Spin;
+  options.spin_count = 0; // Sleeps directly
+  options.yield_count = 0;
+  options.sleep_time = 5s;
+  SpinWait spin(options);
+  std::array<SharedMemoryRing*, 2> rings = {first.ring, second.ring};
+  const uint32_t commits = CommitCount(rings);
+  std::atomic<bool> stop = false;
+  // A commit in the second ring wakes a sleeper on both rings.
+  std::thread publisher([&] () -> void {
+    std::this_thread::sleep_for(50ms);
+    EXPECT_TRUE(second.ring->Publish(mutex, message));
+  });
+  const auto start = std::chrono::steady_clock::now();
+  WaitForCommits(rings, commits, spin, options, stop);
+  EXPECT_LT(std::chrono::steady_clock::now() - start, 4s);
+  EXPECT_EQ(segment.commits, 1);
+  publisher.join();
+}
+
+}  // namespace bus
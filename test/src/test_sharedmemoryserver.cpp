@@ -133,6 +133,8 @@ TEST(SharedMemoryServer, TestOneClient) {
   EXPECT_TRUE(client_subscriber);
   EXPECT_TRUE(client_subscriber->Empty());
   EXPECT_EQ(client->NofSubscribers(), 0);
+  // The subscribers are attached when started, so the publishers wait
+  // for them and no messages are lost.
   client_subscriber->Start();
 
   auto msg = std::make_shared<CanDataFrame>();
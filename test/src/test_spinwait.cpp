@@ -0,0 +1,54 @@
+/*
+* Copyright 2025 Ingemar Hedvall
+* SPDX-License-Identifier: MIT
+ */
+
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "bus/spinwait.h"
+
+namespace bus {
+
+TEST(SpinWait, TestPhases) {
+  QueueWaitOptions options;
+  EXPECT_EQ(options.strategy, WaitStrategy::Sleep);
+  EXPECT_EQ(options.cpu, -1);
+  options.spin_count = 100;
+  options.yield_count = 10;
+
+  SpinWait spin(options);
+  size_t count = 0;
+  while (spin.Pause()) {
+    ++count;
+  }
+  EXPECT_EQ(count, 110);
+  EXPECT_FALSE(spin.Pause()); // Stays in the sleep phase
+
+  spin.Reset();
+  EXPECT_TRUE(spin.Pause());
+
+  options.spin_count = 0;
+  options.yield_count = 0;
+  SpinWait no_spin(options);
+  EXPECT_FALSE(no_spin.Pause());
+}
+
+TEST(SpinWait, TestPinThread) {
+  EXPECT_FALSE(PinCurrentThread(-1));
+#if defined(__linux__) || defined(_WIN32)
+  bool pinned = false;
+  std::thread thread([&] () -> void {
+    pinned = PinCurrentThread(0);
+  });
+  thread.join();
+  // A container may not allow CPU 0.
+  if (!pinned) {
+    GTEST_SKIP() << "CPU 0 isn't available";
+  }
+  EXPECT_TRUE(pinned);
+#endif
+}
+
+} // bus
@@ -0,0 +1,123 @@
+/*
+* Copyright 2025 Ingemar Hedvall
+* SPDX-License-Identifier: MIT
+ */
+
+#include <algorithm>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "tcpframereader.h"
+#include "tcphandshake.h"
+#include "tcpsendbuffer.h"
+#include "bus/littlebuffer.h"
+
+namespace {
+
+void AddFrame(std::vector<uint8_t>& dest, uint32_t flags, size_t size,
+              uint8_t value) {
+  const bus::LittleBuffer<uint32_t> length(
+      flags | static_cast<uint32_t>(size));
+  dest.insert(dest.end(), length.cbegin(), length.cend());
+  dest.insert(dest.end(), size, value);
+}
+
+/** \brief Copies the stream into the reader in chunks of the read size. */
+bool Receive(bus::TcpFrameReader& reader, const std::vector<uint8_t>& stream,
+             size_t read_size,
+             const bus::TcpFrameReader::FrameCallback& on_frame) {
+  for (size_t offset = 0; offset < stream.size(); ) {
+    const auto space = reader.FreeSpace();
+    const size_t bytes = std::min({read_size, space.size(),
+                                   stream.size() - offset});
+    std::copy_n(stream.begin() + static_cast<ptrdiff_t>(offset), bytes,
+                space.begin());
+    offset += bytes;
+    if (!reader.Read(bytes, on_frame)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+} // end namespace
+
+namespace bus {
+
+TEST(TcpFrameReader, TestSmallFrames) {
+  std::vector<uint8_t> stream;
+  for (size_t frame = 0; frame < 10'000; ++frame) {
+    AddFrame(stream, 0, 1 + (frame % 30), static_cast<uint8_t>(frame));
+  }
+  AddFrame(stream, kControlFrame, 12, 0xCC);
+
+  // Reads of different sizes split the frames at all positions.
+  for (const size_t read_size : {1, 3, 7, 1'000, 100'000}) {
+    TcpFrameReader reader;
+    size_t nof_frames = 0;
+    size_t nof_control = 0;
+    const bool valid = Receive(reader, stream, read_size,
+        [&](uint32_t flags, std::span<const uint8_t> frame) -> bool {
+          if (flags == kControlFrame) {
+            ++nof_control;
+            EXPECT_EQ(frame.size(), 12);
+            return true;
+          }
+          EXPECT_EQ(frame.size(), 1 + (nof_frames % 30));
+          EXPECT_EQ(frame.front(), static_cast<uint8_t>(nof_frames));
+          ++nof_frames;
+          return true;
+        });
+    EXPECT_TRUE(valid) << read_size;
+    EXPECT_EQ(nof_frames, 10'000) << read_size;
+    EXPECT_EQ(nof_control, 1) << read_size;
+    EXPECT_EQ(reader.Size(), 0) << read_size;
+  }
+}
+
+TEST(TcpFrameReader, TestLargeFrame) {
+  std::vector<uint8_t> stream;
+  AddFrame(stream, 0, 10, 0x01);
+  AddFrame(stream, kCompressedBlock, 3 * TcpFrameReader::kReceiveBufferSize,
+           0x02);
+  AddFrame(stream, 0, 10, 0x03);
+
+  TcpFrameReader reader;
+  std::vector<size_t> sizes;
+  EXPECT_TRUE(Receive(reader, stream, 10'000,
+      [&](uint32_t, std::span<const uint8_t> frame) -> bool {
+        sizes.push_back(frame.size());
+        return true;
+      }));
+  ASSERT_EQ(sizes.size(), 3);
+  EXPECT_EQ(sizes[1], 3 * TcpFrameReader::kReceiveBufferSize);
+  EXPECT_EQ(sizes[2], 10);
+  // The buffer shrinks back after the large frame.
+  EXPECT_EQ(reader.FreeSpace().size(), TcpFrameReader::kReceiveBufferSize);
+}
+
+TEST(TcpFrameReader, TestInvalidFrame) {
+  std::vector<uint8_t> stream;
+  AddFrame(stream, 0, 10, 0x01);
+  const LittleBuffer<uint32_t> length(kMaxMessageSize + 1);
+  stream.insert(stream.end(), length.cbegin(), length.cend());
+
+  TcpFrameReader reader;
+  size_t nof_frames = 0;
+  EXPECT_FALSE(Receive(reader, stream, 1'000,
+      [&](uint32_t, std::span<const uint8_t>) -> bool {
+        ++nof_frames;
+        return true;
+      }));
+  EXPECT_EQ(nof_frames, 1);
+
+  // The callback may also stop the reading.
+  TcpFrameReader stop_reader;
+  EXPECT_FALSE(Receive(stop_reader, stream, 1'000,
+      [&](uint32_t, std::span<const uint8_t>) -> bool {
+        return false;
+      }));
+}
+
+}  // namespace bus
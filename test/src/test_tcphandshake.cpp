@@ -0,0 +1,111 @@
+/*
+* Copyright 2025 Ingemar Hedvall
+* SPDX-License-Identifier: MIT
+ */
+
+#include <gtest/gtest.h>
+
+#include "tcphandshake.h"
+#include "bus/littlebuffer.h"
+
+namespace bus {
+
+TEST(TcpHandshake, TestHello) {
+  TcpHello hello;
+  hello.encodings = kEncodingLz4 | kEncodingCompactCan;
+  hello.max_batch_size = 500;
+  hello.options.push_back({7, {1, 2, 3}});
+
+  std::vector<uint8_t> buffer;
+  hello.ToRaw(buffer);
+  const LittleBuffer<uint32_t> length(buffer, 0);
+  ASSERT_EQ(length.value(),
+            kControlFrame | static_cast<uint32_t>(buffer.size() - 4));
+
+  const std::span<const uint8_t> frame(buffer.data() + 4, buffer.size() - 4);
+  TcpHello received;
+  ASSERT_TRUE(received.FromRaw(frame));
+  EXPECT_EQ(received.type, TcpControlType::Hello);
+  EXPECT_EQ(received.version, kProtocolVersion);
+  EXPECT_EQ(received.encodings, hello.encodings);
+  EXPECT_EQ(received.max_batch_size, 500);
+  ASSERT_EQ(received.options.size(), 1);
+  EXPECT_EQ(received.options[0].type, 7);
+  EXPECT_EQ(received.options[0].data, hello.options[0].data);
+
+  // The server selects the common modes.
+  const auto ack = received.Accept(kEncodingLz4, kDefaultBatchSize);
+  EXPECT_EQ(ack.type, TcpControlType::HelloAck);
+  EXPECT_EQ(ack.encodings, kEncodingLz4);
+  EXPECT_EQ(ack.max_batch_size, 500);
+
+  TcpLinkMode link;
+  link.Select(ack);
+  EXPECT_TRUE(link.compress);
+  EXPECT_FALSE(link.compact_can);
+  EXPECT_EQ(link.max_batch_size, 500);
+
+  // Truncated frames are rejected.
+  EXPECT_FALSE(received.FromRaw(frame.first(11)));
+  EXPECT_FALSE(received.FromRaw(frame.first(frame.size() - 1)));
+}
+
+TEST(TcpHandshake, TestFilter) {
+  TcpHello hello;
+  BusMessageFilter filter;
+  hello.AddFilter(filter);
+  EXPECT_TRUE(hello.options.empty()); // Empty filter isn't sent
+
+  filter.AddBusChannel(3);
+  filter.CanIds().AddId(0x123);
+  hello.AddFilter(filter);
+  ASSERT_EQ(hello.options.size(), 1);
+  EXPECT_EQ(hello.options[0].type, kFilterOption);
+
+  std::vector<uint8_t> buffer;
+  hello.ToRaw(buffer);
+  TcpHello received;
+  ASSERT_TRUE(received.FromRaw(
+      std::span<const uint8_t>(buffer.data() + 4, buffer.size() - 4)));
+  BusMessageFilter received_filter;
+  ASSERT_TRUE(received.ReadFilter(received_filter));
+  EXPECT_EQ(received_filter.BusChannels(), filter.BusChannels());
+  EXPECT_TRUE(received_filter.CanIds().Match(0x123));
+  EXPECT_FALSE(received_filter.CanIds().Match(0x124));
+
+  received.options[0].data.pop_back();
+  EXPECT_FALSE(received.ReadFilter(received_filter));
+  EXPECT_TRUE(received_filter.Empty());
+}
+
+TEST(TcpHandshake, TestLargeFilter) {
+  BusMessageFilter filter;
+  for (uint32_t id = 0; id < 40'000; id += 2) {
+    filter.CanIds().AddId(id); // Single IDs, no ranges
+  }
+  TcpHello hello;
+  EXPECT_FALSE(hello.AddFilter(filter));
+  EXPECT_TRUE(hello.options.empty());
+
+  // An oversized option is skipped instead of truncated.
+  TcpHelloOption option;
+  option.type = kFilterOption;
+  option.data.resize(0x10000, 0);
+  hello.options.push_back(option);
+  std::vector<uint8_t> buffer;
+  hello.ToRaw(buffer);
+  TcpHello received;
+  ASSERT_TRUE(received.FromRaw(
+      std::span<const uint8_t>(buffer.data() + 4, buffer.size() - 4)));
+  EXPECT_TRUE(received.options.empty());
+
+  hello.options[0].data.resize(kMaxOptionSize);
+  hello.ToRaw(buffer);
+  EXPECT_EQ(buffer.size() - 4, kMaxControlSize);
+  ASSERT_TRUE(received.FromRaw(
+      std::span<const uint8_t>(buffer.data() + 4, buffer.size() - 4)));
+  ASSERT_EQ(received.options.size(), 1);
+  EXPECT_EQ(received.options[0].data.size(), kMaxOptionSize);
+}
+
+}  // namespace bus
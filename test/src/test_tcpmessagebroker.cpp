@@ -7,11 +7,13 @@
 #include <array>
 #include <memory>
 
+#include <boost/asio.hpp>
 #include <gtest/gtest.h>
 
 #include "bus/interface/businterfacefactory.h"
 #include "bus/buslogstream.h"
 #include "bus/candataframe.h"
+#include "bus/littlebuffer.h"
 
 using namespace std::chrono_literals;
 
@@ -148,4 +150,328 @@ TEST(TcpMessageBroker, TestOneClient) {
   BusLogStream::UserLogFunction = BusLogStream::BusNoLogFunction;
 }
 
+TEST(TcpMessageBroker, TestCompression) {
+  BusLogStream::UserLogFunction = BusLogStream::BusConsoleLogFunction;
+  BusLogStream::ResetErrorCount();
+
+  constexpr size_t max_messages = 10'000;
+
+  auto broker = BusInterfaceFactory::CreateBroker(
+    BrokerType::TcpBrokerType);
+  ASSERT_TRUE(broker);
+  broker->Name("BusMemTest");
+  broker->Address("127.0.0.1");
+  broker->Port(42611);
+  broker->Compression(BusCompression::Lz4);
+  broker->CompactEncoding(true);
+  broker->Start();
+
+  auto client = BusInterfaceFactory::CreateBroker(
+    BrokerType::TcpClientType);
+  ASSERT_TRUE(client);
+  client->Name("TcpClient");
+  client->Address("127.0.0.1");
+  client->Port(42611);
+  client->Compression(BusCompression::Lz4);
+  client->CompactEncoding(true);
+  client->FlushInterval(5);
+  client->Start();
+  EXPECT_TRUE(client->IsConnected());
+
+  auto publisher = client->CreatePublisher();
+  ASSERT_TRUE(publisher);
+  publisher->Start();
+
+  auto subscriber = client->CreateSubscriber();
+  ASSERT_TRUE(subscriber);
+  subscriber->Start();
+
+  for (size_t sample = 0; sample < max_messages; ++sample) {
+    auto msg = std::make_shared<CanDataFrame>();
+    msg->MessageId(0x100 + (sample % 10));
+    msg->DataBytes({1, 2, 3, 4, 5, 6, 7, static_cast<uint8_t>(sample)});
+    publisher->Push(msg);
+  }
+
+  for (size_t timeout = 0;
+       timeout < 100 && subscriber->Size() != max_messages;
+       ++timeout) {
+    std::this_thread::sleep_for(100ms);
+  }
+  EXPECT_EQ(subscriber->Size(), max_messages);
+  const auto msg = std::dynamic_pointer_cast<CanDataFrame>(
+      subscriber->Pop());
+  ASSERT_TRUE(msg);
+  EXPECT_EQ(msg->MessageId(), 0x100);
+  EXPECT_EQ(msg->DataBytes().size(), 8);
+
+  client->Stop();
+  publisher->Stop();
+  subscriber->Stop();
+  broker->Stop();
+
+  EXPECT_EQ(BusLogStream::ErrorCount(), 0);
+  BusLogStream::UserLogFunction = BusLogStream::BusNoLogFunction;
+}
+
+TEST(TcpMessageBroker, TestSubscriptionFilter) {
+  BusLogStream::UserLogFunction = BusLogStream::BusConsoleLogFunction;
+  BusLogStream::ResetErrorCount();
+
+  constexpr size_t max_messages = 1'000;
+
+  auto broker = BusInterfaceFactory::CreateBroker(
+    BrokerType::TcpBrokerType);
+  ASSERT_TRUE(broker);
+  broker->Name("BusMemTest");
+  broker->Address("127.0.0.1");
+  broker->Port(42611);
+  broker->Start();
+
+  // The server only sends 2 of the 10 CAN IDs to the client.
+  BusMessageFilter filter;
+  filter.CanIds().AddRange(0x100, 0x101);
+  auto client = BusInterfaceFactory::CreateBroker(
+    BrokerType::TcpClientType);
+  ASSERT_TRUE(client);
+  client->Name("TcpClient");
+  client->Address("127.0.0.1");
+  client->Port(42611);
+  client->SubscriptionFilter(filter);
+  client->Start();
+  EXPECT_TRUE(client->IsConnected());
+
+  auto publisher = client->CreatePublisher();
+  ASSERT_TRUE(publisher);
+  publisher->Start();
+
+  auto subscriber = client->CreateSubscriber();
+  ASSERT_TRUE(subscriber);
+  subscriber->Start();
+
+  for (size_t sample = 0; sample < max_messages; ++sample) {
+    auto msg = std::make_shared<CanDataFrame>();
+    msg->MessageId(0x100 + (sample % 10));
+    msg->DataBytes({1, 2, 3, 4, 5, 6, 7, static_cast<uint8_t>(sample)});
+    publisher->Push(msg);
+  }
+
+  for (size_t timeout = 0;
+       timeout < 100 && subscriber->Size() != max_messages / 5;
+       ++timeout) {
+    std::this_thread::sleep_for(100ms);
+  }
+  std::this_thread::sleep_for(200ms);
+  EXPECT_EQ(subscriber->Size(), max_messages / 5);
+  while (subscriber->Size() > 0) {
+    const auto msg = std::dynamic_pointer_cast<CanDataFrame>(
+        subscriber->Pop());
+    ASSERT_TRUE(msg);
+    EXPECT_TRUE(filter.Match(*msg));
+  }
+  // The connection queue only holds the subscribed messages.
+  for (const auto& connection : broker->Connections()) {
+    EXPECT_EQ(connection.queue_size, 0);
+    EXPECT_EQ(connection.lost_messages, 0);
+  }
+
+  client->Stop();
+  publisher->Stop();
+  subscriber->Stop();
+  broker->Stop();
+
+  EXPECT_EQ(BusLogStream::ErrorCount(), 0);
+  BusLogStream::UserLogFunction = BusLogStream::BusNoLogFunction;
+}
+
+TEST(TcpMessageBroker, TestSlowClient) {
+  BusLogStream::UserLogFunction = BusLogStream::BusConsoleLogFunction;
+  BusLogStream::ResetErrorCount();
+
+  auto broker = BusInterfaceFactory::CreateBroker(
+    BrokerType::TcpBrokerType);
+  ASSERT_TRUE(broker);
+  broker->Name("BusMemTest");
+  broker->Address("127.0.0.1");
+  broker->Port(42611);
+  broker->SendQueueSize(1'000);
+  broker->SlowClient(SlowClientPolicy::DropOldest);
+  broker->SlowClientTimeout(0);
+  broker->Start();
+  EXPECT_TRUE(broker->Connections().empty());
+
+  auto publisher = broker->CreatePublisher();
+  ASSERT_TRUE(publisher);
+  publisher->Start();
+
+  // The client connects but never reads.
+  using namespace boost::asio;
+  io_context context;
+  ip::tcp::socket socket(context);
+  socket.open(ip::tcp::v4());
+  socket.set_option(socket_base::receive_buffer_size(4'096));
+  socket.connect(ip::tcp::endpoint(ip::make_address("127.0.0.1"), 42611));
+  for (size_t timeout = 0;
+       timeout < 100 && broker->Connections().empty();
+       ++timeout) {
+    std::this_thread::sleep_for(10ms);
+  }
+  ASSERT_EQ(broker->Connections().size(), 1);
+
+  ConnectionStatistics statistics;
+  for (size_t timeout = 0;
+       timeout < 100 && statistics.lost_messages == 0;
+       ++timeout) {
+    for (size_t sample = 0; sample < 1'000; ++sample) {
+      auto msg = std::make_shared<CanDataFrame>();
+      msg->MessageId(0x100 + (sample % 10));
+      msg->DataBytes(std::vector<uint8_t>(64, static_cast<uint8_t>(sample)));
+      publisher->Push(msg);
+    }
+    std::this_thread::sleep_for(100ms);
+    const auto list = broker->Connections();
+    ASSERT_EQ(list.size(), 1);
+    statistics = list[0];
+    EXPECT_LE(statistics.queue_size, 1'000);
+  }
+  EXPECT_FALSE(statistics.remote.empty());
+  EXPECT_GT(statistics.sent_messages, 0);
+  EXPECT_GT(statistics.sent_bytes, 0);
+  EXPECT_GT(statistics.lost_messages, 0);
+  EXPECT_GT(statistics.max_lag, 0);
+
+  publisher->Stop();
+  broker->Stop();
+
+  EXPECT_EQ(BusLogStream::ErrorCount(), 0);
+  BusLogStream::UserLogFunction = BusLogStream::BusNoLogFunction;
+}
+
+TEST(TcpMessageBroker, TestSlowClientDisconnect) {
+  BusLogStream::UserLogFunction = BusLogStream::BusConsoleLogFunction;
+  BusLogStream::ResetErrorCount();
+
+  auto broker = BusInterfaceFactory::CreateBroker(
+    BrokerType::TcpBrokerType);
+  ASSERT_TRUE(broker);
+  broker->Name("BusMemTest");
+  broker->Address("127.0.0.1");
+  broker->Port(42611);
+  broker->SendQueueSize(1'000);
+  broker->SlowClient(SlowClientPolicy::Disconnect);
+  broker->SlowClientTimeout(500);
+  broker->Start();
+
+  auto publisher = broker->CreatePublisher();
+  ASSERT_TRUE(publisher);
+  publisher->Start();
+
+  using namespace boost::asio;
+  io_context context;
+  ip::tcp::socket socket(context);
+  socket.open(ip::tcp::v4());
+  socket.set_option(socket_base::receive_buffer_size(4'096));
+  socket.connect(ip::tcp::endpoint(ip::make_address("127.0.0.1"), 42611));
+  for (size_t timeout = 0;
+       timeout < 100 && broker->Connections().empty();
+       ++timeout) {
+    std::this_thread::sleep_for(10ms);
+  }
+  ASSERT_EQ(broker->Connections().size(), 1);
+
+  // The lagging client is disconnected.
+  for (size_t timeout = 0;
+       timeout < 100 && !broker->Connections().empty();
+       ++timeout) {
+    for (size_t sample = 0; sample < 1'000; ++sample) {
+      auto msg = std::make_shared<CanDataFrame>();
+      msg->MessageId(0x100 + (sample % 10));
+      msg->DataBytes(std::vector<uint8_t>(64, static_cast<uint8_t>(sample)));
+      publisher->Push(msg);
+    }
+    std::this_thread::sleep_for(100ms);
+  }
+  EXPECT_TRUE(broker->Connections().empty());
+
+  publisher->Stop();
+  broker->Stop();
+
+  EXPECT_EQ(BusLogStream::ErrorCount(), 0);
+  BusLogStream::UserLogFunction = BusLogStream::BusNoLogFunction;
+}
+
+TEST(TcpMessageBroker, TestLegacyServer) {
+  BusLogStream::UserLogFunction = BusLogStream::BusConsoleLogFunction;
+  BusLogStream::ResetErrorCount();
+
+  // Simulates a server without the handshake. It takes the hello as a
+  // message size and waits for the body until the client gives up. It
+  // sends plain messages on the next connection.
+  using namespace boost::asio;
+  io_context context;
+  ip::tcp::acceptor acceptor(context,
+      ip::tcp::endpoint(ip::make_address("127.0.0.1"), 42612));
+  std::atomic<bool> done = false;
+  std::thread server([&] () -> void {
+    try {
+      {
+        ip::tcp::socket socket(context);
+        acceptor.accept(socket);
+        std::array<uint8_t, 4> size_data = {};
+        read(socket, buffer(size_data));
+        std::vector<uint8_t> body(1'024);
+        boost::system::error_code error;
+        read(socket, buffer(body), error); // Until the client closes
+        EXPECT_TRUE(error);
+      }
+      ip::tcp::socket socket(context);
+      acceptor.accept(socket);
+      std::this_thread::sleep_for(500ms);
+      CanDataFrame frame;
+      frame.MessageId(0x123);
+      frame.DataBytes({1, 2, 3, 4});
+      std::vector<uint8_t> raw;
+      frame.ToRaw(raw);
+      const LittleBuffer<uint32_t> length(static_cast<uint32_t>(raw.size()));
+      write(socket, buffer(length.data(), length.size()));
+      write(socket, buffer(raw));
+      while (!done) {
+        std::this_thread::sleep_for(10ms);
+      }
+    } catch (const std::exception& err) {
+      ADD_FAILURE() << err.what();
+    }
+  });
+
+  auto client = BusInterfaceFactory::CreateBroker(
+    BrokerType::TcpClientType);
+  ASSERT_TRUE(client);
+  client->Name("TcpClient");
+  client->Address("127.0.0.1");
+  client->Port(42612);
+  client->Compression(BusCompression::Lz4);
+  client->Start();
+
+  auto subscriber = client->CreateSubscriber();
+  ASSERT_TRUE(subscriber);
+  subscriber->Start();
+
+  for (size_t timeout = 0; timeout < 50 && subscriber->Empty(); ++timeout) {
+    std::this_thread::sleep_for(100ms);
+  }
+  const auto msg = std::dynamic_pointer_cast<CanDataFrame>(
+      subscriber->Pop());
+  ASSERT_TRUE(msg);
+  EXPECT_EQ(msg->MessageId(), 0x123);
+  EXPECT_TRUE(client->IsConnected());
+
+  done = true;
+  server.join();
+  client->Stop();
+  subscriber->Stop();
+
+  EXPECT_EQ(BusLogStream::ErrorCount(), 0);
+  BusLogStream::UserLogFunction = BusLogStream::BusNoLogFunction;
+}
+
 } // namespace bus
\ No newline at end of file
@@ -0,0 +1,137 @@
+/*
+* Copyright 2025 Ingemar Hedvall
+* SPDX-License-Identifier: MIT
+ */
+
+#include <gtest/gtest.h>
+
+#include "tcpsendbuffer.h"
+#include "tcpblockreader.h"
+#include "bus/candataframe.h"
+#include "bus/ethernetframe.h"
+#include "bus/littlebuffer.h"
+#include "bus/busmessageview.h"
+
+namespace bus {
+
+TEST(TcpSendBuffer, TestBuffers) {
+  TcpSendBuffer send_buffer;
+  EXPECT_TRUE(send_buffer.Empty());
+
+  CanDataFrame can_frame;
+  can_frame.MessageId(0x123);
+  can_frame.DataBytes({1, 2, 3, 4, 5, 6, 7, 8});
+  EthernetFrame eth_frame;
+  eth_frame.DataBytes(std::vector<uint8_t>(9'000, 0x55));
+
+  for (size_t loop = 0; loop < 2; ++loop) {
+    send_buffer.Clear();
+    send_buffer.Add(can_frame);
+    send_buffer.Add(can_frame);
+    send_buffer.Add(eth_frame);
+    send_buffer.Add(can_frame);
+    EXPECT_FALSE(send_buffer.Empty());
+
+    // The CAN frames are copied together while the Ethernet frame is
+    // sent from its own buffer.
+    const auto& buffers = send_buffer.Buffers();
+    ASSERT_EQ(buffers.size(), 3);
+    EXPECT_EQ(buffers[0].size(), (2 * (4 + can_frame.Size())) + 4);
+    EXPECT_EQ(buffers[1].size(), eth_frame.Size());
+    EXPECT_EQ(buffers[2].size(), 4 + can_frame.Size());
+    EXPECT_EQ(send_buffer.Size(), boost::asio::buffer_size(buffers));
+
+    // Gather the stream and parse it as the receiver does.
+    std::vector<uint8_t> stream(send_buffer.Size());
+    boost::asio::buffer_copy(boost::asio::buffer(stream), buffers);
+    size_t offset = 0;
+    std::vector<BusMessageType> types;
+    while (offset < stream.size()) {
+      const LittleBuffer<uint32_t> length(stream, offset);
+      offset += 4;
+      const auto msg = IBusMessage::Create(
+          static_cast<BusMessageType>(stream[offset]));
+      ASSERT_EQ(msg->Decode(std::span(stream.data() + offset,
+                                      length.value())),
+                BusDecodeStatus::Ok);
+      types.push_back(msg->Type());
+      offset += length.value();
+    }
+    ASSERT_EQ(types.size(), 4);
+    EXPECT_EQ(types[2], BusMessageType::ETH_Frame);
+  }
+}
+
+TEST(TcpSendBuffer, TestCompression) {
+  TcpSendBuffer send_buffer;
+  send_buffer.Compression(BusCompression::Lz4);
+
+  CanDataFrame can_frame;
+  can_frame.MessageId(0x123);
+  can_frame.DataBytes({1, 2, 3, 4, 5, 6, 7, 8});
+  EthernetFrame eth_frame;
+  eth_frame.DataBytes(std::vector<uint8_t>(9'000, 0x55));
+
+  for (size_t index = 0; index < 100; ++index) {
+    send_buffer.Add(can_frame);
+  }
+  send_buffer.Add(eth_frame);
+  const size_t raw_size = send_buffer.Size();
+
+  // The batch is sent as one compressed block.
+  const auto& buffers = send_buffer.Buffers();
+  ASSERT_EQ(buffers.size(), 2);
+  EXPECT_LT(send_buffer.Size() * 10, raw_size);
+  EXPECT_EQ(send_buffer.Size(), boost::asio::buffer_size(buffers));
+
+  std::vector<uint8_t> stream(send_buffer.Size());
+  boost::asio::buffer_copy(boost::asio::buffer(stream), buffers);
+  const LittleBuffer<uint32_t> length(stream, 0);
+  ASSERT_NE(length.value() & kCompressedBlock, 0);
+  EXPECT_EQ(length.value() & ~kCompressedBlock, stream.size() - 4);
+
+  TcpBlockReader reader;
+  std::vector<BusMessageType> types;
+  const std::span<const uint8_t> block(stream.data() + 4, stream.size() - 4);
+  EXPECT_TRUE(reader.Unpack(block, [&](const std::vector<uint8_t>& message) {
+    const BusMessageView view(message);
+    ASSERT_TRUE(view.Valid());
+    types.push_back(view.Type());
+  }));
+  ASSERT_EQ(types.size(), 101);
+  EXPECT_EQ(types.back(), BusMessageType::ETH_Frame);
+
+  // Corrupt blocks are rejected.
+  EXPECT_FALSE(reader.Unpack(block.first(block.size() - 1),
+                             [](const std::vector<uint8_t>&) {}));
+
+  // Small batches are not compressed.
+  send_buffer.Clear();
+  send_buffer.Add(can_frame);
+  EXPECT_EQ(send_buffer.Buffers().size(), 1);
+  EXPECT_EQ(send_buffer.Size(), 4 + can_frame.Size());
+}
+
+TEST(TcpSendBuffer, TestCompactCan) {
+  TcpSendBuffer send_buffer;
+  send_buffer.CompactCan(true);
+
+  CanDataFrame can_frame;
+  can_frame.MessageId(0x123);
+  can_frame.DataBytes({1, 2, 3, 4, 5, 6, 7, 8});
+  send_buffer.Add(can_frame);
+  EXPECT_LT(send_buffer.Size(), 4 + can_frame.Size());
+  EXPECT_EQ(can_frame.Version(), 0); // The message is not changed
+
+  std::vector<uint8_t> stream(send_buffer.Size());
+  boost::asio::buffer_copy(boost::asio::buffer(stream),
+                           send_buffer.Buffers());
+  CanDataFrame received;
+  ASSERT_EQ(received.Decode(std::span(stream).subspan(4)),
+            BusDecodeStatus::Ok);
+  EXPECT_EQ(received.Version(), CanDataFrame::kCompactVersion);
+  EXPECT_EQ(received.MessageId(), 0x123);
+  EXPECT_EQ(received.DataBytes(), can_frame.DataBytes());
+}
+
+}  // namespace bus
@@ -0,0 +1,126 @@
+/*
+* Copyright 2025 Ingemar Hedvall
+* SPDX-License-Identifier: MIT
+ */
+
+#include <chrono>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "udpdatagram.h"
+#include "bus/busmessageview.h"
+#include "bus/candataframe.h"
+#include "bus/ethernetframe.h"
+
+using namespace std::chrono_literals;
+
+namespace bus {
+
+TEST(UdpDatagram, TestPack) {
+  UdpDatagramPacker packer(1234);
+  for (uint32_t index = 0; index < 100; ++index) {
+    CanDataFrame frame;
+    frame.MessageId(index);
+    frame.DataBytes({1, 2, 3, 4, 5, 6, 7, 8});
+    packer.Add(frame);
+  }
+  EthernetFrame ethernet;
+  ethernet.DataBytes(std::vector<uint8_t>(4'000, 0xAA));
+  packer.Add(ethernet);
+  packer.Flush();
+
+  auto& datagrams = packer.Datagrams();
+  ASSERT_GT(datagrams.size(), 2);
+  EXPECT_EQ(packer.Sequence(), datagrams.size());
+  std::vector<uint32_t> id_list;
+  size_t nof_ethernet = 0;
+  for (size_t index = 0; index < datagrams.size(); ++index) {
+    const auto& datagram = datagrams[index];
+    UdpDatagramHeader header;
+    ASSERT_TRUE(header.FromRaw(datagram));
+    EXPECT_EQ(header.type, UdpDatagramType::Data);
+    EXPECT_EQ(header.sender, 1234);
+    EXPECT_EQ(header.sequence, index);
+    if (index + 1 < datagrams.size()) {
+      EXPECT_LE(datagram.size(), kMaxDatagramSize);
+    }
+    EXPECT_TRUE(UnpackDatagram(datagram,
+        [&] (std::span<const uint8_t> message) -> void {
+          const BusMessageView view(message);
+          if (view.Type() == BusMessageType::CAN_DataFrame) {
+            CanDataFrame frame;
+            EXPECT_EQ(frame.Decode(message), BusDecodeStatus::Ok);
+            id_list.push_back(frame.MessageId());
+          } else {
+            EXPECT_EQ(view.Type(), BusMessageType::ETH_Frame);
+            ++nof_ethernet;
+          }
+        }));
+  }
+  ASSERT_EQ(id_list.size(), 100);
+  EXPECT_EQ(id_list[99], 99);
+  EXPECT_EQ(nof_ethernet, 1);
+
+  auto truncated = datagrams[0];
+  truncated.pop_back();
+  EXPECT_FALSE(UnpackDatagram(truncated, {}));
+  truncated[0] = 0;
+  UdpDatagramHeader header;
+  EXPECT_FALSE(header.FromRaw(truncated));
+}
+
+TEST(UdpDatagram, TestSequence) {
+  UdpSequenceTracker tracker;
+  uint32_t first = 0;
+  uint32_t count = 0;
+  EXPECT_TRUE(tracker.Receive(5, first, count));
+  EXPECT_TRUE(tracker.Receive(6, first, count));
+  EXPECT_EQ(count, 0);
+
+  EXPECT_TRUE(tracker.Receive(9, first, count));
+  EXPECT_EQ(first, 7);
+  EXPECT_EQ(count, 2);
+  EXPECT_EQ(tracker.Lost(), 2);
+
+  EXPECT_TRUE(tracker.Receive(7, first, count)); // Retransmitted
+  EXPECT_EQ(tracker.Lost(), 1);
+  EXPECT_FALSE(tracker.Receive(7, first, count)); // Duplicate
+  EXPECT_FALSE(tracker.Receive(9, first, count));
+
+  UdpSequenceTracker wrap;
+  EXPECT_TRUE(wrap.Receive(0xFFFFFFFF, first, count));
+  EXPECT_TRUE(wrap.Receive(0, first, count));
+  EXPECT_EQ(count, 0);
+  EXPECT_TRUE(wrap.Receive(2, first, count));
+  EXPECT_EQ(first, 1);
+  EXPECT_EQ(count, 1);
+}
+
+TEST(UdpDatagram, TestRetransmitWindow) {
+  UdpRetransmitWindow window;
+  window.Add(0, {1});
+  EXPECT_EQ(window.Find(0), nullptr); // Disabled
+
+  window.Size(4);
+  for (uint32_t sequence = 0; sequence < 6; ++sequence) {
+    window.Add(sequence, {static_cast<uint8_t>(sequence)});
+  }
+  EXPECT_EQ(window.Find(1), nullptr);
+  const auto* datagram = window.Find(5);
+  ASSERT_NE(datagram, nullptr);
+  EXPECT_EQ((*datagram)[0], 5);
+  EXPECT_EQ(window.Find(6), nullptr);
+
+  // Only the first request within the hold-off time is retransmitted.
+  const auto now = std::chrono::steady_clock::now();
+  EXPECT_NE(window.Resend(5, now, 20ms), nullptr);
+  EXPECT_EQ(window.Resend(5, now + 10ms, 20ms), nullptr);
+  EXPECT_NE(window.Resend(4, now + 10ms, 20ms), nullptr);
+  EXPECT_NE(window.Resend(5, now + 30ms, 20ms), nullptr);
+  EXPECT_EQ(window.Resend(6, now, 20ms), nullptr);
+  window.Add(9, {9}); // Replaces 5
+  EXPECT_NE(window.Resend(9, now + 31ms, 20ms), nullptr);
+}
+
+}  // namespace bus
@@ -0,0 +1,98 @@
+/*
+* Copyright 2025 Ingemar Hedvall
+* SPDX-License-Identifier: MIT
+ */
+#include <chrono>
+#include <memory>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "bus/interface/businterfacefactory.h"
+#include "bus/buslogstream.h"
+#include "bus/candataframe.h"
+
+using namespace std::chrono_literals;
+
+namespace bus {
+
+TEST(UdpMulticastBroker, TestPublishSubscribe) {
+  BusLogStream::UserLogFunction = BusLogStream::BusConsoleLogFunction;
+  BusLogStream::ResetErrorCount();
+
+  constexpr size_t max_messages = 10'000;
+
+  auto sender = BusInterfaceFactory::CreateBroker(
+    BrokerType::UdpMulticastType);
+  ASSERT_TRUE(sender);
+  sender->Name("UdpSender");
+  sender->Address("239.255.0.1");
+  sender->Port(42620);
+  sender->RetransmitWindow(1'024);
+
+  auto receiver = BusInterfaceFactory::CreateBroker(
+    BrokerType::UdpMulticastType);
+  ASSERT_TRUE(receiver);
+  receiver->Name("UdpReceiver");
+  receiver->Address("239.255.0.1");
+  receiver->Port(42620);
+  receiver->RetransmitWindow(1'024);
+
+  receiver->Start();
+  EXPECT_TRUE(receiver->IsConnected());
+  sender->Start();
+  EXPECT_TRUE(sender->IsConnected());
+
+  auto subscriber = receiver->CreateSubscriber();
+  ASSERT_TRUE(subscriber);
+  subscriber->Start();
+
+  auto publisher = sender->CreatePublisher();
+  ASSERT_TRUE(publisher);
+  publisher->Start();
+
+  for (size_t sample = 0; sample < max_messages; ++sample) {
+    auto msg = std::make_shared<CanDataFrame>();
+    msg->MessageId(0x100 + (sample % 10));
+    msg->DataBytes({1, 2, 3, 4, 5, 6, 7, static_cast<uint8_t>(sample)});
+    publisher->Push(msg);
+  }
+
+  for (size_t timeout = 0;
+       timeout < 100 && subscriber->Size() < max_messages;
+       ++timeout) {
+    std::this_thread::sleep_for(100ms);
+  }
+  EXPECT_EQ(subscriber->Size(), max_messages);
+  const auto msg = std::dynamic_pointer_cast<CanDataFrame>(subscriber->Pop());
+  ASSERT_TRUE(msg);
+  EXPECT_EQ(msg->MessageId(), 0x100);
+
+  const auto senders = receiver->Connections();
+  ASSERT_EQ(senders.size(), 1);
+  EXPECT_FALSE(senders[0].remote.empty());
+  EXPECT_EQ(senders[0].received_messages, max_messages);
+  EXPECT_EQ(senders[0].lost_datagrams, 0);
+
+  publisher->Stop();
+  subscriber->Stop();
+  sender->Stop();
+  receiver->Stop();
+
+  EXPECT_EQ(BusLogStream::ErrorCount(), 0);
+  BusLogStream::UserLogFunction = BusLogStream::BusNoLogFunction;
+}
+
+TEST(UdpMulticastBroker, TestNoGroup) {
+  BusLogStream::UserLogFunction = BusLogStream::BusNoLogFunction;
+  BusLogStream::ResetErrorCount();
+  auto broker = BusInterfaceFactory::CreateBroker(
+    BrokerType::UdpMulticastType);
+  ASSERT_TRUE(broker);
+  broker->Start();
+  EXPECT_FALSE(broker->IsConnected());
+  EXPECT_EQ(BusLogStream::ErrorCount(), 1);
+  EXPECT_TRUE(broker->Connections().empty());
+}
+
+}  // namespace bus
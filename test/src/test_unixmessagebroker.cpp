@@ -0,0 +1,142 @@
+/*
+* Copyright 2025 Ingemar Hedvall
+* SPDX-License-Identifier: MIT
+ */
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "bus/interface/businterfacefactory.h"
+#include "bus/buslogstream.h"
+#include "bus/candataframe.h"
+
+using namespace std::chrono_literals;
+
+namespace {
+
+std::string SocketPath() {
+  const auto path = std::filesystem::temp_directory_path() /
+                    "bus_message_test.sock";
+  return path.string();
+}
+
+void RoundTrip(bool zero_copy) {
+  constexpr size_t max_messages = 10'000;
+
+  auto broker = bus::BusInterfaceFactory::CreateBroker(
+    bus::BrokerType::UnixBrokerType);
+  ASSERT_TRUE(broker);
+  broker->Name("BusUnixTest");
+  broker->Address(SocketPath());
+  broker->Start();
+  ASSERT_TRUE(broker->IsConnected());
+  EXPECT_TRUE(std::filesystem::exists(SocketPath()));
+
+  auto client = bus::BusInterfaceFactory::CreateBroker(
+    bus::BrokerType::UnixClientType);
+  ASSERT_TRUE(client);
+  client->Name("BusUnixClient");
+  client->Address(SocketPath());
+  client->ZeroCopy(zero_copy);
+
+  auto client_subscriber = client->CreateSubscriber();
+  ASSERT_TRUE(client_subscriber);
+  client_subscriber->Start();
+
+  auto client_publisher = client->CreatePublisher();
+  ASSERT_TRUE(client_publisher);
+  client_publisher->Start();
+
+  client->Start();
+  ASSERT_TRUE(client->IsConnected());
+  std::this_thread::sleep_for(500ms); // Wait on the handshake
+
+  auto publisher = broker->CreatePublisher();
+  ASSERT_TRUE(publisher);
+  publisher->Start();
+
+  auto subscriber = broker->CreateSubscriber();
+  ASSERT_TRUE(subscriber);
+  subscriber->Start();
+
+  for (size_t sample = 0; sample < max_messages; ++sample) {
+    auto msg = std::make_shared<bus::CanDataFrame>();
+    msg->MessageId(0x100 + (sample % 10));
+    msg->DataBytes({1, 2, 3, 4, 5, 6, 7, static_cast<uint8_t>(sample)});
+    publisher->Push(msg);
+  }
+  for (size_t timeout = 0;
+       timeout < 100 && client_subscriber->Size() < max_messages;
+       ++timeout) {
+    std::this_thread::sleep_for(100ms);
+  }
+  EXPECT_EQ(client_subscriber->Size(), max_messages);
+  const auto first = std::dynamic_pointer_cast<bus::CanDataFrame>(
+      client_subscriber->Pop());
+  ASSERT_TRUE(first);
+  EXPECT_EQ(first->MessageId(), 0x100);
+
+  // The client publishes over the socket in both modes.
+  subscriber->Clear();
+  auto reply = std::make_shared<bus::CanDataFrame>();
+  reply->MessageId(0x200);
+  client_publisher->Push(reply);
+  for (size_t timeout = 0; timeout < 100 && subscriber->Empty(); ++timeout) {
+    std::this_thread::sleep_for(100ms);
+  }
+  EXPECT_FALSE(subscriber->Empty());
+
+  const auto connections = broker->Connections();
+  ASSERT_EQ(connections.size(), 1);
+  EXPECT_EQ(connections[0].remote, "local");
+  // The broker doesn't send any messages when the client maps the memory.
+  if (zero_copy) {
+    EXPECT_EQ(connections[0].sent_messages, 0);
+  } else {
+    EXPECT_GE(connections[0].sent_messages, max_messages);
+  }
+
+  client_publisher->Stop();
+  client_subscriber->Stop();
+  client->Stop();
+  publisher->Stop();
+  subscriber->Stop();
+  broker->Stop();
+  EXPECT_FALSE(std::filesystem::exists(SocketPath()));
+}
+
+} // end namespace
+
+namespace bus {
+
+TEST(UnixMessageBroker, TestPublishSubscribe) {
+  BusLogStream::UserLogFunction = BusLogStream::BusConsoleLogFunction;
+  BusLogStream::ResetErrorCount();
+  RoundTrip(false);
+  EXPECT_EQ(BusLogStream::ErrorCount(), 0);
+  BusLogStream::UserLogFunction = BusLogStream::BusNoLogFunction;
+}
+
+TEST(UnixMessageBroker, TestZeroCopy) {
+  BusLogStream::UserLogFunction = BusLogStream::BusConsoleLogFunction;
+  BusLogStream::ResetErrorCount();
+  RoundTrip(true);
+  EXPECT_EQ(BusLogStream::ErrorCount(), 0);
+  BusLogStream::UserLogFunction = BusLogStream::BusNoLogFunction;
+}
+
+TEST(UnixMessageBroker, TestNoPath) {
+  BusLogStream::UserLogFunction = BusLogStream::BusNoLogFunction;
+  BusLogStream::ResetErrorCount();
+  auto broker = BusInterfaceFactory::CreateBroker(BrokerType::UnixBrokerType);
+  ASSERT_TRUE(broker);
+  broker->Name("BusUnixTest");
+  broker->Start();
+  EXPECT_FALSE(broker->IsConnected());
+  EXPECT_EQ(BusLogStream::ErrorCount(), 1);
+}
+
+}  // namespace bus